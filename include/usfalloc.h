@@ -0,0 +1,83 @@
+#ifndef USFALLOC_H
+#define USFALLOC_H
+
+#include <string.h>
+#include "usfstd.h"
+#include "usfatomic.h"
+
+/* Allocator interface used by usflib2 containers
+ * Sizes are always passed back on realloc and free, so that allocators
+ * which do not keep per-allocation headers (arenas, pools) can honor them. */
+typedef struct usf_allocator {
+	void *(*alloc)(void *context, u64 size);
+	void *(*realloc)(void *context, void *pointer, u64 oldsize, u64 newsize);
+	void (*free)(void *context, void *pointer, u64 size);
+	void *context;
+} usf_allocator;
+
+#define USF_ALLOC_CACHELINE 64
+#define USF_ALLOC_HUGEPAGE (U64(2) * 1024 * 1024)	/* Transparent huge page size on x86-64 and most arm64 kernels */
+
+/* Huge page options of usf_alignalloc, for allocations of at least USF_ALLOC_HUGEPAGE bytes */
+#define USF_ALLOC_THP 1		/* Maps them aligned to a huge page and advises transparent huge pages */
+#define USF_ALLOC_HUGETLB 2	/* Maps them from the reserved huge page pool, else as with USF_ALLOC_THP */
+
+extern const usf_allocator usf_stdallocator; /* libc (usf_malloc) allocator, default for all containers */
+extern const usf_allocator usf_cachelineallocator; /* Cache line aligned memory */
+extern const usf_allocator usf_hugepageallocator; /* Cache line aligned memory, on transparent huge pages when large */
+
+/* Memory used by a container, in bytes */
+typedef struct usf_memusage {
+	u64 structure;	/* Container struct */
+	u64 array;		/* Occupied slots of the backing array */
+	u64 nodes;		/* Live nodes */
+	u64 keys;		/* Owned key copies */
+	u64 locks;		/* Lock objects */
+	u64 slack;		/* Allocated but unused capacity (free slots, pooled nodes) */
+	u64 total;
+} usf_memusage;
+
+/* Allocation counters */
+typedef struct usf_memstats {
+	u64 bytes;			/* Currently allocated */
+	u64 peak;			/* Highest value of bytes */
+	u64 allocations;
+	u64 frees;
+} usf_memstats;
+
+/* Tracking allocator attributing everything allocated through it to a tag
+ * Pass &tag->allocator to containers; memory is obtained from parent. */
+typedef struct usf_memtag {
+	usf_allocator allocator;
+	const usf_allocator *parent;
+	const char *name;
+	atomic_u64 bytes;
+	atomic_u64 peak;
+	atomic_u64 allocations;
+	atomic_u64 frees;
+} usf_memtag;
+
+/* Allocator returning memory aligned to a power of two, and optionally backed by huge pages
+ * Pass &aligned->allocator to containers; growth goes through it too and stays aligned. */
+typedef struct usf_alignalloc {
+	usf_allocator allocator;
+	u64 alignment;
+	u32 options;		/* USF_ALLOC_THP, USF_ALLOC_HUGETLB, or 0 */
+} usf_alignalloc;
+
+void *usf_amalloc(const usf_allocator *allocator, u64 size);
+void *usf_acalloc(const usf_allocator *allocator, u64 n, u64 size);
+void *usf_arealloc(const usf_allocator *allocator, void *pointer, u64 oldsize, u64 newsize);
+void usf_afree(const usf_allocator *allocator, void *pointer, u64 size);
+
+void usf_memtrack(u8 enable);
+usf_memstats usf_memglobal(void);
+
+usf_memtag *usf_newmemtag(const char *name, const usf_allocator *parent);
+usf_memstats usf_memtagstats(const usf_memtag *tag);
+void usf_freememtag(usf_memtag *tag);
+
+usf_alignalloc *usf_newalignalloc(u64 alignment, u32 options);
+void usf_freealignalloc(usf_alignalloc *aligned);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef USFARENA_H
+#define USFARENA_H
+
+#include <string.h>
+#include <stddef.h>
+#include "usfstd.h"
+#include "usfmath.h"
+#include "usfalloc.h"
+#include "usfthread.h"
+
+#define USF_ARENA_DEFAULTCHUNKSIZE (U64(1) << 16)
+#define USF_ARENA_ALIGNMENT alignof(max_align_t)
+
+typedef struct usf_arenachunk {
+	struct usf_arenachunk *prev;
+	u64 size; /* Usable bytes after the header */
+} usf_arenachunk;
+
+typedef struct usf_arena {
+	usf_allocator allocator;	/* Pass &arena->allocator to *_alloc constructors */
+	usf_arenachunk *chunk;		/* Current chunk; earlier ones are linked through prev */
+	u64 offset;					/* Bump offset into the current chunk */
+	u64 chunksize;
+	void *last;					/* Most recent allocation, which can be resized or freed in place */
+} usf_arena;
+
+typedef struct usf_arenamark {
+	usf_arenachunk *chunk;
+	u64 offset;
+} usf_arenamark;
+
+usf_arena *usf_newarena(void);
+usf_arena *usf_newarenasz(u64 chunksize);
+
+void *usf_arenaalloc(usf_arena *arena, u64 size);
+void *usf_arenaalalloc(usf_arena *arena, u64 size, u64 alignment);
+usf_arenamark usf_arenasave(const usf_arena *arena);
+void usf_arenarewind(usf_arena *arena, usf_arenamark mark);
+void usf_arenareset(usf_arena *arena);
+
+usf_arena *usf_threadarena(void);
+void usf_freethreadarena(void);
+
+void usf_freearena(usf_arena *arena);
+
+#endif
@@ -20,8 +20,8 @@ typedef _Atomic(i64) atomic_i64;
 typedef _Atomic(u8) atomic_u8;
 
 typedef _Atomic(u16) atomic_u16;
-typedef _Atomic(u16) atomic_u32;
-typedef _Atomic(u16) atomic_u64;
+typedef _Atomic(u32) atomic_u32;
+typedef _Atomic(u64) atomic_u64;
 typedef _Atomic(f32) atomic_f32;
 typedef _Atomic(f64) atomic_f64;
 
@@ -0,0 +1,46 @@
+#ifndef USFBITSET_H
+#define USFBITSET_H
+
+#include <string.h>
+#include "usfstd.h"
+#include "usfmath.h"
+#include "usfthread.h"
+#include "usfalloc.h"
+
+#define USF_BITSET_RANKWORDS U64(8)	/* Words per rank index block, a cache line of bits */
+
+typedef struct usf_bitset {
+	usf_mutex *lock;
+	u64 *words;					/* Bits past size are kept cleared */
+	u64 size;					/* In bits */
+	u64 nwords;
+	u64 *ranks;					/* Set bits before each block of USF_BITSET_RANKWORDS words, then in total */
+	u8 stale;					/* Set when ranks no longer matches words */
+	const usf_allocator *allocator;
+} usf_bitset;
+
+usf_bitset *usf_newbitset(u64 size);
+usf_bitset *usf_newbitset_ts(u64 size);
+usf_bitset *usf_newbitset_alloc(u64 size, const usf_allocator *allocator);
+usf_bitset *usf_newbitset_ts_alloc(u64 size, const usf_allocator *allocator);
+
+usf_bitset *usf_bitsetset(usf_bitset *bitset, u64 i);						/* Thread-safe */
+usf_bitset *usf_bitsetclear(usf_bitset *bitset, u64 i);					/* Thread-safe */
+u8 usf_bitsettest(const usf_bitset *bitset, u64 i);						/* Thread-safe */
+usf_bitset *usf_bitsetfill(usf_bitset *bitset, u8 value);					/* Thread-safe */
+usf_bitset *usf_bitsetresize(usf_bitset *bitset, u64 size);				/* Thread-safe */
+
+usf_bitset *usf_bitsetand(usf_bitset *dst, const usf_bitset *src);			/* Thread-safe */
+usf_bitset *usf_bitsetor(usf_bitset *dst, const usf_bitset *src);			/* Thread-safe */
+usf_bitset *usf_bitsetxor(usf_bitset *dst, const usf_bitset *src);			/* Thread-safe */
+usf_bitset *usf_bitsetandnot(usf_bitset *dst, const usf_bitset *src);		/* Thread-safe */
+
+u64 usf_bitsetcount(const usf_bitset *bitset);								/* Thread-safe */
+u64 usf_bitsetnext(const usf_bitset *bitset, u64 i);						/* Thread-safe */
+u64 usf_bitsetrank(usf_bitset *bitset, u64 i);								/* Thread-safe */
+u64 usf_bitsetselect(usf_bitset *bitset, u64 k);							/* Thread-safe */
+usf_memusage usf_bitsetmemusage(const usf_bitset *bitset);					/* Thread-safe */
+
+void usf_freebitset(usf_bitset *bitset);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef USFBTREE_H
+#define USFBTREE_H
+
+#include <string.h>
+#include "usfstd.h"
+#include "usfdata.h"
+#include "usfthread.h"
+#include "usfalloc.h"
+#include "usfpool.h"
+#include "usfmath.h"
+
+#define USF_BTREE_NKEYS 32							/* Keys per node, four cache lines of them */
+#define USF_BTREE_MINKEYS (USF_BTREE_NKEYS / 2)	/* Below this, non-root nodes are rebalanced */
+#define USF_BTREE_MAXDEPTH 16						/* Far more than 2^64 keys need */
+
+typedef struct usf_btnode {
+	u64 keys[USF_BTREE_NKEYS];	/* Sorted; unused keys are U64_MAX so that searches can scan whole nodes */
+	u32 nkeys;
+	u32 leaf;
+	union {
+		struct usf_btnode *children[USF_BTREE_NKEYS + 1];	/* Inner nodes: children[k + 1] starts at keys[k] */
+		usf_data values[USF_BTREE_NKEYS];					/* Leaves */
+	};
+	struct usf_btnode *next;	/* Leaves only, in index order */
+} usf_btnode;
+
+typedef struct usf_btree {
+	usf_mutex *lock;
+	usf_btnode *root;		/* NULL when empty */
+	u64 size;
+	u64 depth;				/* Levels of inner nodes above the leaves */
+	u64 nnodes;
+	usf_pool *nodes;		/* Protected by lock */
+	const usf_allocator *allocator;
+} usf_btree;
+
+usf_btree *usf_newbt(void);
+usf_btree *usf_newbt_ts(void);
+usf_btree *usf_newbt_alloc(const usf_allocator *allocator);
+usf_btree *usf_newbt_ts_alloc(const usf_allocator *allocator);
+usf_btree *usf_btfromsorted(const u64 *indices, const usf_data *data, u64 n);
+usf_btree *usf_btfromsorted_ts(const u64 *indices, const usf_data *data, u64 n);
+usf_btree *usf_btfromsorted_alloc(const u64 *indices, const usf_data *data, u64 n,
+		const usf_allocator *allocator);
+usf_btree *usf_btfromsorted_ts_alloc(const u64 *indices, const usf_data *data, u64 n,
+		const usf_allocator *allocator);
+
+usf_btree *usf_btset(usf_btree *btree, u64 i, usf_data data);	/* Thread-safe */
+usf_data usf_btget(const usf_btree *btree, u64 i);				/* Thread-safe */
+usf_data usf_btdel(usf_btree *btree, u64 i);					/* Thread-safe */
+u64 usf_btrange(usf_btree *btree, u64 lo, u64 hi,
+		void (*callback)(u64 index, usf_data data, void *context), void *context);	/* Thread-safe */
+usf_memusage usf_btmemusage(const usf_btree *btree);			/* Thread-safe */
+
+void usf_freebtfunc(usf_btree *btree, void (*freefunc)(void *));
+void usf_freebt(usf_btree *btree);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef USFFUTURE_H
+#define USFFUTURE_H
+
+#include <time.h>
+#include "usfstd.h"
+#include "usfdata.h"
+#include "usfthread.h"
+#include "usfatomic.h"
+
+typedef struct usf_futurecont {
+	void (*callback)(usf_data value, void *context, u64 tag);
+	void (*destroy)(void *context); /* Releases context if the continuation is discarded unrun */
+	void *context;
+	u64 tag;
+	usf_data value; /* Set when the continuation is queued to run */
+	struct usf_futurecont *next;
+} usf_futurecont;
+
+typedef struct usf_future {
+	usf_mutex lock;
+	usf_cond cond;
+	usf_data value;
+	u32 ready;
+	usf_futurecont *continuations;
+} usf_future;
+
+usf_future *usf_newfuture(void);
+usf_future *usf_async(usf_data (*func)(void *), void *arg);
+
+usf_future *usf_futureset(usf_future *future, usf_data value);								/* Thread-safe */
+usf_data usf_futureget(usf_future *future);													/* Thread-safe */
+void usf_futurewait(usf_future *future);													/* Thread-safe */
+i32 usf_futuretimedwait(usf_future *future, const struct timespec *timeout);				/* Thread-safe */
+i32 usf_futureready(usf_future *future);													/* Thread-safe */
+usf_future *usf_futurethen(usf_future *future, usf_data (*func)(usf_data, void *), void *arg);	/* Thread-safe */
+usf_future *usf_futurewhenall(usf_future *const *futures, u64 n);							/* Thread-safe */
+usf_future *usf_futurewhenany(usf_future *const *futures, u64 n);							/* Thread-safe */
+
+void usf_freefuture(usf_future *future);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef USFGAPLIST_H
+#define USFGAPLIST_H
+
+#include <string.h>
+#include "usfstd.h"
+#include "usfdata.h"
+#include "usfmath.h"
+#include "usfthread.h"
+#include "usfalloc.h"
+
+#define USF_GAPLIST_DEFAULTSIZE 16
+#define USF_GAPLIST_RESIZE_MULTIPLIER 2
+
+/* Generic gap buffer list declaration for multiple possible underlying types
+ * Elements [0, gap) start the array and the others end it, with the free capacity in between:
+ * inserting or deleting at the gap is O(1), and moving the gap costs the distance it moves. */
+#define USF_GAPLISTDECL(_TYPE, _NAME) \
+	typedef struct usf_gaplist##_NAME { \
+		usf_mutex *lock; \
+		_TYPE *array; \
+		u64 size; \
+		u64 capacity; \
+		u64 gap; /* Index of the cursor, where the free capacity lies */ \
+		const usf_allocator *allocator; \
+	} usf_gaplist##_NAME; \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME(void); \
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##_ts(void); \
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##sz(u64 capacity); \
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##sz_ts(u64 capacity); \
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##_alloc(const usf_allocator *allocator); \
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##_ts_alloc(const usf_allocator *allocator); \
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##sz_alloc(u64 capacity, const usf_allocator *allocator); \
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##sz_ts_alloc(u64 capacity, const usf_allocator *allocator); \
+	\
+	usf_gaplist##_NAME *usf_gaplist##_NAME##set(usf_gaplist##_NAME *list, u64 i, _TYPE data);	/* Thread-safe */ \
+	usf_gaplist##_NAME *usf_gaplist##_NAME##ins(usf_gaplist##_NAME *list, u64 i, _TYPE data);	/* Thread-safe */ \
+	usf_gaplist##_NAME *usf_gaplist##_NAME##add(usf_gaplist##_NAME *list, _TYPE data);			/* Thread-safe */ \
+	usf_gaplist##_NAME *usf_gaplist##_NAME##seek(usf_gaplist##_NAME *list, u64 i);				/* Thread-safe */ \
+	_TYPE usf_gaplist##_NAME##get(const usf_gaplist##_NAME *list, u64 i);						/* Thread-safe */ \
+	_TYPE usf_gaplist##_NAME##del(usf_gaplist##_NAME *list, u64 i);								/* Thread-safe */ \
+	u64 usf_gaplist##_NAME##copy(const usf_gaplist##_NAME *list, u64 i, u64 n, _TYPE *dst);		/* Thread-safe */ \
+	usf_memusage usf_gaplist##_NAME##memusage(const usf_gaplist##_NAME *list);				/* Thread-safe */ \
+	\
+	void usf_freegaplist##_NAME##func(usf_gaplist##_NAME *list, void (*freefunc)(_TYPE)); \
+	void usf_freegaplist##_NAME(usf_gaplist##_NAME *list);
+USF_GAPLISTDECL(i8, i8)
+USF_GAPLISTDECL(i16, i16)
+USF_GAPLISTDECL(i32, i32)
+USF_GAPLISTDECL(i64, i64)
+USF_GAPLISTDECL(u8, u8)
+USF_GAPLISTDECL(u16, u16)
+USF_GAPLISTDECL(u32, u32)
+USF_GAPLISTDECL(u64, u64)
+USF_GAPLISTDECL(f32, f32)
+USF_GAPLISTDECL(f64, f64)
+USF_GAPLISTDECL(void *, ptr)
+USF_GAPLISTDECL(usf_data, )
+#undef USF_GAPLISTDECL
+
+#endif
@@ -6,6 +6,7 @@
 #include "usfmath.h"
 #include "usfthread.h"
 #include "usfatomic.h"
+#include "usfalloc.h"
 
 #define USF_HASHMAP_DEFAULTSIZE 16
 #define USF_HASHMAP_RESIZE_MULTIPLIER 2
@@ -28,6 +29,7 @@ typedef struct usf_hashmap {
 	usf_hashentry *array;
 	u64 size;
 	u64 capacity;
+	const usf_allocator *allocator;
 } usf_hashmap;
 
 typedef struct usf_hashiter {
@@ -41,6 +43,10 @@ usf_hashmap *usf_newhm(void);
 usf_hashmap *usf_newhm_ts(void);
 usf_hashmap *usf_newhmsz(u64 capacity);
 usf_hashmap *usf_newhmsz_ts(u64 capacity);
+usf_hashmap *usf_newhm_alloc(const usf_allocator *allocator);
+usf_hashmap *usf_newhm_ts_alloc(const usf_allocator *allocator);
+usf_hashmap *usf_newhmsz_alloc(u64 capacity, const usf_allocator *allocator);
+usf_hashmap *usf_newhmsz_ts_alloc(u64 capacity, const usf_allocator *allocator);
 
 usf_hashmap *usf_strhmput(usf_hashmap *hashmap, const char *key, usf_data value);
 usf_data usf_strhmget(const usf_hashmap *hashmap, const char *key);
@@ -54,6 +60,8 @@ void usf_hmiterskim(usf_hashmap *hashmap, usf_hashiter *iter);
 usf_hashentry *usf_hmiternext(usf_hashiter *iter);
 void usf_hmiterend(usf_hashiter *iter);
 
+usf_memusage usf_hmmemusage(const usf_hashmap *hashmap);	/* Thread-safe */
+
 void usf_hmclearfunc(usf_hashmap *hashmap, void (*freefunc)(void *));
 void usf_hmclear(usf_hashmap *hashmap);
 void usf_freehmfunc(usf_hashmap *hashmap, void (*freefunc)(void *));
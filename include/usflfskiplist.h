@@ -0,0 +1,50 @@
+#ifndef USFLFSKIPLIST_H
+#define USFLFSKIPLIST_H
+
+#include "usfstd.h"
+#include "usfdata.h"
+#include "usfmath.h"
+#include "usfatomic.h"
+#include "usfthread.h"
+#include "usfalloc.h"
+
+#define USF_LFSKIPLIST_FRAMESIZE 24		/* Maximum node height */
+#define USF_LFSKIPLIST_NSLOTS 64		/* Threads operating on one skiplist at once */
+
+/* Bytes taken by a lock-free skipnode of the given height */
+#define USF_LFSKIPNODESIZE(_HEIGHT) (sizeof(usf_lfskipnode) + (_HEIGHT) * sizeof(atomic_u64))
+
+typedef struct usf_lfskipnode {
+	atomic_u64 data;					/* usf_data bits */
+	u64 index;
+	u64 height;
+	atomic_u32 owners;					/* Inserter and deleter; the last one done retires the node */
+	struct usf_lfskipnode *retired;		/* Next node awaiting reclamation */
+	atomic_u64 nextnodes[];				/* Links; the low bit marks this node as deleted at that level */
+} usf_lfskipnode;
+
+typedef struct usf_lfskipslot {
+	atomic_u64 state;	/* Pinned epoch << 1 | 1, or 0 when free */
+	u8 padding[56];		/* One cache line per slot to avoid false sharing */
+} usf_lfskipslot;
+
+typedef struct usf_lfskiplist {
+	atomic_u64 base[USF_LFSKIPLIST_FRAMESIZE];
+	atomic_u64 size;
+	atomic_u64 epoch;
+	_Atomic(usf_lfskipnode *) retired[3];	/* Unlinked nodes by epoch of retirement */
+	usf_lfskipslot slots[USF_LFSKIPLIST_NSLOTS];
+	const usf_allocator *allocator;
+} usf_lfskiplist;
+
+usf_lfskiplist *usf_newlfsk(void);
+usf_lfskiplist *usf_newlfsk_alloc(const usf_allocator *allocator);
+
+usf_lfskiplist *usf_lfskset(usf_lfskiplist *skiplist, u64 i, usf_data data);	/* Thread-safe */
+usf_data usf_lfskget(usf_lfskiplist *skiplist, u64 i);							/* Thread-safe */
+usf_data usf_lfskdel(usf_lfskiplist *skiplist, u64 i);							/* Thread-safe */
+
+void usf_freelfskfunc(usf_lfskiplist *skiplist, void (*freefunc)(void *));
+void usf_freelfsk(usf_lfskiplist *skiplist);
+
+#endif
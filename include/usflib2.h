@@ -4,13 +4,24 @@
 #include "usfstd.h"
 #include "usfaesc.h"
 #include "usfdata.h"
+#include "usfalloc.h"
+#include "usfarena.h"
+#include "usfpool.h"
 
 #include "usfstring.h"
 #include "usfhashmap.h"
 #include "usfdynarr.h" /* DEPRECATED */
 #include "usfskiplist.h"
+#include "usflfskiplist.h"
+#include "usfbtree.h"
+#include "usfgaplist.h"
+#include "usfrope.h"
+#include "usfseglist.h"
+#include "usfbitset.h"
+#include "usfpacklist.h"
 #include "usfqueue.h"
 #include "usfio.h"
 #include "usfmath.h"
+#include "usffuture.h"
 
 #endif
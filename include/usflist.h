@@ -6,9 +6,42 @@
 #include "usfdata.h"
 #include "usfmath.h"
 #include "usfthread.h"
+#include "usfalloc.h"
+#include "usfatomic.h"
 
 #define USF_LIST_DEFAULTSIZE 16
 #define USF_LIST_RESIZE_MULTIPLIER 2
+#define USF_LIST_INSERTIONSORT 32	/* Ranges this small are insertion sorted */
+#define USF_LIST_MAXSORTTHREADS 64
+#define USF_LIST_MAPMAGIC 0x005453494C465355	/* "USFLIST" at the start of list files */
+#define USF_LIST_LANES 16			/* Independent accumulators in reductions, enough to fill vector registers */
+
+typedef struct usf_listretired {
+	struct usf_listretired *next;
+	void *array;
+	u64 size;					/* In bytes */
+} usf_listretired;
+
+typedef struct usf_listcc {
+	atomic_u64 claimed;			/* Slots handed out to adders */
+	atomic_u64 writers;			/* Adders in flight */
+	atomic_u8 paused;			/* Set while a locked operation keeps adders out */
+	usf_listretired *retired;	/* Replaced arrays, which readers may still hold; protected by lock */
+} usf_listcc;
+
+typedef struct usf_listmapheader {
+	u64 magic;					/* USF_LIST_MAPMAGIC */
+	u64 elemsize;
+	u64 size;					/* As of the last sync */
+	u64 reserved[5];			/* Keeps the array cache line aligned */
+} usf_listmapheader;
+
+typedef struct usf_listmap {
+	i32 fd;
+	u8 writable;
+	void *base;					/* Mapping of the whole file: a usf_listmapheader, then the list array */
+	u64 length;					/* In bytes */
+} usf_listmap;
 
 /* Generic list declaration for multiple possible underlying types */
 #define USF_LISTDECL(_TYPE, _NAME) \
@@ -17,18 +50,36 @@
 		_TYPE *array; \
 		u64 size; \
 		u64 capacity; \
+		usf_listcc *cc; /* Concurrent lists only */ \
+		usf_listmap *map; /* Mapped lists only */ \
+		const usf_allocator *allocator; \
 	} usf_list##_NAME; \
 	\
 	usf_list##_NAME *usf_newlist##_NAME(void); \
 	usf_list##_NAME *usf_newlist##_NAME##_ts(void); \
 	usf_list##_NAME *usf_newlist##_NAME##sz(u64 capacity); \
 	usf_list##_NAME *usf_newlist##_NAME##sz_ts(u64 capacity); \
+	usf_list##_NAME *usf_newlist##_NAME##_alloc(const usf_allocator *allocator); \
+	usf_list##_NAME *usf_newlist##_NAME##_ts_alloc(const usf_allocator *allocator); \
+	usf_list##_NAME *usf_newlist##_NAME##sz_alloc(u64 capacity, const usf_allocator *allocator); \
+	usf_list##_NAME *usf_newlist##_NAME##sz_ts_alloc(u64 capacity, const usf_allocator *allocator); \
+	usf_list##_NAME *usf_newlist##_NAME##_cc(void); \
+	usf_list##_NAME *usf_newlist##_NAME##sz_cc(u64 capacity); \
+	usf_list##_NAME *usf_newlist##_NAME##_cc_alloc(const usf_allocator *allocator); \
+	usf_list##_NAME *usf_newlist##_NAME##sz_cc_alloc(u64 capacity, const usf_allocator *allocator); \
 	\
 	usf_list##_NAME *usf_list##_NAME##set(usf_list##_NAME *list, u64 i, _TYPE data);	/* Thread-safe */ \
 	usf_list##_NAME *usf_list##_NAME##ins(usf_list##_NAME *list, u64 i, _TYPE data);	/* Thread-safe */ \
 	usf_list##_NAME *usf_list##_NAME##add(usf_list##_NAME *list, _TYPE data);			/* Thread-safe */ \
+	usf_list##_NAME *usf_list##_NAME##addn(usf_list##_NAME *list, _TYPE const *src, u64 n);	/* Thread-safe */ \
+	usf_list##_NAME *usf_list##_NAME##extend(usf_list##_NAME *list, const usf_list##_NAME *other);	/* Thread-safe */ \
+	usf_list##_NAME *usf_list##_NAME##reserve(usf_list##_NAME *list, u64 capacity);		/* Thread-safe */ \
+	usf_list##_NAME *usf_list##_NAME##shrink(usf_list##_NAME *list);					/* Thread-safe */ \
 	_TYPE usf_list##_NAME##get(const usf_list##_NAME *list, u64 i);						/* Thread-safe */ \
 	_TYPE usf_list##_NAME##del(usf_list##_NAME *list, u64 i);							/* Thread-safe */ \
+	usf_list##_NAME *usf_list##_NAME##sortby(usf_list##_NAME *list, \
+			i32 (*compare)(const void *, const void *));									/* Thread-safe */ \
+	usf_memusage usf_list##_NAME##memusage(const usf_list##_NAME *list);				/* Thread-safe */ \
 	\
 	void usf_freelist##_NAME##func(usf_list##_NAME *list, void (*freefunc)(_TYPE)); \
 	void usf_freelist##_NAME(usf_list##_NAME *list);
@@ -46,4 +97,66 @@ USF_LISTDECL(void *, ptr)
 USF_LISTDECL(usf_data, )
 #undef USF_LISTDECL
 
+/* Lists of numeric types stored in memory-mapped files */
+#define USF_LISTMAPDECL(_NAME) \
+	usf_list##_NAME *usf_newlist##_NAME##map(const char *path, const char *mode); \
+	usf_list##_NAME *usf_newlist##_NAME##map_ts(const char *path, const char *mode); \
+	usf_list##_NAME *usf_list##_NAME##sync(usf_list##_NAME *list);					/* Thread-safe */
+USF_LISTMAPDECL(i8)
+USF_LISTMAPDECL(i16)
+USF_LISTMAPDECL(i32)
+USF_LISTMAPDECL(i64)
+USF_LISTMAPDECL(u8)
+USF_LISTMAPDECL(u16)
+USF_LISTMAPDECL(u32)
+USF_LISTMAPDECL(u64)
+USF_LISTMAPDECL(f32)
+USF_LISTMAPDECL(f64)
+#undef USF_LISTMAPDECL
+
+/* Sorting in natural order for numeric list types */
+#define USF_LISTSORTDECL(_NAME) \
+	usf_list##_NAME *usf_list##_NAME##sort(usf_list##_NAME *list);					/* Thread-safe */ \
+	usf_list##_NAME *usf_list##_NAME##psort(usf_list##_NAME *list, u64 nthreads);	/* Thread-safe */
+USF_LISTSORTDECL(i8)
+USF_LISTSORTDECL(i16)
+USF_LISTSORTDECL(i32)
+USF_LISTSORTDECL(i64)
+USF_LISTSORTDECL(u8)
+USF_LISTSORTDECL(u16)
+USF_LISTSORTDECL(u32)
+USF_LISTSORTDECL(u64)
+USF_LISTSORTDECL(f32)
+USF_LISTSORTDECL(f64)
+#undef USF_LISTSORTDECL
+
+/* Vectorized reductions and searches for numeric list types, and raw arrays of them */
+#define USF_LISTREDUCEDECL(_TYPE, _NAME, _ACC) \
+	_ACC usf_arr##_NAME##sum(const _TYPE *array, u64 n); \
+	_TYPE usf_arr##_NAME##min(const _TYPE *array, u64 n); \
+	_TYPE usf_arr##_NAME##max(const _TYPE *array, u64 n); \
+	void usf_arr##_NAME##minmax(const _TYPE *array, u64 n, _TYPE *min, _TYPE *max); \
+	u64 usf_arr##_NAME##count(const _TYPE *array, u64 n, _TYPE value); \
+	u64 usf_arr##_NAME##find(const _TYPE *array, u64 n, _TYPE value); \
+	_ACC usf_arr##_NAME##dot(const _TYPE *a, const _TYPE *b, u64 n); \
+	\
+	_ACC usf_list##_NAME##sum(const usf_list##_NAME *list);								/* Thread-safe */ \
+	_TYPE usf_list##_NAME##min(const usf_list##_NAME *list);							/* Thread-safe */ \
+	_TYPE usf_list##_NAME##max(const usf_list##_NAME *list);							/* Thread-safe */ \
+	void usf_list##_NAME##minmax(const usf_list##_NAME *list, _TYPE *min, _TYPE *max);	/* Thread-safe */ \
+	u64 usf_list##_NAME##count(const usf_list##_NAME *list, _TYPE value);				/* Thread-safe */ \
+	u64 usf_list##_NAME##find(const usf_list##_NAME *list, _TYPE value);				/* Thread-safe */ \
+	_ACC usf_list##_NAME##dot(const usf_list##_NAME *a, const usf_list##_NAME *b);		/* Thread-safe */
+USF_LISTREDUCEDECL(i8, i8, i64)
+USF_LISTREDUCEDECL(i16, i16, i64)
+USF_LISTREDUCEDECL(i32, i32, i64)
+USF_LISTREDUCEDECL(i64, i64, i64)
+USF_LISTREDUCEDECL(u8, u8, u64)
+USF_LISTREDUCEDECL(u16, u16, u64)
+USF_LISTREDUCEDECL(u32, u32, u64)
+USF_LISTREDUCEDECL(u64, u64, u64)
+USF_LISTREDUCEDECL(f32, f32, f64)
+USF_LISTREDUCEDECL(f64, f64, f64)
+#undef USF_LISTREDUCEDECL
+
 #endif
@@ -50,6 +50,7 @@
 
 u64 usf_strhash(const char *str);
 u64 usf_hash(u64 val);
+u64 usf_xorshift(u64 *state);
 
 /* Generic math functions */
 i32 usf_indcmpi32(const void *a, const void *b);
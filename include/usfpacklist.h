@@ -0,0 +1,51 @@
+#ifndef USFPACKLIST_H
+#define USFPACKLIST_H
+
+#include <string.h>
+#include "usfstd.h"
+#include "usfmath.h"
+#include "usfthread.h"
+#include "usfalloc.h"
+
+#define USF_PACKLIST_BLOCKSIZE U64(128)	/* Values per packed block */
+#define USF_PACKLIST_DEFAULTBLOCKS 4
+
+typedef struct usf_packblock {
+	u64 first;					/* First value, from which the next ones are stored as deltas */
+	u64 offset;					/* Index of the first word of the block in the packed data */
+	u64 width;					/* Bits per delta, the block taking 2 * width words */
+} usf_packblock;
+
+/* Sorted u64 list stored as blocks of bit-packed deltas. The last values, until they fill
+ * a block, are kept unpacked in the tail; blocks double as skip pointers to any index or value. */
+typedef struct usf_packlist {
+	usf_mutex *lock;
+	usf_packblock *blocks;
+	u64 nblocks;
+	u64 blockcapacity;
+	u64 *data;					/* Packed deltas of all blocks */
+	u64 datasize;				/* In words */
+	u64 datacapacity;
+	u64 tail[USF_PACKLIST_BLOCKSIZE];
+	u64 ntail;
+	u64 size;
+	const usf_allocator *allocator;
+} usf_packlist;
+
+usf_packlist *usf_newpacklist(void);
+usf_packlist *usf_newpacklist_ts(void);
+usf_packlist *usf_newpacklist_alloc(const usf_allocator *allocator);
+usf_packlist *usf_newpacklist_ts_alloc(const usf_allocator *allocator);
+
+usf_packlist *usf_packlistadd(usf_packlist *list, u64 value);								/* Thread-safe */
+usf_packlist *usf_packlistaddn(usf_packlist *list, const u64 *values, u64 n);				/* Thread-safe */
+u64 usf_packlistget(const usf_packlist *list, u64 i);										/* Thread-safe */
+u64 usf_packlistcopy(const usf_packlist *list, u64 i, u64 n, u64 *dst);						/* Thread-safe */
+u64 usf_packlistfind(const usf_packlist *list, u64 value);									/* Thread-safe */
+usf_packlist *usf_packlistintersect(const usf_packlist *a, const usf_packlist *b);			/* Thread-safe */
+usf_packlist *usf_packlistunion(const usf_packlist *a, const usf_packlist *b);				/* Thread-safe */
+usf_memusage usf_packlistmemusage(const usf_packlist *list);								/* Thread-safe */
+
+void usf_freepacklist(usf_packlist *list);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef USFPOOL_H
+#define USFPOOL_H
+
+#include <stddef.h>
+#include "usfstd.h"
+#include "usfalloc.h"
+#include "usfatomic.h"
+#include "usfthread.h"
+#include "usfmath.h"
+
+#define USF_POOL_MINSLABSIZE 16		/* Objects in the first slab; each new slab doubles up to */
+#define USF_POOL_MAXSLABSIZE 4096	/* this many objects */
+#define USF_POOL_NCACHES 16			/* Thread caches of thread-safe pools */
+#define USF_POOL_CACHESIZE 64		/* Objects a thread cache holds before spilling back to the pool */
+
+typedef struct usf_poolslab {
+	struct usf_poolslab *next;
+	u64 nobjects;
+} usf_poolslab;
+
+typedef struct usf_poolcache {
+	atomic_flag lock;
+	void *freelist;
+	void *last;
+	u64 count;
+	u8 padding[32]; /* One cache line per cache to avoid false sharing */
+} usf_poolcache;
+
+typedef struct usf_pool {
+	usf_mutex *lock;
+	usf_poolcache *caches;		/* Thread-safe pools only */
+	void *freelist;
+	usf_poolslab *slabs;
+	usf_poolslab *freshslab;	/* Slab being carved out */
+	u64 nfresh;					/* Objects left to carve out of freshslab */
+	u64 objsize;
+	u64 slabsize;				/* Objects in the next slab */
+	const usf_allocator *allocator;
+} usf_pool;
+
+usf_pool *usf_newpool(u64 objsize);
+usf_pool *usf_newpool_ts(u64 objsize);
+usf_pool *usf_newpool_alloc(u64 objsize, const usf_allocator *allocator);
+usf_pool *usf_newpool_ts_alloc(u64 objsize, const usf_allocator *allocator);
+
+void *usf_poolalloc(usf_pool *pool);				/* Thread-safe */
+void usf_poolfree(usf_pool *pool, void *object);	/* Thread-safe */
+void usf_poolreset(usf_pool *pool);
+u64 usf_poolbytes(const usf_pool *pool);
+
+void usf_freepool(usf_pool *pool);
+
+#endif
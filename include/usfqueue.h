@@ -4,6 +4,8 @@
 #include "usfstd.h"
 #include "usfdata.h"
 #include "usfthread.h"
+#include "usfalloc.h"
+#include "usfpool.h"
 
 typedef struct usf_queuenode {
 	usf_data data;
@@ -15,13 +17,18 @@ typedef struct usf_queue {
 	u64 size;
 	usf_queuenode *first;
 	usf_queuenode *last;
+	usf_pool *pool;		/* Nodes; protected by lock */
+	const usf_allocator *allocator;
 } usf_queue;
 
 usf_queue *usf_newqueue(void);
 usf_queue *usf_newqueue_ts(void);
+usf_queue *usf_newqueue_alloc(const usf_allocator *allocator);
+usf_queue *usf_newqueue_ts_alloc(const usf_allocator *allocator);
 
 usf_queue *usf_enqueue(usf_queue *queue, usf_data data);	/* Thread-safe */
 usf_data usf_dequeue(usf_queue *queue);						/* Thread-safe */
+usf_memusage usf_queuememusage(const usf_queue *queue);		/* Thread-safe */
 
 void usf_freequeuefunc(usf_queue *queue, void (*freefunc)(void *));
 void usf_freequeue(usf_queue *queue);
@@ -0,0 +1,76 @@
+#ifndef USFROPE_H
+#define USFROPE_H
+
+#include <string.h>
+#include "usfstd.h"
+#include "usfdata.h"
+#include "usfmath.h"
+#include "usfthread.h"
+#include "usfalloc.h"
+
+#define USF_ROPE_LEAFSIZE 1024		/* Bytes of elements per leaf */
+#define USF_ROPE_FANOUT 32			/* Children per inner node */
+#define USF_ROPE_MAXDEPTH 16		/* Far more than 2^64 elements need */
+
+typedef struct usf_ropeleaf {
+	u64 count;
+	u8 elements[USF_ROPE_LEAFSIZE];
+} usf_ropeleaf;
+
+typedef struct usf_ropenode {
+	u64 counts[USF_ROPE_FANOUT];	/* Elements under each child */
+	void *children[USF_ROPE_FANOUT];	/* Inner nodes, or leaves on the bottom level */
+	u64 nchildren;
+} usf_ropenode;
+
+/* Element type independent rope, wrapped by the typed ones */
+typedef struct usf_ropebase {
+	usf_mutex *lock;
+	void *root;						/* A leaf when depth is 0, NULL when empty */
+	u64 size;
+	u64 depth;						/* Levels of inner nodes above the leaves */
+	u64 elemsize;
+	u64 leafcapacity;				/* Elements per leaf */
+	u64 nleaves;
+	u64 nnodes;
+	const usf_allocator *allocator;
+} usf_ropebase;
+
+/* Generic rope declaration for multiple possible underlying types
+ * A rope is a list split in chunks held by a tree counting the elements under each
+ * subtree, so that accessing, inserting or deleting at any index is O(log n). */
+#define USF_ROPEDECL(_TYPE, _NAME) \
+	typedef struct usf_rope##_NAME { \
+		usf_ropebase rope; \
+	} usf_rope##_NAME; \
+	\
+	usf_rope##_NAME *usf_newrope##_NAME(void); \
+	usf_rope##_NAME *usf_newrope##_NAME##_ts(void); \
+	usf_rope##_NAME *usf_newrope##_NAME##_alloc(const usf_allocator *allocator); \
+	usf_rope##_NAME *usf_newrope##_NAME##_ts_alloc(const usf_allocator *allocator); \
+	\
+	usf_rope##_NAME *usf_rope##_NAME##set(usf_rope##_NAME *rope, u64 i, _TYPE data);	/* Thread-safe */ \
+	usf_rope##_NAME *usf_rope##_NAME##ins(usf_rope##_NAME *rope, u64 i, _TYPE data);	/* Thread-safe */ \
+	usf_rope##_NAME *usf_rope##_NAME##add(usf_rope##_NAME *rope, _TYPE data);			/* Thread-safe */ \
+	_TYPE usf_rope##_NAME##get(const usf_rope##_NAME *rope, u64 i);						/* Thread-safe */ \
+	_TYPE usf_rope##_NAME##del(usf_rope##_NAME *rope, u64 i);							/* Thread-safe */ \
+	u64 usf_rope##_NAME##copy(const usf_rope##_NAME *rope, u64 i, u64 n, _TYPE *dst);	/* Thread-safe */ \
+	usf_memusage usf_rope##_NAME##memusage(const usf_rope##_NAME *rope);				/* Thread-safe */ \
+	\
+	void usf_freerope##_NAME##func(usf_rope##_NAME *rope, void (*freefunc)(_TYPE)); \
+	void usf_freerope##_NAME(usf_rope##_NAME *rope);
+USF_ROPEDECL(i8, i8)
+USF_ROPEDECL(i16, i16)
+USF_ROPEDECL(i32, i32)
+USF_ROPEDECL(i64, i64)
+USF_ROPEDECL(u8, u8)
+USF_ROPEDECL(u16, u16)
+USF_ROPEDECL(u32, u32)
+USF_ROPEDECL(u64, u64)
+USF_ROPEDECL(f32, f32)
+USF_ROPEDECL(f64, f64)
+USF_ROPEDECL(void *, ptr)
+USF_ROPEDECL(usf_data, )
+#undef USF_ROPEDECL
+
+#endif
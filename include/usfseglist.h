@@ -0,0 +1,62 @@
+#ifndef USFSEGLIST_H
+#define USFSEGLIST_H
+
+#include <string.h>
+#include "usfstd.h"
+#include "usfdata.h"
+#include "usfmath.h"
+#include "usfthread.h"
+#include "usfalloc.h"
+
+#define USF_SEGLIST_FIRSTSHIFT 4	/* The first segment holds 2^4 elements, each next one twice as many */
+#define USF_SEGLIST_FIRSTSIZE (U64(1) << USF_SEGLIST_FIRSTSHIFT)
+#define USF_SEGLIST_MAXSEGMENTS (64 - USF_SEGLIST_FIRSTSHIFT)
+
+/* Generic segmented list declaration for multiple possible underlying types
+ * Elements are stored in segments of doubling size which are never reallocated, so growing the
+ * list copies nothing and the address of an element stays valid until it is deleted. */
+#define USF_SEGLISTDECL(_TYPE, _NAME) \
+	typedef struct usf_seglist##_NAME { \
+		usf_mutex *lock; \
+		_TYPE *segments[USF_SEGLIST_MAXSEGMENTS]; /* Segment k holds USF_SEGLIST_FIRSTSIZE << k elements */ \
+		u64 size; \
+		u64 capacity; \
+		u64 nsegments; \
+		const usf_allocator *allocator; \
+	} usf_seglist##_NAME; \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME(void); \
+	usf_seglist##_NAME *usf_newseglist##_NAME##_ts(void); \
+	usf_seglist##_NAME *usf_newseglist##_NAME##sz(u64 capacity); \
+	usf_seglist##_NAME *usf_newseglist##_NAME##sz_ts(u64 capacity); \
+	usf_seglist##_NAME *usf_newseglist##_NAME##_alloc(const usf_allocator *allocator); \
+	usf_seglist##_NAME *usf_newseglist##_NAME##_ts_alloc(const usf_allocator *allocator); \
+	usf_seglist##_NAME *usf_newseglist##_NAME##sz_alloc(u64 capacity, const usf_allocator *allocator); \
+	usf_seglist##_NAME *usf_newseglist##_NAME##sz_ts_alloc(u64 capacity, const usf_allocator *allocator); \
+	\
+	usf_seglist##_NAME *usf_seglist##_NAME##set(usf_seglist##_NAME *list, u64 i, _TYPE data);	/* Thread-safe */ \
+	usf_seglist##_NAME *usf_seglist##_NAME##add(usf_seglist##_NAME *list, _TYPE data);			/* Thread-safe */ \
+	usf_seglist##_NAME *usf_seglist##_NAME##reserve(usf_seglist##_NAME *list, u64 capacity);	/* Thread-safe */ \
+	usf_seglist##_NAME *usf_seglist##_NAME##shrink(usf_seglist##_NAME *list);					/* Thread-safe */ \
+	_TYPE usf_seglist##_NAME##get(const usf_seglist##_NAME *list, u64 i);						/* Thread-safe */ \
+	_TYPE *usf_seglist##_NAME##at(const usf_seglist##_NAME *list, u64 i);						/* Thread-safe */ \
+	_TYPE usf_seglist##_NAME##del(usf_seglist##_NAME *list, u64 i);								/* Thread-safe */ \
+	usf_memusage usf_seglist##_NAME##memusage(const usf_seglist##_NAME *list);				/* Thread-safe */ \
+	\
+	void usf_freeseglist##_NAME##func(usf_seglist##_NAME *list, void (*freefunc)(_TYPE)); \
+	void usf_freeseglist##_NAME(usf_seglist##_NAME *list);
+USF_SEGLISTDECL(i8, i8)
+USF_SEGLISTDECL(i16, i16)
+USF_SEGLISTDECL(i32, i32)
+USF_SEGLISTDECL(i64, i64)
+USF_SEGLISTDECL(u8, u8)
+USF_SEGLISTDECL(u16, u16)
+USF_SEGLISTDECL(u32, u32)
+USF_SEGLISTDECL(u64, u64)
+USF_SEGLISTDECL(f32, f32)
+USF_SEGLISTDECL(f64, f64)
+USF_SEGLISTDECL(void *, ptr)
+USF_SEGLISTDECL(usf_data, )
+#undef USF_SEGLISTDECL
+
+#endif
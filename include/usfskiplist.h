@@ -4,27 +4,85 @@
 #include <string.h>
 #include "usfdata.h"
 #include "usfthread.h"
+#include "usfalloc.h"
+#include "usfpool.h"
+#include "usfmath.h"
+#include "usfatomic.h"
 
-#define USF_SKIPLIST_FRAMESIZE 24
+#define USF_SKIPLIST_FRAMESIZE 24 /* Maximum node height */
+
+/* Bytes taken by a skipnode of the given height: its links, then their span widths */
+#define USF_SKIPNODESIZE(_HEIGHT) (sizeof(usf_skipnode) + (_HEIGHT) * (sizeof(usf_skipnode *) + sizeof(u64)))
+/* Span widths of a skipnode's links, i.e. how many elements each of them moves forward by */
+#define USF_SKIPWIDTHS(_NODE) ((u64 *) (void *) ((_NODE)->nextnodes + (_NODE)->height))
 
 typedef struct usf_skipnode {
-	struct usf_skipnode *nextnodes[USF_SKIPLIST_FRAMESIZE];
 	usf_data data;
 	u64 index;
+	u64 height;
+	struct usf_skipnode *nextnodes[]; /* One link per level, sized to height, followed by widths */
 } usf_skipnode;
 
+typedef struct usf_skipfinger {
+	usf_skipnode *preds[USF_SKIPLIST_FRAMESIZE];	/* Last search path by level, NULL for base */
+	u64 ranks[USF_SKIPLIST_FRAMESIZE];				/* Rank of each of these, 0 for base */
+} usf_skipfinger;
+
 typedef struct usf_skiplist {
 	usf_mutex *lock;
 	usf_skipnode *base[USF_SKIPLIST_FRAMESIZE];
+	u64 basewidths[USF_SKIPLIST_FRAMESIZE];		/* Span widths of the base links */
 	u64 size;
+	u64 level;									/* Levels in use */
+	u64 rngstate;								/* Height generator; protected by lock */
+	usf_skipfinger *finger;						/* Optional; protected by lock */
+	usf_pool *pools[USF_SKIPLIST_FRAMESIZE];	/* Nodes by height, created lazily; protected by lock */
+	void *block;								/* Nodes built by usf_skfromsorted */
+	u64 blocksize;
+	const usf_allocator *allocator;
 } usf_skiplist;
 
+typedef struct usf_skipiter {
+	usf_skipnode *node;			/* Current node, or NULL outside of the skiplist */
+	usf_skiplist *skiplist;
+} usf_skipiter;
+
 usf_skiplist *usf_newsk(void);
 usf_skiplist *usf_newsk_ts(void);
+usf_skiplist *usf_newsk_alloc(const usf_allocator *allocator);
+usf_skiplist *usf_newsk_ts_alloc(const usf_allocator *allocator);
+usf_skiplist *usf_skfromsorted(const u64 *indices, const usf_data *data, u64 n);
+usf_skiplist *usf_skfromsorted_ts(const u64 *indices, const usf_data *data, u64 n);
+usf_skiplist *usf_skfromsorted_alloc(const u64 *indices, const usf_data *data, u64 n,
+		const usf_allocator *allocator);
+usf_skiplist *usf_skfromsorted_ts_alloc(const u64 *indices, const usf_data *data, u64 n,
+		const usf_allocator *allocator);
+
+void usf_skseed(usf_skiplist *skiplist, u64 seed);
+usf_skiplist *usf_skfinger(usf_skiplist *skiplist, u8 enable);	/* Thread-safe */
 
 usf_skiplist *usf_skset(usf_skiplist *skiplist, u64 i, usf_data data);	/* Thread-safe */
 usf_data usf_skget(const usf_skiplist *skiplist, u64 data);				/* Thread-safe */
 usf_data usf_skdel(usf_skiplist *skiplist, u64 data);					/* Thread-safe */
+usf_skiplist *usf_sksetsorted(usf_skiplist *skiplist, const u64 *indices,
+		const usf_data *data, u64 n);										/* Thread-safe */
+usf_memusage usf_skmemusage(const usf_skiplist *skiplist);				/* Thread-safe */
+
+usf_data usf_skfloor(const usf_skiplist *skiplist, u64 i, u64 *index);	/* Thread-safe */
+usf_data usf_skceil(const usf_skiplist *skiplist, u64 i, u64 *index);	/* Thread-safe */
+usf_data usf_skfirst(const usf_skiplist *skiplist, u64 *index);			/* Thread-safe */
+usf_data usf_sklast(const usf_skiplist *skiplist, u64 *index);			/* Thread-safe */
+u64 usf_skrank(const usf_skiplist *skiplist, u64 i);						/* Thread-safe */
+usf_data usf_skselect(const usf_skiplist *skiplist, u64 k, u64 *index);	/* Thread-safe */
+u64 usf_skrange(usf_skiplist *skiplist, u64 lo, u64 hi,
+		void (*callback)(u64 index, usf_data data, void *context), void *context);	/* Thread-safe */
+
+void usf_skiterbegin(usf_skiplist *skiplist, usf_skipiter *iter);
+void usf_skiterskim(usf_skiplist *skiplist, usf_skipiter *iter);
+usf_skipnode *usf_skiternext(usf_skipiter *iter);
+usf_skipnode *usf_skiterprev(usf_skipiter *iter);
+usf_skipnode *usf_skiterseek(usf_skipiter *iter, u64 i);
+void usf_skiterend(usf_skipiter *iter);
 
 void usf_freeskfunc(usf_skiplist *skiplist, void (*freefunc)(void *));
 void usf_freesk(usf_skiplist *skiplist);
@@ -13,10 +13,11 @@
 	#include <unistd.h>
 #endif
 #include "usfstd.h"
+#include "usfatomic.h"
 
 #define THRD_SUCCESS thrd_success
 #define THRD_NOMEM thrd_nomem
-#define THRD_TIMEOUT thrd_timeout
+#define THRD_TIMEOUT thrd_timedout
 #define THRD_BUSY thrd_busy
 #define THRD_ERROR thrd_error
 #define MTXINIT_PLAIN mtx_plain
@@ -24,11 +25,64 @@
 #define MTXINIT_RECURSIVE (mtx_plain | mtx_recursive)
 #define MTXINIT_TIMEDRECURSIVE (mtx_timed | mtx_recursive)
 
+#define USF_THREAD_SPINCOUNT 256 /* Spin iterations before a blocking wait sleeps */
+
 typedef thrd_t usf_thread;
 typedef mtx_t usf_mutex;
 typedef cnd_t usf_cond;
 typedef usf_compatibility_int (*usf_threadfunc)(void *);
 
+typedef struct usf_barrier {
+	atomic_u32 count;		/* Threads yet to arrive in this phase */
+	atomic_u32 phase;		/* Advanced by the last thread to arrive */
+	atomic_u32 sleepers;
+	u32 nthreads;
+} usf_barrier;
+
+typedef struct usf_latch {
+	atomic_u32 count;
+	atomic_u32 sleepers;
+} usf_latch;
+
+typedef struct usf_semaphore {
+	atomic_u32 count;
+	atomic_u32 sleepers;
+} usf_semaphore;
+
+#define USF_CPU_MAXCACHES 8
+
+typedef enum usf_cachetype {
+	USF_CACHE_UNIFIED,
+	USF_CACHE_DATA,
+	USF_CACHE_INSTRUCTION
+} usf_cachetype;
+
+typedef struct usf_cpucache {
+	u64 size;		/* In bytes */
+	u64 linesize;	/* In bytes */
+	u64 nshared;	/* Number of logical CPUs sharing this cache */
+	u32 level;
+	usf_cachetype type;
+} usf_cpucache;
+
+typedef struct usf_cpu {
+	u32 id;			/* Logical CPU number (as used by usf_thrdsetaffinity) */
+	u32 core;		/* Physical core index, unique across packages */
+	u32 package;
+	u32 node;		/* NUMA node */
+	u32 smt;		/* SMT sibling rank on its core (0 is the first sibling) */
+} usf_cpu;
+
+typedef struct usf_cputopo {
+	usf_cpu *cpus;
+	u64 ncpus;
+	u64 ncores;
+	u64 npackages;
+	u64 nnodes;
+	usf_cpucache caches[USF_CPU_MAXCACHES]; /* Caches seen by the first online CPU */
+	u64 ncaches;
+} usf_cputopo;
+
 #define usf_thrdcreate thrd_create
 #define usf_thrdequal thrd_equal
 #define usf_thrdcurrent thrd_current
@@ -47,12 +101,35 @@ typedef usf_compatibility_int (*usf_threadfunc)(void *);
 
 #define usf_cndinit cnd_init
 #define usf_cndsignal cnd_signal
-#define usf_cndbroadcast cnd_broadcase
+#define usf_cndbroadcast cnd_broadcast
 #define usf_cndwait cnd_wait
 #define usf_cndtimedwait cnd_timedwait
 #define usf_cnddestroy cnd_destroy
 
+i32 usf_barrinit(usf_barrier *barrier, u32 nthreads);
+i32 usf_barrwait(usf_barrier *barrier);
+void usf_barrdestroy(usf_barrier *barrier);
+
+i32 usf_latchinit(usf_latch *latch, u32 count);
+void usf_latchcountdown(usf_latch *latch, u32 n);
+void usf_latchwait(usf_latch *latch);
+i32 usf_latchtrywait(usf_latch *latch);
+void usf_latchdestroy(usf_latch *latch);
+
+i32 usf_seminit(usf_semaphore *semaphore, u32 count);
+void usf_sempost(usf_semaphore *semaphore);
+void usf_semwait(usf_semaphore *semaphore);
+i32 usf_semtrywait(usf_semaphore *semaphore);
+void usf_semdestroy(usf_semaphore *semaphore);
+
 u64 usf_nprocsonln(void);
 u64 usf_nprocsconf(void);
 
+usf_cputopo *usf_newcputopo(void);
+u64 usf_cputopocores(const usf_cputopo *topology, u32 *cpus, u64 n);
+void usf_freecputopo(usf_cputopo *topology);
+
+i32 usf_thrdsetaffinity(usf_thread thread, u32 cpu);
+i32 usf_thrdpincores(const usf_thread *threads, u64 n);
+
 #endif
@@ -0,0 +1,376 @@
+#ifdef __linux__
+	#include <sys/mman.h>
+#endif
+#include "usfalloc.h"
+#include "usfmath.h"
+
+static void *usf_internal_stdalloc(void *context, u64 size);
+static void *usf_internal_stdrealloc(void *context, void *pointer, u64 oldsize, u64 newsize);
+static void usf_internal_stdfree(void *context, void *pointer, u64 size);
+static void *usf_internal_tagalloc(void *context, u64 size);
+static void *usf_internal_tagrealloc(void *context, void *pointer, u64 oldsize, u64 newsize);
+static void usf_internal_tagfree(void *context, void *pointer, u64 size);
+static void usf_internal_memcount(atomic_u64 *bytes, atomic_u64 *peak, u64 added, u64 removed);
+static void *usf_internal_alignalloc(void *context, u64 size);
+static void *usf_internal_alignrealloc(void *context, void *pointer, u64 oldsize, u64 newsize);
+static void usf_internal_alignfree(void *context, void *pointer, u64 size);
+static u8 usf_internal_alignmapped(const usf_alignalloc *aligned, u64 size);
+static u64 usf_internal_alignsize(const usf_alignalloc *aligned, u64 size);
+#ifdef __linux__
+	static void *usf_internal_alignmap(u64 length, u64 alignment);
+#endif
+
+static atomic_u8 tracking_; /* usf_stdallocator counting switch */
+static atomic_u64 stdbytes_, stdpeak_, stdallocations_, stdfrees_;
+
+const usf_allocator usf_stdallocator = {
+	.alloc = usf_internal_stdalloc,
+	.realloc = usf_internal_stdrealloc,
+	.free = usf_internal_stdfree,
+	.context = NULL
+};
+
+static usf_alignalloc cacheline_ = { /* Contexts of the exported aligned allocators */
+	.alignment = USF_ALLOC_CACHELINE,
+	.options = 0
+};
+
+static usf_alignalloc hugepage_ = {
+	.alignment = USF_ALLOC_CACHELINE,
+	.options = USF_ALLOC_THP
+};
+
+const usf_allocator usf_cachelineallocator = {
+	.alloc = usf_internal_alignalloc,
+	.realloc = usf_internal_alignrealloc,
+	.free = usf_internal_alignfree,
+	.context = &cacheline_
+};
+
+const usf_allocator usf_hugepageallocator = {
+	.alloc = usf_internal_alignalloc,
+	.realloc = usf_internal_alignrealloc,
+	.free = usf_internal_alignfree,
+	.context = &hugepage_
+};
+
+void *usf_amalloc(const usf_allocator *allocator, u64 size) {
+	/* Allocates size bytes using the given allocator, or usf_stdallocator if it is NULL.
+	 * Returns the allocated memory, or NULL on failure. */
+
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
+	return allocator->alloc(allocator->context, size);
+}
+
+void *usf_acalloc(const usf_allocator *allocator, u64 n, u64 size) {
+	/* Allocates n elements of size bytes initialized to 0 using the given allocator,
+	 * or usf_stdallocator if it is NULL.
+	 * Returns the allocated memory, or NULL on failure. */
+
+	if (size && n > U64_MAX / size) return NULL; /* Overflow */
+	if (allocator == NULL || allocator == &usf_stdallocator) {
+		if (!usf_atmmld(&tracking_, MEMORDER_RELAXED)) return usf_calloc(n, size);
+		allocator = &usf_stdallocator; /* Counted path */
+	}
+
+	void *pointer;
+	if ((pointer = allocator->alloc(allocator->context, n * size))) memset(pointer, 0, n * size);
+
+	return pointer;
+}
+
+void *usf_arealloc(const usf_allocator *allocator, void *pointer, u64 oldsize, u64 newsize) {
+	/* Resizes memory of oldsize bytes obtained from the given allocator (or usf_stdallocator
+	 * if it is NULL) to newsize bytes. A NULL pointer is allocated as with usf_amalloc.
+	 * Returns the resized memory, or NULL on failure (in which case pointer is left untouched). */
+
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
+	if (pointer == NULL) return allocator->alloc(allocator->context, newsize);
+	return allocator->realloc(allocator->context, pointer, oldsize, newsize);
+}
+
+void usf_afree(const usf_allocator *allocator, void *pointer, u64 size) {
+	/* Frees memory of size bytes obtained from the given allocator, or usf_stdallocator if it is NULL.
+	 * If pointer is NULL, this function has no effect. */
+
+	if (pointer == NULL) return;
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
+	allocator->free(allocator->context, pointer, size);
+}
+
+void usf_memtrack(u8 enable) {
+	/* Enables or disables allocation counting in usf_stdallocator, which is off by default.
+	 * Memory allocated while counting is disabled is still subtracted when freed
+	 * while it is enabled, so counting should be enabled before containers are created. */
+
+	usf_atmmst(&tracking_, enable, MEMORDER_RELAXED);
+}
+
+usf_memstats usf_memglobal(void) {
+	/* Returns the allocation counters of usf_stdallocator (see usf_memtrack).
+	 * Only allocations made through usf_stdallocator, i.e. by containers, are counted. */
+
+	return (usf_memstats) {
+		.bytes = usf_atmmld(&stdbytes_, MEMORDER_RELAXED),
+		.peak = usf_atmmld(&stdpeak_, MEMORDER_RELAXED),
+		.allocations = usf_atmmld(&stdallocations_, MEMORDER_RELAXED),
+		.frees = usf_atmmld(&stdfrees_, MEMORDER_RELAXED)
+	};
+}
+
+usf_memtag *usf_newmemtag(const char *name, const usf_allocator *parent) {
+	/* Creates a tracking allocator which counts all memory allocated through tag->allocator
+	 * and obtains it from parent (or usf_stdallocator if it is NULL). Tags can be nested
+	 * by using another tag's allocator as parent. The name is not copied.
+	 * Returns the created tag, or NULL on failure. */
+
+	usf_memtag *tag;
+	if ((tag = usf_calloc(1, sizeof(usf_memtag))) == NULL) return NULL;
+
+	tag->allocator = (usf_allocator) {
+		.alloc = usf_internal_tagalloc,
+		.realloc = usf_internal_tagrealloc,
+		.free = usf_internal_tagfree,
+		.context = tag
+	};
+	tag->parent = parent ? parent : &usf_stdallocator;
+	tag->name = name;
+
+	return tag;
+}
+
+usf_memstats usf_memtagstats(const usf_memtag *tag) {
+	/* Returns the allocation counters of a tag, or zeroes if it is NULL. */
+
+	if (tag == NULL) return (usf_memstats) {0};
+
+	return (usf_memstats) {
+		.bytes = usf_atmmld(&tag->bytes, MEMORDER_RELAXED),
+		.peak = usf_atmmld(&tag->peak, MEMORDER_RELAXED),
+		.allocations = usf_atmmld(&tag->allocations, MEMORDER_RELAXED),
+		.frees = usf_atmmld(&tag->frees, MEMORDER_RELAXED)
+	};
+}
+
+void usf_freememtag(usf_memtag *tag) {
+	/* Frees a tag. Memory allocated through it must already have been freed.
+	 * If tag is NULL, this function has no effect. */
+
+	usf_free(tag);
+}
+
+usf_alignalloc *usf_newalignalloc(u64 alignment, u32 options) {
+	/* Creates an allocator whose memory is aligned to alignment, a power of two of at least
+	 * sizeof(void *). With options, allocations of at least USF_ALLOC_HUGEPAGE bytes are mapped
+	 * directly instead, aligned to a huge page or more, and backed by huge pages: transparent
+	 * ones with USF_ALLOC_THP, or the reserved pool with USF_ALLOC_HUGETLB, falling back to
+	 * transparent ones when it is exhausted. Options have no effect outside of Linux.
+	 * Its memory is not counted by usf_memtrack; use it as the parent of a usf_memtag for that.
+	 * Returns the created allocator, or NULL if alignment is invalid or on failure. */
+
+	usf_alignalloc *aligned;
+	if (alignment < sizeof(void *) || (alignment & (alignment - 1))) return NULL; /* Not a power of two */
+	if ((aligned = usf_malloc(sizeof(usf_alignalloc))) == NULL) return NULL;
+
+	aligned->allocator = (usf_allocator) {
+		.alloc = usf_internal_alignalloc,
+		.realloc = usf_internal_alignrealloc,
+		.free = usf_internal_alignfree,
+		.context = aligned
+	};
+	aligned->alignment = alignment;
+	aligned->options = options;
+
+	return aligned;
+}
+
+void usf_freealignalloc(usf_alignalloc *aligned) {
+	/* Frees an aligned allocator. Memory allocated through it must already have been freed.
+	 * If aligned is NULL, this function has no effect. */
+
+	usf_free(aligned);
+}
+
+static void *usf_internal_stdalloc(void *context, u64 size) {
+	/* usf_stdallocator alloc */
+
+	(void) context;
+
+	void *pointer;
+	if ((pointer = usf_malloc(size)) && usf_atmmld(&tracking_, MEMORDER_RELAXED)) {
+		usf_internal_memcount(&stdbytes_, &stdpeak_, size, 0);
+		usf_atmaddi(&stdallocations_, 1, MEMORDER_RELAXED);
+	}
+
+	return pointer;
+}
+
+static void *usf_internal_stdrealloc(void *context, void *pointer, u64 oldsize, u64 newsize) {
+	/* usf_stdallocator realloc */
+
+	(void) context;
+
+	void *newpointer;
+	if ((newpointer = usf_realloc(pointer, newsize)) && usf_atmmld(&tracking_, MEMORDER_RELAXED))
+		usf_internal_memcount(&stdbytes_, &stdpeak_, newsize, oldsize);
+
+	return newpointer;
+}
+
+static void usf_internal_stdfree(void *context, void *pointer, u64 size) {
+	/* usf_stdallocator free */
+
+	(void) context;
+
+	usf_free(pointer);
+	if (usf_atmmld(&tracking_, MEMORDER_RELAXED)) {
+		usf_internal_memcount(&stdbytes_, &stdpeak_, 0, size);
+		usf_atmaddi(&stdfrees_, 1, MEMORDER_RELAXED);
+	}
+}
+
+static void *usf_internal_tagalloc(void *context, u64 size) {
+	/* usf_memtag alloc */
+
+	usf_memtag *tag;
+	void *pointer;
+	tag = context;
+	if ((pointer = usf_amalloc(tag->parent, size))) {
+		usf_internal_memcount(&tag->bytes, &tag->peak, size, 0);
+		usf_atmaddi(&tag->allocations, 1, MEMORDER_RELAXED);
+	}
+
+	return pointer;
+}
+
+static void *usf_internal_tagrealloc(void *context, void *pointer, u64 oldsize, u64 newsize) {
+	/* usf_memtag realloc */
+
+	usf_memtag *tag;
+	void *newpointer;
+	tag = context;
+	if ((newpointer = usf_arealloc(tag->parent, pointer, oldsize, newsize)))
+		usf_internal_memcount(&tag->bytes, &tag->peak, newsize, oldsize);
+
+	return newpointer;
+}
+
+static void usf_internal_tagfree(void *context, void *pointer, u64 size) {
+	/* usf_memtag free */
+
+	usf_memtag *tag;
+	tag = context;
+	usf_afree(tag->parent, pointer, size);
+	usf_internal_memcount(&tag->bytes, &tag->peak, 0, size);
+	usf_atmaddi(&tag->frees, 1, MEMORDER_RELAXED);
+}
+
+static void usf_internal_memcount(atomic_u64 *bytes, atomic_u64 *peak, u64 added, u64 removed) {
+	/* Updates a byte counter and its peak */
+
+	u64 current, highest;
+	if (added < removed) {
+		usf_atmsubi(bytes, removed - added, MEMORDER_RELAXED);
+		return;
+	}
+	current = usf_atmaddi(bytes, added - removed, MEMORDER_RELAXED) + added - removed;
+	for (highest = usf_atmmld(peak, MEMORDER_RELAXED); current > highest;)
+		if (usf_atmcmpxch_weak(peak, &highest, current, MEMORDER_RELAXED, MEMORDER_RELAXED)) break;
+}
+
+static void *usf_internal_alignalloc(void *context, u64 size) {
+	/* usf_alignalloc alloc */
+
+	usf_alignalloc *aligned;
+	u64 length;
+	aligned = context;
+	length = usf_internal_alignsize(aligned, size);
+
+#ifdef __linux__
+	void *pointer;
+	if (usf_internal_alignmapped(aligned, size)) {
+		if (aligned->options & USF_ALLOC_HUGETLB && aligned->alignment <= USF_ALLOC_HUGEPAGE
+				&& (pointer = mmap(NULL, length, PROT_READ | PROT_WRITE,
+						MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)) != MAP_FAILED)
+			return pointer; /* Reserved huge pages */
+		return usf_internal_alignmap(length, USF_MAX(aligned->alignment, USF_ALLOC_HUGEPAGE));
+	}
+#endif
+	return usf_alalloc(aligned->alignment, length);
+}
+
+static void *usf_internal_alignrealloc(void *context, void *pointer, u64 oldsize, u64 newsize) {
+	/* usf_alignalloc realloc, which moves the memory to keep it aligned */
+
+	usf_alignalloc *aligned;
+	void *newpointer;
+	aligned = context;
+	if (usf_internal_alignmapped(aligned, oldsize) == usf_internal_alignmapped(aligned, newsize)
+			&& usf_internal_alignsize(aligned, oldsize) == usf_internal_alignsize(aligned, newsize))
+		return pointer; /* Already fits */
+
+	if ((newpointer = usf_internal_alignalloc(context, newsize)) == NULL) return NULL;
+	memcpy(newpointer, pointer, USF_MIN(oldsize, newsize));
+	usf_internal_alignfree(context, pointer, oldsize);
+
+	return newpointer;
+}
+
+static void usf_internal_alignfree(void *context, void *pointer, u64 size) {
+	/* usf_alignalloc free */
+
+	usf_alignalloc *aligned;
+	aligned = context;
+
+#ifdef __linux__
+	if (usf_internal_alignmapped(aligned, size)) {
+		munmap(pointer, usf_internal_alignsize(aligned, size));
+		return;
+	}
+#endif
+	(void) aligned; (void) size;
+	usf_free(pointer);
+}
+
+static u8 usf_internal_alignmapped(const usf_alignalloc *aligned, u64 size) {
+	/* Returns 1 if an allocation of size bytes is mapped directly, or 0 if it comes from usf_alalloc */
+
+#ifdef __linux__
+	return aligned->options && size >= USF_ALLOC_HUGEPAGE;
+#else
+	(void) aligned; (void) size;
+	return 0;
+#endif
+}
+
+static u64 usf_internal_alignsize(const usf_alignalloc *aligned, u64 size) {
+	/* Returns the number of bytes obtained for an allocation of size bytes, a multiple of
+	 * the huge page size when mapped, or of the alignment (as usf_alalloc requires) otherwise */
+
+	u64 unit;
+	unit = usf_internal_alignmapped(aligned, size) ? USF_ALLOC_HUGEPAGE : aligned->alignment;
+	return size ? (size + unit - 1) / unit * unit : unit;
+}
+
+#ifdef __linux__
+static void *usf_internal_alignmap(u64 length, u64 alignment) {
+	/* Maps length bytes aligned to alignment by trimming a larger mapping, and advises the
+	 * kernel to back them with transparent huge pages.
+	 * Returns the mapped memory, or NULL on failure */
+
+	u8 *base;
+	u64 lead;
+	if ((base = mmap(NULL, length + alignment, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) return NULL;
+
+	lead = (alignment - (uintptr_t) base % alignment) % alignment;
+	if (lead) munmap(base, lead);
+	munmap(base + lead + length, alignment - lead);
+	madvise(base + lead, length, MADV_HUGEPAGE); /* Advisory, THP may be disabled */
+
+	return base + lead;
+}
+#endif
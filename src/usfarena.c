@@ -0,0 +1,228 @@
+#include "usfarena.h"
+
+/* Chunk payloads start right after their header, at the arena's base alignment */
+#define USF_ARENA_HEADERSIZE \
+	((sizeof(usf_arenachunk) + USF_ARENA_ALIGNMENT - 1) & ~(USF_ARENA_ALIGNMENT - 1))
+
+static usf_arenachunk *usf_internal_newarenachunk(usf_arenachunk *prev, u64 size);
+static void *usf_internal_arenaalloc(void *context, u64 size);
+static void *usf_internal_arenarealloc(void *context, void *pointer, u64 oldsize, u64 newsize);
+static void usf_internal_arenafree(void *context, void *pointer, u64 size);
+static void usf_internal_newthreadarenakey(void);
+static void usf_internal_freethreadarena(void *arena);
+
+static tss_t threadarenakey_;
+static once_flag threadarenaonce_ = ONCE_FLAG_INIT;
+
+usf_arena *usf_newarena(void) {
+	/* Wrapper for creating arenas with default-sized chunks. */
+
+	return usf_newarenasz(USF_ARENA_DEFAULTCHUNKSIZE);
+}
+
+usf_arena *usf_newarenasz(u64 chunksize) {
+	/* Creates a new arena which bump-allocates from chunks of chunksize bytes.
+	 * Its first chunk is allocated right away. An arena is not thread-safe.
+	 * Returns the created arena, or NULL if chunksize is 0 or the first chunk cannot be allocated. */
+
+	if (chunksize == 0) return NULL;
+
+	usf_arena *arena;
+	arena = usf_malloc(sizeof(usf_arena));
+	arena->allocator.alloc = usf_internal_arenaalloc;
+	arena->allocator.realloc = usf_internal_arenarealloc;
+	arena->allocator.free = usf_internal_arenafree;
+	arena->allocator.context = arena;
+	arena->offset = 0;
+	arena->chunksize = chunksize;
+	arena->last = NULL;
+
+	if ((arena->chunk = usf_internal_newarenachunk(NULL, chunksize)) == NULL) {
+		usf_free(arena);
+		return NULL; /* chunk allocation failed */
+	}
+
+	return arena;
+}
+
+void *usf_arenaalloc(usf_arena *arena, u64 size) {
+	/* Allocates size bytes from the arena, aligned for any standard type.
+	 * Returns the allocated memory, or NULL on failure. */
+
+	return usf_arenaalalloc(arena, size, USF_ARENA_ALIGNMENT);
+}
+
+void *usf_arenaalalloc(usf_arena *arena, u64 size, u64 alignment) {
+	/* Allocates size bytes from the arena, aligned to alignment (a power of two).
+	 * Requests which do not fit in a chunk get a dedicated chunk of their own.
+	 * Returns the allocated memory, or NULL on failure. */
+
+	if (arena == NULL || alignment == 0 || (alignment & (alignment - 1))) return NULL;
+	if (alignment < USF_ARENA_ALIGNMENT) alignment = USF_ARENA_ALIGNMENT;
+
+	uintptr_t base, pointer;
+	base = (uintptr_t) arena->chunk + USF_ARENA_HEADERSIZE;
+	pointer = (base + arena->offset + alignment - 1) & ~(uintptr_t) (alignment - 1);
+
+	if (pointer - base > arena->chunk->size /* Does not fit (checked without overflowing), start a new chunk */
+			|| size > arena->chunk->size - (pointer - base)) {
+		usf_arenachunk *chunk;
+		if (size > U64_MAX - alignment) return NULL; /* Overflow */
+		if ((chunk = usf_internal_newarenachunk(arena->chunk, USF_MAX(arena->chunksize, size + alignment))) == NULL)
+			return NULL;
+
+		arena->chunk = chunk;
+		base = (uintptr_t) chunk + USF_ARENA_HEADERSIZE;
+		pointer = (base + alignment - 1) & ~(uintptr_t) (alignment - 1);
+	}
+
+	arena->offset = pointer - base + size;
+	return arena->last = (void *) pointer;
+}
+
+usf_arenamark usf_arenasave(const usf_arena *arena) {
+	/* Returns a mark of the arena's current position, which usf_arenarewind can return to. */
+
+	return (usf_arenamark) { .chunk = arena->chunk, .offset = arena->offset };
+}
+
+void usf_arenarewind(usf_arena *arena, usf_arenamark mark) {
+	/* Releases everything allocated from the arena since mark was saved, including chunks.
+	 * Marks saved after this one (or before a usf_arenareset) become invalid. */
+
+	if (arena == NULL) return;
+
+	usf_arenachunk *prev;
+	for (; arena->chunk != mark.chunk; arena->chunk = prev) {
+		prev = arena->chunk->prev;
+		usf_free(arena->chunk);
+	}
+	arena->offset = mark.offset;
+	arena->last = NULL;
+}
+
+void usf_arenareset(usf_arena *arena) {
+	/* Releases everything allocated from the arena at once, keeping only its first chunk.
+	 * Containers built on the arena's allocator are gone afterwards and must not be freed. */
+
+	if (arena == NULL) return;
+
+	usf_arenachunk *prev;
+	for (; arena->chunk->prev; arena->chunk = prev) {
+		prev = arena->chunk->prev;
+		usf_free(arena->chunk);
+	}
+	arena->offset = 0;
+	arena->last = NULL;
+}
+
+usf_arena *usf_threadarena(void) {
+	/* Returns this thread's scratch arena, creating it on first use.
+	 * The arena is freed when the thread exits through usf_thrdexit or by returning,
+	 * or explicitly with usf_freethreadarena. Returns NULL if it cannot be created. */
+
+	call_once(&threadarenaonce_, usf_internal_newthreadarenakey);
+
+	usf_arena *arena;
+	if ((arena = tss_get(threadarenakey_))) return arena;
+
+	if ((arena = usf_newarena()) == NULL) return NULL;
+	if (tss_set(threadarenakey_, arena) != THRD_SUCCESS) {
+		usf_freearena(arena);
+		return NULL;
+	}
+
+	return arena;
+}
+
+void usf_freethreadarena(void) {
+	/* Frees this thread's scratch arena, if it was created. */
+
+	call_once(&threadarenaonce_, usf_internal_newthreadarenakey);
+
+	usf_freearena(tss_get(threadarenakey_));
+	tss_set(threadarenakey_, NULL);
+}
+
+void usf_freearena(usf_arena *arena) {
+	/* Frees an arena and everything allocated from it.
+	 * If arena is NULL, this function has no effect. */
+
+	if (arena == NULL) return;
+
+	usf_arenachunk *chunk, *prev;
+	for (chunk = arena->chunk; chunk; chunk = prev) {
+		prev = chunk->prev;
+		usf_free(chunk);
+	}
+	usf_free(arena);
+}
+
+static usf_arenachunk *usf_internal_newarenachunk(usf_arenachunk *prev, u64 size) {
+	/* Allocates a chunk with size usable bytes, linked after prev.
+	 * Returns the chunk, or NULL on failure. */
+
+	usf_arenachunk *chunk;
+	if (size > U64_MAX - USF_ARENA_HEADERSIZE) return NULL;
+	if ((chunk = usf_alalloc(USF_ARENA_ALIGNMENT, (size + USF_ARENA_HEADERSIZE + USF_ARENA_ALIGNMENT - 1)
+			& ~(USF_ARENA_ALIGNMENT - 1))) == NULL) return NULL;
+
+	chunk->prev = prev;
+	chunk->size = size;
+
+	return chunk;
+}
+
+static void *usf_internal_arenaalloc(void *context, u64 size) {
+	/* usf_arena allocator alloc */
+
+	return usf_arenaalloc(context, size);
+}
+
+static void *usf_internal_arenarealloc(void *context, void *pointer, u64 oldsize, u64 newsize) {
+	/* usf_arena allocator realloc: the most recent allocation is resized in place when it fits */
+
+	usf_arena *arena;
+	arena = context;
+
+	if (pointer == arena->last) {
+		uintptr_t base;
+		base = (uintptr_t) arena->chunk + USF_ARENA_HEADERSIZE;
+		if ((uintptr_t) pointer - base <= arena->chunk->size
+				&& newsize <= arena->chunk->size - ((uintptr_t) pointer - base)) { /* Fits without overflowing */
+			arena->offset = (uintptr_t) pointer - base + newsize;
+			return pointer;
+		}
+	}
+
+	void *resized;
+	if ((resized = usf_arenaalloc(arena, newsize)) == NULL) return NULL;
+	memcpy(resized, pointer, USF_MIN(oldsize, newsize));
+
+	return resized;
+}
+
+static void usf_internal_arenafree(void *context, void *pointer, u64 size) {
+	/* usf_arena allocator free: only the most recent allocation is given back */
+
+	(void) size;
+	usf_arena *arena;
+	arena = context;
+
+	if (pointer == arena->last) {
+		arena->offset = (uintptr_t) pointer - ((uintptr_t) arena->chunk + USF_ARENA_HEADERSIZE);
+		arena->last = NULL;
+	}
+}
+
+static void usf_internal_newthreadarenakey(void) {
+	/* Creates the usf_threadarena key, whose destructor frees the arena on thread exit */
+
+	tss_create(&threadarenakey_, usf_internal_freethreadarena);
+}
+
+static void usf_internal_freethreadarena(void *arena) {
+	/* usf_threadarena destructor */
+
+	usf_freearena(arena);
+}
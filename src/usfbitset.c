@@ -0,0 +1,442 @@
+#include "usfbitset.h"
+
+/* Word kernels are also compiled for Haswell (AVX2 and POPCNT) where the toolchain can
+ * pick between clones at load time, since the x86-64 baseline lacks a popcount instruction */
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(__clang__)
+#define USF_BITSETKERNEL __attribute__((target_clones("arch=haswell", "default")))
+#else
+#define USF_BITSETKERNEL
+#endif
+
+typedef enum usf_bitsetop {
+	USF_BITSETAND, USF_BITSETOR, USF_BITSETXOR, USF_BITSETANDNOT
+} usf_bitsetop;
+
+static usf_bitset *usf_internal_bitsetcombine(usf_bitset *dst, const usf_bitset *src, usf_bitsetop op);
+static void usf_internal_bitsettrim(usf_bitset *bitset);
+static u8 usf_internal_bitsetindex(usf_bitset *bitset);
+static USF_BITSETKERNEL u64 usf_internal_bitsetpopcount(const u64 *words, u64 n);
+static USF_BITSETKERNEL void usf_internal_bitsetand(u64 *dst, const u64 *src, u64 n);
+static USF_BITSETKERNEL void usf_internal_bitsetor(u64 *dst, const u64 *src, u64 n);
+static USF_BITSETKERNEL void usf_internal_bitsetxor(u64 *dst, const u64 *src, u64 n);
+static USF_BITSETKERNEL void usf_internal_bitsetandnot(u64 *dst, const u64 *src, u64 n);
+
+usf_bitset *usf_newbitset(u64 size) {
+	/* Wrapper for creating non thread-safe bitsets using usf_stdallocator. */
+
+	return usf_newbitset_alloc(size, &usf_stdallocator);
+}
+
+usf_bitset *usf_newbitset_ts(u64 size) {
+	/* Wrapper for creating thread-safe bitsets using usf_stdallocator. */
+
+	return usf_newbitset_ts_alloc(size, &usf_stdallocator);
+}
+
+usf_bitset *usf_newbitset_alloc(u64 size, const usf_allocator *allocator) {
+	/* Creates a new non thread-safe bitset of size bits, all cleared, packed 64 to a u64 word.
+	 * Whole-set operations and counts work a word at a time, and a rank index of one count per
+	 * USF_BITSET_RANKWORDS words, rebuilt on demand after modifications, makes rank and select
+	 * O(log n) with a scan of at most one block.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+	 * Returns the created bitset, or NULL on failure. */
+
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
+	usf_bitset *bitset;
+	if ((bitset = usf_acalloc(allocator, 1, sizeof(usf_bitset))) == NULL) return NULL;
+	bitset->size = size;
+	bitset->nwords = (size + 63) / 64;
+	bitset->stale = 1;
+	bitset->allocator = allocator;
+	if ((bitset->words = usf_acalloc(allocator, bitset->nwords, sizeof(u64))) == NULL && bitset->nwords) {
+		usf_afree(allocator, bitset, sizeof(usf_bitset));
+		return NULL; /* Allocation failed */
+	}
+
+	return bitset;
+}
+
+usf_bitset *usf_newbitset_ts_alloc(u64 size, const usf_allocator *allocator) {
+	/* Creates a new thread-safe bitset of size bits, see usf_newbitset_alloc.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+	 * Returns the created bitset, or NULL if an error occurred. */
+
+	usf_bitset *bitset;
+	if ((bitset = usf_newbitset_alloc(size, allocator)) == NULL) return NULL;
+	bitset->lock = usf_amalloc(bitset->allocator, sizeof(usf_mutex));
+	if (bitset->lock == NULL || usf_mtxinit(bitset->lock, MTXINIT_RECURSIVE)) {
+		usf_afree(bitset->allocator, bitset->lock, sizeof(usf_mutex));
+		bitset->lock = NULL;
+		usf_freebitset(bitset);
+		return NULL; /* mutex init failed */
+	}
+
+	return bitset;
+}
+
+usf_bitset *usf_bitsetset(usf_bitset *bitset, u64 i) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Sets bit i of the bitset.
+	 * Returns the bitset, or NULL if i is out of range. */
+
+	if (bitset == NULL) return NULL;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	usf_bitset *result;
+	if (i < bitset->size) {
+		bitset->words[i / 64] |= U64(1) << (i % 64);
+		bitset->stale = 1;
+		result = bitset;
+	} else result = NULL; /* Out of range */
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return result;
+}
+
+usf_bitset *usf_bitsetclear(usf_bitset *bitset, u64 i) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Clears bit i of the bitset.
+	 * Returns the bitset, or NULL if i is out of range. */
+
+	if (bitset == NULL) return NULL;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	usf_bitset *result;
+	if (i < bitset->size) {
+		bitset->words[i / 64] &= ~(U64(1) << (i % 64));
+		bitset->stale = 1;
+		result = bitset;
+	} else result = NULL; /* Out of range */
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return result;
+}
+
+u8 usf_bitsettest(const usf_bitset *bitset, u64 i) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Returns bit i of the bitset, or 0 if i is out of range. */
+
+	if (bitset == NULL) return 0;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	u8 bit;
+	bit = i < bitset->size ? bitset->words[i / 64] >> (i % 64) & 1 : 0;
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return bit;
+}
+
+usf_bitset *usf_bitsetfill(usf_bitset *bitset, u8 value) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Sets every bit of the bitset if value is nonzero, or clears them all otherwise.
+	 * Returns the bitset. */
+
+	if (bitset == NULL) return NULL;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	memset(bitset->words, value ? 0xFF : 0, bitset->nwords * sizeof(u64));
+	usf_internal_bitsettrim(bitset);
+	bitset->stale = 1;
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return bitset;
+}
+
+usf_bitset *usf_bitsetresize(usf_bitset *bitset, u64 size) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Grows or shrinks the bitset to size bits. Added bits are cleared.
+	 * Returns the bitset, or NULL if an error occurred, in which case it is left unchanged. */
+
+	if (bitset == NULL) return NULL;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	u64 *words, nwords;
+	nwords = (size + 63) / 64;
+	if (nwords != bitset->nwords) {
+		if ((words = usf_arealloc(bitset->allocator, bitset->words, bitset->nwords * sizeof(u64),
+				nwords * sizeof(u64))) == NULL && nwords) {
+			if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+			return NULL; /* Reallocation failed */
+		}
+		if (nwords > bitset->nwords) memset(words + bitset->nwords, 0, (nwords - bitset->nwords) * sizeof(u64));
+		usf_afree(bitset->allocator, bitset->ranks,
+				((bitset->nwords + USF_BITSET_RANKWORDS - 1) / USF_BITSET_RANKWORDS + 1) * sizeof(u64));
+		bitset->ranks = NULL; /* Sized for the old words */
+		bitset->words = words;
+		bitset->nwords = nwords;
+	}
+	bitset->size = size;
+	usf_internal_bitsettrim(bitset);
+	bitset->stale = 1;
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return bitset;
+}
+
+usf_bitset *usf_bitsetand(usf_bitset *dst, const usf_bitset *src) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Keeps in dst only the bits also set in src, bits past the size of src counting as cleared.
+	 * Returns dst. */
+
+	return usf_internal_bitsetcombine(dst, src, USF_BITSETAND);
+}
+
+usf_bitset *usf_bitsetor(usf_bitset *dst, const usf_bitset *src) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Sets in dst the bits set in src, ignoring those past the size of dst.
+	 * Returns dst. */
+
+	return usf_internal_bitsetcombine(dst, src, USF_BITSETOR);
+}
+
+usf_bitset *usf_bitsetxor(usf_bitset *dst, const usf_bitset *src) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Flips in dst the bits set in src, ignoring those past the size of dst.
+	 * Returns dst. */
+
+	return usf_internal_bitsetcombine(dst, src, USF_BITSETXOR);
+}
+
+usf_bitset *usf_bitsetandnot(usf_bitset *dst, const usf_bitset *src) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Clears in dst the bits set in src.
+	 * Returns dst. */
+
+	return usf_internal_bitsetcombine(dst, src, USF_BITSETANDNOT);
+}
+
+u64 usf_bitsetcount(const usf_bitset *bitset) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Returns the number of set bits in the bitset, from the rank index if it is up to date. */
+
+	if (bitset == NULL) return 0;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	u64 count;
+	if (bitset->stale || bitset->ranks == NULL) count = usf_internal_bitsetpopcount(bitset->words, bitset->nwords);
+	else count = bitset->ranks[(bitset->nwords + USF_BITSET_RANKWORDS - 1) / USF_BITSET_RANKWORDS];
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return count;
+}
+
+u64 usf_bitsetnext(const usf_bitset *bitset, u64 i) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Returns the index of the first set bit at or after index i, or U64_MAX if there is none. */
+
+	if (bitset == NULL) return U64_MAX;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	u64 w, word;
+	if (i < bitset->size) {
+		w = i / 64;
+		for (word = bitset->words[w] & (U64_MAX << (i % 64)); word == 0 && ++w < bitset->nwords; word = bitset->words[w]);
+		i = word ? w * 64 + (u64) __builtin_ctzll(word) : U64_MAX;
+	} else i = U64_MAX; /* Out of range */
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return i;
+}
+
+u64 usf_bitsetrank(usf_bitset *bitset, u64 i) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Returns the number of set bits before index i in the bitset, rebuilding its rank index
+	 * first if it was modified since, so as to only count bits in the block of i.
+	 * Without memory for the index, this counts from the start. */
+
+	if (bitset == NULL) return 0;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	u64 w, b, rank;
+	i = USF_MIN(i, bitset->size);
+	w = i / 64;
+	b = usf_internal_bitsetindex(bitset) ? 0 : w / USF_BITSET_RANKWORDS;
+	rank = b ? bitset->ranks[b] : 0;
+
+	rank += usf_internal_bitsetpopcount(bitset->words + b * USF_BITSET_RANKWORDS, w - b * USF_BITSET_RANKWORDS);
+	if (i % 64) rank += (u64) __builtin_popcountll(bitset->words[w] & (U64_MAX >> (64 - i % 64)));
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return rank;
+}
+
+u64 usf_bitsetselect(usf_bitset *bitset, u64 k) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Returns the index of the set bit of rank k in the bitset (the first one for k = 0), or
+	 * U64_MAX if fewer bits are set. The block holding it is found by binary search of the rank
+	 * index, rebuilt first if the bitset was modified since, then scanned. */
+
+	if (bitset == NULL) return U64_MAX;
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	u64 lo, hi, mid, w, word, count, i;
+	w = 0;
+	if (usf_internal_bitsetindex(bitset) == 0) {
+		for (lo = 0, hi = (bitset->nwords + USF_BITSET_RANKWORDS - 1) / USF_BITSET_RANKWORDS; lo + 1 < hi;) {
+			mid = (lo + hi) / 2; /* Last block starting at rank k or lower */
+			if (bitset->ranks[mid] <= k) lo = mid;
+			else hi = mid;
+		}
+		k -= bitset->nwords ? bitset->ranks[lo] : 0;
+		w = lo * USF_BITSET_RANKWORDS;
+	}
+
+	for (i = U64_MAX; w < bitset->nwords; w++, k -= count) {
+		word = bitset->words[w];
+		if (k < (count = (u64) __builtin_popcountll(word))) {
+			for (; k; k--) word &= word - 1; /* Drop the lower set bits */
+			i = w * 64 + (u64) __builtin_ctzll(word);
+			break;
+		}
+	}
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return i;
+}
+
+usf_memusage usf_bitsetmemusage(const usf_bitset *bitset) {
+	/* This function is thread-safe when operating on thread-safe bitsets.
+	 *
+	 * Returns the memory used by a bitset, counting its rank index as nodes. */
+
+	if (bitset == NULL) return (usf_memusage) {0};
+	if (bitset->lock) usf_mtxlock(bitset->lock); /* Thread-safe lock */
+
+	usf_memusage usage;
+	usage = (usf_memusage) {0};
+	usage.structure = sizeof(usf_bitset);
+	usage.array = bitset->nwords * sizeof(u64);
+	usage.nodes = bitset->ranks ? ((bitset->nwords + USF_BITSET_RANKWORDS - 1) / USF_BITSET_RANKWORDS + 1) * sizeof(u64) : 0;
+	usage.locks = bitset->lock ? sizeof(usf_mutex) : 0;
+	usage.total = usage.structure + usage.array + usage.nodes + usage.locks;
+
+	if (bitset->lock) usf_mtxunlock(bitset->lock); /* Thread-safe unlock */
+	return usage;
+}
+
+void usf_freebitset(usf_bitset *bitset) {
+	/* Frees a bitset.
+	 * If bitset is NULL, this function has no effect. */
+
+	if (bitset == NULL) return;
+
+	usf_afree(bitset->allocator, bitset->ranks,
+			((bitset->nwords + USF_BITSET_RANKWORDS - 1) / USF_BITSET_RANKWORDS + 1) * sizeof(u64));
+	usf_afree(bitset->allocator, bitset->words, bitset->nwords * sizeof(u64));
+	if (bitset->lock) {
+		usf_mtxdestroy(bitset->lock);
+		usf_afree(bitset->allocator, bitset->lock, sizeof(usf_mutex));
+	}
+	usf_afree(bitset->allocator, bitset, sizeof(usf_bitset));
+}
+
+static usf_bitset *usf_internal_bitsetcombine(usf_bitset *dst, const usf_bitset *src, usf_bitsetop op) {
+	/* Applies op word-wise from src to dst, holding both bitsets with their locks taken in address order.
+	 * Returns dst */
+
+	usf_mutex *first, *second;
+	u64 n;
+	if (dst == NULL || src == NULL) return dst;
+	first = dst < src ? dst->lock : src->lock;
+	second = src == dst ? NULL : dst < src ? src->lock : dst->lock;
+	if (first) usf_mtxlock(first); /* Thread-safe lock */
+	if (second) usf_mtxlock(second); /* Thread-safe lock */
+
+	n = USF_MIN(dst->nwords, src->nwords);
+	switch (op) {
+		case USF_BITSETAND:
+			usf_internal_bitsetand(dst->words, src->words, n);
+			memset(dst->words + n, 0, (dst->nwords - n) * sizeof(u64)); /* Cleared in src */
+			break;
+		case USF_BITSETOR:
+			usf_internal_bitsetor(dst->words, src->words, n);
+			break;
+		case USF_BITSETXOR:
+			usf_internal_bitsetxor(dst->words, src->words, n);
+			break;
+		case USF_BITSETANDNOT:
+			usf_internal_bitsetandnot(dst->words, src->words, n);
+			break;
+	}
+	usf_internal_bitsettrim(dst);
+	dst->stale = 1;
+
+	if (second) usf_mtxunlock(second); /* Thread-safe unlock */
+	if (first) usf_mtxunlock(first); /* Thread-safe unlock */
+	return dst;
+}
+
+static void usf_internal_bitsettrim(usf_bitset *bitset) {
+	/* Clears the bits of the last word past the size of a bitset */
+
+	if (bitset->size % 64) bitset->words[bitset->nwords - 1] &= U64_MAX >> (64 - bitset->size % 64);
+}
+
+static u8 usf_internal_bitsetindex(usf_bitset *bitset) {
+	/* Rebuilds the rank index of a bitset if it is stale.
+	 * Returns 0, or 1 if it could not be allocated */
+
+	u64 nblocks, b;
+	if (!bitset->stale && bitset->ranks) return 0;
+
+	nblocks = (bitset->nwords + USF_BITSET_RANKWORDS - 1) / USF_BITSET_RANKWORDS;
+	if (bitset->ranks == NULL && (bitset->ranks = usf_amalloc(bitset->allocator, (nblocks + 1) * sizeof(u64))) == NULL)
+		return 1; /* Allocation failed */
+
+	for (bitset->ranks[0] = 0, b = 0; b < nblocks; b++) bitset->ranks[b + 1] = bitset->ranks[b]
+			+ usf_internal_bitsetpopcount(bitset->words + b * USF_BITSET_RANKWORDS,
+					USF_MIN(USF_BITSET_RANKWORDS, bitset->nwords - b * USF_BITSET_RANKWORDS));
+	bitset->stale = 0;
+	return 0;
+}
+
+static USF_BITSETKERNEL u64 usf_internal_bitsetpopcount(const u64 *words, u64 n) {
+	/* Returns the number of set bits in n words */
+
+	u64 i, count;
+	for (i = count = 0; i < n; i++) count += (u64) __builtin_popcountll(words[i]);
+
+	return count;
+}
+
+static USF_BITSETKERNEL void usf_internal_bitsetand(u64 *dst, const u64 *src, u64 n) {
+	/* dst &= src over n words */
+
+	u64 i;
+	for (i = 0; i < n; i++) dst[i] &= src[i];
+}
+
+static USF_BITSETKERNEL void usf_internal_bitsetor(u64 *dst, const u64 *src, u64 n) {
+	/* dst |= src over n words */
+
+	u64 i;
+	for (i = 0; i < n; i++) dst[i] |= src[i];
+}
+
+static USF_BITSETKERNEL void usf_internal_bitsetxor(u64 *dst, const u64 *src, u64 n) {
+	/* dst ^= src over n words */
+
+	u64 i;
+	for (i = 0; i < n; i++) dst[i] ^= src[i];
+}
+
+static USF_BITSETKERNEL void usf_internal_bitsetandnot(u64 *dst, const u64 *src, u64 n) {
+	/* dst &= ~src over n words */
+
+	u64 i;
+	for (i = 0; i < n; i++) dst[i] &= ~src[i];
+}
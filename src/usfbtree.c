@@ -0,0 +1,517 @@
+#include "usfbtree.h"
+
+static u32 usf_internal_btcount(const u64 *keys, u64 i);
+static usf_btnode *usf_internal_btleaf(const usf_btree *btree, u64 i, usf_btnode **path, u32 *slots);
+static usf_btnode *usf_internal_btnewnode(usf_btree *btree, u32 leaf);
+static void usf_internal_btfreenode(usf_btree *btree, usf_btnode *node);
+static void usf_internal_btinsert(usf_btnode *node, u32 slot, u64 key, usf_data value, usf_btnode *child);
+static u64 usf_internal_btsplit(usf_btnode *node, usf_btnode *right);
+static void usf_internal_btrebalance(usf_btree *btree, usf_btnode *node, usf_btnode **path, u32 *slots);
+static usf_btree *usf_internal_btbuild(usf_btree *btree, const u64 *indices, const usf_data *data, u64 n);
+
+usf_btree *usf_newbt(void) {
+	/* Wrapper for creating non thread-safe B+trees using usf_stdallocator. */
+
+	return usf_newbt_alloc(&usf_stdallocator);
+}
+
+usf_btree *usf_newbt_ts(void) {
+	/* Wrapper for creating thread-safe B+trees using usf_stdallocator. */
+
+	return usf_newbt_ts_alloc(&usf_stdallocator);
+}
+
+usf_btree *usf_newbt_alloc(const usf_allocator *allocator) {
+	/* Creates a new non thread-safe B+tree, an ordered map from u64 indices to usf_data
+	 * with the same semantics as usf_skiplist. Nodes hold USF_BTREE_NKEYS keys in a
+	 * contiguous array, so that a lookup takes one cache-friendly node per level instead
+	 * of one pointer dereference per skipped element, and leaves are linked in index order.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+	 * Returns the created B+tree, or NULL if its node pool cannot be created. */
+
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
+	usf_btree *btree;
+	btree = usf_acalloc(allocator, 1, sizeof(usf_btree));
+	btree->allocator = allocator;
+	if ((btree->nodes = usf_newpool_alloc(sizeof(usf_btnode), allocator)) == NULL) {
+		usf_afree(allocator, btree, sizeof(usf_btree));
+		return NULL; /* Pool creation failed */
+	}
+
+	return btree;
+}
+
+usf_btree *usf_newbt_ts_alloc(const usf_allocator *allocator) {
+	/* Creates a new thread-safe B+tree, initialized to 0.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+	 * Returns the created B+tree, or NULL if an error occurred. */
+
+	usf_btree *btree;
+	if ((btree = usf_newbt_alloc(allocator)) == NULL) return NULL;
+	btree->lock = usf_amalloc(btree->allocator, sizeof(usf_mutex));
+	if (usf_mtxinit(btree->lock, MTXINIT_RECURSIVE)) {
+		usf_afree(btree->allocator, btree->lock, sizeof(usf_mutex));
+		btree->lock = NULL;
+		usf_freebt(btree);
+		return NULL; /* mutex init failed */
+	}
+
+	return btree;
+}
+
+usf_btree *usf_btfromsorted(const u64 *indices, const usf_data *data, u64 n) {
+	/* Wrapper for building non thread-safe B+trees using usf_stdallocator. */
+
+	return usf_btfromsorted_alloc(indices, data, n, &usf_stdallocator);
+}
+
+usf_btree *usf_btfromsorted_ts(const u64 *indices, const usf_data *data, u64 n) {
+	/* Wrapper for building thread-safe B+trees using usf_stdallocator. */
+
+	return usf_btfromsorted_ts_alloc(indices, data, n, &usf_stdallocator);
+}
+
+usf_btree *usf_btfromsorted_alloc(const u64 *indices, const usf_data *data, u64 n,
+		const usf_allocator *allocator) {
+	/* Builds a new non thread-safe B+tree holding data[k] at virtual index indices[k]
+	 * for the n given elements, whose indices must be strictly increasing.
+	 * This runs in O(n), bottom-up, with the elements spread evenly over as few nodes as possible.
+	 * Returns the built B+tree, or NULL if the indices are not sorted or allocation failed. */
+
+	return usf_internal_btbuild(usf_newbt_alloc(allocator), indices, data, n);
+}
+
+usf_btree *usf_btfromsorted_ts_alloc(const u64 *indices, const usf_data *data, u64 n,
+		const usf_allocator *allocator) {
+	/* Builds a new thread-safe B+tree from n sorted elements (see usf_btfromsorted_alloc).
+	 * Returns the built B+tree, or NULL if the indices are not sorted or an error occurred. */
+
+	return usf_internal_btbuild(usf_newbt_ts_alloc(allocator), indices, data, n);
+}
+
+usf_btree *usf_btset(usf_btree *btree, u64 i, usf_data data) {
+	/* This function is thread-safe when operating on thread-safe B+trees.
+	 *
+	 * Sets the given data at virtual index i in the B+tree.
+	 * Returns the B+tree, or NULL if an error occurred (it is then left unchanged). */
+
+	if (btree == NULL) return NULL;
+	if (btree->lock) usf_mtxlock(btree->lock); /* Thread-safe lock */
+
+	if (btree->root == NULL && (btree->root = usf_internal_btnewnode(btree, 1)) == NULL) {
+		if (btree->lock) usf_mtxunlock(btree->lock); /* Thread-safe unlock */
+		return NULL; /* Allocation failed */
+	}
+
+	usf_btnode *path[USF_BTREE_MAXDEPTH], *spares[USF_BTREE_MAXDEPTH + 2], *node, *right, *child;
+	u32 slots[USF_BTREE_MAXDEPTH], slot, nspares;
+	u64 depth, key, separator;
+	node = usf_internal_btleaf(btree, i, path, slots);
+	slot = usf_internal_btcount(node->keys, i);
+	if (slot < node->nkeys && node->keys[slot] == i) { /* Found */
+		node->values[slot] = data;
+		if (btree->lock) usf_mtxunlock(btree->lock); /* Thread-safe unlock */
+		return btree;
+	}
+
+	nspares = 0; /* Splits cascade up through full nodes, so take every new node beforehand */
+	if (node->nkeys == USF_BTREE_NKEYS) {
+		for (nspares = 1, depth = btree->depth; depth && path[depth - 1]->nkeys == USF_BTREE_NKEYS; depth--)
+			nspares++;
+		if (depth == 0) nspares++; /* New root */
+	}
+	for (depth = 0; depth < nspares; depth++) {
+		if ((spares[depth] = usf_internal_btnewnode(btree, 0)) == NULL) {
+			while (depth) usf_internal_btfreenode(btree, spares[--depth]);
+			if (btree->lock) usf_mtxunlock(btree->lock); /* Thread-safe unlock */
+			return NULL; /* Allocation failed */
+		}
+	}
+
+	for (key = i, child = NULL, depth = btree->depth;; node = path[--depth], slot = slots[depth]) {
+		if (node->nkeys < USF_BTREE_NKEYS) {
+			usf_internal_btinsert(node, slot, key, data, child);
+			break;
+		}
+		right = spares[--nspares];
+		separator = usf_internal_btsplit(node, right);
+		if (slot > USF_BTREE_MINKEYS) /* Goes to the upper half */
+			usf_internal_btinsert(right, slot - (node->leaf ? USF_BTREE_MINKEYS : USF_BTREE_MINKEYS + 1), key, data, child);
+		else usf_internal_btinsert(node, slot, key, data, child);
+		key = separator; child = right; /* Which the parent now needs to link */
+
+		if (depth == 0) { /* Split the root */
+			node = spares[--nspares];
+			node->keys[0] = key; node->nkeys = 1;
+			node->children[0] = btree->root; node->children[1] = child;
+			btree->root = node;
+			btree->depth++;
+			break;
+		}
+	}
+	btree->size++;
+
+	if (btree->lock) usf_mtxunlock(btree->lock); /* Thread-safe unlock */
+	return btree;
+}
+
+usf_data usf_btget(const usf_btree *btree, u64 i) {
+	/* This function is thread-safe when operating on thread-safe B+trees.
+	 *
+	 * Returns the data at virtual index i in the given B+tree,
+	 * or USFNULL (zero) if it is inaccessible. */
+
+	if (btree == NULL) return USFNULL;
+	if (btree->lock) usf_mtxlock(btree->lock); /* Thread-safe lock */
+
+	usf_btnode *leaf;
+	usf_data data;
+	u32 slot;
+	data = USFNULL;
+	if (btree->root) {
+		leaf = usf_internal_btleaf(btree, i, NULL, NULL);
+		slot = usf_internal_btcount(leaf->keys, i);
+		if (slot < leaf->nkeys && leaf->keys[slot] == i) data = leaf->values[slot];
+	}
+
+	if (btree->lock) usf_mtxunlock(btree->lock); /* Thread-safe unlock */
+	return data;
+}
+
+usf_data usf_btdel(usf_btree *btree, u64 i) {
+	/* This function is thread-safe when operating on thread-safe B+trees.
+	 *
+	 * Deletes the 64-bit usf_data at virtual index i in the given B+tree, merging
+	 * or rebalancing nodes which fall below half full on the way up.
+	 * Returns the deleted value, or USFNULL (zero) if it is not accessible. */
+
+	if (btree == NULL) return USFNULL;
+	if (btree->lock) usf_mtxlock(btree->lock); /* Thread-safe lock */
+
+	usf_btnode *path[USF_BTREE_MAXDEPTH], *leaf;
+	u32 slots[USF_BTREE_MAXDEPTH], slot;
+	usf_data data;
+	data = USFNULL;
+	if (btree->root) {
+		leaf = usf_internal_btleaf(btree, i, path, slots);
+		slot = usf_internal_btcount(leaf->keys, i);
+		if (slot < leaf->nkeys && leaf->keys[slot] == i) { /* Found */
+			data = leaf->values[slot];
+			leaf->nkeys--;
+			memmove(&leaf->keys[slot], &leaf->keys[slot + 1], (leaf->nkeys - slot) * sizeof(u64));
+			memmove(&leaf->values[slot], &leaf->values[slot + 1], (leaf->nkeys - slot) * sizeof(usf_data));
+			leaf->keys[leaf->nkeys] = U64_MAX; /* Padding */
+			usf_internal_btrebalance(btree, leaf, path, slots);
+			btree->size--;
+		}
+	}
+
+	if (btree->lock) usf_mtxunlock(btree->lock); /* Thread-safe unlock */
+	return data;
+}
+
+u64 usf_btrange(usf_btree *btree, u64 lo, u64 hi,
+		void (*callback)(u64 index, usf_data data, void *context), void *context) {
+	/* This function is thread-safe when operating on thread-safe B+trees.
+	 *
+	 * Calls callback on every element with an index between lo and hi (inclusive), in order,
+	 * after a single descent, by scanning along the linked leaves. The B+tree stays locked
+	 * during the callbacks, which may read it but must not modify it.
+	 * Returns the number of elements visited. */
+
+	if (btree == NULL) return 0;
+	if (btree->lock) usf_mtxlock(btree->lock); /* Thread-safe lock */
+
+	usf_btnode *leaf;
+	u64 count;
+	u32 slot;
+	leaf = btree->root ? usf_internal_btleaf(btree, lo, NULL, NULL) : NULL;
+	for (count = 0, slot = leaf ? usf_internal_btcount(leaf->keys, lo) : 0; leaf; leaf = leaf->next, slot = 0) {
+		for (; slot < leaf->nkeys; slot++, count++) {
+			if (leaf->keys[slot] > hi) goto done;
+			callback(leaf->keys[slot], leaf->values[slot], context);
+		}
+	}
+	done:
+
+	if (btree->lock) usf_mtxunlock(btree->lock); /* Thread-safe unlock */
+	return count;
+}
+
+usf_memusage usf_btmemusage(const usf_btree *btree) {
+	/* This function is thread-safe when operating on thread-safe B+trees.
+	 *
+	 * Returns the memory used by a B+tree, excluding what its values point to.
+	 * Pooled nodes not currently in the B+tree are counted as slack. */
+
+	if (btree == NULL) return (usf_memusage) {0};
+	if (btree->lock) usf_mtxlock(btree->lock); /* Thread-safe lock */
+
+	usf_memusage usage;
+	usage = (usf_memusage) {0};
+	usage.structure = sizeof(usf_btree);
+	usage.nodes = btree->nnodes * sizeof(usf_btnode);
+	usage.slack = usf_poolbytes(btree->nodes) - usage.nodes;
+	usage.locks = btree->lock ? sizeof(usf_mutex) : 0;
+	usage.total = usage.structure + usage.nodes + usage.locks + usage.slack;
+
+	if (btree->lock) usf_mtxunlock(btree->lock); /* Thread-safe unlock */
+	return usage;
+}
+
+void usf_freebtfunc(usf_btree *btree, void (*freefunc)(void *)) {
+	/* Frees a B+tree and calls freefunc on its values.
+	 * If freefunc is NULL, nothing is done on the B+tree values.
+	 * If btree is NULL, this function has no effect. */
+
+	if (btree == NULL) return;
+
+	usf_btnode *leaf;
+	u32 slot;
+	if (freefunc && btree->root) {
+		for (leaf = usf_internal_btleaf(btree, 0, NULL, NULL); leaf; leaf = leaf->next)
+			for (slot = 0; slot < leaf->nkeys; slot++) freefunc(leaf->values[slot].p);
+	}
+	usf_freepool(btree->nodes); /* Releases all nodes at once */
+
+	if (btree->lock) {
+		usf_mtxdestroy(btree->lock);
+		usf_afree(btree->allocator, btree->lock, sizeof(usf_mutex));
+	}
+	usf_afree(btree->allocator, btree, sizeof(usf_btree));
+}
+
+void usf_freebt(usf_btree *btree) {
+	/* Frees a B+tree without freeing its values.
+	 * If btree is NULL, this function has no effect. */
+
+	usf_freebtfunc(btree, NULL);
+}
+
+static u32 usf_internal_btcount(const u64 *keys, u64 i) {
+	/* Returns how many keys of a node are lower than i, in a branchless pass over the whole
+	 * node (padding keys are never lower) which vectorizes on targets with 64-bit vector compares */
+
+	u32 k, count;
+	for (k = count = 0; k < USF_BTREE_NKEYS; k++) count += (u32) (keys[k] < i);
+
+	return count;
+}
+
+static usf_btnode *usf_internal_btleaf(const usf_btree *btree, u64 i, usf_btnode **path, u32 *slots) {
+	/* Returns the leaf where index i belongs in a non-empty B+tree, filling in the
+	 * inner nodes above it and the children taken from them if path is not NULL */
+
+	usf_btnode *node;
+	u64 depth;
+	u32 slot;
+	for (node = btree->root, depth = 0; depth < btree->depth; depth++) {
+		slot = i == U64_MAX ? node->nkeys : usf_internal_btcount(node->keys, i + 1); /* Keys <= i */
+		if (path) path[depth] = node, slots[depth] = slot;
+		node = node->children[slot];
+	}
+
+	return node;
+}
+
+static usf_btnode *usf_internal_btnewnode(usf_btree *btree, u32 leaf) {
+	/* Returns an empty node from the node pool, or NULL on failure */
+
+	usf_btnode *node;
+	if ((node = usf_poolalloc(btree->nodes)) == NULL) return NULL;
+	memset(node->keys, 0xFF, sizeof(node->keys)); /* U64_MAX padding */
+	node->nkeys = 0;
+	node->leaf = leaf;
+	node->next = NULL;
+	btree->nnodes++;
+
+	return node;
+}
+
+static void usf_internal_btfreenode(usf_btree *btree, usf_btnode *node) {
+	/* Returns a node to the node pool */
+
+	usf_poolfree(btree->nodes, node);
+	btree->nnodes--;
+}
+
+static void usf_internal_btinsert(usf_btnode *node, u32 slot, u64 key, usf_data value, usf_btnode *child) {
+	/* Inserts key at slot in a node with room for it, along with its value in a leaf,
+	 * or with the child starting at it in an inner node */
+
+	memmove(&node->keys[slot + 1], &node->keys[slot], (node->nkeys - slot) * sizeof(u64));
+	node->keys[slot] = key;
+	if (node->leaf) {
+		memmove(&node->values[slot + 1], &node->values[slot], (node->nkeys - slot) * sizeof(usf_data));
+		node->values[slot] = value;
+	} else {
+		memmove(&node->children[slot + 2], &node->children[slot + 1], (node->nkeys - slot) * sizeof(usf_btnode *));
+		node->children[slot + 1] = child;
+	}
+	node->nkeys++;
+}
+
+static u64 usf_internal_btsplit(usf_btnode *node, usf_btnode *right) {
+	/* Moves the upper half of a full node to an empty right sibling,
+	 * and returns the key separating them in their parent */
+
+	u64 separator;
+	right->leaf = node->leaf;
+	if (node->leaf) {
+		memcpy(right->keys, &node->keys[USF_BTREE_MINKEYS], (USF_BTREE_NKEYS - USF_BTREE_MINKEYS) * sizeof(u64));
+		memcpy(right->values, &node->values[USF_BTREE_MINKEYS], (USF_BTREE_NKEYS - USF_BTREE_MINKEYS) * sizeof(usf_data));
+		right->nkeys = USF_BTREE_NKEYS - USF_BTREE_MINKEYS;
+		right->next = node->next;
+		node->next = right;
+		separator = right->keys[0];
+	} else { /* The middle key moves up */
+		separator = node->keys[USF_BTREE_MINKEYS];
+		memcpy(right->keys, &node->keys[USF_BTREE_MINKEYS + 1], (USF_BTREE_NKEYS - USF_BTREE_MINKEYS - 1) * sizeof(u64));
+		memcpy(right->children, &node->children[USF_BTREE_MINKEYS + 1], (USF_BTREE_NKEYS - USF_BTREE_MINKEYS) * sizeof(usf_btnode *));
+		right->nkeys = USF_BTREE_NKEYS - USF_BTREE_MINKEYS - 1;
+	}
+	memset(&node->keys[USF_BTREE_MINKEYS], 0xFF, (USF_BTREE_NKEYS - USF_BTREE_MINKEYS) * sizeof(u64)); /* Padding */
+	node->nkeys = USF_BTREE_MINKEYS;
+
+	return separator;
+}
+
+static void usf_internal_btrebalance(usf_btree *btree, usf_btnode *node, usf_btnode **path, u32 *slots) {
+	/* Restores node and its ancestors to at least half full after a deletion, by borrowing
+	 * a key from a sibling which can spare one or else merging with it, and shrinks the root */
+
+	usf_btnode *parent, *left, *right;
+	u64 depth;
+	u32 slot, n;
+	for (depth = btree->depth; depth && node->nkeys < USF_BTREE_MINKEYS; node = parent) {
+		parent = path[--depth]; slot = slots[depth];
+		left = slot ? parent->children[slot - 1] : NULL;
+		right = slot < parent->nkeys ? parent->children[slot + 1] : NULL;
+
+		if (left && left->nkeys > USF_BTREE_MINKEYS) { /* Borrow the last key of left */
+			n = --left->nkeys;
+			memmove(&node->keys[1], node->keys, node->nkeys * sizeof(u64));
+			if (node->leaf) {
+				memmove(&node->values[1], node->values, node->nkeys * sizeof(usf_data));
+				node->keys[0] = left->keys[n];
+				node->values[0] = left->values[n];
+				parent->keys[slot - 1] = node->keys[0];
+			} else { /* Rotates through the parent */
+				memmove(&node->children[1], node->children, (node->nkeys + 1) * sizeof(usf_btnode *));
+				node->keys[0] = parent->keys[slot - 1];
+				node->children[0] = left->children[n + 1];
+				parent->keys[slot - 1] = left->keys[n];
+			}
+			left->keys[n] = U64_MAX; /* Padding */
+			node->nkeys++;
+		} else if (right && right->nkeys > USF_BTREE_MINKEYS) { /* Borrow the first key of right */
+			n = --right->nkeys;
+			if (node->leaf) {
+				node->keys[node->nkeys] = right->keys[0];
+				node->values[node->nkeys] = right->values[0];
+				memmove(right->values, &right->values[1], n * sizeof(usf_data));
+				memmove(right->keys, &right->keys[1], n * sizeof(u64));
+				parent->keys[slot] = right->keys[0];
+			} else { /* Rotates through the parent */
+				node->keys[node->nkeys] = parent->keys[slot];
+				node->children[node->nkeys + 1] = right->children[0];
+				parent->keys[slot] = right->keys[0];
+				memmove(right->keys, &right->keys[1], n * sizeof(u64));
+				memmove(right->children, &right->children[1], (n + 1) * sizeof(usf_btnode *));
+			}
+			right->keys[n] = U64_MAX; /* Padding */
+			node->nkeys++;
+		} else { /* Merge right into left, where either of them is this node */
+			if (left) right = node, slot--;
+			else left = node;
+			n = left->nkeys;
+			if (left->leaf) {
+				memcpy(&left->keys[n], right->keys, right->nkeys * sizeof(u64));
+				memcpy(&left->values[n], right->values, right->nkeys * sizeof(usf_data));
+				left->nkeys += right->nkeys;
+				left->next = right->next;
+			} else { /* The separator moves down */
+				left->keys[n] = parent->keys[slot];
+				memcpy(&left->keys[n + 1], right->keys, right->nkeys * sizeof(u64));
+				memcpy(&left->children[n + 1], right->children, (right->nkeys + 1) * sizeof(usf_btnode *));
+				left->nkeys += right->nkeys + 1;
+			}
+			usf_internal_btfreenode(btree, right);
+
+			n = --parent->nkeys;
+			memmove(&parent->keys[slot], &parent->keys[slot + 1], (n - slot) * sizeof(u64));
+			memmove(&parent->children[slot + 1], &parent->children[slot + 2], (n - slot) * sizeof(usf_btnode *));
+			parent->keys[n] = U64_MAX; /* Padding */
+		}
+	}
+
+	if (btree->depth && btree->root->nkeys == 0) { /* Root left with a single child */
+		node = btree->root;
+		btree->root = node->children[0];
+		btree->depth--;
+		usf_internal_btfreenode(btree, node);
+	} else if (btree->depth == 0 && btree->root->nkeys == 0) { /* Empty */
+		usf_internal_btfreenode(btree, btree->root);
+		btree->root = NULL;
+	}
+}
+
+static usf_btree *usf_internal_btbuild(usf_btree *btree, const u64 *indices, const usf_data *data, u64 n) {
+	/* Builds an empty B+tree bottom-up from n sorted elements, freeing it if they
+	 * are not strictly increasing */
+
+	if (btree == NULL) return NULL;
+
+	u64 k;
+	for (k = 1; k < n; k++) {
+		if (indices[k] <= indices[k - 1]) {
+			usf_freebt(btree);
+			return NULL; /* Not sorted */
+		}
+	}
+	if (n == 0) return btree;
+
+	usf_btnode **level, *node, *prev;
+	u64 *lows, nnodes, count, width, start, end, j;
+	nnodes = (n + USF_BTREE_NKEYS - 1) / USF_BTREE_NKEYS;
+	level = usf_amalloc(btree->allocator, nnodes * sizeof(usf_btnode *));
+	lows = usf_amalloc(btree->allocator, nnodes * sizeof(u64)); /* Lowest index under each node */
+	if (level == NULL || lows == NULL) goto fail;
+
+	for (k = 0, prev = NULL; k < nnodes; k++, prev = node) { /* Leaves, evenly filled */
+		if ((node = usf_internal_btnewnode(btree, 1)) == NULL) goto fail;
+		start = n * k / nnodes; end = n * (k + 1) / nnodes;
+		memcpy(node->keys, &indices[start], (end - start) * sizeof(u64));
+		memcpy(node->values, &data[start], (end - start) * sizeof(usf_data));
+		node->nkeys = (u32) (end - start);
+		if (prev) prev->next = node;
+		level[k] = node; lows[k] = indices[start];
+	}
+
+	for (count = nnodes; count > 1; count = width, btree->depth++) { /* Inner levels, as few nodes as possible */
+		width = (count + USF_BTREE_NKEYS) / (USF_BTREE_NKEYS + 1);
+		for (k = 0; k < width; k++) {
+			if ((node = usf_internal_btnewnode(btree, 0)) == NULL) goto fail;
+			start = count * k / width; end = count * (k + 1) / width;
+			for (j = start; j < end; j++) {
+				node->children[j - start] = level[j];
+				if (j > start) node->keys[j - start - 1] = lows[j];
+			}
+			node->nkeys = (u32) (end - start - 1);
+			level[k] = node; lows[k] = lows[start]; /* In place, as k <= start */
+		}
+	}
+	btree->root = level[0];
+	btree->size = n;
+
+	usf_afree(btree->allocator, level, nnodes * sizeof(usf_btnode *));
+	usf_afree(btree->allocator, lows, nnodes * sizeof(u64));
+	return btree;
+
+	fail:
+	usf_afree(btree->allocator, level, nnodes * sizeof(usf_btnode *));
+	usf_afree(btree->allocator, lows, nnodes * sizeof(u64));
+	usf_freebt(btree); /* Also releases the nodes built so far */
+	return NULL; /* Allocation failed */
+}
@@ -0,0 +1,356 @@
+#include "usffuture.h"
+
+typedef struct usf_internal_asynctask { /* usf_async closure */
+	usf_data (*func)(void *);
+	void *arg;
+	usf_future *future;
+} usf_internal_asynctask;
+
+typedef struct usf_internal_thenstate { /* usf_futurethen closure */
+	usf_data (*func)(usf_data, void *);
+	void *arg;
+	usf_future *future;
+} usf_internal_thenstate;
+
+typedef struct usf_internal_joinstate { /* usf_futurewhenall and usf_futurewhenany shared state */
+	usf_future *future;
+	atomic_u64 remaining;
+	atomic_flag done;
+	u64 n;
+	i32 any;
+} usf_internal_joinstate;
+
+/* Continuations set off by other continuations are queued here and run by the outermost
+ * usf_futureset on this thread, so that long usf_futurethen chains do not grow the stack. */
+static thread_local usf_futurecont *pendingfirst_, *pendinglast_;
+static thread_local i32 draining_;
+
+static void usf_internal_futurechain(usf_future *future, void (*callback)(usf_data, void *, u64),
+		void (*destroy)(void *), void *context, u64 tag);
+static usf_compatibility_int usf_internal_asyncrun(void *context);
+static void usf_internal_thenrun(usf_data value, void *context, u64 tag);
+static void usf_internal_thendrop(void *context);
+static void usf_internal_joinrun(usf_data value, void *context, u64 tag);
+static void usf_internal_joindrop(void *context);
+static usf_future *usf_internal_newfuturejoin(usf_future *const *futures, u64 n, i32 any);
+
+usf_future *usf_newfuture(void) {
+	/* Creates a new pending future.
+	 * Returns the created future, or NULL if its mutex or condition variable cannot be created. */
+
+	usf_future *future;
+	future = usf_calloc(1, sizeof(usf_future));
+	if (usf_mtxinit(&future->lock, MTXINIT_PLAIN) != THRD_SUCCESS) {
+		usf_free(future);
+		return NULL; /* mutex init failed */
+	}
+	if (usf_cndinit(&future->cond) != THRD_SUCCESS) {
+		usf_mtxdestroy(&future->lock);
+		usf_free(future);
+		return NULL; /* cond init failed */
+	}
+
+	return future;
+}
+
+usf_future *usf_async(usf_data (*func)(void *), void *arg) {
+	/* Runs func(arg) on a new detached thread and sets the returned future to its result.
+	 * This lets blocking work (e.g. usf_ftob) overlap with computation on the calling thread.
+	 * Returns the future, or NULL if it or its thread cannot be created. */
+
+	if (func == NULL) return NULL;
+
+	usf_future *future;
+	if ((future = usf_newfuture()) == NULL) return NULL;
+
+	usf_internal_asynctask *task;
+	task = usf_malloc(sizeof(usf_internal_asynctask));
+	task->func = func;
+	task->arg = arg;
+	task->future = future;
+
+	usf_thread thread;
+	if (usf_thrdcreate(&thread, usf_internal_asyncrun, task) != THRD_SUCCESS) {
+		usf_free(task);
+		usf_freefuture(future);
+		return NULL; /* thread creation failed */
+	}
+	usf_thrddetach(thread);
+
+	return future;
+}
+
+usf_future *usf_futureset(usf_future *future, usf_data value) {
+	/* This function is thread-safe.
+	 *
+	 * Fulfills a future with the given value, waking its waiters and running its continuations
+	 * on the calling thread, in the order they were attached. Continuations which set other
+	 * futures have theirs queued and run in turn rather than recursively.
+	 * Returns the future, or NULL if it was already set. */
+
+	if (future == NULL) return NULL;
+	usf_mtxlock(&future->lock);
+
+	if (future->ready) {
+		usf_mtxunlock(&future->lock);
+		return NULL; /* A future is only set once */
+	}
+
+	usf_futurecont *continuation, *next, *ordered;
+	future->value = value;
+	future->ready = 1;
+	continuation = future->continuations;
+	future->continuations = NULL;
+
+	usf_cndbroadcast(&future->cond);
+	usf_mtxunlock(&future->lock);
+
+	for (ordered = NULL; continuation; continuation = next) { /* Continuations are pushed LIFO */
+		next = continuation->next;
+		continuation->value = value;
+		continuation->next = ordered;
+		ordered = continuation;
+	}
+	if (ordered) { /* Queue behind those already pending on this thread */
+		if (pendinglast_) pendinglast_->next = ordered;
+		else pendingfirst_ = ordered;
+		for (pendinglast_ = ordered; pendinglast_->next; pendinglast_ = pendinglast_->next);
+	}
+	if (draining_) return future; /* Called from a continuation; the outermost call runs the queue */
+
+	for (draining_ = 1; (continuation = pendingfirst_);) {
+		if ((pendingfirst_ = continuation->next) == NULL) pendinglast_ = NULL;
+		continuation->callback(continuation->value, continuation->context, continuation->tag);
+		usf_free(continuation);
+	}
+	draining_ = 0;
+
+	return future;
+}
+
+usf_data usf_futureget(usf_future *future) {
+	/* This function is thread-safe.
+	 *
+	 * Blocks until the future is set and returns its value,
+	 * or USFNULL (zero) if the future is NULL. */
+
+	if (future == NULL) return USFNULL;
+
+	usf_futurewait(future);
+	return future->value; /* Immutable once ready */
+}
+
+void usf_futurewait(usf_future *future) {
+	/* This function is thread-safe.
+	 *
+	 * Blocks until the future is set.
+	 * If future is NULL, this function has no effect. */
+
+	if (future == NULL) return;
+	usf_mtxlock(&future->lock);
+
+	while (!future->ready) usf_cndwait(&future->cond, &future->lock);
+
+	usf_mtxunlock(&future->lock);
+}
+
+i32 usf_futuretimedwait(usf_future *future, const struct timespec *timeout) {
+	/* This function is thread-safe.
+	 *
+	 * Blocks until the future is set or until the absolute TIME_UTC-based timeout is reached.
+	 * Returns THRD_SUCCESS if the future is set, THRD_TIMEOUT if the timeout was reached first,
+	 * or THRD_ERROR on error. */
+
+	if (future == NULL || timeout == NULL) return THRD_ERROR;
+	usf_mtxlock(&future->lock);
+
+	i32 r;
+	for (r = THRD_SUCCESS; !future->ready && r == THRD_SUCCESS;)
+		r = usf_cndtimedwait(&future->cond, &future->lock, timeout);
+	if (future->ready) r = THRD_SUCCESS; /* Set right as the timeout expired */
+
+	usf_mtxunlock(&future->lock);
+	return r;
+}
+
+i32 usf_futureready(usf_future *future) {
+	/* This function is thread-safe.
+	 *
+	 * Returns 1 if the future is set, or 0 if it is still pending or NULL. */
+
+	if (future == NULL) return 0;
+	usf_mtxlock(&future->lock);
+
+	i32 ready;
+	ready = (i32) future->ready;
+
+	usf_mtxunlock(&future->lock);
+	return ready;
+}
+
+usf_future *usf_futurethen(usf_future *future, usf_data (*func)(usf_data, void *), void *arg) {
+	/* This function is thread-safe.
+	 *
+	 * Chains a continuation onto a future: once it is set, func(value, arg) runs on the setting
+	 * thread (or immediately on this thread if it is already set) and its result sets the returned future.
+	 * Returns the chained future, or NULL if it cannot be created. */
+
+	if (future == NULL || func == NULL) return NULL;
+
+	usf_future *next;
+	if ((next = usf_newfuture()) == NULL) return NULL;
+
+	usf_internal_thenstate *then;
+	then = usf_malloc(sizeof(usf_internal_thenstate));
+	then->func = func;
+	then->arg = arg;
+	then->future = next;
+	usf_internal_futurechain(future, usf_internal_thenrun, usf_internal_thendrop, then, 0);
+
+	return next;
+}
+
+usf_future *usf_futurewhenall(usf_future *const *futures, u64 n) {
+	/* This function is thread-safe.
+	 *
+	 * Returns a future which is set to n once all n futures are set,
+	 * or NULL if it cannot be created. An empty set of futures yields a future that is already set. */
+
+	return usf_internal_newfuturejoin(futures, n, 0);
+}
+
+usf_future *usf_futurewhenany(usf_future *const *futures, u64 n) {
+	/* This function is thread-safe.
+	 *
+	 * Returns a future which is set to the index of the first of the n futures to be set,
+	 * or NULL if it cannot be created or if n is 0. */
+
+	if (n == 0) return NULL; /* Would never be set */
+	return usf_internal_newfuturejoin(futures, n, 1);
+}
+
+void usf_freefuture(usf_future *future) {
+	/* Frees a future. No thread may be waiting on it, and it must not be set afterwards;
+	 * pending continuations are discarded without being run and their internal state is released.
+	 * Futures chained onto it by usf_futurethen are then never set, and neither are those of
+	 * usf_futurewhenall it was passed to; they remain owned by their callers, who must free them.
+	 * If future is NULL, this function has no effect. */
+
+	if (future == NULL) return;
+
+	usf_futurecont *continuation, *next;
+	for (continuation = future->continuations; continuation; continuation = next) {
+		next = continuation->next;
+		continuation->destroy(continuation->context);
+		usf_free(continuation);
+	}
+
+	usf_cnddestroy(&future->cond);
+	usf_mtxdestroy(&future->lock);
+	usf_free(future);
+}
+
+static void usf_internal_futurechain(usf_future *future, void (*callback)(usf_data, void *, u64),
+		void (*destroy)(void *), void *context, u64 tag) {
+	/* Attaches callback(value, context, tag) to a future, or runs it right away if the future is set.
+	 * destroy(context) is called instead if the future is freed before being set. */
+
+	usf_mtxlock(&future->lock);
+
+	if (future->ready) {
+		usf_mtxunlock(&future->lock);
+		callback(future->value, context, tag);
+		return;
+	}
+
+	usf_futurecont *continuation;
+	continuation = usf_malloc(sizeof(usf_futurecont));
+	continuation->callback = callback;
+	continuation->destroy = destroy;
+	continuation->context = context;
+	continuation->tag = tag;
+	continuation->next = future->continuations;
+	future->continuations = continuation;
+
+	usf_mtxunlock(&future->lock);
+}
+
+static usf_compatibility_int usf_internal_asyncrun(void *context) {
+	/* usf_async thread entry point */
+
+	usf_internal_asynctask task;
+	task = *(usf_internal_asynctask *) context;
+	usf_free(context);
+
+	usf_futureset(task.future, task.func(task.arg));
+	return 0;
+}
+
+static void usf_internal_thenrun(usf_data value, void *context, u64 tag) {
+	/* usf_futurethen continuation */
+
+	(void) tag;
+	usf_internal_thenstate then;
+	then = *(usf_internal_thenstate *) context;
+	usf_free(context);
+
+	usf_futureset(then.future, then.func(value, then.arg));
+}
+
+static void usf_internal_thendrop(void *context) {
+	/* usf_futurethen continuation discarded by usf_freefuture; the chained future belongs to the caller */
+
+	usf_free(context);
+}
+
+static void usf_internal_joinrun(usf_data value, void *context, u64 tag) {
+	/* usf_futurewhenall and usf_futurewhenany continuation; the last one to run frees the shared state */
+
+	(void) value;
+	usf_internal_joinstate *join;
+	join = context;
+
+	if (join->any && !usf_atmflagtry(&join->done, MEMORDER_ACQ_REL))
+		usf_futureset(join->future, USFDATAU(tag)); /* First one in */
+
+	if (usf_atmsubi(&join->remaining, 1, MEMORDER_ACQ_REL) == 1) {
+		if (!join->any && !usf_atmflagtry(&join->done, MEMORDER_ACQ_REL))
+			usf_futureset(join->future, USFDATAU(join->n)); /* Last one in, none discarded */
+		usf_free(join);
+	}
+}
+
+static void usf_internal_joindrop(void *context) {
+	/* usf_futurewhenall and usf_futurewhenany continuation discarded by usf_freefuture.
+	 * Drops its reference to the shared state; a when-all can then no longer be set. */
+
+	usf_internal_joinstate *join;
+	join = context;
+
+	if (!join->any) usf_atmflagtry(&join->done, MEMORDER_ACQ_REL); /* Marks the when-all as abandoned */
+
+	if (usf_atmsubi(&join->remaining, 1, MEMORDER_ACQ_REL) == 1)
+		usf_free(join);
+}
+
+static usf_future *usf_internal_newfuturejoin(usf_future *const *futures, u64 n, i32 any) {
+	/* Common constructor for usf_futurewhenall and usf_futurewhenany */
+
+	usf_future *future;
+	if ((future = usf_newfuture()) == NULL) return NULL;
+
+	if (n == 0) return usf_futureset(future, USFDATAU(0));
+
+	usf_internal_joinstate *join;
+	join = usf_malloc(sizeof(usf_internal_joinstate));
+	join->future = future;
+	usf_atminit(&join->remaining, n);
+	usf_atmflagclr(&join->done, MEMORDER_RELAXED);
+	join->n = n;
+	join->any = any;
+
+	u64 i;
+	for (i = 0; i < n; i++) usf_internal_futurechain(futures[i], usf_internal_joinrun, usf_internal_joindrop, join, i);
+
+	return future;
+}
@@ -0,0 +1,307 @@
+#include "usfgaplist.h"
+
+/* Generic gap buffer list implementation
+ * _TYPE		underlying list type
+ * _NAME		list name suffix (e.g. f32 -> usf_gaplistf32)
+ * */
+
+#define USF_GAPLISTIMPL(_TYPE, _NAME) \
+	static void usf_internal_gaplist##_NAME##seek(usf_gaplist##_NAME *list, u64 i) { \
+		/* Moves the gap of a list to index i (at most its size), shifting the elements in between */ \
+		\
+		u64 gaplen; \
+		gaplen = list->capacity - list->size; \
+		if (i < list->gap) memmove(&list->array[i + gaplen], &list->array[i], (list->gap - i) * sizeof(_TYPE)); \
+		else if (i > list->gap) memmove(&list->array[list->gap], &list->array[list->gap + gaplen], \
+				(i - list->gap) * sizeof(_TYPE)); \
+		list->gap = i; \
+	} \
+	\
+	static u8 usf_internal_gaplist##_NAME##grow(usf_gaplist##_NAME *list) { \
+		/* Makes room for one more element in a full list, moving the elements past its gap
+		 * to the end of the new array. Returns 0, or 1 if the array could not be grown. */ \
+		\
+		_TYPE *array; \
+		u64 capacity; \
+		if (list->size < list->capacity) return 0; \
+		capacity = USF_MAX(USF_GAPLIST_RESIZE_MULTIPLIER * list->capacity, USF_GAPLIST_DEFAULTSIZE); \
+		if ((array = usf_arealloc(list->allocator, list->array, list->capacity * sizeof(_TYPE), \
+				capacity * sizeof(_TYPE))) == NULL) return 1; /* Reallocation failed */ \
+		\
+		memmove(&array[capacity - (list->size - list->gap)], &array[list->gap], \
+				(list->size - list->gap) * sizeof(_TYPE)); /* Tail to the end */ \
+		list->array = array; \
+		list->capacity = capacity; \
+		return 0; \
+	} \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME(void) { \
+		/* Wrapper for creating default-sized non thread-safe gap lists. */ \
+		\
+		return usf_newgaplist##_NAME##sz(USF_GAPLIST_DEFAULTSIZE); \
+	} \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##_ts(void) { \
+		/* Wrapper for creating default-sized thread-safe gap lists. */ \
+		\
+		return usf_newgaplist##_NAME##sz_ts(USF_GAPLIST_DEFAULTSIZE); \
+	} \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##sz(u64 capacity) { \
+		/* Wrapper for creating non thread-safe gap lists using usf_stdallocator. */ \
+		\
+		return usf_newgaplist##_NAME##sz_alloc(capacity, &usf_stdallocator); \
+	} \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##sz_ts(u64 capacity) { \
+		/* Wrapper for creating thread-safe gap lists using usf_stdallocator. */ \
+		\
+		return usf_newgaplist##_NAME##sz_ts_alloc(capacity, &usf_stdallocator); \
+	} \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##_alloc(const usf_allocator *allocator) { \
+		/* Wrapper for creating default-sized non thread-safe gap lists using the given allocator. */ \
+		\
+		return usf_newgaplist##_NAME##sz_alloc(USF_GAPLIST_DEFAULTSIZE, allocator); \
+	} \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##_ts_alloc(const usf_allocator *allocator) { \
+		/* Wrapper for creating default-sized thread-safe gap lists using the given allocator. */ \
+		\
+		return usf_newgaplist##_NAME##sz_ts_alloc(USF_GAPLIST_DEFAULTSIZE, allocator); \
+	} \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##sz_alloc(u64 capacity, const usf_allocator *allocator) { \
+		/* Creates a new non thread-safe gap list of given capacity, which behaves as a usf_list
+		 * but inserts and deletes in O(1) near its last edit (its gap), making local edits cheap
+		 * anywhere in it. Moving the gap elsewhere costs the number of elements it crosses.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+		 * Returns the created list, or NULL on failure. */ \
+		\
+		if (allocator == NULL) allocator = &usf_stdallocator; \
+		\
+		usf_gaplist##_NAME *list; \
+		if ((list = usf_amalloc(allocator, sizeof(usf_gaplist##_NAME))) == NULL) return NULL; \
+		list->lock = NULL; \
+		list->array = usf_amalloc(allocator, capacity * sizeof(_TYPE)); \
+		list->size = 0; \
+		list->capacity = list->array ? capacity : 0; \
+		list->gap = 0; \
+		list->allocator = allocator; \
+		\
+		return list; \
+	} \
+	\
+	usf_gaplist##_NAME *usf_newgaplist##_NAME##sz_ts_alloc(u64 capacity, const usf_allocator *allocator) { \
+		/* Creates a new thread-safe gap list of given capacity, see usf_newgaplist##_NAMEsz_alloc.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+		 * Returns the created list, or NULL if an error occurred. */ \
+		\
+		usf_gaplist##_NAME *list; \
+		if ((list = usf_newgaplist##_NAME##sz_alloc(capacity, allocator)) == NULL) return NULL; \
+		list->lock = usf_amalloc(list->allocator, sizeof(usf_mutex)); \
+		if (list->lock == NULL || usf_mtxinit(list->lock, MTXINIT_RECURSIVE)) { \
+			usf_afree(list->allocator, list->lock, sizeof(usf_mutex)); \
+			list->lock = NULL; \
+			usf_freegaplist##_NAME(list); \
+			return NULL; /* mutex init failed */ \
+		} \
+		\
+		return list; \
+	} \
+	\
+	usf_gaplist##_NAME *usf_gaplist##_NAME##set(usf_gaplist##_NAME *list, u64 i, _TYPE data) { \
+		/* This function is thread-safe when operating on thread-safe gap lists.
+		 *
+		 * Sets the given data at index i in the list, or appends it if i is the list's size.
+		 * This does not move the gap, except to append.
+		 * Returns the list, or NULL if i is past the list's size or an error occurred. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		usf_gaplist##_NAME *result; \
+		if (i < list->size) { \
+			list->array[i < list->gap ? i : i + list->capacity - list->size] = data; \
+			result = list; \
+		} else result = usf_gaplist##_NAME##ins(list, i, data); /* Appends, or fails past the end */ \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return result; \
+	} \
+	\
+	usf_gaplist##_NAME *usf_gaplist##_NAME##ins(usf_gaplist##_NAME *list, u64 i, _TYPE data) { \
+		/* This function is thread-safe when operating on thread-safe gap lists.
+		 *
+		 * Inserts the given data at index i in the list, before the element that currently has that
+		 * index, after moving the gap there. The gap is then left right after the inserted element,
+		 * so that consecutive insertions are O(1).
+		 * Returns the list, or NULL if i is past the list's size or an error occurred. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		if (i > list->size || usf_internal_gaplist##_NAME##grow(list)) { \
+			if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+			return NULL; /* Out of range, or growing failed */ \
+		} \
+		usf_internal_gaplist##_NAME##seek(list, i); \
+		list->array[list->gap++] = data; \
+		list->size++; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list; \
+	} \
+	\
+	usf_gaplist##_NAME *usf_gaplist##_NAME##add(usf_gaplist##_NAME *list, _TYPE data) { \
+		/* This function is thread-safe when operating on thread-safe gap lists.
+		 *
+		 * Appends the given data at index list->size in the list, see usf_gaplist##_NAMEins.
+		 * Returns the list, or NULL if an error occurred. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		usf_gaplist##_NAME *result; \
+		result = usf_gaplist##_NAME##ins(list, list->size, data); /* Recursive lock */ \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return result; \
+	} \
+	\
+	usf_gaplist##_NAME *usf_gaplist##_NAME##seek(usf_gaplist##_NAME *list, u64 i) { \
+		/* This function is thread-safe when operating on thread-safe gap lists.
+		 *
+		 * Moves the gap of the list to index i ahead of a series of edits there, which ins and del
+		 * otherwise do on their first edit.
+		 * Returns the list, or NULL if i is past the list's size. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		usf_gaplist##_NAME *result; \
+		if (i <= list->size) { \
+			usf_internal_gaplist##_NAME##seek(list, i); \
+			result = list; \
+		} else result = NULL; /* Out of range */ \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return result; \
+	} \
+	\
+	_TYPE usf_gaplist##_NAME##get(const usf_gaplist##_NAME *list, u64 i) { \
+		/* This function is thread-safe when operating on thread-safe gap lists.
+		 *
+		 * Returns the data at index i in the given list, or zero if it is inaccessible. */ \
+		\
+		if (list == NULL) return (_TYPE) {0}; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		_TYPE data; \
+		if (i >= list->size) data = (_TYPE) {0}; \
+		else data = list->array[i < list->gap ? i : i + list->capacity - list->size]; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return data; \
+	} \
+	\
+	_TYPE usf_gaplist##_NAME##del(usf_gaplist##_NAME *list, u64 i) { \
+		/* This function is thread-safe when operating on thread-safe gap lists.
+		 *
+		 * Deletes the element at index i in the given list after moving the gap there, which widens
+		 * the gap by one: deleting forwards (at a fixed index) or backwards is O(1) per element.
+		 * Returns the deleted value, or zero if it is inaccessible. */ \
+		\
+		if (list == NULL) return (_TYPE) {0}; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		_TYPE data; \
+		if (i >= list->size) data = (_TYPE) {0}; \
+		else { \
+			usf_internal_gaplist##_NAME##seek(list, i); \
+			data = list->array[i + list->capacity - list->size]; \
+			list->size--; \
+		} \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return data; \
+	} \
+	\
+	u64 usf_gaplist##_NAME##copy(const usf_gaplist##_NAME *list, u64 i, u64 n, _TYPE *dst) { \
+		/* This function is thread-safe when operating on thread-safe gap lists.
+		 *
+		 * Copies up to n elements of the list starting at index i to dst, in at most two copies.
+		 * Returns the number of elements copied. */ \
+		\
+		if (list == NULL) return 0; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		u64 before, gaplen; \
+		gaplen = list->capacity - list->size; \
+		n = i < list->size ? USF_MIN(n, list->size - i) : 0; \
+		before = i < list->gap ? USF_MIN(n, list->gap - i) : 0; \
+		if (before) memcpy(dst, &list->array[i], before * sizeof(_TYPE)); \
+		if (n > before) memcpy(dst + before, &list->array[i + before + gaplen], (n - before) * sizeof(_TYPE)); \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return n; \
+	} \
+	\
+	usf_memusage usf_gaplist##_NAME##memusage(const usf_gaplist##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe gap lists.
+		 *
+		 * Returns the memory used by a gap list, excluding what its values point to. */ \
+		\
+		if (list == NULL) return (usf_memusage) {0}; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		usf_memusage usage; \
+		usage = (usf_memusage) {0}; \
+		usage.structure = sizeof(usf_gaplist##_NAME); \
+		usage.array = list->size * sizeof(_TYPE); \
+		usage.slack = (list->capacity - list->size) * sizeof(_TYPE); /* The gap */ \
+		usage.locks = list->lock ? sizeof(usf_mutex) : 0; \
+		usage.total = usage.structure + usage.array + usage.locks + usage.slack; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return usage; \
+	} \
+	\
+	void usf_freegaplist##_NAME##func(usf_gaplist##_NAME *list, void (*freefunc)(_TYPE)) { \
+		/* Frees a gap list and calls freefunc on its values.
+		 * If freefunc is NULL, nothing is done to the values.
+		 * If list is NULL, this function has no effect. */ \
+		\
+		if (list == NULL) return; \
+		\
+		u64 i; \
+		if (freefunc) for (i = 0; i < list->size; i++) /* Free value */ \
+			freefunc(list->array[i < list->gap ? i : i + list->capacity - list->size]); \
+		\
+		usf_afree(list->allocator, list->array, list->capacity * sizeof(_TYPE)); \
+		if (list->lock) { \
+			usf_mtxdestroy(list->lock); \
+			usf_afree(list->allocator, list->lock, sizeof(usf_mutex)); \
+		} \
+		usf_afree(list->allocator, list, sizeof(usf_gaplist##_NAME)); \
+	} \
+	\
+	void usf_freegaplist##_NAME(usf_gaplist##_NAME *list) { \
+		/* Frees a gap list without freeing its values.
+		 * If list is NULL, this function has no effect. */ \
+		\
+		usf_freegaplist##_NAME##func(list, NULL); \
+	}
+USF_GAPLISTIMPL(i8, i8)
+USF_GAPLISTIMPL(i16, i16)
+USF_GAPLISTIMPL(i32, i32)
+USF_GAPLISTIMPL(i64, i64)
+USF_GAPLISTIMPL(u8, u8)
+USF_GAPLISTIMPL(u16, u16)
+USF_GAPLISTIMPL(u32, u32)
+USF_GAPLISTIMPL(u64, u64)
+USF_GAPLISTIMPL(f32, f32)
+USF_GAPLISTIMPL(f64, f64)
+USF_GAPLISTIMPL(void *, ptr)
+USF_GAPLISTIMPL(usf_data, )
+#undef USF_GAPLISTIMPL
@@ -13,30 +13,61 @@ usf_hashmap *usf_newhm_ts(void) {
 }
 
 usf_hashmap *usf_newhmsz(u64 capacity) {
+	/* Wrapper for creating non-blocking hashmaps using usf_stdallocator. */
+
+	return usf_newhmsz_alloc(capacity, &usf_stdallocator);
+}
+
+usf_hashmap *usf_newhmsz_ts(u64 capacity) {
+	/* Wrapper for creating thread-blocking hashmaps using usf_stdallocator. */
+
+	return usf_newhmsz_ts_alloc(capacity, &usf_stdallocator);
+}
+
+usf_hashmap *usf_newhm_alloc(const usf_allocator *allocator) {
+	/* Wrapper for creating default-sized non-blocking hashmaps using the given allocator. */
+
+	return usf_newhmsz_alloc(USF_HASHMAP_DEFAULTSIZE, allocator);
+}
+
+usf_hashmap *usf_newhm_ts_alloc(const usf_allocator *allocator) {
+	/* Wrapper for creating default-sized thread-blocking hashmaps using the given allocator. */
+
+	return usf_newhmsz_ts_alloc(USF_HASHMAP_DEFAULTSIZE, allocator);
+}
+
+usf_hashmap *usf_newhmsz_alloc(u64 capacity, const usf_allocator *allocator) {
 	/* Creates a new non-blocking usf_hashmap initialized to 0 of given capacity.
+	 * All of its memory (including string keys) is obtained from allocator,
+	 * or usf_stdallocator if it is NULL.
 	 * Returns the created hashmap. */
 
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
 	usf_hashmap *hashmap;
-	hashmap = usf_malloc(sizeof(usf_hashmap));
+	hashmap = usf_amalloc(allocator, sizeof(usf_hashmap));
 	hashmap->lock = NULL; /* Non-blocking */
-    hashmap->array = usf_calloc(capacity, sizeof(usf_hashentry));
+	hashmap->array = usf_acalloc(allocator, capacity, sizeof(usf_hashentry));
 	hashmap->size = 0;
 	hashmap->capacity = capacity;
+	hashmap->allocator = allocator;
 
 	return hashmap;
 }
 
-usf_hashmap *usf_newhmsz_ts(u64 capacity) {
+usf_hashmap *usf_newhmsz_ts_alloc(u64 capacity, const usf_allocator *allocator) {
 	/* Creates a new thread-blocking usf_hashmap initialized to 0 of given capacity.
+	 * All of its memory (including string keys) is obtained from allocator,
+	 * or usf_stdallocator if it is NULL.
 	 * Returns the created hashmap, or NULL if a mutex cannot be created. */
 
 	usf_hashmap *hashmap;
-	hashmap = usf_newhmsz(capacity);
-	hashmap->lock = usf_malloc(sizeof(usf_mutex));
+	hashmap = usf_newhmsz_alloc(capacity, allocator);
+	hashmap->lock = usf_amalloc(hashmap->allocator, sizeof(usf_mutex));
 	if (usf_mtxinit(hashmap->lock, MTXINIT_RECURSIVE) == THRD_ERROR) {
-		usf_free(hashmap->lock);
-		usf_free(hashmap->array);
-		usf_free(hashmap);
+		usf_afree(hashmap->allocator, hashmap->lock, sizeof(usf_mutex));
+		usf_afree(hashmap->allocator, hashmap->array, capacity * sizeof(usf_hashentry));
+		usf_afree(hashmap->allocator, hashmap, sizeof(usf_hashmap));
 		return NULL; /* mutex init failed */
 	}
 
@@ -79,7 +110,7 @@ usf_hashmap *usf_strhmput(usf_hashmap *hashmap, const char *key, usf_data value)
 	switch (ENTRY_->flag) { \
 		case USF_HASHMAP_UNINITIALIZED: \
 			if (sentinel) ENTRY_ = sentinel; \
-			ENTRY_->key.p = usf_malloc(strlen(key) + 1); \
+			ENTRY_->key.p = usf_amalloc(hashmap->allocator, strlen(key) + 1); \
 			strcpy(ENTRY_->key.p, key); \
 			ENTRY_->flag = USF_HASHMAP_KEY_STRING; \
 			hashmap->size++; \
@@ -140,7 +171,7 @@ usf_data usf_strhmdel(usf_hashmap *hashmap, const char *key) {
 #define ACCESS \
 	if (ENTRY_->flag == USF_HASHMAP_UNINITIALIZED) break; \
 	if (ENTRY_->flag == USF_HASHMAP_KEY_STRING && !strcmp(ENTRY_->key.p, key)) { \
-		usf_free(ENTRY_->key.p); \
+		usf_afree(hashmap->allocator, ENTRY_->key.p, strlen(ENTRY_->key.p) + 1); \
 		ENTRY_->flag = USF_HASHMAP_SENTINEL; \
 		value = ENTRY_->value; \
 		hashmap->size--; \
@@ -294,7 +325,7 @@ void usf_internal_resizehm(usf_hashmap *hashmap, u64 size) {
 	if (hashmap == NULL || hashmap->capacity >= size) return; /* Arguments have no effect */
 
 	usf_hashmap *newhm;
-	newhm = usf_newhmsz(size);
+	newhm = usf_newhmsz_alloc(size, hashmap->allocator);
 
 	usf_hashiter iter;
 	for (usf_hmiterskim(hashmap, &iter); usf_hmiternext(&iter);) {
@@ -318,6 +349,30 @@ void usf_internal_resizehm(usf_hashmap *hashmap, u64 size) {
 	usf_freehm(newhm); /* Free temporary buffer */
 }
 
+usf_memusage usf_hmmemusage(const usf_hashmap *hashmap) {
+	/* This function is thread-safe when operating on thread-safe hashmaps.
+	 *
+	 * Returns the memory used by a hashmap, excluding what its values point to.
+	 * String keys are walked, so this runs in O(capacity). */
+
+	if (hashmap == NULL) return (usf_memusage) {0};
+	if (hashmap->lock) usf_mtxlock(hashmap->lock); /* Thread-safe lock */
+
+	usf_memusage usage;
+	u64 i;
+	usage = (usf_memusage) {0};
+	usage.structure = sizeof(usf_hashmap);
+	usage.array = hashmap->size * sizeof(usf_hashentry);
+	usage.slack = (hashmap->capacity - hashmap->size) * sizeof(usf_hashentry);
+	usage.locks = hashmap->lock ? sizeof(usf_mutex) : 0;
+	for (i = 0; i < hashmap->capacity; i++) if (hashmap->array[i].flag == USF_HASHMAP_KEY_STRING)
+		usage.keys += strlen(hashmap->array[i].key.p) + 1;
+	usage.total = usage.structure + usage.array + usage.keys + usage.locks + usage.slack;
+
+	if (hashmap->lock) usf_mtxunlock(hashmap->lock); /* Thread-safe unlock */
+	return usage;
+}
+
 void usf_hmclearfunc(usf_hashmap *hashmap, void (*freefunc)(void *)) {
 	/* Clears (resets) a usf_hashmap and calls freefunc on its values.
 	 * If freefunc is NULL, nothing is done to the hashmap values.
@@ -327,7 +382,8 @@ void usf_hmclearfunc(usf_hashmap *hashmap, void (*freefunc)(void *)) {
 
 	usf_hashiter iter; /* Thread-safe lock */
 	for (usf_hmiterbegin(hashmap, &iter); usf_hmiternext(&iter);) {
-		if (iter.entry->flag == USF_HASHMAP_KEY_STRING) usf_free(iter.entry->key.p);
+		if (iter.entry->flag == USF_HASHMAP_KEY_STRING)
+			usf_afree(hashmap->allocator, iter.entry->key.p, strlen(iter.entry->key.p) + 1);
 		if (freefunc) freefunc(iter.entry->value.p);
 		memset(iter.entry, 0, sizeof(usf_hashentry)); /* Clear */
 	}
@@ -351,16 +407,17 @@ void usf_freehmfunc(usf_hashmap *hashmap, void (*freefunc)(void *)) {
 
 	usf_hashiter iter;
 	for (usf_hmiterskim(hashmap, &iter); usf_hmiternext(&iter);) {
-		if (iter.entry->flag == USF_HASHMAP_KEY_STRING) usf_free(iter.entry->key.p);
+		if (iter.entry->flag == USF_HASHMAP_KEY_STRING)
+			usf_afree(hashmap->allocator, iter.entry->key.p, strlen(iter.entry->key.p) + 1);
 		if (freefunc) freefunc(iter.entry->value.p);
 	}
 
 	if (hashmap->lock) {
 		usf_mtxdestroy(hashmap->lock);
-		usf_free(hashmap->lock);
+		usf_afree(hashmap->allocator, hashmap->lock, sizeof(usf_mutex));
 	}
-	usf_free(hashmap->array);
-	usf_free(hashmap);
+	usf_afree(hashmap->allocator, hashmap->array, hashmap->capacity * sizeof(usf_hashentry));
+	usf_afree(hashmap->allocator, hashmap, sizeof(usf_hashmap));
 }
 
 void usf_freehm(usf_hashmap *hashmap) {
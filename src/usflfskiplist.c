@@ -0,0 +1,311 @@
+#include "usflfskiplist.h"
+
+/* Tagged link accessors */
+#define USF_LFSKMARKED(_LINK) ((_LINK) & 1)
+#define USF_LFSKNODE(_LINK) ((usf_lfskipnode *) (uintptr_t) ((_LINK) & ~U64(1)))
+#define USF_LFSKLINK(_NODE) ((u64) (uintptr_t) (_NODE))
+
+static i32 usf_internal_lfskfind(usf_lfskiplist *skiplist, u64 i, atomic_u64 **preds, usf_lfskipnode **succs);
+static u64 usf_internal_lfskheight(void);
+static usf_lfskipslot *usf_internal_lfskpin(usf_lfskiplist *skiplist);
+static void usf_internal_lfskunpin(usf_lfskipslot *slot);
+static void usf_internal_lfskretire(usf_lfskiplist *skiplist, usf_lfskipnode *node);
+
+static thread_local u64 slotindex_ = U64_MAX; /* First reclamation slot this thread tries */
+static thread_local u64 rngstate_; /* Node height generator */
+static atomic_u64 nthreads_;
+
+usf_lfskiplist *usf_newlfsk(void) {
+	/* Wrapper for creating lock-free skiplists using usf_stdallocator. */
+
+	return usf_newlfsk_alloc(&usf_stdallocator);
+}
+
+usf_lfskiplist *usf_newlfsk_alloc(const usf_allocator *allocator) {
+	/* Creates a new lock-free skiplist, initialized to 0.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL,
+	 * which must be thread-safe. Every operation is thread-safe and never blocks on a lock;
+	 * deleted nodes are reclaimed once no thread can still be reading them (epoch-based
+	 * reclamation). At most USF_LFSKIPLIST_NSLOTS threads make progress at once.
+	 * Returns the created skiplist. */
+
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
+	usf_lfskiplist *skiplist;
+	skiplist = usf_acalloc(allocator, 1, sizeof(usf_lfskiplist));
+	skiplist->allocator = allocator;
+
+	return skiplist;
+}
+
+usf_lfskiplist *usf_lfskset(usf_lfskiplist *skiplist, u64 i, usf_data data) {
+	/* This function is thread-safe.
+	 *
+	 * Sets the given data at virtual index i in the skiplist.
+	 * Returns the skiplist, or NULL if an error occurred. */
+
+	if (skiplist == NULL) return NULL;
+
+	atomic_u64 *preds[USF_LFSKIPLIST_FRAMESIZE];
+	usf_lfskipnode *succs[USF_LFSKIPLIST_FRAMESIZE], *node;
+	usf_lfskipslot *slot;
+	u64 height, level, link, expected;
+	slot = usf_internal_lfskpin(skiplist);
+	height = usf_internal_lfskheight();
+	node = NULL;
+
+	for (;;) {
+		if (usf_internal_lfskfind(skiplist, i, preds, succs)) { /* Update in place */
+			usf_atmmst(&succs[0]->data, data.u, MEMORDER_RELEASE);
+			usf_afree(skiplist->allocator, node, USF_LFSKIPNODESIZE(height)); /* Never published */
+			usf_internal_lfskunpin(slot);
+			return skiplist;
+		}
+
+		if (node == NULL) {
+			if ((node = usf_amalloc(skiplist->allocator, USF_LFSKIPNODESIZE(height))) == NULL) {
+				usf_internal_lfskunpin(slot);
+				return NULL; /* Allocation failed */
+			}
+			usf_atminit(&node->data, data.u);
+			usf_atminit(&node->owners, 2);
+			node->index = i; node->height = height;
+		}
+		for (level = 0; level < height; level++) usf_atminit(&node->nextnodes[level], USF_LFSKLINK(succs[level]));
+
+		expected = USF_LFSKLINK(succs[0]); /* Publish at level 0 */
+		if (usf_atmcmpxch_strong(&preds[0][0], &expected, USF_LFSKLINK(node), MEMORDER_SEQ_CST, MEMORDER_SEQ_CST))
+			break;
+	}
+	usf_atmaddi(&skiplist->size, 1, MEMORDER_RELAXED);
+
+	for (level = 1; level < height; level++) {
+		for (;;) {
+			link = usf_atmmld(&node->nextnodes[level], MEMORDER_SEQ_CST);
+			if (USF_LFSKMARKED(link)) goto linked; /* Deleted meanwhile */
+			if (link != USF_LFSKLINK(succs[level]) && !usf_atmcmpxch_strong(&node->nextnodes[level],
+						&link, USF_LFSKLINK(succs[level]), MEMORDER_SEQ_CST, MEMORDER_SEQ_CST))
+				goto linked; /* Marked meanwhile */
+
+			expected = USF_LFSKLINK(succs[level]);
+			if (usf_atmcmpxch_strong(&preds[level][level], &expected, USF_LFSKLINK(node),
+						MEMORDER_SEQ_CST, MEMORDER_SEQ_CST)) break;
+
+			usf_internal_lfskfind(skiplist, i, preds, succs); /* Refresh neighbours */
+			if (succs[0] != node) goto linked; /* Deleted meanwhile */
+		}
+	}
+
+linked:
+	/* A delete racing with the links above may have missed the last ones, unlink them */
+	if (USF_LFSKMARKED(usf_atmmld(&node->nextnodes[0], MEMORDER_SEQ_CST)))
+		usf_internal_lfskfind(skiplist, i, preds, succs);
+	if (usf_atmsubi(&node->owners, 1, MEMORDER_ACQ_REL) == 1) usf_internal_lfskretire(skiplist, node);
+
+	usf_internal_lfskunpin(slot);
+	return skiplist;
+}
+
+usf_data usf_lfskget(usf_lfskiplist *skiplist, u64 i) {
+	/* This function is thread-safe.
+	 *
+	 * Returns the data at virtual index i in the given skiplist,
+	 * or USFNULL (zero) if it is inaccessible. Never writes to shared links. */
+
+	if (skiplist == NULL) return USFNULL;
+
+	atomic_u64 *links;
+	usf_lfskipnode *node;
+	usf_lfskipslot *slot;
+	usf_data data;
+	u64 succ;
+	i32 level;
+	slot = usf_internal_lfskpin(skiplist);
+
+	node = NULL;
+	for (links = skiplist->base, level = USF_LFSKIPLIST_FRAMESIZE - 1; level >= 0; level--) {
+		node = USF_LFSKNODE(usf_atmmld(&links[level], MEMORDER_ACQUIRE));
+		while (node) {
+			succ = usf_atmmld(&node->nextnodes[level], MEMORDER_ACQUIRE);
+			if (USF_LFSKMARKED(succ)) { /* Step over deleted nodes */
+				node = USF_LFSKNODE(succ);
+				continue;
+			}
+			if (node->index >= i) break;
+
+			links = node->nextnodes; /* Skip along */
+			node = USF_LFSKNODE(succ);
+		}
+	}
+
+	if (node && node->index == i) data.u = usf_atmmld(&node->data, MEMORDER_ACQUIRE);
+	else data = USFNULL;
+
+	usf_internal_lfskunpin(slot);
+	return data;
+}
+
+usf_data usf_lfskdel(usf_lfskiplist *skiplist, u64 i) {
+	/* This function is thread-safe.
+	 *
+	 * Deletes the 64-bit usf_data at virtual index i in the given skiplist.
+	 * Returns the deleted value, or USFNULL (zero) if it is not accessible. */
+
+	if (skiplist == NULL) return USFNULL;
+
+	atomic_u64 *preds[USF_LFSKIPLIST_FRAMESIZE];
+	usf_lfskipnode *succs[USF_LFSKIPLIST_FRAMESIZE], *node;
+	usf_lfskipslot *slot;
+	usf_data data;
+	u64 level, link;
+	slot = usf_internal_lfskpin(skiplist);
+
+	if (!usf_internal_lfskfind(skiplist, i, preds, succs)) {
+		usf_internal_lfskunpin(slot);
+		return USFNULL; /* Not present */
+	}
+
+	node = succs[0];
+	for (level = node->height - 1; level > 0; level--) /* Mark top-down */
+		usf_atmori(&node->nextnodes[level], 1, MEMORDER_SEQ_CST);
+
+	for (link = usf_atmmld(&node->nextnodes[0], MEMORDER_SEQ_CST);;) {
+		if (USF_LFSKMARKED(link)) {
+			usf_internal_lfskunpin(slot);
+			return USFNULL; /* Another thread deleted it first */
+		}
+		if (usf_atmcmpxch_weak(&node->nextnodes[0], &link, link | 1, MEMORDER_SEQ_CST, MEMORDER_SEQ_CST))
+			break; /* Logically deleted */
+	}
+	data.u = usf_atmmld(&node->data, MEMORDER_ACQUIRE);
+	usf_atmsubi(&skiplist->size, 1, MEMORDER_RELAXED);
+
+	usf_internal_lfskfind(skiplist, i, preds, succs); /* Physically unlink */
+	if (usf_atmsubi(&node->owners, 1, MEMORDER_ACQ_REL) == 1) usf_internal_lfskretire(skiplist, node);
+
+	usf_internal_lfskunpin(slot);
+	return data;
+}
+
+void usf_freelfskfunc(usf_lfskiplist *skiplist, void (*freefunc)(void *)) {
+	/* Frees a lock-free skiplist and calls freefunc on its values.
+	 * No other thread may be operating on the skiplist.
+	 * If freefunc is NULL, nothing is done on the skiplist values.
+	 * If skiplist is NULL, this function has no effect. */
+
+	if (skiplist == NULL) return;
+
+	usf_lfskipnode *node, *next;
+	u64 epoch;
+	for (node = USF_LFSKNODE(usf_atmmld(&skiplist->base[0], MEMORDER_ACQUIRE)); node; node = next) {
+		next = USF_LFSKNODE(usf_atmmld(&node->nextnodes[0], MEMORDER_RELAXED));
+		if (freefunc) freefunc((void *) (uintptr_t) usf_atmmld(&node->data, MEMORDER_RELAXED));
+		usf_afree(skiplist->allocator, node, USF_LFSKIPNODESIZE(node->height));
+	}
+
+	for (epoch = 0; epoch < countof(skiplist->retired); epoch++) {
+		for (node = usf_atmmld(&skiplist->retired[epoch], MEMORDER_ACQUIRE); node; node = next) {
+			next = node->retired;
+			usf_afree(skiplist->allocator, node, USF_LFSKIPNODESIZE(node->height));
+		}
+	}
+
+	usf_afree(skiplist->allocator, skiplist, sizeof(usf_lfskiplist));
+}
+
+void usf_freelfsk(usf_lfskiplist *skiplist) {
+	/* Frees a lock-free skiplist without freeing its values.
+	 * If skiplist is NULL, this function has no effect. */
+
+	usf_freelfskfunc(skiplist, NULL);
+}
+
+static i32 usf_internal_lfskfind(usf_lfskiplist *skiplist, u64 i, atomic_u64 **preds, usf_lfskipnode **succs) {
+	/* Fills the predecessor links and successors of index i at every level,
+	 * unlinking deleted nodes on the way. Returns whether a live node with index i is present */
+
+	atomic_u64 *pred;
+	usf_lfskipnode *node;
+	u64 succ, expected;
+	i32 level;
+
+retry:
+	for (pred = skiplist->base, level = USF_LFSKIPLIST_FRAMESIZE - 1; level >= 0; level--) {
+		node = USF_LFSKNODE(usf_atmmld(&pred[level], MEMORDER_SEQ_CST));
+		while (node) {
+			succ = usf_atmmld(&node->nextnodes[level], MEMORDER_SEQ_CST);
+			while (USF_LFSKMARKED(succ)) { /* Unlink deleted node */
+				expected = USF_LFSKLINK(node);
+				if (!usf_atmcmpxch_strong(&pred[level], &expected, succ & ~U64(1), MEMORDER_SEQ_CST, MEMORDER_SEQ_CST))
+					goto retry; /* Predecessor changed or was deleted */
+
+				if ((node = USF_LFSKNODE(succ)) == NULL) break;
+				succ = usf_atmmld(&node->nextnodes[level], MEMORDER_SEQ_CST);
+			}
+			if (node == NULL || node->index >= i) break;
+
+			pred = node->nextnodes; /* Skip along */
+			node = USF_LFSKNODE(succ);
+		}
+		preds[level] = pred;
+		succs[level] = node;
+	}
+
+	return succs[0] && succs[0]->index == i;
+}
+
+static u64 usf_internal_lfskheight(void) {
+	/* Draws a geometric node height from this thread's generator */
+
+	if (rngstate_ == 0) rngstate_ = usf_hash(usf_atmaddi(&nthreads_, 1, MEMORDER_RELAXED)) | 1;
+	return 1 + (u64) __builtin_ctzll(usf_xorshift(&rngstate_) | U64(1) << (USF_LFSKIPLIST_FRAMESIZE - 1));
+}
+
+static usf_lfskipslot *usf_internal_lfskpin(usf_lfskiplist *skiplist) {
+	/* Claims a free reclamation slot and pins it to the current epoch */
+
+	usf_lfskipslot *slot;
+	u64 i, expected;
+	if (slotindex_ == U64_MAX) slotindex_ = usf_atmaddi(&nthreads_, 1, MEMORDER_RELAXED);
+
+	for (i = slotindex_;; i++) {
+		if (i != slotindex_ && i % USF_LFSKIPLIST_NSLOTS == slotindex_ % USF_LFSKIPLIST_NSLOTS)
+			usf_thrdyield(); /* All slots taken */
+
+		slot = &skiplist->slots[i % USF_LFSKIPLIST_NSLOTS];
+		expected = 0;
+		if (usf_atmcmpxch_strong(&slot->state, &expected, usf_atmmld(&skiplist->epoch, MEMORDER_SEQ_CST) << 1 | 1,
+					MEMORDER_SEQ_CST, MEMORDER_RELAXED)) return slot;
+	}
+}
+
+static void usf_internal_lfskunpin(usf_lfskipslot *slot) {
+	/* Releases a reclamation slot */
+
+	usf_atmmst(&slot->state, 0, MEMORDER_RELEASE);
+}
+
+static void usf_internal_lfskretire(usf_lfskiplist *skiplist, usf_lfskipnode *node) {
+	/* Queues an unlinked node for reclamation, and frees the nodes retired two epochs
+	 * ago if every pinned thread has reached the current epoch */
+
+	_Atomic(usf_lfskipnode *) *bag;
+	u64 epoch, i, state;
+	epoch = usf_atmmld(&skiplist->epoch, MEMORDER_SEQ_CST);
+	bag = &skiplist->retired[epoch % 3];
+	node->retired = usf_atmmld(bag, MEMORDER_RELAXED);
+	while (!usf_atmcmpxch_weak(bag, &node->retired, node, MEMORDER_RELEASE, MEMORDER_RELAXED));
+
+	for (i = 0; i < USF_LFSKIPLIST_NSLOTS; i++) {
+		state = usf_atmmld(&skiplist->slots[i].state, MEMORDER_SEQ_CST);
+		if ((state & 1) && state >> 1 != epoch) return; /* Some thread lags behind */
+	}
+	if (!usf_atmcmpxch_strong(&skiplist->epoch, &epoch, epoch + 1, MEMORDER_SEQ_CST, MEMORDER_RELAXED))
+		return; /* Another thread advanced it */
+
+	usf_lfskipnode *next;
+	for (node = usf_atmxch(&skiplist->retired[(epoch + 2) % 3], NULL, MEMORDER_ACQUIRE); node; node = next) {
+		next = node->retired;
+		usf_afree(skiplist->allocator, node, USF_LFSKIPNODESIZE(node->height));
+	}
+}
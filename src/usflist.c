@@ -1,5 +1,23 @@
+#ifdef __linux__
+	#define _GNU_SOURCE /* mremap */
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "usflist.h"
 
+static void usf_internal_listpause(usf_listcc *cc);
+static void usf_internal_listresume(usf_listcc *cc, u64 size);
+static u64 usf_internal_listclaim(usf_listcc *cc, const u64 *capacity);
+static void usf_internal_listcommit(usf_listcc *cc, u64 *size, u64 slot);
+static void *usf_internal_listrealloc(const usf_allocator *allocator, usf_listcc *cc, usf_listmap *map,
+		void *array, u64 oldsize, u64 newsize);
+static usf_listmap *usf_internal_listmap(const char *path, const char *mode, u64 elemsize);
+static void *usf_internal_listremap(usf_listmap *map, u64 arraysize);
+static i32 usf_internal_listsyncmap(usf_listmap *map, u64 size);
+static void usf_internal_listunmap(usf_listmap *map, u64 size);
+
 /* Common check to resize (grow) a list on access
  * _LIST		reference to the list
  * _INDEX		list index being accessed
@@ -13,13 +31,39 @@
 	if (_INDEX >= _LIST->capacity) { /* Resize to either double old size, or enough to include i */ \
 		RESIZESZ_ = USF_MAX(USF_LIST_RESIZE_MULTIPLIER * _LIST->capacity, _INDEX + 1); \
 		\
-		_LIST->array = usf_realloc(_LIST->array, RESIZESZ_ * sizeof(_DATA)); /* Realloc */ \
+		__atomic_store_n(&_LIST->array, usf_internal_listrealloc(_LIST->allocator, _LIST->cc, _LIST->map, _LIST->array, \
+				_LIST->capacity * sizeof(_DATA), RESIZESZ_ * sizeof(_DATA)), __ATOMIC_RELEASE); /* Realloc */ \
 		memset(_LIST->array + _LIST->capacity, 0, (RESIZESZ_ - _LIST->capacity) * sizeof(_DATA)); \
 		\
 		_LIST->size = _INDEX + 1; \
 		_LIST->capacity = RESIZESZ_; \
 	} else _LIST->size = USF_MAX(_LIST->size, _INDEX + 1); /* No array resize, but list growth */
 
+/* Common growth of a list's array to hold at least a given number of elements
+ * _LIST		reference to the list
+ * _CAPACITY	number of elements needed
+ * _FILLED		elements up to which the caller overwrites the array right after, which are not zeroed
+ * _TYPE		underlying list type
+ *
+ * RESERVESZ_	new list capacity, in _TYPEs
+ * RESERVED_	new list array, or NULL if it could not be grown (the list is then left untouched)
+ * */
+
+#define USF_LISTRESERVE(_LIST, _CAPACITY, _FILLED, _TYPE) \
+	u64 RESERVESZ_; \
+	_TYPE *RESERVED_; \
+	if (_CAPACITY > _LIST->capacity) { /* Grow to either double old size, or enough to hold _CAPACITY */ \
+		RESERVESZ_ = USF_MAX(USF_LIST_RESIZE_MULTIPLIER * _LIST->capacity, _CAPACITY); \
+		\
+		if ((RESERVED_ = usf_internal_listrealloc(_LIST->allocator, _LIST->cc, _LIST->map, _LIST->array, \
+				_LIST->capacity * sizeof(_TYPE), RESERVESZ_ * sizeof(_TYPE)))) { \
+			__atomic_store_n(&_LIST->array, RESERVED_, __ATOMIC_RELEASE); /* Published for concurrent readers */ \
+			_LIST->capacity = USF_MAX(_LIST->capacity, _FILLED); /* Zero only what stays unused */ \
+			memset(_LIST->array + _LIST->capacity, 0, (RESERVESZ_ - _LIST->capacity) * sizeof(_TYPE)); \
+			_LIST->capacity = RESERVESZ_; \
+		} \
+	}
+
 /* Generic list implementation
  * _TYPE		underlying list type
  * _NAME		list name suffix (e.g. f32 -> usf_listf32)
@@ -39,34 +83,101 @@
 	} \
 	\
 	usf_list##_NAME *usf_newlist##_NAME##sz(u64 capacity) { \
+		/* Wrapper for creating non thread-safe lists using usf_stdallocator. */ \
+		\
+		return usf_newlist##_NAME##sz_alloc(capacity, &usf_stdallocator); \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##sz_ts(u64 capacity) { \
+		/* Wrapper for creating thread-safe lists using usf_stdallocator. */ \
+		\
+		return usf_newlist##_NAME##sz_ts_alloc(capacity, &usf_stdallocator); \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##_alloc(const usf_allocator *allocator) { \
+		/* Wrapper for creating default-sized non thread-safe lists using the given allocator. */ \
+		\
+		return usf_newlist##_NAME##sz_alloc(USF_LIST_DEFAULTSIZE, allocator); \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##_ts_alloc(const usf_allocator *allocator) { \
+		/* Wrapper for creating default-sized thread-safe lists using the given allocator. */ \
+		\
+		return usf_newlist##_NAME##sz_ts_alloc(USF_LIST_DEFAULTSIZE, allocator); \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##sz_alloc(u64 capacity, const usf_allocator *allocator) { \
 		/* Creates a new non thread-safe memory-contiguous list, initialized to 0 of given capacity.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
 		 * Returns the created list. */ \
 		\
+		if (allocator == NULL) allocator = &usf_stdallocator; \
+		\
 		usf_list##_NAME *list; \
-		list = usf_malloc(sizeof(usf_list##_NAME)); \
+		list = usf_amalloc(allocator, sizeof(usf_list##_NAME)); \
 		list->lock = NULL; \
-		list->array = usf_calloc(capacity, sizeof(_TYPE)); \
+		list->array = usf_acalloc(allocator, capacity, sizeof(_TYPE)); \
 		list->size = 0; \
 		list->capacity = capacity; \
+		list->cc = NULL; \
+		list->map = NULL; \
+		list->allocator = allocator; \
 		\
 		return list; \
 	} \
 	\
-	usf_list##_NAME *usf_newlist##_NAME##sz_ts(u64 capacity) { \
+	usf_list##_NAME *usf_newlist##_NAME##sz_ts_alloc(u64 capacity, const usf_allocator *allocator) { \
 		/* Creates a new thread-safe memory-contiguous list, initialized to 0 of given capacity.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
 		 * Returns the created list, or NULL if a mutex cannot be created. */ \
 		\
 		usf_list##_NAME *list; \
-		list = usf_malloc(sizeof(usf_list##_NAME)); \
-		list->lock = usf_malloc(sizeof(usf_mutex)); \
+		list = usf_newlist##_NAME##sz_alloc(capacity, allocator); \
+		list->lock = usf_amalloc(list->allocator, sizeof(usf_mutex)); \
 		if (usf_mtxinit(list->lock, MTXINIT_RECURSIVE)) { \
-			usf_free(list->lock); \
-			usf_free(list); \
+			usf_afree(list->allocator, list->lock, sizeof(usf_mutex)); \
+			usf_afree(list->allocator, list->array, capacity * sizeof(_TYPE)); \
+			usf_afree(list->allocator, list, sizeof(usf_list##_NAME)); \
 			return NULL; /* mutex init failed */ \
 		} \
-		list->array = usf_calloc(capacity, sizeof(_TYPE)); \
-		list->size = 0; \
-		list->capacity = capacity; \
+		\
+		return list; \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##_cc(void) { \
+		/* Wrapper for creating default-sized concurrent lists. */ \
+		\
+		return usf_newlist##_NAME##sz_cc(USF_LIST_DEFAULTSIZE); \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##sz_cc(u64 capacity) { \
+		/* Wrapper for creating concurrent lists using usf_stdallocator. */ \
+		\
+		return usf_newlist##_NAME##sz_cc_alloc(capacity, &usf_stdallocator); \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##_cc_alloc(const usf_allocator *allocator) { \
+		/* Wrapper for creating default-sized concurrent lists using the given allocator. */ \
+		\
+		return usf_newlist##_NAME##sz_cc_alloc(USF_LIST_DEFAULTSIZE, allocator); \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##sz_cc_alloc(u64 capacity, const usf_allocator *allocator) { \
+		/* Creates a new concurrent list, a thread-safe list on which usf_list##_NAMEadd and
+		 * usf_list##_NAMEget do not lock: adders claim slots of the pre-reserved capacity with an
+		 * atomic increment and publish them in order, and readers are wait-free. Growing the list
+		 * and every other modification still lock it and briefly hold adders off. Replaced arrays
+		 * are kept until the list is freed, since readers may still be using them, so capacity
+		 * should be reserved generously up front.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+		 * Returns the created list, or NULL if an error occurred. */ \
+		\
+		usf_list##_NAME *list; \
+		if ((list = usf_newlist##_NAME##sz_ts_alloc(capacity, allocator)) == NULL) return NULL; \
+		if ((list->cc = usf_acalloc(list->allocator, 1, sizeof(usf_listcc))) == NULL) { \
+			usf_freelist##_NAME(list); \
+			return NULL; /* Allocation failed */ \
+		} \
 		\
 		return list; \
 	} \
@@ -77,10 +188,12 @@
 		\
 		if (list == NULL) return NULL; \
 		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		usf_internal_listpause(list->cc); /* Keeps adders out */ \
 		\
 		USF_LISTRESIZE(list, i, data); \
 		list->array[i] = data; \
 		\
+		usf_internal_listresume(list->cc, list->size); \
 		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
 		return list; \
 	} \
@@ -92,12 +205,14 @@
 		\
 		if (list == NULL) return NULL; \
 		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		usf_internal_listpause(list->cc); /* Keeps adders out */ \
 		\
 		USF_LISTRESIZE(list, USF_MAX(list->size, i), data); \
 		if (i < list->size) \
 			memmove(&list->array[i + 1], &list->array[i], (list->size - (i + 1)) * sizeof(_TYPE)); \
 		list->array[i] = data; \
 		\
+		usf_internal_listresume(list->cc, list->size); \
 		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
 		return list; \
 	} \
@@ -108,9 +223,26 @@
 		 * Returns the list, or NULL if an error occurred. */ \
 		\
 		if (list == NULL) return NULL; \
-		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
 		\
 		u64 i; \
+		u8 full; \
+		if (list->cc) { /* Claims a slot without locking, growing the list under lock when it is full */ \
+			while ((i = usf_internal_listclaim(list->cc, &list->capacity)) == U64_MAX) { \
+				usf_mtxlock(list->lock); /* Thread-safe lock */ \
+				usf_internal_listpause(list->cc); \
+				USF_LISTRESERVE(list, list->size + 1, list->size, _TYPE); \
+				full = list->capacity == list->size; /* Unless room was made */ \
+				usf_internal_listresume(list->cc, list->size); \
+				usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+				if (full) return NULL; /* Allocation failed */ \
+			} \
+			__atomic_load_n(&list->array, __ATOMIC_ACQUIRE)[i] = data; \
+			usf_internal_listcommit(list->cc, &list->size, i); \
+			return list; \
+		} \
+		\
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
 		USF_LISTRESIZE(list, (i = list->size), data); \
 		list->array[i] = data; \
 		\
@@ -118,13 +250,105 @@
 		return list; \
 	} \
 	\
+	usf_list##_NAME *usf_list##_NAME##addn(usf_list##_NAME *list, _TYPE const *src, u64 n) { \
+		/* Appends the n elements at src to the list in a single copy, growing it at most once.
+		 * Returns the list, or NULL if an error occurred (it is then left untouched). */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		usf_internal_listpause(list->cc); /* Keeps adders out */ \
+		\
+		USF_LISTRESERVE(list, list->size + n, list->size + n, _TYPE); \
+		if (list->capacity < list->size + n) { \
+			usf_internal_listresume(list->cc, list->size); \
+			if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+			return NULL; /* Allocation failed */ \
+		} \
+		if (n) memcpy(&list->array[list->size], src, n * sizeof(_TYPE)); \
+		list->size += n; \
+		\
+		usf_internal_listresume(list->cc, list->size); \
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list; \
+	} \
+	\
+	usf_list##_NAME *usf_list##_NAME##extend(usf_list##_NAME *list, const usf_list##_NAME *other) { \
+		/* Appends all elements of other to the list (see usf_list##_NAMEaddn); other may be the list itself.
+		 * Both lists stay locked meanwhile, so two lists must not be extended with each other concurrently.
+		 * Returns the list, or NULL if an error occurred. */ \
+		\
+		if (list == NULL || other == NULL) return NULL; \
+		if (other->lock) usf_mtxlock(other->lock); /* Thread-safe lock */ \
+		\
+		usf_list##_NAME *result; \
+		if (list == other) { /* Grow first, as that moves the source */ \
+			result = usf_list##_NAME##reserve(list, list->size * 2) \
+				? usf_list##_NAME##addn(list, list->array, list->size) : NULL; \
+		} else result = usf_list##_NAME##addn(list, other->array, other->size); \
+		\
+		if (other->lock) usf_mtxunlock(other->lock); /* Thread-safe unlock */ \
+		return result; \
+	} \
+	\
+	usf_list##_NAME *usf_list##_NAME##reserve(usf_list##_NAME *list, u64 capacity) { \
+		/* Grows the list's array to hold at least capacity elements, so that
+		 * adding up to that many elements does not reallocate it again.
+		 * Returns the list, or NULL if an error occurred (it is then left untouched). */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		usf_internal_listpause(list->cc); /* Keeps adders out */ \
+		\
+		USF_LISTRESERVE(list, capacity, 0, _TYPE); \
+		\
+		usf_internal_listresume(list->cc, list->size); \
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list->capacity < capacity ? NULL : list; \
+	} \
+	\
+	usf_list##_NAME *usf_list##_NAME##shrink(usf_list##_NAME *list) { \
+		/* Shrinks the list's array to fit its size exactly, releasing its unused capacity.
+		 * Concurrent lists keep their capacity: their readers bound indices by a size loaded
+		 * before the array, which only holds as long as arrays never get smaller.
+		 * Returns the list, or NULL if an error occurred (it is then left untouched). */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->cc) return list; /* Never shrunk under wait-free readers */ \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		_TYPE *array; \
+		if (list->size == 0 && list->map == NULL) { \
+			usf_afree(list->allocator, list->array, list->capacity * sizeof(_TYPE)); \
+			list->array = NULL; \
+			list->capacity = 0; \
+		} else if ((list->size || list->map) && list->size < list->capacity) { \
+			if ((array = usf_internal_listrealloc(list->allocator, list->cc, list->map, list->array, \
+					list->capacity * sizeof(_TYPE), list->size * sizeof(_TYPE))) == NULL) { \
+				if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+				return NULL; /* Reallocation failed */ \
+			} \
+			__atomic_store_n(&list->array, array, __ATOMIC_RELEASE); /* Published for concurrent readers */ \
+			list->capacity = list->size; \
+		} \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list; \
+	} \
+	\
 	_TYPE usf_list##_NAME##get(const usf_list##_NAME *list, u64 i) { \
-		/* Returns the data at index i in the given list, or zero if it is inaccessible. */ \
+		/* Returns the data at index i in the given list, or zero if it is inaccessible.
+		 * This never locks concurrent lists. */ \
 		\
 		if (list == NULL) return (_TYPE) {0}; \
-		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
 		\
 		_TYPE data; \
+		if (list->cc) { /* Wait-free: size is published after the element, and arrays only grow and stay valid */ \
+			if (i >= __atomic_load_n(&list->size, __ATOMIC_ACQUIRE)) return (_TYPE) {0}; \
+			return __atomic_load_n(&list->array, __ATOMIC_ACQUIRE)[i]; \
+		} \
+		\
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
 		if (i >= list->size) data = (_TYPE) {0}; \
 		else data = list->array[i]; \
 		\
@@ -139,6 +363,7 @@
 		\
 		if (list == NULL) return (_TYPE) {0}; \
 		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		usf_internal_listpause(list->cc); /* Keeps adders out */ \
 		\
 		_TYPE data; \
 		if (i >= list->size) data = (_TYPE) {0}; \
@@ -148,10 +373,115 @@
 			list->size--; \
 		} \
 		\
+		usf_internal_listresume(list->cc, list->size); \
 		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
 		return data; \
 	} \
 	\
+	static void usf_internal_list##_NAME##heapsort(_TYPE *array, u64 n, i32 (*compare)(const void *, const void *)) { \
+		/* Sorts n elements with compare in O(n log n) regardless of their order */ \
+		\
+		_TYPE element; \
+		u64 root, hole, child, end; \
+		for (end = n, root = n / 2; end > 1;) { \
+			if (root) element = array[--root]; /* Heapify */ \
+			else { /* Pop the greatest */ \
+				element = array[--end]; \
+				array[end] = array[0]; \
+			} \
+			for (hole = root; (child = hole * 2 + 1) < end; hole = child) { /* Sift down */ \
+				if (child + 1 < end && compare(&array[child], &array[child + 1]) < 0) child++; \
+				if (compare(&element, &array[child]) >= 0) break; \
+				array[hole] = array[child]; \
+			} \
+			array[hole] = element; \
+		} \
+	} \
+	\
+	static void usf_internal_list##_NAME##introsort(_TYPE *array, u64 n, u32 depth, \
+			i32 (*compare)(const void *, const void *)) { \
+		/* Sorts n elements with compare: quicksort on median-of-three pivots, recursing into the smaller
+		 * side only, which falls back to heapsort past depth levels and insertion sorts small ranges */ \
+		\
+		_TYPE pivot; \
+		_TYPE element; \
+		u64 i, j; \
+		while (n > USF_LIST_INSERTIONSORT) { \
+			if (depth-- == 0) { \
+				usf_internal_list##_NAME##heapsort(array, n, compare); \
+				return; \
+			} \
+			if (compare(&array[n / 2], &array[0]) < 0) USF_SWAP(array[n / 2], array[0]); \
+			if (compare(&array[n - 1], &array[n / 2]) < 0) { \
+				USF_SWAP(array[n - 1], array[n / 2]); \
+				if (compare(&array[n / 2], &array[0]) < 0) USF_SWAP(array[n / 2], array[0]); \
+			} \
+			pivot = array[n / 2]; /* The ends now bound both scans */ \
+			for (i = 0, j = n - 1;;) { \
+				do i++; while (compare(&array[i], &pivot) < 0); \
+				do j--; while (compare(&pivot, &array[j]) < 0); \
+				if (i >= j) break; \
+				USF_SWAP(array[i], array[j]); \
+			} \
+			if (i < n - i) { \
+				usf_internal_list##_NAME##introsort(array, i, depth, compare); \
+				array += i; n -= i; \
+			} else { \
+				usf_internal_list##_NAME##introsort(array + i, n - i, depth, compare); \
+				n = i; \
+			} \
+		} \
+		for (i = 1; i < n; i++) { /* Insertion sort */ \
+			for (element = array[i], j = i; j && compare(&element, &array[j - 1]) < 0; j--) \
+				array[j] = array[j - 1]; \
+			array[j] = element; \
+		} \
+	} \
+	\
+	usf_list##_NAME *usf_list##_NAME##sortby(usf_list##_NAME *list, i32 (*compare)(const void *, const void *)) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Sorts the list in place in the order given by compare, which has the same semantics as
+		 * with qsort (e.g. usf_indcmpu64), with an introsort specialized to the list type.
+		 * Returns the list. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		usf_internal_listpause(list->cc); /* Keeps adders out */ \
+		\
+		u32 depth; /* Twice the ideal recursion depth */ \
+		depth = list->size ? 2 * (u32) (64 - __builtin_clzll(list->size)) : 0; \
+		usf_internal_list##_NAME##introsort(list->array, list->size, depth, compare); \
+		\
+		usf_internal_listresume(list->cc, list->size); \
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list; \
+	} \
+	\
+	usf_memusage usf_list##_NAME##memusage(const usf_list##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Returns the memory used by a list, excluding what its values point to. */ \
+		\
+		if (list == NULL) return (usf_memusage) {0}; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		usf_memusage usage; \
+		usf_listretired *retired; \
+		usage = (usf_memusage) {0}; \
+		usage.structure = sizeof(usf_list##_NAME) + (list->cc ? sizeof(usf_listcc) : 0) \
+				+ (list->map ? sizeof(usf_listmap) + sizeof(usf_listmapheader) : 0); \
+		usage.array = list->size * sizeof(_TYPE); \
+		usage.slack = (list->capacity - list->size) * sizeof(_TYPE); \
+		for (retired = list->cc ? list->cc->retired : NULL; retired; retired = retired->next) \
+			usage.slack += retired->size + sizeof(usf_listretired); /* Replaced arrays */ \
+		usage.locks = list->lock ? sizeof(usf_mutex) : 0; \
+		usage.total = usage.structure + usage.array + usage.locks + usage.slack; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return usage; \
+	} \
+	\
 	void usf_freelist##_NAME##func(usf_list##_NAME *list, void (*freefunc)(_TYPE)) { \
 		/* Frees a list and calls freefunc on its values.
 		 * If freefunc is NULL, nothing is done to the values.
@@ -163,12 +493,22 @@
 		if (freefunc) for (i = 0; i < list->size; i++) \
 			freefunc(list->array[i]); /* Free value */ \
 		\
-		usf_free(list->array); \
+		if (list->map) usf_internal_listunmap(list->map, list->size); /* Persists the size */ \
+		else usf_afree(list->allocator, list->array, list->capacity * sizeof(_TYPE)); \
+		if (list->cc) { \
+			usf_listretired *retired; \
+			while ((retired = list->cc->retired)) { \
+				list->cc->retired = retired->next; \
+				usf_afree(list->allocator, retired->array, retired->size); \
+				usf_afree(list->allocator, retired, sizeof(usf_listretired)); \
+			} \
+			usf_afree(list->allocator, list->cc, sizeof(usf_listcc)); \
+		} \
 		if (list->lock) { \
 			usf_mtxdestroy(list->lock); \
-			usf_free(list->lock); \
+			usf_afree(list->allocator, list->lock, sizeof(usf_mutex)); \
 		} \
-		usf_free(list); \
+		usf_afree(list->allocator, list, sizeof(usf_list##_NAME)); \
 	} \
 	\
 	void usf_freelist##_NAME(usf_list##_NAME *list) { \
@@ -191,3 +531,682 @@ USF_LISTIMPL(void *, ptr)
 USF_LISTIMPL(usf_data, )
 #undef USF_LISTIMPL
 #undef USF_LISTRESIZE
+#undef USF_LISTRESERVE
+
+/* Memory-mapped file storage for numeric lists
+ * _TYPE		underlying list type
+ * _NAME		list name suffix (e.g. f32 -> usf_listf32)
+ * */
+
+#define USF_LISTMAPIMPL(_TYPE, _NAME) \
+	usf_list##_NAME *usf_newlist##_NAME##map(const char *path, const char *mode) { \
+		/* Creates a new non thread-safe list whose array lives in the memory-mapped file at path,
+		 * so that it may exceed memory and outlive the process. Its file grows and shrinks with it.
+		 * mode is "r" to map an existing list file read-only (the list must then not be modified),
+		 * "r+" to map it for reading and writing, or "w+" to create or truncate it first.
+		 * Elements reach the file as the system writes the mapping back, but its size is only
+		 * recorded by usf_list##_NAMEsync and when the list is freed.
+		 * Returns the created list, or NULL if the file cannot be opened or mapped, or holds
+		 * something other than a list of this element size. */ \
+		\
+		usf_list##_NAME *list; \
+		usf_listmap *map; \
+		if ((map = usf_internal_listmap(path, mode, sizeof(_TYPE))) == NULL) return NULL; \
+		if ((list = usf_amalloc(&usf_stdallocator, sizeof(usf_list##_NAME))) == NULL) { \
+			usf_internal_listunmap(map, ((usf_listmapheader *) map->base)->size); \
+			return NULL; \
+		} \
+		\
+		list->lock = NULL; \
+		list->array = (_TYPE *) (void *) ((u8 *) map->base + sizeof(usf_listmapheader)); \
+		list->size = ((usf_listmapheader *) map->base)->size; \
+		list->capacity = (map->length - sizeof(usf_listmapheader)) / sizeof(_TYPE); \
+		list->cc = NULL; \
+		list->map = map; \
+		list->allocator = &usf_stdallocator; \
+		\
+		return list; \
+	} \
+	\
+	usf_list##_NAME *usf_newlist##_NAME##map_ts(const char *path, const char *mode) { \
+		/* Creates a new thread-safe list stored in the memory-mapped file at path, see usf_newlist##_NAMEmap.
+		 * Returns the created list, or NULL if an error occurred. */ \
+		\
+		usf_list##_NAME *list; \
+		if ((list = usf_newlist##_NAME##map(path, mode)) == NULL) return NULL; \
+		list->lock = usf_amalloc(list->allocator, sizeof(usf_mutex)); \
+		if (usf_mtxinit(list->lock, MTXINIT_RECURSIVE)) { \
+			usf_afree(list->allocator, list->lock, sizeof(usf_mutex)); \
+			list->lock = NULL; \
+			usf_freelist##_NAME(list); \
+			return NULL; /* mutex init failed */ \
+		} \
+		\
+		return list; \
+	} \
+	\
+	usf_list##_NAME *usf_list##_NAME##sync(usf_list##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Records the size of a mapped list in its file and waits until all of it is written back,
+		 * so that it survives a crash as of now. Lists that are not mapped are left untouched.
+		 * Returns the list, or NULL if an error occurred. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->map == NULL) return list; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		i32 status; \
+		status = usf_internal_listsyncmap(list->map, list->size); \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return status ? NULL : list; \
+	}
+USF_LISTMAPIMPL(i8, i8)
+USF_LISTMAPIMPL(i16, i16)
+USF_LISTMAPIMPL(i32, i32)
+USF_LISTMAPIMPL(i64, i64)
+USF_LISTMAPIMPL(u8, u8)
+USF_LISTMAPIMPL(u16, u16)
+USF_LISTMAPIMPL(u32, u32)
+USF_LISTMAPIMPL(u64, u64)
+USF_LISTMAPIMPL(f32, f32)
+USF_LISTMAPIMPL(f64, f64)
+#undef USF_LISTMAPIMPL
+
+/* Job handed to a sorting thread: sort src[lo, hi) using dst as scratch space, or
+ * merge the sorted runs src[lo, mid) and src[mid, hi) into dst[lo, hi) */
+typedef struct usf_listsortjob {
+	void *src;
+	void *dst;
+	u64 lo, mid, hi;
+} usf_listsortjob;
+
+/* Natural order sorting implementation for numeric lists
+ * _TYPE		underlying list type
+ * _NAME		list name suffix (e.g. f32 -> usf_listf32)
+ * _UTYPE		unsigned integer type of the same width as _TYPE
+ * _KIND		0 for unsigned integers, 1 for signed integers, 2 for floating point
+ *
+ * Elements are sorted on unsigned keys of their bits in the same order: the sign bit is
+ * flipped for signed integers and positive floats, and all bits for negative floats.
+ * */
+
+#define USF_LISTSORTIMPL(_TYPE, _NAME, _UTYPE, _KIND) \
+	static inline _UTYPE usf_internal_list##_NAME##key(_TYPE element) { \
+		/* Returns the radix key of an element */ \
+		\
+		_UTYPE bits, sign; \
+		memcpy(&bits, &element, sizeof(bits)); \
+		sign = (_UTYPE) ((_UTYPE) 1 << (sizeof(_UTYPE) * 8 - 1)); \
+		if (_KIND == 1) bits = (_UTYPE) (bits ^ sign); \
+		else if (_KIND == 2) bits = (_UTYPE) (bits & sign ? ~bits : bits | sign); \
+		return bits; \
+	} \
+	\
+	static void usf_internal_list##_NAME##radixsort(_TYPE *array, _TYPE *buffer, u64 n) { \
+		/* Sorts n elements with an LSD radix sort on bytes, using buffer (of n elements) as
+		 * scratch space; passes on bytes that are equal for all elements are skipped */ \
+		\
+		_TYPE *src, *dst, element; \
+		_UTYPE key; \
+		u64 counts[sizeof(_TYPE)][256], offset, count, i, j; \
+		u32 digit, d; \
+		if (n <= USF_LIST_INSERTIONSORT) { /* Insertion sort */ \
+			for (i = 1; i < n; i++) { \
+				element = array[i], key = usf_internal_list##_NAME##key(element); \
+				for (j = i; j && key < usf_internal_list##_NAME##key(array[j - 1]); j--) \
+					array[j] = array[j - 1]; \
+				array[j] = element; \
+			} \
+			return; \
+		} \
+		\
+		memset(counts, 0, sizeof(counts)); \
+		for (i = 0; i < n; i++) { /* All histograms in one read */ \
+			key = usf_internal_list##_NAME##key(array[i]); \
+			for (d = 0; d < sizeof(_TYPE); d++) counts[d][(key >> (d * 8)) & 0xFF]++; \
+		} \
+		\
+		src = array; dst = buffer; \
+		for (d = 0; d < sizeof(_TYPE); d++) { \
+			if (counts[d][(usf_internal_list##_NAME##key(src[0]) >> (d * 8)) & 0xFF] == n) continue; \
+			\
+			for (digit = 0, offset = 0; digit < 256; digit++) { /* Histogram to offsets */ \
+				count = counts[d][digit]; \
+				counts[d][digit] = offset; \
+				offset += count; \
+			} \
+			for (i = 0; i < n; i++) \
+				dst[counts[d][(usf_internal_list##_NAME##key(src[i]) >> (d * 8)) & 0xFF]++] = src[i]; \
+			USF_SWAP(src, dst); \
+		} \
+		if (src != array) memcpy(array, src, n * sizeof(_TYPE)); \
+	} \
+	\
+	static usf_compatibility_int usf_internal_list##_NAME##sortrun(void *job) { \
+		/* Thread entry sorting a run of a usf_listsortjob in place */ \
+		\
+		usf_listsortjob *run; \
+		run = job; \
+		usf_internal_list##_NAME##radixsort((_TYPE *) run->src + run->lo, (_TYPE *) run->dst + run->lo, \
+				run->hi - run->lo); \
+		return 0; \
+	} \
+	\
+	static usf_compatibility_int usf_internal_list##_NAME##sortmerge(void *job) { \
+		/* Thread entry stably merging the two runs of a usf_listsortjob */ \
+		\
+		usf_listsortjob *merge; \
+		_TYPE *src, *dst; \
+		u64 i, j, k; \
+		merge = job; \
+		src = merge->src; dst = merge->dst; \
+		for (i = merge->lo, j = merge->mid, k = merge->lo; i < merge->mid && j < merge->hi; k++) \
+			dst[k] = usf_internal_list##_NAME##key(src[j]) < usf_internal_list##_NAME##key(src[i]) \
+				? src[j++] : src[i++]; \
+		memcpy(dst + k, src + i, (merge->mid - i) * sizeof(_TYPE)); \
+		memcpy(dst + k + merge->mid - i, src + j, (merge->hi - j) * sizeof(_TYPE)); \
+		return 0; \
+	} \
+	\
+	usf_list##_NAME *usf_list##_NAME##sort(usf_list##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Sorts the list in place in ascending order, without comparisons, with an LSD radix
+		 * sort. Floating point lists sort -0.0 before 0.0, and NaNs at either end by sign.
+		 * Returns the list, or NULL if the scratch space could not be allocated. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		usf_internal_listpause(list->cc); /* Keeps adders out */ \
+		\
+		_TYPE *buffer; \
+		buffer = NULL; \
+		if (list->size > USF_LIST_INSERTIONSORT \
+				&& (buffer = usf_amalloc(list->allocator, list->size * sizeof(_TYPE))) == NULL) { \
+			usf_internal_listresume(list->cc, list->size); \
+			if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+			return NULL; \
+		} \
+		usf_internal_list##_NAME##radixsort(list->array, buffer, list->size); \
+		usf_afree(list->allocator, buffer, list->size * sizeof(_TYPE)); \
+		\
+		usf_internal_listresume(list->cc, list->size); \
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list; \
+	} \
+	\
+	usf_list##_NAME *usf_list##_NAME##psort(usf_list##_NAME *list, u64 nthreads) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Sorts the list in place in ascending order like usf_list*sort, over up to nthreads
+		 * threads (at most USF_LIST_MAXSORTTHREADS): each radix sorts a run of the list, and
+		 * the runs are then merged pairwise, all pairs of a round in parallel.
+		 * Jobs whose thread cannot be started run on the calling thread instead.
+		 * Returns the list, or NULL if the scratch space could not be allocated. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		usf_internal_listpause(list->cc); /* Keeps adders out */ \
+		\
+		usf_listsortjob jobs[USF_LIST_MAXSORTTHREADS]; \
+		usf_thread threads[USF_LIST_MAXSORTTHREADS]; \
+		u8 started[USF_LIST_MAXSORTTHREADS]; \
+		_TYPE *buffer, *src, *dst; \
+		u64 n, runsz, njobs, k; \
+		n = list->size; \
+		nthreads = USF_MIN(USF_MAX(nthreads, 1), USF_LIST_MAXSORTTHREADS); \
+		nthreads = USF_MIN(nthreads, n / USF_LIST_INSERTIONSORT + 1); /* No threads for tiny runs */ \
+		\
+		buffer = NULL; \
+		if (n > USF_LIST_INSERTIONSORT && (buffer = usf_amalloc(list->allocator, n * sizeof(_TYPE))) == NULL) { \
+			usf_internal_listresume(list->cc, n); \
+			if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+			return NULL; \
+		} \
+		\
+		src = list->array; dst = buffer; \
+		runsz = (n + nthreads - 1) / nthreads; \
+		for (k = 0; k < nthreads; k++) /* Sort runs in place */ \
+			jobs[k] = (usf_listsortjob) {src, dst, USF_MIN(k * runsz, n), 0, USF_MIN((k + 1) * runsz, n)}; \
+		for (k = 1; k < nthreads; k++) \
+			started[k] = usf_thrdcreate(&threads[k], usf_internal_list##_NAME##sortrun, &jobs[k]) == THRD_SUCCESS; \
+		for (k = 0; k < nthreads; k++) { \
+			if (k == 0 || !started[k]) usf_internal_list##_NAME##sortrun(&jobs[k]); \
+			else usf_thrdjoin(threads[k], NULL); \
+		} \
+		\
+		for (; runsz < n; runsz *= 2) { /* Merge pairs of runs between the array and buffer */ \
+			njobs = (n + 2 * runsz - 1) / (2 * runsz); \
+			for (k = 0; k < njobs; k++) \
+				jobs[k] = (usf_listsortjob) {src, dst, k * 2 * runsz, USF_MIN((k * 2 + 1) * runsz, n), \
+						USF_MIN((k + 1) * 2 * runsz, n)}; \
+			for (k = 1; k < njobs; k++) \
+				started[k] = usf_thrdcreate(&threads[k], usf_internal_list##_NAME##sortmerge, &jobs[k]) == THRD_SUCCESS; \
+			for (k = 0; k < njobs; k++) { \
+				if (k == 0 || !started[k]) usf_internal_list##_NAME##sortmerge(&jobs[k]); \
+				else usf_thrdjoin(threads[k], NULL); \
+			} \
+			USF_SWAP(src, dst); \
+		} \
+		if (src != list->array) memcpy(list->array, src, n * sizeof(_TYPE)); \
+		usf_afree(list->allocator, buffer, n * sizeof(_TYPE)); \
+		\
+		usf_internal_listresume(list->cc, n); \
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list; \
+	}
+USF_LISTSORTIMPL(i8, i8, u8, 1)
+USF_LISTSORTIMPL(i16, i16, u16, 1)
+USF_LISTSORTIMPL(i32, i32, u32, 1)
+USF_LISTSORTIMPL(i64, i64, u64, 1)
+USF_LISTSORTIMPL(u8, u8, u8, 0)
+USF_LISTSORTIMPL(u16, u16, u16, 0)
+USF_LISTSORTIMPL(u32, u32, u32, 0)
+USF_LISTSORTIMPL(u64, u64, u64, 0)
+USF_LISTSORTIMPL(f32, f32, u32, 2)
+USF_LISTSORTIMPL(f64, f64, u64, 2)
+#undef USF_LISTSORTIMPL
+
+/* Reduction kernels are also compiled for AVX2 where the toolchain can pick between
+ * clones at load time; SSE2 is the x86-64 baseline of the default clone */
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(__clang__)
+#define USF_LISTKERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define USF_LISTKERNEL
+#endif
+
+/* Consistent snapshot of a list's contents for reading, holding the lock of non-concurrent lists
+ * _LIST		reference to the list
+ * _TYPE		underlying list type
+ * _STATEMENT	statement over ARRAY_ and SIZE_
+ *
+ * ARRAY_		list array, which concurrent lists keep valid while it is read
+ * SIZE_		list size, loaded before the array so that the array holds all of it (concurrent list arrays only grow)
+ * */
+
+#define USF_LISTREAD(_LIST, _TYPE, _STATEMENT) \
+	const _TYPE *ARRAY_; \
+	u64 SIZE_; \
+	if (_LIST->lock && _LIST->cc == NULL) usf_mtxlock(_LIST->lock); /* Thread-safe lock */ \
+	SIZE_ = __atomic_load_n(&_LIST->size, __ATOMIC_ACQUIRE); \
+	ARRAY_ = __atomic_load_n(&_LIST->array, __ATOMIC_ACQUIRE); \
+	_STATEMENT; \
+	if (_LIST->lock && _LIST->cc == NULL) usf_mtxunlock(_LIST->lock); /* Thread-safe unlock */
+
+/* Reductions and searches for numeric lists
+ * _TYPE		underlying list type
+ * _NAME		list name suffix (e.g. f32 -> usf_listf32)
+ * _ACC			type of sums and dot products
+ * _MATH		type they are computed in: unsigned for integers so that overflow wraps around
+ *
+ * Loops keep USF_LIST_LANES independent accumulators, which the compiler maps onto vector
+ * registers; floating point reductions could not be vectorized otherwise, as that reorders them.
+ * */
+
+#define USF_LISTREDUCEIMPL(_TYPE, _NAME, _ACC, _MATH) \
+	USF_LISTKERNEL _ACC usf_arr##_NAME##sum(const _TYPE *array, u64 n) { \
+		/* Returns the sum of n elements, wrapping around on integer overflow */ \
+		\
+		_MATH lanes[USF_LIST_LANES] = {0}, sum; \
+		u64 i, k; \
+		for (i = 0; i + USF_LIST_LANES <= n; i += USF_LIST_LANES) \
+			for (k = 0; k < USF_LIST_LANES; k++) lanes[k] += (_MATH) (_ACC) array[i + k]; \
+		for (sum = 0, k = 0; k < USF_LIST_LANES; k++) sum += lanes[k]; \
+		for (; i < n; i++) sum += (_MATH) (_ACC) array[i]; \
+		return (_ACC) sum; \
+	} \
+	\
+	_TYPE usf_arr##_NAME##min(const _TYPE *array, u64 n) { \
+		/* Returns the least of n elements, or zero if there are none */ \
+		\
+		_TYPE min; \
+		usf_arr##_NAME##minmax(array, n, &min, NULL); \
+		return min; \
+	} \
+	\
+	_TYPE usf_arr##_NAME##max(const _TYPE *array, u64 n) { \
+		/* Returns the greatest of n elements, or zero if there are none */ \
+		\
+		_TYPE max; \
+		usf_arr##_NAME##minmax(array, n, NULL, &max); \
+		return max; \
+	} \
+	\
+	USF_LISTKERNEL void usf_arr##_NAME##minmax(const _TYPE *array, u64 n, _TYPE *min, _TYPE *max) { \
+		/* Stores the least and greatest of n elements in min and max when they are not NULL,
+		 * or zero if there are none. Floating point arrays holding NaNs give unspecified results. */ \
+		\
+		_TYPE lows[USF_LIST_LANES], highs[USF_LIST_LANES], low, high; \
+		u64 i, k; \
+		if (n == 0) { \
+			if (min) *min = 0; \
+			if (max) *max = 0; \
+			return; \
+		} \
+		\
+		for (k = 0; k < USF_LIST_LANES; k++) lows[k] = highs[k] = array[0]; \
+		for (i = 0; i + USF_LIST_LANES <= n; i += USF_LIST_LANES) { \
+			for (k = 0; k < USF_LIST_LANES; k++) { \
+				lows[k] = array[i + k] < lows[k] ? array[i + k] : lows[k]; \
+				highs[k] = array[i + k] > highs[k] ? array[i + k] : highs[k]; \
+			} \
+		} \
+		for (low = high = array[0], k = 0; k < USF_LIST_LANES; k++) { \
+			low = lows[k] < low ? lows[k] : low; \
+			high = highs[k] > high ? highs[k] : high; \
+		} \
+		for (; i < n; i++) { \
+			low = array[i] < low ? array[i] : low; \
+			high = array[i] > high ? array[i] : high; \
+		} \
+		if (min) *min = low; \
+		if (max) *max = high; \
+	} \
+	\
+	USF_LISTKERNEL u64 usf_arr##_NAME##count(const _TYPE *array, u64 n, _TYPE value) { \
+		/* Returns the number of elements among n equal to value */ \
+		\
+		u64 lanes[USF_LIST_LANES] = {0}, count, i, k; \
+		for (i = 0; i + USF_LIST_LANES <= n; i += USF_LIST_LANES) \
+			for (k = 0; k < USF_LIST_LANES; k++) lanes[k] += array[i + k] == value; \
+		for (count = 0, k = 0; k < USF_LIST_LANES; k++) count += lanes[k]; \
+		for (; i < n; i++) count += array[i] == value; \
+		return count; \
+	} \
+	\
+	USF_LISTKERNEL u64 usf_arr##_NAME##find(const _TYPE *array, u64 n, _TYPE value) { \
+		/* Returns the index of the first element among n equal to value, or U64_MAX if there is none.
+		 * Whole blocks are compared at once, and only the one holding a match is searched. */ \
+		\
+		u64 i, k; \
+		u8 hit; \
+		for (i = 0; i + USF_LIST_LANES <= n; i += USF_LIST_LANES) { \
+			for (hit = 0, k = 0; k < USF_LIST_LANES; k++) hit |= array[i + k] == value; \
+			if (hit) break; \
+		} \
+		for (; i < n; i++) if (array[i] == value) return i; \
+		return U64_MAX; \
+	} \
+	\
+	USF_LISTKERNEL _ACC usf_arr##_NAME##dot(const _TYPE *a, const _TYPE *b, u64 n) { \
+		/* Returns the dot product of two arrays of n elements, wrapping around on integer overflow */ \
+		\
+		_MATH lanes[USF_LIST_LANES] = {0}, dot; \
+		u64 i, k; \
+		for (i = 0; i + USF_LIST_LANES <= n; i += USF_LIST_LANES) \
+			for (k = 0; k < USF_LIST_LANES; k++) lanes[k] += (_MATH) (_ACC) a[i + k] * (_MATH) (_ACC) b[i + k]; \
+		for (dot = 0, k = 0; k < USF_LIST_LANES; k++) dot += lanes[k]; \
+		for (; i < n; i++) dot += (_MATH) (_ACC) a[i] * (_MATH) (_ACC) b[i]; \
+		return (_ACC) dot; \
+	} \
+	\
+	_ACC usf_list##_NAME##sum(const usf_list##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Returns the sum of a list's elements, wrapping around on integer overflow.
+		 * This never locks concurrent lists, nor does any other reduction. */ \
+		\
+		if (list == NULL) return 0; \
+		\
+		_ACC sum; \
+		USF_LISTREAD(list, _TYPE, sum = usf_arr##_NAME##sum(ARRAY_, SIZE_)); \
+		return sum; \
+	} \
+	\
+	_TYPE usf_list##_NAME##min(const usf_list##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Returns the least element of a list, or zero if it is empty. */ \
+		\
+		if (list == NULL) return 0; \
+		\
+		_TYPE min; \
+		USF_LISTREAD(list, _TYPE, min = usf_arr##_NAME##min(ARRAY_, SIZE_)); \
+		return min; \
+	} \
+	\
+	_TYPE usf_list##_NAME##max(const usf_list##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Returns the greatest element of a list, or zero if it is empty. */ \
+		\
+		if (list == NULL) return 0; \
+		\
+		_TYPE max; \
+		USF_LISTREAD(list, _TYPE, max = usf_arr##_NAME##max(ARRAY_, SIZE_)); \
+		return max; \
+	} \
+	\
+	void usf_list##_NAME##minmax(const usf_list##_NAME *list, _TYPE *min, _TYPE *max) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Stores the least and greatest elements of a list in min and max when they are not NULL,
+		 * in a single pass, or zero if it is empty. */ \
+		\
+		if (list == NULL) return; \
+		\
+		USF_LISTREAD(list, _TYPE, usf_arr##_NAME##minmax(ARRAY_, SIZE_, min, max)); \
+	} \
+	\
+	u64 usf_list##_NAME##count(const usf_list##_NAME *list, _TYPE value) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Returns the number of elements of a list equal to value. */ \
+		\
+		if (list == NULL) return 0; \
+		\
+		u64 count; \
+		USF_LISTREAD(list, _TYPE, count = usf_arr##_NAME##count(ARRAY_, SIZE_, value)); \
+		return count; \
+	} \
+	\
+	u64 usf_list##_NAME##find(const usf_list##_NAME *list, _TYPE value) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Returns the index of the first element of a list equal to value, or U64_MAX if there is none. */ \
+		\
+		if (list == NULL) return U64_MAX; \
+		\
+		u64 index; \
+		USF_LISTREAD(list, _TYPE, index = usf_arr##_NAME##find(ARRAY_, SIZE_, value)); \
+		return index; \
+	} \
+	\
+	_ACC usf_list##_NAME##dot(const usf_list##_NAME *a, const usf_list##_NAME *b) { \
+		/* This function is thread-safe when operating on thread-safe lists.
+		 *
+		 * Returns the dot product of two lists over the length of the shorter one, wrapping around
+		 * on integer overflow. Both lists are held at once, their locks taken in address order. */ \
+		\
+		if (a == NULL || b == NULL) return 0; \
+		if (a > b) USF_SWAP(a, b); \
+		\
+		_ACC dot; \
+		usf_mutex *locka, *lockb; \
+		u64 n; \
+		locka = a->cc ? NULL : a->lock; \
+		lockb = b->cc || b == a ? NULL : b->lock; \
+		if (locka) usf_mtxlock(locka); /* Thread-safe lock */ \
+		if (lockb) usf_mtxlock(lockb); /* Thread-safe lock */ \
+		\
+		n = USF_MIN(__atomic_load_n(&a->size, __ATOMIC_ACQUIRE), __atomic_load_n(&b->size, __ATOMIC_ACQUIRE)); /* See USF_LISTREAD */ \
+		dot = usf_arr##_NAME##dot(__atomic_load_n(&a->array, __ATOMIC_ACQUIRE), \
+				__atomic_load_n(&b->array, __ATOMIC_ACQUIRE), n); \
+		\
+		if (lockb) usf_mtxunlock(lockb); /* Thread-safe unlock */ \
+		if (locka) usf_mtxunlock(locka); /* Thread-safe unlock */ \
+		return dot; \
+	}
+USF_LISTREDUCEIMPL(i8, i8, i64, u64)
+USF_LISTREDUCEIMPL(i16, i16, i64, u64)
+USF_LISTREDUCEIMPL(i32, i32, i64, u64)
+USF_LISTREDUCEIMPL(i64, i64, i64, u64)
+USF_LISTREDUCEIMPL(u8, u8, u64, u64)
+USF_LISTREDUCEIMPL(u16, u16, u64, u64)
+USF_LISTREDUCEIMPL(u32, u32, u64, u64)
+USF_LISTREDUCEIMPL(u64, u64, u64, u64)
+USF_LISTREDUCEIMPL(f32, f32, f64, f64)
+USF_LISTREDUCEIMPL(f64, f64, f64, f64)
+#undef USF_LISTREDUCEIMPL
+#undef USF_LISTREAD
+#undef USF_LISTKERNEL
+
+static void usf_internal_listpause(usf_listcc *cc) {
+	/* Keeps adders out of a concurrent list and waits for those in flight to publish their element */
+
+	if (cc == NULL) return;
+
+	usf_atmmst(&cc->paused, 1, MEMORDER_SEQ_CST);
+	while (usf_atmmld(&cc->writers, MEMORDER_SEQ_CST)) usf_thrdyield();
+}
+
+static void usf_internal_listresume(usf_listcc *cc, u64 size) {
+	/* Lets adders back in a concurrent list of the given size, discarding claims past its capacity */
+
+	if (cc == NULL) return;
+
+	usf_atmmst(&cc->claimed, size, MEMORDER_RELAXED);
+	usf_atmmst(&cc->paused, 0, MEMORDER_SEQ_CST);
+}
+
+static u64 usf_internal_listclaim(usf_listcc *cc, const u64 *capacity) {
+	/* Returns a slot for an adder to write its element in, after which it must call usf_internal_listcommit,
+	 * or U64_MAX if the list is full or paused (the adder then needs to take the lock).
+	 * The capacity is only read once this adder is counted as a writer and saw the list unpaused:
+	 * from then on, nothing can resize the array before it commits */
+
+	u64 slot;
+	usf_atmaddi(&cc->writers, 1, MEMORDER_SEQ_CST);
+	if (usf_atmmld(&cc->paused, MEMORDER_SEQ_CST) == 0
+			&& (slot = usf_atmaddi(&cc->claimed, 1, MEMORDER_RELAXED)) < __atomic_load_n(capacity, __ATOMIC_ACQUIRE))
+		return slot;
+
+	usf_atmsubi(&cc->writers, 1, MEMORDER_RELEASE);
+	return U64_MAX;
+}
+
+static void usf_internal_listcommit(usf_listcc *cc, u64 *size, u64 slot) {
+	/* Publishes a written slot to readers once all slots before it are */
+
+	while (__atomic_load_n(size, __ATOMIC_ACQUIRE) != slot) usf_thrdyield();
+	__atomic_store_n(size, slot + 1, __ATOMIC_RELEASE);
+	usf_atmsubi(&cc->writers, 1, MEMORDER_RELEASE);
+}
+
+static void *usf_internal_listrealloc(const usf_allocator *allocator, usf_listcc *cc, usf_listmap *map,
+		void *array, u64 oldsize, u64 newsize) {
+	/* Resizes a list array like usf_arealloc, but resizes the file of mapped lists, and moves
+	 * concurrent list arrays to new memory and retires the old one until the list is freed instead,
+	 * as readers may still be using it */
+
+	if (map) return usf_internal_listremap(map, newsize);
+	if (cc == NULL || array == NULL) return usf_arealloc(allocator, array, oldsize, newsize);
+
+	usf_listretired *retired;
+	void *newarray;
+	if ((retired = usf_amalloc(allocator, sizeof(usf_listretired))) == NULL) return NULL;
+	if ((newarray = usf_amalloc(allocator, newsize)) == NULL) {
+		usf_afree(allocator, retired, sizeof(usf_listretired));
+		return NULL;
+	}
+	memcpy(newarray, array, USF_MIN(oldsize, newsize));
+
+	retired->next = cc->retired;
+	retired->array = array;
+	retired->size = oldsize;
+	cc->retired = retired;
+
+	return newarray;
+}
+
+static usf_listmap *usf_internal_listmap(const char *path, const char *mode, u64 elemsize) {
+	/* Maps the list file at path with mode "r", "r+" or "w+" (see usf_newlist*map), creating it
+	 * with room for USF_LIST_DEFAULTSIZE elements in the latter case.
+	 * Returns the mapping, or NULL if an error occurred or the file does not hold elemsize-byte elements */
+
+	usf_listmap *map;
+	usf_listmapheader *header;
+	struct stat status;
+	i32 flags, created;
+	if (strcmp(mode, "r") == 0) flags = O_RDONLY, created = 0;
+	else if (strcmp(mode, "r+") == 0) flags = O_RDWR, created = 0;
+	else if (strcmp(mode, "w+") == 0) flags = O_RDWR | O_CREAT | O_TRUNC, created = 1;
+	else return NULL; /* Unknown mode */
+
+	if ((map = usf_malloc(sizeof(usf_listmap))) == NULL) return NULL;
+	if ((map->fd = open(path, flags, 0644)) < 0) {
+		usf_free(map);
+		return NULL; /* Failed to open */
+	}
+	map->writable = flags != O_RDONLY;
+	if (created) map->length = sizeof(usf_listmapheader) + USF_LIST_DEFAULTSIZE * elemsize;
+	else map->length = fstat(map->fd, &status) ? 0 : (u64) status.st_size;
+
+	if (map->length < sizeof(usf_listmapheader) || (created && ftruncate(map->fd, (off_t) map->length))
+			|| (map->base = mmap(NULL, map->length, map->writable ? PROT_READ | PROT_WRITE : PROT_READ,
+					MAP_SHARED, map->fd, 0)) == MAP_FAILED) {
+		close(map->fd);
+		usf_free(map);
+		return NULL; /* Not a list file, or failed to map */
+	}
+
+	header = map->base;
+	if (created) *header = (usf_listmapheader) {USF_LIST_MAPMAGIC, elemsize, 0, {0}};
+	if (header->magic != USF_LIST_MAPMAGIC || header->elemsize != elemsize
+			|| (map->length - sizeof(usf_listmapheader)) % elemsize
+			|| header->size > (map->length - sizeof(usf_listmapheader)) / elemsize) {
+		munmap(map->base, map->length);
+		close(map->fd);
+		usf_free(map);
+		return NULL; /* Wrong or damaged list file */
+	}
+
+	return map;
+}
+
+static void *usf_internal_listremap(usf_listmap *map, u64 arraysize) {
+	/* Resizes the file and mapping of a mapped list to hold an array of arraysize bytes.
+	 * Returns the array, which may have moved, or NULL if an error occurred (the list is then left untouched) */
+
+	void *base;
+	u64 length;
+	length = sizeof(usf_listmapheader) + arraysize;
+	if (length > map->length && ftruncate(map->fd, (off_t) length)) return NULL; /* Grow the file first */
+
+#ifdef __linux__
+	base = mremap(map->base, map->length, length, MREMAP_MAYMOVE);
+#else
+	if ((base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0)) != MAP_FAILED)
+		munmap(map->base, map->length); /* Both map the same file */
+#endif
+	if (base == MAP_FAILED) {
+		if (length > map->length && ftruncate(map->fd, (off_t) map->length)) {} /* Best effort */
+		return NULL;
+	}
+	if (length < map->length && ftruncate(map->fd, (off_t) length)) {} /* Only releases disk space */
+
+	map->base = base;
+	map->length = length;
+	return (u8 *) base + sizeof(usf_listmapheader);
+}
+
+static i32 usf_internal_listsyncmap(usf_listmap *map, u64 size) {
+	/* Records size in the header of a writable mapped list and writes the mapping back to its file.
+	 * Returns 0, or -1 if an error occurred */
+
+	if (!map->writable) return 0;
+	((usf_listmapheader *) map->base)->size = size;
+	return msync(map->base, map->length, MS_SYNC);
+}
+
+static void usf_internal_listunmap(usf_listmap *map, u64 size) {
+	/* Records size in the header of a mapped list, then unmaps it and closes its file.
+	 * The system writes back the mapping afterwards. */
+
+	if (map->writable) ((usf_listmapheader *) map->base)->size = size;
+	munmap(map->base, map->length);
+	close(map->fd);
+	usf_free(map);
+}
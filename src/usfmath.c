@@ -22,6 +22,16 @@ u64 usf_hash(u64 val) {
 	return val;
 }
 
+u64 usf_xorshift(u64 *state) {
+	/* Advances a xorshift64* generator state, which must not be zero.
+	 * Returns the next 64-bit pseudorandom value. */
+
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545F4914F6CDD1D;
+}
+
 /* Generic comparison functions */
 #define USF_INDCMPFUNC(_TYPE) \
 	i32 usf_indcmp##_TYPE(const void *a, const void *b) { \
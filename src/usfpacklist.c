@@ -0,0 +1,442 @@
+#include "usfpacklist.h"
+
+/* Sequential reader over a packlist, a block at a time */
+typedef struct usf_packcursor {
+	const usf_packlist *list;
+	u64 block;					/* Loaded block, nblocks for the tail */
+	u64 n;						/* Values in values, 0 past the end */
+	u64 pos;
+	u64 values[USF_PACKLIST_BLOCKSIZE];
+} usf_packcursor;
+
+static u8 usf_internal_packlistappend(usf_packlist *list, u64 value);
+static u8 usf_internal_packlistflush(usf_packlist *list);
+static void usf_internal_packlistunpack(const usf_packlist *list, u64 b, u64 *dst);
+static u64 usf_internal_packlistdelta(const u64 *words, u64 width, u64 j);
+static u64 usf_internal_packlistfirst(const usf_packlist *list, u64 b);
+static void usf_internal_packcursorload(usf_packcursor *cursor, u64 b);
+static void usf_internal_packcursorseek(usf_packcursor *cursor, u64 value);
+static void usf_internal_packcursornext(usf_packcursor *cursor);
+static void usf_internal_packlistlock(const usf_packlist *a, const usf_packlist *b, u8 unlock);
+
+usf_packlist *usf_newpacklist(void) {
+	/* Wrapper for creating non thread-safe packlists using usf_stdallocator. */
+
+	return usf_newpacklist_alloc(&usf_stdallocator);
+}
+
+usf_packlist *usf_newpacklist_ts(void) {
+	/* Wrapper for creating thread-safe packlists using usf_stdallocator. */
+
+	return usf_newpacklist_ts_alloc(&usf_stdallocator);
+}
+
+usf_packlist *usf_newpacklist_alloc(const usf_allocator *allocator) {
+	/* Creates a new empty non thread-safe packlist, a sorted list of u64 values compressed by
+	 * storing each block of USF_PACKLIST_BLOCKSIZE values as its first value and the deltas to the
+	 * next ones, bit-packed to the width of the largest. Dense sorted ids take a few bits each.
+	 * Values are read back a block at a time, and the block headers act as skip pointers.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+	 * Returns the created packlist, or NULL on failure. */
+
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
+	usf_packlist *list;
+	if ((list = usf_acalloc(allocator, 1, sizeof(usf_packlist))) == NULL) return NULL;
+	list->allocator = allocator;
+
+	return list;
+}
+
+usf_packlist *usf_newpacklist_ts_alloc(const usf_allocator *allocator) {
+	/* Creates a new empty thread-safe packlist, see usf_newpacklist_alloc.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+	 * Returns the created packlist, or NULL if an error occurred. */
+
+	usf_packlist *list;
+	if ((list = usf_newpacklist_alloc(allocator)) == NULL) return NULL;
+	list->lock = usf_amalloc(list->allocator, sizeof(usf_mutex));
+	if (list->lock == NULL || usf_mtxinit(list->lock, MTXINIT_RECURSIVE)) {
+		usf_afree(list->allocator, list->lock, sizeof(usf_mutex));
+		list->lock = NULL;
+		usf_freepacklist(list);
+		return NULL; /* mutex init failed */
+	}
+
+	return list;
+}
+
+usf_packlist *usf_packlistadd(usf_packlist *list, u64 value) {
+	/* This function is thread-safe when operating on thread-safe packlists.
+	 *
+	 * Appends value to the packlist, packing the tail into a block once it is full.
+	 * Returns the packlist, or NULL if value is lower than the last one or an error occurred. */
+
+	if (list == NULL) return NULL;
+	if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */
+
+	u8 failed;
+	failed = (list->ntail && value < list->tail[list->ntail - 1]) || usf_internal_packlistappend(list, value);
+
+	if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */
+	return failed ? NULL : list;
+}
+
+usf_packlist *usf_packlistaddn(usf_packlist *list, const u64 *values, u64 n) {
+	/* This function is thread-safe when operating on thread-safe packlists.
+	 *
+	 * Appends n sorted values to the packlist.
+	 * Returns the packlist, or NULL if values are not sorted or an error occurred, in which
+	 * case only the values up to the offending one were added. */
+
+	if (list == NULL) return NULL;
+	if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */
+
+	u64 k;
+	for (k = 0; k < n; k++) {
+		if ((list->ntail && values[k] < list->tail[list->ntail - 1]) || usf_internal_packlistappend(list, values[k])) {
+			if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */
+			return NULL; /* Unsorted, or allocation failed */
+		}
+	}
+
+	if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */
+	return list;
+}
+
+u64 usf_packlistget(const usf_packlist *list, u64 i) {
+	/* This function is thread-safe when operating on thread-safe packlists.
+	 *
+	 * Returns the value at index i in the packlist, or zero if it is inaccessible.
+	 * This jumps to the block holding it and sums the deltas before it, which is
+	 * O(USF_PACKLIST_BLOCKSIZE): prefer usf_packlistcopy to read consecutive values. */
+
+	if (list == NULL) return 0;
+	if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */
+
+	const usf_packblock *block;
+	u64 value, j;
+	if (i >= list->size) value = 0;
+	else if (i / USF_PACKLIST_BLOCKSIZE == list->nblocks) value = list->tail[i % USF_PACKLIST_BLOCKSIZE];
+	else {
+		block = &list->blocks[i / USF_PACKLIST_BLOCKSIZE];
+		for (value = block->first, j = 1; j <= i % USF_PACKLIST_BLOCKSIZE; j++)
+			value += usf_internal_packlistdelta(list->data + block->offset, block->width, j);
+	}
+
+	if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */
+	return value;
+}
+
+u64 usf_packlistcopy(const usf_packlist *list, u64 i, u64 n, u64 *dst) {
+	/* This function is thread-safe when operating on thread-safe packlists.
+	 *
+	 * Decodes up to n values of the packlist starting at index i to dst, a block at a time.
+	 * Returns the number of values copied. */
+
+	if (list == NULL) return 0;
+	if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */
+
+	usf_packcursor cursor;
+	u64 copied, chunk;
+	n = i < list->size ? USF_MIN(n, list->size - i) : 0;
+	cursor.list = list;
+	usf_internal_packcursorload(&cursor, i / USF_PACKLIST_BLOCKSIZE);
+	cursor.pos = i % USF_PACKLIST_BLOCKSIZE;
+	for (copied = 0; copied < n; copied += chunk, usf_internal_packcursorload(&cursor, cursor.block + 1)) {
+		chunk = USF_MIN(n - copied, cursor.n - cursor.pos);
+		memcpy(dst + copied, cursor.values + cursor.pos, chunk * sizeof(u64));
+	}
+
+	if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */
+	return n;
+}
+
+u64 usf_packlistfind(const usf_packlist *list, u64 value) {
+	/* This function is thread-safe when operating on thread-safe packlists.
+	 *
+	 * Returns the index of the first value of the packlist greater or equal to value, or its
+	 * size if there is none. The block is found by binary search of the block headers, so only
+	 * one block is decoded. */
+
+	if (list == NULL) return 0;
+	if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */
+
+	usf_packcursor cursor;
+	u64 i;
+	cursor.list = list;
+	usf_internal_packcursorload(&cursor, 0);
+	usf_internal_packcursorseek(&cursor, value);
+	i = cursor.n ? cursor.block * USF_PACKLIST_BLOCKSIZE + cursor.pos : list->size;
+
+	if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */
+	return i;
+}
+
+usf_packlist *usf_packlistintersect(const usf_packlist *a, const usf_packlist *b) {
+	/* This function is thread-safe when operating on thread-safe packlists.
+	 *
+	 * Creates a new non thread-safe packlist, using the allocator of a, holding once each
+	 * value present in both packlists. Each list skips whole blocks ending before the current
+	 * value of the other, so a short list intersects a long one in about as many block
+	 * decodes as it has values.
+	 * Returns the created packlist, or NULL if an error occurred. */
+
+	if (a == NULL || b == NULL) return NULL;
+
+	usf_packcursor *ca, *cb;
+	usf_packlist *result;
+	u64 va, vb;
+	u8 failed;
+	if ((result = usf_newpacklist_alloc(a->allocator)) == NULL) return NULL;
+	if ((ca = usf_amalloc(a->allocator, 2 * sizeof(usf_packcursor))) == NULL) {
+		usf_freepacklist(result);
+		return NULL; /* Allocation failed */
+	}
+	cb = ca + 1;
+	usf_internal_packlistlock(a, b, 0);
+
+	ca->list = a, cb->list = b;
+	usf_internal_packcursorload(ca, 0);
+	usf_internal_packcursorload(cb, 0);
+	for (failed = 0; ca->n && cb->n && !failed;) {
+		va = ca->values[ca->pos], vb = cb->values[cb->pos];
+		if (va < vb) usf_internal_packcursorseek(ca, vb);
+		else if (vb < va) usf_internal_packcursorseek(cb, va);
+		else {
+			if (result->size == 0 || result->tail[result->ntail - 1] != va) failed = usf_internal_packlistappend(result, va);
+			usf_internal_packcursornext(ca);
+			usf_internal_packcursornext(cb);
+		}
+	}
+
+	usf_internal_packlistlock(a, b, 1);
+	usf_afree(a->allocator, ca, 2 * sizeof(usf_packcursor));
+	if (failed) {
+		usf_freepacklist(result);
+		return NULL; /* Allocation failed */
+	}
+	return result;
+}
+
+usf_packlist *usf_packlistunion(const usf_packlist *a, const usf_packlist *b) {
+	/* This function is thread-safe when operating on thread-safe packlists.
+	 *
+	 * Creates a new non thread-safe packlist, using the allocator of a, holding once each
+	 * value present in either packlist, by merging them a block at a time.
+	 * Returns the created packlist, or NULL if an error occurred. */
+
+	if (a == NULL || b == NULL) return NULL;
+
+	usf_packcursor *ca, *cb, *next;
+	usf_packlist *result;
+	u64 value;
+	u8 failed;
+	if ((result = usf_newpacklist_alloc(a->allocator)) == NULL) return NULL;
+	if ((ca = usf_amalloc(a->allocator, 2 * sizeof(usf_packcursor))) == NULL) {
+		usf_freepacklist(result);
+		return NULL; /* Allocation failed */
+	}
+	cb = ca + 1;
+	usf_internal_packlistlock(a, b, 0);
+
+	ca->list = a, cb->list = b;
+	usf_internal_packcursorload(ca, 0);
+	usf_internal_packcursorload(cb, 0);
+	for (failed = 0; (ca->n || cb->n) && !failed; usf_internal_packcursornext(next)) {
+		next = cb->n == 0 || (ca->n && ca->values[ca->pos] <= cb->values[cb->pos]) ? ca : cb;
+		value = next->values[next->pos];
+		if (result->size == 0 || result->tail[result->ntail - 1] != value) failed = usf_internal_packlistappend(result, value);
+	}
+
+	usf_internal_packlistlock(a, b, 1);
+	usf_afree(a->allocator, ca, 2 * sizeof(usf_packcursor));
+	if (failed) {
+		usf_freepacklist(result);
+		return NULL; /* Allocation failed */
+	}
+	return result;
+}
+
+usf_memusage usf_packlistmemusage(const usf_packlist *list) {
+	/* This function is thread-safe when operating on thread-safe packlists.
+	 *
+	 * Returns the memory used by a packlist, counting its block headers as nodes
+	 * and its unpacked tail as part of the structure. */
+
+	if (list == NULL) return (usf_memusage) {0};
+	if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */
+
+	usf_memusage usage;
+	usage = (usf_memusage) {0};
+	usage.structure = sizeof(usf_packlist);
+	usage.array = list->datasize * sizeof(u64);
+	usage.nodes = list->nblocks * sizeof(usf_packblock);
+	usage.locks = list->lock ? sizeof(usf_mutex) : 0;
+	usage.slack = (list->datacapacity - list->datasize) * sizeof(u64)
+		+ (list->blockcapacity - list->nblocks) * sizeof(usf_packblock);
+	usage.total = usage.structure + usage.array + usage.nodes + usage.locks + usage.slack;
+
+	if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */
+	return usage;
+}
+
+void usf_freepacklist(usf_packlist *list) {
+	/* Frees a packlist.
+	 * If list is NULL, this function has no effect. */
+
+	if (list == NULL) return;
+
+	usf_afree(list->allocator, list->blocks, list->blockcapacity * sizeof(usf_packblock));
+	usf_afree(list->allocator, list->data, list->datacapacity * sizeof(u64));
+	if (list->lock) {
+		usf_mtxdestroy(list->lock);
+		usf_afree(list->allocator, list->lock, sizeof(usf_mutex));
+	}
+	usf_afree(list->allocator, list, sizeof(usf_packlist));
+}
+
+static u8 usf_internal_packlistappend(usf_packlist *list, u64 value) {
+	/* Appends value, not lower than the last one, to the tail, packing it first if it is full.
+	 * Returns 0, or 1 if packing failed to allocate */
+
+	if (list->ntail == USF_PACKLIST_BLOCKSIZE && usf_internal_packlistflush(list)) return 1;
+	list->tail[list->ntail++] = value;
+	list->size++;
+
+	return 0;
+}
+
+static u8 usf_internal_packlistflush(usf_packlist *list) {
+	/* Packs a full tail into a new block, growing the block and data arrays as needed.
+	 * Returns 0, or 1 if an allocation failed, leaving the list unchanged */
+
+	usf_packblock *blocks, *block;
+	u64 *data, *words, capacity, maxdelta, width, delta, bit, j;
+	for (maxdelta = 0, j = 1; j < USF_PACKLIST_BLOCKSIZE; j++) maxdelta |= list->tail[j] - list->tail[j - 1];
+	width = maxdelta ? 64 - (u64) __builtin_clzll(maxdelta) : 0; /* Width of the largest delta */
+
+	if (list->nblocks == list->blockcapacity) {
+		capacity = USF_MAX(2 * list->blockcapacity, USF_PACKLIST_DEFAULTBLOCKS);
+		if ((blocks = usf_arealloc(list->allocator, list->blocks, list->blockcapacity * sizeof(usf_packblock),
+				capacity * sizeof(usf_packblock))) == NULL) return 1; /* Reallocation failed */
+		list->blocks = blocks;
+		list->blockcapacity = capacity;
+	}
+	if (list->datasize + 2 * width > list->datacapacity) {
+		capacity = USF_MAX(2 * list->datacapacity, list->datasize + 2 * width);
+		if ((data = usf_arealloc(list->allocator, list->data, list->datacapacity * sizeof(u64),
+				capacity * sizeof(u64))) == NULL) return 1; /* Reallocation failed */
+		list->data = data;
+		list->datacapacity = capacity;
+	}
+
+	block = &list->blocks[list->nblocks++];
+	block->first = list->tail[0];
+	block->offset = list->datasize;
+	block->width = width;
+	words = list->data + list->datasize;
+	for (j = 0; j < 2 * width; j++) words[j] = 0;
+	for (j = 1; j < USF_PACKLIST_BLOCKSIZE && width; j++) { /* Delta j at bit j * width */
+		delta = list->tail[j] - list->tail[j - 1];
+		bit = j * width;
+		words[bit / 64] |= delta << bit % 64;
+		if (bit % 64 + width > 64) words[bit / 64 + 1] |= delta >> (64 - bit % 64);
+	}
+	list->datasize += 2 * width;
+	list->ntail = 0;
+
+	return 0;
+}
+
+static void usf_internal_packlistunpack(const usf_packlist *list, u64 b, u64 *dst) {
+	/* Decodes the values of block b to dst */
+
+	const usf_packblock *block;
+	const u64 *words;
+	u64 j, bit, width, mask, delta;
+	block = &list->blocks[b];
+	words = list->data + block->offset;
+	width = block->width;
+	mask = width == 64 ? U64_MAX : (U64(1) << width) - 1;
+
+	dst[0] = block->first;
+	for (j = 1, bit = width; j < USF_PACKLIST_BLOCKSIZE; j++, bit += width) {
+		delta = width ? words[bit / 64] >> bit % 64 : 0; /* A run of one value has no words */
+		if (bit % 64 + width > 64) delta |= words[bit / 64 + 1] << (64 - bit % 64);
+		dst[j] = dst[j - 1] + (delta & mask);
+	}
+}
+
+static u64 usf_internal_packlistdelta(const u64 *words, u64 width, u64 j) {
+	/* Returns delta j of a block packed at width bits in words */
+
+	u64 bit, delta;
+	if (width == 0) return 0;
+
+	bit = j * width;
+	delta = words[bit / 64] >> bit % 64;
+	if (bit % 64 + width > 64) delta |= words[bit / 64 + 1] << (64 - bit % 64);
+	return width == 64 ? delta : delta & ((U64(1) << width) - 1);
+}
+
+static u64 usf_internal_packlistfirst(const usf_packlist *list, u64 b) {
+	/* Returns the first value of block b, the tail being block nblocks */
+
+	return b < list->nblocks ? list->blocks[b].first : list->tail[0];
+}
+
+static void usf_internal_packcursorload(usf_packcursor *cursor, u64 b) {
+	/* Loads block b, the tail, or nothing past it, at its first value */
+
+	const usf_packlist *list;
+	list = cursor->list;
+	cursor->block = b;
+	cursor->pos = 0;
+	if (b < list->nblocks) {
+		usf_internal_packlistunpack(list, b, cursor->values);
+		cursor->n = USF_PACKLIST_BLOCKSIZE;
+	} else if (b == list->nblocks) {
+		memcpy(cursor->values, list->tail, list->ntail * sizeof(u64));
+		cursor->n = list->ntail;
+	} else cursor->n = 0;
+}
+
+static void usf_internal_packcursorseek(usf_packcursor *cursor, u64 value) {
+	/* Advances a cursor to the first value greater or equal to value, skipping by binary search
+	 * the blocks followed by one starting below value, which cannot hold it */
+
+	u64 lo, hi, mid;
+	if (cursor->n == 0) return;
+
+	for (lo = cursor->block, hi = cursor->list->nblocks + 1; lo + 1 < hi;) {
+		mid = (lo + hi) / 2;
+		if ((mid < cursor->list->nblocks || cursor->list->ntail) && usf_internal_packlistfirst(cursor->list, mid) < value)
+			lo = mid;
+		else hi = mid;
+	}
+	if (lo != cursor->block) usf_internal_packcursorload(cursor, lo);
+
+	while (cursor->n && cursor->values[cursor->pos] < value) usf_internal_packcursornext(cursor);
+}
+
+static void usf_internal_packcursornext(usf_packcursor *cursor) {
+	/* Advances a cursor by one value, loading the next block at the end of this one */
+
+	if (++cursor->pos == cursor->n) usf_internal_packcursorload(cursor, cursor->block + 1);
+}
+
+static void usf_internal_packlistlock(const usf_packlist *a, const usf_packlist *b, u8 unlock) {
+	/* Locks (or unlocks if unlock) two packlists, in address order */
+
+	usf_mutex *first, *second;
+	first = a < b ? a->lock : b->lock;
+	second = a == b ? NULL : a < b ? b->lock : a->lock;
+	if (unlock) {
+		if (second) usf_mtxunlock(second); /* Thread-safe unlock */
+		if (first) usf_mtxunlock(first); /* Thread-safe unlock */
+	} else {
+		if (first) usf_mtxlock(first); /* Thread-safe lock */
+		if (second) usf_mtxlock(second); /* Thread-safe lock */
+	}
+}
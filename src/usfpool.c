@@ -0,0 +1,242 @@
+#include "usfpool.h"
+
+/* Slab objects start right after their header, at the strictest standard alignment */
+#define USF_POOL_HEADERSIZE \
+	((sizeof(usf_poolslab) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+static_assert(sizeof(usf_poolcache) == 64, "usflib2: usf_poolcache is not one cache line");
+
+static void *usf_internal_poolcarve(usf_pool *pool);
+static usf_poolcache *usf_internal_poolcache(usf_pool *pool);
+static void usf_internal_poolcachelock(usf_poolcache *cache);
+
+static thread_local u64 threadindex_ = U64_MAX; /* Picks this thread's cache in thread-safe pools */
+static atomic_u64 nthreads_;
+
+usf_pool *usf_newpool(u64 objsize) {
+	/* Wrapper for creating non thread-safe pools using usf_stdallocator. */
+
+	return usf_newpool_alloc(objsize, &usf_stdallocator);
+}
+
+usf_pool *usf_newpool_ts(u64 objsize) {
+	/* Wrapper for creating thread-safe pools using usf_stdallocator. */
+
+	return usf_newpool_ts_alloc(objsize, &usf_stdallocator);
+}
+
+usf_pool *usf_newpool_alloc(u64 objsize, const usf_allocator *allocator) {
+	/* Creates a new non thread-safe pool of fixed-size objects of objsize bytes.
+	 * Objects are carved out of slabs which are obtained from allocator (or usf_stdallocator
+	 * if it is NULL) and which double in size, from USF_POOL_MINSLABSIZE up to USF_POOL_MAXSLABSIZE
+	 * objects. Freed objects are recycled through an intrusive free list. Objects are aligned
+	 * to 8 bytes, or 16 bytes when objsize is a multiple of 16.
+	 * Returns the created pool. */
+
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
+	usf_pool *pool;
+	pool = usf_acalloc(allocator, 1, sizeof(usf_pool));
+	pool->objsize = (USF_MAX(objsize, (u64) sizeof(void *)) + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	pool->slabsize = USF_POOL_MINSLABSIZE;
+	pool->allocator = allocator;
+
+	return pool;
+}
+
+usf_pool *usf_newpool_ts_alloc(u64 objsize, const usf_allocator *allocator) {
+	/* Creates a new thread-safe pool of fixed-size objects of objsize bytes (see usf_newpool_alloc).
+	 * Each thread allocates from and frees to its own cache, among USF_POOL_NCACHES, and only
+	 * takes the pool lock to refill or spill its cache in batches.
+	 * Returns the created pool, or NULL if a mutex cannot be created. */
+
+	usf_pool *pool;
+	pool = usf_newpool_alloc(objsize, allocator);
+	pool->lock = usf_amalloc(pool->allocator, sizeof(usf_mutex));
+	if (usf_mtxinit(pool->lock, MTXINIT_PLAIN)) {
+		usf_afree(pool->allocator, pool->lock, sizeof(usf_mutex));
+		usf_afree(pool->allocator, pool, sizeof(usf_pool));
+		return NULL; /* mutex init failed */
+	}
+
+	u64 i;
+	pool->caches = usf_acalloc(pool->allocator, USF_POOL_NCACHES, sizeof(usf_poolcache));
+	for (i = 0; i < USF_POOL_NCACHES; i++) usf_atmflagclr(&pool->caches[i].lock, MEMORDER_RELAXED);
+
+	return pool;
+}
+
+void *usf_poolalloc(usf_pool *pool) {
+	/* This function is thread-safe when operating on thread-safe pools.
+	 *
+	 * Returns an object from the pool (its contents are unspecified), or NULL on failure. */
+
+	if (pool == NULL) return NULL;
+	if (pool->caches == NULL) return usf_internal_poolcarve(pool);
+
+	usf_poolcache *cache;
+	void *object;
+	cache = usf_internal_poolcache(pool);
+	usf_internal_poolcachelock(cache);
+	if ((object = cache->freelist)) {
+		cache->freelist = *(void **) object;
+		cache->count--;
+		usf_atmflagclr(&cache->lock, MEMORDER_RELEASE);
+		return object;
+	}
+	usf_atmflagclr(&cache->lock, MEMORDER_RELEASE);
+
+	void *batch, *last, *node;
+	u64 n;
+	usf_mtxlock(pool->lock); /* Cache is empty, take this object and a batch of free ones */
+	object = usf_internal_poolcarve(pool);
+	for (batch = node = pool->freelist, last = NULL, n = 0; node && n < USF_POOL_CACHESIZE / 2; n++)
+		node = *(void **) (last = node);
+	pool->freelist = node;
+	usf_mtxunlock(pool->lock);
+
+	if (n) {
+		usf_internal_poolcachelock(cache);
+		*(void **) last = cache->freelist;
+		if (cache->freelist == NULL) cache->last = last;
+		cache->freelist = batch;
+		cache->count += n;
+		usf_atmflagclr(&cache->lock, MEMORDER_RELEASE);
+	}
+
+	return object;
+}
+
+void usf_poolfree(usf_pool *pool, void *object) {
+	/* This function is thread-safe when operating on thread-safe pools.
+	 *
+	 * Returns an object obtained from usf_poolalloc to the pool.
+	 * If object is NULL, this function has no effect. */
+
+	if (pool == NULL || object == NULL) return;
+	if (pool->caches == NULL) {
+		*(void **) object = pool->freelist;
+		pool->freelist = object;
+		return;
+	}
+
+	usf_poolcache *cache;
+	void *spill, *last;
+	cache = usf_internal_poolcache(pool);
+	usf_internal_poolcachelock(cache);
+	*(void **) object = cache->freelist;
+	if (cache->freelist == NULL) cache->last = object;
+	cache->freelist = object;
+	if (++cache->count > USF_POOL_CACHESIZE) { /* Spill the whole cache */
+		spill = cache->freelist;
+		last = cache->last;
+		cache->freelist = NULL;
+		cache->count = 0;
+	} else spill = last = NULL;
+	usf_atmflagclr(&cache->lock, MEMORDER_RELEASE);
+
+	if (spill) {
+		usf_mtxlock(pool->lock);
+		*(void **) last = pool->freelist;
+		pool->freelist = spill;
+		usf_mtxunlock(pool->lock);
+	}
+}
+
+void usf_poolreset(usf_pool *pool) {
+	/* Returns every object to the pool at once, keeping its slabs for reuse.
+	 * Objects obtained before the reset must no longer be used.
+	 * (Note: this function is not thread-safe, even on thread-safe pools) */
+
+	if (pool == NULL) return;
+
+	u64 i;
+	if (pool->caches) for (i = 0; i < USF_POOL_NCACHES; i++) {
+		pool->caches[i].freelist = NULL;
+		pool->caches[i].count = 0;
+	}
+	pool->freelist = NULL;
+	pool->freshslab = NULL; /* Carve again from the first slab */
+	pool->nfresh = 0;
+}
+
+u64 usf_poolbytes(const usf_pool *pool) {
+	/* Returns the number of bytes reserved by a pool, including its slabs, caches and lock.
+	 * (Note: this function is not thread-safe, even on thread-safe pools) */
+
+	if (pool == NULL) return 0;
+
+	usf_poolslab *slab;
+	u64 bytes;
+	bytes = sizeof(usf_pool);
+	if (pool->lock) bytes += sizeof(usf_mutex) + USF_POOL_NCACHES * sizeof(usf_poolcache);
+	for (slab = pool->slabs; slab; slab = slab->next)
+		bytes += USF_POOL_HEADERSIZE + slab->nobjects * pool->objsize;
+
+	return bytes;
+}
+
+void usf_freepool(usf_pool *pool) {
+	/* Frees a pool and all of its objects at once.
+	 * If pool is NULL, this function has no effect. */
+
+	if (pool == NULL) return;
+
+	usf_poolslab *slab, *next;
+	for (slab = pool->slabs; slab; slab = next) {
+		next = slab->next;
+		usf_afree(pool->allocator, slab, USF_POOL_HEADERSIZE + slab->nobjects * pool->objsize);
+	}
+
+	if (pool->lock) {
+		usf_mtxdestroy(pool->lock);
+		usf_afree(pool->allocator, pool->lock, sizeof(usf_mutex));
+	}
+	usf_afree(pool->allocator, pool->caches, USF_POOL_NCACHES * sizeof(usf_poolcache));
+	usf_afree(pool->allocator, pool, sizeof(usf_pool));
+}
+
+static void *usf_internal_poolcarve(usf_pool *pool) {
+	/* Takes an object from the pool's free list, or carves a new one out of its slabs.
+	 * Thread-safe pools must be locked. Returns the object, or NULL if a slab cannot be allocated. */
+
+	void *object;
+	if ((object = pool->freelist)) {
+		pool->freelist = *(void **) object;
+		return object;
+	}
+
+	if (pool->nfresh == 0) { /* Move on to the next slab */
+		usf_poolslab *slab;
+		if ((slab = pool->freshslab ? pool->freshslab->next : pool->slabs) == NULL) {
+			if ((slab = usf_amalloc(pool->allocator, USF_POOL_HEADERSIZE + pool->slabsize * pool->objsize)) == NULL)
+				return NULL; /* slab allocation failed */
+			slab->next = NULL;
+			slab->nobjects = pool->slabsize;
+			if (pool->freshslab) pool->freshslab->next = slab;
+			else pool->slabs = slab;
+
+			pool->slabsize = USF_MIN(pool->slabsize * 2, (u64) USF_POOL_MAXSLABSIZE);
+		}
+		pool->freshslab = slab;
+		pool->nfresh = slab->nobjects;
+	}
+
+	object = (u8 *) pool->freshslab + USF_POOL_HEADERSIZE + (pool->freshslab->nobjects - pool->nfresh) * pool->objsize;
+	pool->nfresh--;
+
+	return object;
+}
+
+static usf_poolcache *usf_internal_poolcache(usf_pool *pool) {
+	/* Returns the calling thread's cache in a thread-safe pool */
+
+	if (threadindex_ == U64_MAX) threadindex_ = usf_atmaddi(&nthreads_, 1, MEMORDER_RELAXED);
+	return &pool->caches[threadindex_ % USF_POOL_NCACHES];
+}
+
+static void usf_internal_poolcachelock(usf_poolcache *cache) {
+	/* Acquires a thread cache's spinlock, which is almost never contended */
+
+	while (usf_atmflagtry(&cache->lock, MEMORDER_ACQUIRE)) usf_thrdyield();
+}
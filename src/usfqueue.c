@@ -1,25 +1,45 @@
 #include "usfqueue.h"
 
 usf_queue *usf_newqueue(void) {
+	/* Wrapper for creating non thread-safe queues using usf_stdallocator. */
+
+	return usf_newqueue_alloc(&usf_stdallocator);
+}
+
+usf_queue *usf_newqueue_ts(void) {
+	/* Wrapper for creating thread-safe queues using usf_stdallocator. */
+
+	return usf_newqueue_ts_alloc(&usf_stdallocator);
+}
+
+usf_queue *usf_newqueue_alloc(const usf_allocator *allocator) {
 	/* Creates a new non thread-safe usf_queue, initialized to 0.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+	 * Nodes come from a usf_pool and are only given back to allocator when the queue is freed.
 	 * Returns the created queue. */
 
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
 	usf_queue *queue;
-	queue = usf_calloc(1, sizeof(usf_queue));
+	queue = usf_acalloc(allocator, 1, sizeof(usf_queue));
+	queue->allocator = allocator;
+	queue->pool = usf_newpool_alloc(sizeof(usf_queuenode), allocator);
 
 	return queue;
 }
 
-usf_queue *usf_newqueue_ts(void) {
+usf_queue *usf_newqueue_ts_alloc(const usf_allocator *allocator) {
 	/* Creates a new thread-safe usf_queue, initialized to 0.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
 	 * Returns the created queue, or NULL if a mutex cannot be created. */
 
 	usf_queue *queue;
-	queue = usf_newqueue();
-	queue->lock = usf_malloc(sizeof(usf_mutex));
+	queue = usf_newqueue_alloc(allocator);
+	queue->lock = usf_amalloc(queue->allocator, sizeof(usf_mutex));
 	if (usf_mtxinit(queue->lock, MTXINIT_RECURSIVE)) {
-		usf_free(queue->lock);
-		usf_free(queue);
+		usf_afree(queue->allocator, queue->lock, sizeof(usf_mutex));
+		usf_freepool(queue->pool);
+		usf_afree(queue->allocator, queue, sizeof(usf_queue));
 		return NULL; /* mutex init failed */
 	}
 
@@ -36,7 +56,10 @@ usf_queue *usf_enqueue(usf_queue *queue, usf_data data) {
 	if (queue->lock) usf_mtxlock(queue->lock); /* Thread-safe lock */
 
 	usf_queuenode *enqueue;
-	enqueue = usf_malloc(sizeof(usf_queuenode));
+	if ((enqueue = usf_poolalloc(queue->pool)) == NULL) {
+		if (queue->lock) usf_mtxunlock(queue->lock); /* Thread-safe unlock */
+		return NULL; /* Allocation failed */
+	}
 	enqueue->data = data;
 	enqueue->next = NULL; /* Last in line */
 
@@ -72,13 +95,34 @@ usf_data usf_dequeue(usf_queue *queue) {
 
 	if ((queue->first = dequeue->next) == NULL) /* Bring next one in */
 		queue->last = NULL; /* Dequeue was last member */
-	usf_free(dequeue);
+	usf_poolfree(queue->pool, dequeue);
 	queue->size--; /* Update size */
 
 	if (queue->lock) usf_mtxunlock(queue->lock); /* Thread-safe unlock */
 	return data;
 }
 
+usf_memusage usf_queuememusage(const usf_queue *queue) {
+	/* This function is thread-safe when operating on thread-safe queues.
+	 *
+	 * Returns the memory used by a queue, excluding what its values point to.
+	 * Pooled nodes not currently in the queue are counted as slack. */
+
+	if (queue == NULL) return (usf_memusage) {0};
+	if (queue->lock) usf_mtxlock(queue->lock); /* Thread-safe lock */
+
+	usf_memusage usage;
+	usage = (usf_memusage) {0};
+	usage.structure = sizeof(usf_queue);
+	usage.nodes = queue->size * queue->pool->objsize;
+	usage.slack = usf_poolbytes(queue->pool) - usage.nodes;
+	usage.locks = queue->lock ? sizeof(usf_mutex) : 0;
+	usage.total = usage.structure + usage.nodes + usage.locks + usage.slack;
+
+	if (queue->lock) usf_mtxunlock(queue->lock); /* Thread-safe unlock */
+	return usage;
+}
+
 void usf_freequeuefunc(usf_queue *queue, void (*freefunc)(void *)) {
 	/* Frees a usf_queue and calls freefunc on its values.
 	 * If freefunc is NULL, nothing is done on the queue values.
@@ -86,18 +130,16 @@ void usf_freequeuefunc(usf_queue *queue, void (*freefunc)(void *)) {
 
 	if (queue == NULL) return;
 
-	usf_queuenode *node, *next;
-	for (node = queue->first; node; node = next) {
-		next = node->next;
-		if (freefunc) freefunc(node->data.p);
-		usf_free(node);
-	}
+	usf_queuenode *node;
+	if (freefunc) for (node = queue->first; node; node = node->next)
+		freefunc(node->data.p);
+	usf_freepool(queue->pool); /* Releases all nodes at once */
 
 	if (queue->lock) {
 		usf_mtxdestroy(queue->lock);
-		usf_free(queue->lock);
+		usf_afree(queue->allocator, queue->lock, sizeof(usf_mutex));
 	}
-	usf_free(queue);
+	usf_afree(queue->allocator, queue, sizeof(usf_queue));
 }
 
 void usf_freequeue(usf_queue *queue) {
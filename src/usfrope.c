@@ -0,0 +1,568 @@
+#include "usfrope.h"
+
+static usf_ropebase *usf_internal_ropenew(u64 elemsize, const usf_allocator *allocator, u8 threadsafe);
+static usf_ropebase *usf_internal_ropeset(usf_ropebase *rope, u64 i, const void *element);
+static usf_ropebase *usf_internal_ropeins(usf_ropebase *rope, u64 i, const void *element);
+static u8 usf_internal_ropeget(const usf_ropebase *rope, u64 i, void *element);
+static u8 usf_internal_ropedel(usf_ropebase *rope, u64 i, void *element);
+static u64 usf_internal_ropecopy(const usf_ropebase *rope, u64 i, u64 n, void *dst);
+static usf_memusage usf_internal_ropememusage(const usf_ropebase *rope);
+static void usf_internal_ropeforeach(const usf_ropebase *rope, void (*callback)(void *, void *), void *context);
+static void usf_internal_ropefree(usf_ropebase *rope);
+static usf_ropeleaf *usf_internal_ropefind(const usf_ropebase *rope, u64 *i, usf_ropenode **path, u64 *slots, u8 inserting);
+static usf_ropeleaf *usf_internal_ropenextleaf(const usf_ropebase *rope, usf_ropenode **path, u64 *slots);
+static u64 usf_internal_ropecount(const void *child, u8 leaf);
+static usf_ropenode *usf_internal_ropeinschild(usf_ropebase *rope, usf_ropenode *node, u64 k, void *child, u8 leaf,
+		usf_ropenode *spare);
+static void usf_internal_roperebalance(usf_ropebase *rope, usf_ropenode *node, u64 k, u8 leaf);
+static void usf_internal_ropedelchild(usf_ropenode *node, u64 k);
+static void usf_internal_ropefreenode(usf_ropebase *rope, void *node, u64 depth);
+
+/* Generic rope implementation
+ * _TYPE		underlying rope type
+ * _NAME		rope name suffix (e.g. f32 -> usf_ropef32)
+ *
+ * Typed ropes wrap a usf_ropebase handling elements as bytes, which keeps a single copy of the tree code.
+ * */
+
+#define USF_ROPEIMPL(_TYPE, _NAME) \
+	static void usf_internal_rope##_NAME##freeone(void *element, void *freefunc) { \
+		/* usf_freerope##_NAMEfunc callback */ \
+		\
+		(*(void (**)(_TYPE)) freefunc)(*(_TYPE *) element); \
+	} \
+	\
+	usf_rope##_NAME *usf_newrope##_NAME(void) { \
+		/* Wrapper for creating non thread-safe ropes using usf_stdallocator. */ \
+		\
+		return usf_newrope##_NAME##_alloc(&usf_stdallocator); \
+	} \
+	\
+	usf_rope##_NAME *usf_newrope##_NAME##_ts(void) { \
+		/* Wrapper for creating thread-safe ropes using usf_stdallocator. */ \
+		\
+		return usf_newrope##_NAME##_ts_alloc(&usf_stdallocator); \
+	} \
+	\
+	usf_rope##_NAME *usf_newrope##_NAME##_alloc(const usf_allocator *allocator) { \
+		/* Creates a new empty non thread-safe rope, a list split in leaves of USF_ROPE_LEAFSIZE bytes
+		 * under a tree counting their elements, on which get, set, ins and del are O(log n) at any
+		 * index. Appending is amortized O(1) on top of the descent, filling leaves entirely.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+		 * Returns the created rope, or NULL on failure. */ \
+		\
+		return (usf_rope##_NAME *) (void *) usf_internal_ropenew(sizeof(_TYPE), allocator, 0); \
+	} \
+	\
+	usf_rope##_NAME *usf_newrope##_NAME##_ts_alloc(const usf_allocator *allocator) { \
+		/* Creates a new empty thread-safe rope, see usf_newrope##_NAME_alloc.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+		 * Returns the created rope, or NULL if an error occurred. */ \
+		\
+		return (usf_rope##_NAME *) (void *) usf_internal_ropenew(sizeof(_TYPE), allocator, 1); \
+	} \
+	\
+	usf_rope##_NAME *usf_rope##_NAME##set(usf_rope##_NAME *rope, u64 i, _TYPE data) { \
+		/* This function is thread-safe when operating on thread-safe ropes.
+		 *
+		 * Sets the given data at index i in the rope, or appends it if i is the rope's size.
+		 * Returns the rope, or NULL if i is past the rope's size or an error occurred. */ \
+		\
+		if (rope == NULL) return NULL; \
+		\
+		return usf_internal_ropeset(&rope->rope, i, &data) ? rope : NULL; \
+	} \
+	\
+	usf_rope##_NAME *usf_rope##_NAME##ins(usf_rope##_NAME *rope, u64 i, _TYPE data) { \
+		/* This function is thread-safe when operating on thread-safe ropes.
+		 *
+		 * Inserts the given data at index i in the rope, before the element that currently has that index.
+		 * Returns the rope, or NULL if i is past the rope's size or an error occurred. */ \
+		\
+		if (rope == NULL) return NULL; \
+		\
+		return usf_internal_ropeins(&rope->rope, i, &data) ? rope : NULL; \
+	} \
+	\
+	usf_rope##_NAME *usf_rope##_NAME##add(usf_rope##_NAME *rope, _TYPE data) { \
+		/* This function is thread-safe when operating on thread-safe ropes.
+		 *
+		 * Appends the given data to the rope.
+		 * Returns the rope, or NULL if an error occurred. */ \
+		\
+		if (rope == NULL) return NULL; \
+		\
+		return usf_internal_ropeins(&rope->rope, U64_MAX, &data) ? rope : NULL; \
+	} \
+	\
+	_TYPE usf_rope##_NAME##get(const usf_rope##_NAME *rope, u64 i) { \
+		/* This function is thread-safe when operating on thread-safe ropes.
+		 *
+		 * Returns the data at index i in the given rope, or zero if it is inaccessible. */ \
+		\
+		if (rope == NULL) return (_TYPE) {0}; \
+		\
+		_TYPE data; \
+		if (!usf_internal_ropeget(&rope->rope, i, &data)) data = (_TYPE) {0}; \
+		return data; \
+	} \
+	\
+	_TYPE usf_rope##_NAME##del(usf_rope##_NAME *rope, u64 i) { \
+		/* This function is thread-safe when operating on thread-safe ropes.
+		 *
+		 * Deletes the element at index i in the given rope, shifting the following ones back by one.
+		 * Returns the deleted value, or zero if it is inaccessible. */ \
+		\
+		if (rope == NULL) return (_TYPE) {0}; \
+		\
+		_TYPE data; \
+		if (!usf_internal_ropedel(&rope->rope, i, &data)) data = (_TYPE) {0}; \
+		return data; \
+	} \
+	\
+	u64 usf_rope##_NAME##copy(const usf_rope##_NAME *rope, u64 i, u64 n, _TYPE *dst) { \
+		/* This function is thread-safe when operating on thread-safe ropes.
+		 *
+		 * Copies up to n elements of the rope starting at index i to dst, a leaf at a time.
+		 * Returns the number of elements copied. */ \
+		\
+		if (rope == NULL) return 0; \
+		\
+		return usf_internal_ropecopy(&rope->rope, i, n, dst); \
+	} \
+	\
+	usf_memusage usf_rope##_NAME##memusage(const usf_rope##_NAME *rope) { \
+		/* This function is thread-safe when operating on thread-safe ropes.
+		 *
+		 * Returns the memory used by a rope, excluding what its values point to. */ \
+		\
+		if (rope == NULL) return (usf_memusage) {0}; \
+		\
+		return usf_internal_ropememusage(&rope->rope); \
+	} \
+	\
+	void usf_freerope##_NAME##func(usf_rope##_NAME *rope, void (*freefunc)(_TYPE)) { \
+		/* Frees a rope and calls freefunc on its values.
+		 * If freefunc is NULL, nothing is done to the values.
+		 * If rope is NULL, this function has no effect. */ \
+		\
+		if (rope == NULL) return; \
+		\
+		if (freefunc) usf_internal_ropeforeach(&rope->rope, usf_internal_rope##_NAME##freeone, &freefunc); \
+		usf_internal_ropefree(&rope->rope); \
+	} \
+	\
+	void usf_freerope##_NAME(usf_rope##_NAME *rope) { \
+		/* Frees a rope without freeing its values.
+		 * If rope is NULL, this function has no effect. */ \
+		\
+		usf_freerope##_NAME##func(rope, NULL); \
+	}
+USF_ROPEIMPL(i8, i8)
+USF_ROPEIMPL(i16, i16)
+USF_ROPEIMPL(i32, i32)
+USF_ROPEIMPL(i64, i64)
+USF_ROPEIMPL(u8, u8)
+USF_ROPEIMPL(u16, u16)
+USF_ROPEIMPL(u32, u32)
+USF_ROPEIMPL(u64, u64)
+USF_ROPEIMPL(f32, f32)
+USF_ROPEIMPL(f64, f64)
+USF_ROPEIMPL(void *, ptr)
+USF_ROPEIMPL(usf_data, )
+#undef USF_ROPEIMPL
+
+static usf_ropebase *usf_internal_ropenew(u64 elemsize, const usf_allocator *allocator, u8 threadsafe) {
+	/* Creates an empty rope of elemsize-byte elements, with a lock if threadsafe */
+
+	usf_ropebase *rope;
+	if (allocator == NULL) allocator = &usf_stdallocator;
+	if ((rope = usf_amalloc(allocator, sizeof(usf_ropebase))) == NULL) return NULL;
+
+	*rope = (usf_ropebase) {
+		.elemsize = elemsize,
+		.leafcapacity = USF_ROPE_LEAFSIZE / elemsize,
+		.allocator = allocator
+	};
+	if (threadsafe) {
+		rope->lock = usf_amalloc(allocator, sizeof(usf_mutex));
+		if (rope->lock == NULL || usf_mtxinit(rope->lock, MTXINIT_RECURSIVE)) {
+			usf_afree(allocator, rope->lock, sizeof(usf_mutex));
+			usf_afree(allocator, rope, sizeof(usf_ropebase));
+			return NULL; /* mutex init failed */
+		}
+	}
+
+	return rope;
+}
+
+static usf_ropebase *usf_internal_ropeset(usf_ropebase *rope, u64 i, const void *element) {
+	/* Overwrites the element at index i, or inserts it if i is the size.
+	 * Returns the rope, or NULL if i is past the size or an error occurred */
+
+	usf_ropeleaf *leaf;
+	usf_ropebase *result;
+	if (rope->lock) usf_mtxlock(rope->lock); /* Thread-safe lock */
+
+	if (i < rope->size) {
+		leaf = usf_internal_ropefind(rope, &i, NULL, NULL, 0);
+		memcpy(leaf->elements + i * rope->elemsize, element, rope->elemsize);
+		result = rope;
+	} else result = usf_internal_ropeins(rope, i, element); /* Appends, or fails past the end */
+
+	if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+	return result;
+}
+
+static usf_ropebase *usf_internal_ropeins(usf_ropebase *rope, u64 i, const void *element) {
+	/* Inserts an element at index i (U64_MAX to append), splitting the leaf it lands in if it
+	 * is full, and each full node above. Everything a split needs is allocated beforehand, so
+	 * that the rope is left untouched on failure.
+	 * Returns the rope, or NULL if i is past the size or an error occurred */
+
+	usf_ropenode *path[USF_ROPE_MAXDEPTH], *spares[USF_ROPE_MAXDEPTH + 1], *node;
+	usf_ropeleaf *leaf, *sibling, *target;
+	u64 slots[USF_ROPE_MAXDEPTH], level, nspares, s, half;
+	void *child;
+
+	if (rope->lock) usf_mtxlock(rope->lock); /* Thread-safe lock */
+	if (i == U64_MAX) i = rope->size;
+	if (i > rope->size || (rope->root == NULL
+			&& (rope->root = usf_acalloc(rope->allocator, 1, sizeof(usf_ropeleaf))) == NULL)) {
+		if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+		return NULL; /* Out of range, or allocation failed */
+	}
+	if (rope->nleaves == 0) rope->nleaves = 1; /* First leaf */
+
+	leaf = usf_internal_ropefind(rope, &i, path, slots, 1);
+	sibling = NULL;
+	nspares = 0;
+	if (leaf->count == rope->leafcapacity) { /* Splits up to the first node with room */
+		for (level = rope->depth; level > 0 && path[level - 1]->nchildren == USF_ROPE_FANOUT; level--) nspares++;
+		if (level == 0) nspares++; /* New root */
+
+		sibling = usf_amalloc(rope->allocator, sizeof(usf_ropeleaf));
+		for (s = 0; s < nspares && sibling; s++) {
+			if ((spares[s] = usf_amalloc(rope->allocator, sizeof(usf_ropenode))) == NULL) {
+				while (s--) usf_afree(rope->allocator, spares[s], sizeof(usf_ropenode));
+				usf_afree(rope->allocator, sibling, sizeof(usf_ropeleaf));
+				sibling = NULL;
+			}
+		}
+		if (sibling == NULL) {
+			if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+			return NULL; /* Allocation failed */
+		}
+	}
+
+	target = leaf;
+	if (sibling) {
+		if (i == rope->leafcapacity) sibling->count = 0; /* Appending leaves the leaf full */
+		else {
+			half = rope->leafcapacity / 2;
+			sibling->count = rope->leafcapacity - half;
+			memcpy(sibling->elements, leaf->elements + half * rope->elemsize, sibling->count * rope->elemsize);
+			leaf->count = half;
+		}
+		if (i >= leaf->count) target = sibling, i -= leaf->count;
+		rope->nleaves++;
+	}
+	memmove(target->elements + (i + 1) * rope->elemsize, target->elements + i * rope->elemsize,
+			(target->count - i) * rope->elemsize);
+	memcpy(target->elements + i * rope->elemsize, element, rope->elemsize);
+	target->count++;
+
+	child = sibling; /* Split nodes to add to the level above */
+	for (s = 0, level = rope->depth; level-- > 0;) {
+		node = path[level];
+		node->counts[slots[level]] = usf_internal_ropecount(node->children[slots[level]], level + 1 == rope->depth);
+		if (child) child = usf_internal_ropeinschild(rope, node, slots[level], child, level + 1 == rope->depth,
+				node->nchildren == USF_ROPE_FANOUT ? spares[s++] : NULL);
+	}
+	if (child) { /* The root split */
+		node = spares[s];
+		node->children[0] = rope->root;
+		node->children[1] = child;
+		node->counts[0] = usf_internal_ropecount(rope->root, rope->depth == 0);
+		node->counts[1] = usf_internal_ropecount(child, rope->depth == 0);
+		node->nchildren = 2;
+		rope->root = node;
+		rope->depth++;
+		rope->nnodes++;
+	}
+	rope->size++;
+
+	if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+	return rope;
+}
+
+static u8 usf_internal_ropeget(const usf_ropebase *rope, u64 i, void *element) {
+	/* Copies the element at index i to element.
+	 * Returns 1, or 0 if i is out of range */
+
+	usf_ropeleaf *leaf;
+	u8 found;
+	if (rope->lock) usf_mtxlock(rope->lock); /* Thread-safe lock */
+
+	if ((found = i < rope->size)) {
+		leaf = usf_internal_ropefind(rope, &i, NULL, NULL, 0);
+		memcpy(element, leaf->elements + i * rope->elemsize, rope->elemsize);
+	}
+
+	if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+	return found;
+}
+
+static u8 usf_internal_ropedel(usf_ropebase *rope, u64 i, void *element) {
+	/* Removes the element at index i and copies it to element, then merges the leaf and each
+	 * node above it with a neighbor if they became small enough, and drops empty ones.
+	 * Returns 1, or 0 if i is out of range */
+
+	usf_ropenode *path[USF_ROPE_MAXDEPTH], *node;
+	usf_ropeleaf *leaf;
+	u64 slots[USF_ROPE_MAXDEPTH], level;
+	if (rope->lock) usf_mtxlock(rope->lock); /* Thread-safe lock */
+
+	if (i >= rope->size) {
+		if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+		return 0; /* Out of range */
+	}
+
+	leaf = usf_internal_ropefind(rope, &i, path, slots, 0);
+	memcpy(element, leaf->elements + i * rope->elemsize, rope->elemsize);
+	leaf->count--;
+	memmove(leaf->elements + i * rope->elemsize, leaf->elements + (i + 1) * rope->elemsize,
+			(leaf->count - i) * rope->elemsize);
+	rope->size--;
+
+	for (level = rope->depth; level-- > 0;) {
+		path[level]->counts[slots[level]]--;
+		usf_internal_roperebalance(rope, path[level], slots[level], level + 1 == rope->depth);
+	}
+
+	while (rope->depth && ((usf_ropenode *) rope->root)->nchildren <= 1) { /* Shorten the tree */
+		node = rope->root;
+		rope->root = node->nchildren ? node->children[0] : NULL;
+		usf_afree(rope->allocator, node, sizeof(usf_ropenode));
+		rope->nnodes--;
+		rope->depth = rope->root ? rope->depth - 1 : 0;
+	}
+	if (rope->size == 0 && rope->root) { /* Last leaf */
+		usf_afree(rope->allocator, rope->root, sizeof(usf_ropeleaf));
+		rope->root = NULL;
+		rope->nleaves = 0;
+	}
+
+	if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+	return 1;
+}
+
+static u64 usf_internal_ropecopy(const usf_ropebase *rope, u64 i, u64 n, void *dst) {
+	/* Copies up to n elements from index i to dst, leaf by leaf.
+	 * Returns the number of elements copied */
+
+	usf_ropenode *path[USF_ROPE_MAXDEPTH];
+	usf_ropeleaf *leaf;
+	u64 slots[USF_ROPE_MAXDEPTH], copied, chunk;
+	if (rope->lock) usf_mtxlock(rope->lock); /* Thread-safe lock */
+
+	n = i < rope->size ? USF_MIN(n, rope->size - i) : 0;
+	leaf = n ? usf_internal_ropefind(rope, &i, path, slots, 0) : NULL;
+	for (copied = 0; copied < n; leaf = usf_internal_ropenextleaf(rope, path, slots), i = 0) {
+		chunk = USF_MIN(n - copied, leaf->count - i);
+		memcpy((u8 *) dst + copied * rope->elemsize, leaf->elements + i * rope->elemsize, chunk * rope->elemsize);
+		copied += chunk;
+	}
+
+	if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+	return n;
+}
+
+static usf_memusage usf_internal_ropememusage(const usf_ropebase *rope) {
+	/* Returns the memory used by a rope */
+
+	usf_memusage usage;
+	if (rope->lock) usf_mtxlock(rope->lock); /* Thread-safe lock */
+
+	usage = (usf_memusage) {0};
+	usage.structure = sizeof(usf_ropebase);
+	usage.array = rope->size * rope->elemsize;
+	usage.nodes = rope->nnodes * sizeof(usf_ropenode)
+		+ rope->nleaves * (sizeof(usf_ropeleaf) - rope->leafcapacity * rope->elemsize); /* Leaf headers */
+	usage.slack = rope->nleaves * rope->leafcapacity * rope->elemsize - usage.array; /* Free leaf room */
+	usage.locks = rope->lock ? sizeof(usf_mutex) : 0;
+	usage.total = usage.structure + usage.array + usage.nodes + usage.locks + usage.slack;
+
+	if (rope->lock) usf_mtxunlock(rope->lock); /* Thread-safe unlock */
+	return usage;
+}
+
+static void usf_internal_ropeforeach(const usf_ropebase *rope, void (*callback)(void *, void *), void *context) {
+	/* Calls callback on each element in order, with context */
+
+	usf_ropenode *path[USF_ROPE_MAXDEPTH];
+	usf_ropeleaf *leaf;
+	u64 slots[USF_ROPE_MAXDEPTH], i, k;
+	i = 0;
+	for (leaf = rope->size ? usf_internal_ropefind(rope, &i, path, slots, 0) : NULL; leaf;
+			leaf = usf_internal_ropenextleaf(rope, path, slots)) {
+		for (k = 0; k < leaf->count; k++) callback(leaf->elements + k * rope->elemsize, context);
+	}
+}
+
+static void usf_internal_ropefree(usf_ropebase *rope) {
+	/* Frees a rope and all of its nodes */
+
+	if (rope->root) usf_internal_ropefreenode(rope, rope->root, rope->depth);
+	if (rope->lock) {
+		usf_mtxdestroy(rope->lock);
+		usf_afree(rope->allocator, rope->lock, sizeof(usf_mutex));
+	}
+	usf_afree(rope->allocator, rope, sizeof(usf_ropebase));
+}
+
+static usf_ropeleaf *usf_internal_ropefind(const usf_ropebase *rope, u64 *i, usf_ropenode **path, u64 *slots, u8 inserting) {
+	/* Descends to the leaf holding index *i, recording the nodes on the way and the child taken in each
+	 * in path and slots unless they are NULL, and leaves the index within the leaf in *i.
+	 * When inserting, an index right past the end of a child stays in that child. */
+
+	usf_ropenode *node;
+	void *child;
+	u64 level, k;
+	for (child = rope->root, level = 0; level < rope->depth; level++) {
+		node = child;
+		for (k = 0; k + 1 < node->nchildren && (inserting ? *i > node->counts[k] : *i >= node->counts[k]); k++)
+			*i -= node->counts[k];
+		if (path) path[level] = node, slots[level] = k;
+		child = node->children[k];
+	}
+
+	return child;
+}
+
+static usf_ropeleaf *usf_internal_ropenextleaf(const usf_ropebase *rope, usf_ropenode **path, u64 *slots) {
+	/* Advances a path recorded by usf_internal_ropefind to the next leaf.
+	 * Returns that leaf, or NULL past the last one */
+
+	u64 level;
+	void *child;
+	for (level = rope->depth; level > 0 && slots[level - 1] + 1 == path[level - 1]->nchildren; level--);
+	if (level == 0) return NULL; /* Rightmost path */
+
+	child = path[level - 1]->children[++slots[level - 1]];
+	for (; level < rope->depth; level++) { /* Leftmost descent */
+		path[level] = child;
+		slots[level] = 0;
+		child = path[level]->children[0];
+	}
+
+	return child;
+}
+
+static u64 usf_internal_ropecount(const void *child, u8 leaf) {
+	/* Returns the number of elements under a leaf or inner node */
+
+	const usf_ropenode *node;
+	u64 count, k;
+	if (leaf) return ((const usf_ropeleaf *) child)->count;
+
+	for (node = child, count = 0, k = 0; k < node->nchildren; k++) count += node->counts[k];
+	return count;
+}
+
+static usf_ropenode *usf_internal_ropeinschild(usf_ropebase *rope, usf_ropenode *node, u64 k, void *child, u8 leaf,
+		usf_ropenode *spare) {
+	/* Inserts child (a leaf if leaf) after slot k of node. A full node is split with spare, which takes
+	 * the upper half of the children, or only the new one when it is inserted last (as when appending).
+	 * Returns spare if it was used, or NULL */
+
+	void *children[USF_ROPE_FANOUT + 1];
+	u64 counts[USF_ROPE_FANOUT + 1], n, keep;
+	n = node->nchildren;
+	if (n < USF_ROPE_FANOUT) {
+		memmove(&node->children[k + 2], &node->children[k + 1], (n - k - 1) * sizeof(void *));
+		memmove(&node->counts[k + 2], &node->counts[k + 1], (n - k - 1) * sizeof(u64));
+		node->children[k + 1] = child;
+		node->counts[k + 1] = usf_internal_ropecount(child, leaf);
+		node->nchildren++;
+		return NULL;
+	}
+
+	memcpy(children, node->children, (k + 1) * sizeof(void *));
+	memcpy(counts, node->counts, (k + 1) * sizeof(u64));
+	children[k + 1] = child;
+	counts[k + 1] = usf_internal_ropecount(child, leaf);
+	memcpy(&children[k + 2], &node->children[k + 1], (n - k - 1) * sizeof(void *));
+	memcpy(&counts[k + 2], &node->counts[k + 1], (n - k - 1) * sizeof(u64));
+
+	keep = k + 1 == n ? n : (n + 1) / 2;
+	memcpy(node->children, children, keep * sizeof(void *));
+	memcpy(node->counts, counts, keep * sizeof(u64));
+	node->nchildren = keep;
+	memcpy(spare->children, &children[keep], (n + 1 - keep) * sizeof(void *));
+	memcpy(spare->counts, &counts[keep], (n + 1 - keep) * sizeof(u64));
+	spare->nchildren = n + 1 - keep;
+	rope->nnodes++;
+
+	return spare;
+}
+
+static void usf_internal_roperebalance(usf_ropebase *rope, usf_ropenode *node, u64 k, u8 leaf) {
+	/* Drops child k of node if it is empty, or merges it with a neighbor when it holds less than a
+	 * quarter of its capacity and the merged child would stay under three quarters of it */
+
+	usf_ropeleaf *left, *right;
+	usf_ropenode *lnode, *rnode;
+	u64 l;
+	if (node->counts[k] == 0) { /* Empty leaf, or node whose last leaf was just dropped */
+		usf_internal_ropefreenode(rope, node->children[k], leaf ? 0 : 1);
+		usf_internal_ropedelchild(node, k);
+		return;
+	}
+	if (node->nchildren < 2) return; /* No neighbor */
+
+	l = k + 1 < node->nchildren ? k : k - 1; /* Merge children l and l + 1 */
+	if (leaf) {
+		left = node->children[l], right = node->children[l + 1];
+		if (node->counts[k] >= rope->leafcapacity / 4 || left->count + right->count > rope->leafcapacity * 3 / 4) return;
+		memcpy(left->elements + left->count * rope->elemsize, right->elements, right->count * rope->elemsize);
+		left->count += right->count;
+		usf_afree(rope->allocator, right, sizeof(usf_ropeleaf));
+		rope->nleaves--;
+	} else {
+		lnode = node->children[l], rnode = node->children[l + 1];
+		if (((usf_ropenode *) node->children[k])->nchildren >= USF_ROPE_FANOUT / 4
+				|| lnode->nchildren + rnode->nchildren > USF_ROPE_FANOUT * 3 / 4) return;
+		memcpy(&lnode->children[lnode->nchildren], rnode->children, rnode->nchildren * sizeof(void *));
+		memcpy(&lnode->counts[lnode->nchildren], rnode->counts, rnode->nchildren * sizeof(u64));
+		lnode->nchildren += rnode->nchildren;
+		usf_afree(rope->allocator, rnode, sizeof(usf_ropenode));
+		rope->nnodes--;
+	}
+	node->counts[l] += node->counts[l + 1];
+	usf_internal_ropedelchild(node, l + 1);
+}
+
+static void usf_internal_ropedelchild(usf_ropenode *node, u64 k) {
+	/* Removes child k from node without freeing it */
+
+	node->nchildren--;
+	memmove(&node->children[k], &node->children[k + 1], (node->nchildren - k) * sizeof(void *));
+	memmove(&node->counts[k], &node->counts[k + 1], (node->nchildren - k) * sizeof(u64));
+}
+
+static void usf_internal_ropefreenode(usf_ropebase *rope, void *node, u64 depth) {
+	/* Frees a node with depth levels of inner nodes under it (0 for leaves), and all of them */
+
+	usf_ropenode *inner;
+	u64 k;
+	if (depth == 0) {
+		usf_afree(rope->allocator, node, sizeof(usf_ropeleaf));
+		rope->nleaves--;
+		return;
+	}
+
+	for (inner = node, k = 0; k < inner->nchildren; k++) usf_internal_ropefreenode(rope, inner->children[k], depth - 1);
+	usf_afree(rope->allocator, inner, sizeof(usf_ropenode));
+	rope->nnodes--;
+}
@@ -0,0 +1,321 @@
+#include "usfseglist.h"
+
+static u64 usf_internal_seglistlocate(u64 i, u64 *offset);
+
+/* Generic segmented list implementation
+ * _TYPE		underlying list type
+ * _NAME		list name suffix (e.g. f32 -> usf_seglistf32)
+ * */
+
+#define USF_SEGLISTIMPL(_TYPE, _NAME) \
+	static u8 usf_internal_seglist##_NAME##reserve(usf_seglist##_NAME *list, u64 capacity) { \
+		/* Adds segments to a list until it can hold capacity elements, never touching existing ones.
+		 * Returns 0, or 1 if a segment could not be allocated. */ \
+		\
+		_TYPE *segment; \
+		u64 length; \
+		while (list->capacity < capacity && list->nsegments < USF_SEGLIST_MAXSEGMENTS) { \
+			length = USF_SEGLIST_FIRSTSIZE << list->nsegments; \
+			if ((segment = usf_amalloc(list->allocator, length * sizeof(_TYPE))) == NULL) return 1; \
+			list->segments[list->nsegments++] = segment; \
+			list->capacity += length; \
+		} \
+		\
+		return list->capacity < capacity; \
+	} \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME(void) { \
+		/* Wrapper for creating default-sized non thread-safe segmented lists. */ \
+		\
+		return usf_newseglist##_NAME##sz(USF_SEGLIST_FIRSTSIZE); \
+	} \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME##_ts(void) { \
+		/* Wrapper for creating default-sized thread-safe segmented lists. */ \
+		\
+		return usf_newseglist##_NAME##sz_ts(USF_SEGLIST_FIRSTSIZE); \
+	} \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME##sz(u64 capacity) { \
+		/* Wrapper for creating non thread-safe segmented lists using usf_stdallocator. */ \
+		\
+		return usf_newseglist##_NAME##sz_alloc(capacity, &usf_stdallocator); \
+	} \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME##sz_ts(u64 capacity) { \
+		/* Wrapper for creating thread-safe segmented lists using usf_stdallocator. */ \
+		\
+		return usf_newseglist##_NAME##sz_ts_alloc(capacity, &usf_stdallocator); \
+	} \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME##_alloc(const usf_allocator *allocator) { \
+		/* Wrapper for creating default-sized non thread-safe segmented lists using the given allocator. */ \
+		\
+		return usf_newseglist##_NAME##sz_alloc(USF_SEGLIST_FIRSTSIZE, allocator); \
+	} \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME##_ts_alloc(const usf_allocator *allocator) { \
+		/* Wrapper for creating default-sized thread-safe segmented lists using the given allocator. */ \
+		\
+		return usf_newseglist##_NAME##sz_ts_alloc(USF_SEGLIST_FIRSTSIZE, allocator); \
+	} \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME##sz_alloc(u64 capacity, const usf_allocator *allocator) { \
+		/* Creates a new non thread-safe segmented list with room for at least capacity elements.
+		 * It behaves as a usf_list, but grows by allocating a segment as large as all previous
+		 * ones together instead of reallocating: no element is ever copied by growth, and pointers
+		 * from usf_seglist##_NAMEat stay valid until their element is deleted or the list freed.
+		 * Indexing remains O(1), finding the segment of an index from its highest set bit.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+		 * Returns the created list, or NULL on failure. */ \
+		\
+		if (allocator == NULL) allocator = &usf_stdallocator; \
+		\
+		usf_seglist##_NAME *list; \
+		if ((list = usf_amalloc(allocator, sizeof(usf_seglist##_NAME))) == NULL) return NULL; \
+		*list = (usf_seglist##_NAME) {0}; \
+		list->allocator = allocator; \
+		usf_internal_seglist##_NAME##reserve(list, capacity); /* Grows later on failure */ \
+		\
+		return list; \
+	} \
+	\
+	usf_seglist##_NAME *usf_newseglist##_NAME##sz_ts_alloc(u64 capacity, const usf_allocator *allocator) { \
+		/* Creates a new thread-safe segmented list, see usf_newseglist##_NAMEsz_alloc.
+		 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+		 * Returns the created list, or NULL if an error occurred. */ \
+		\
+		usf_seglist##_NAME *list; \
+		if ((list = usf_newseglist##_NAME##sz_alloc(capacity, allocator)) == NULL) return NULL; \
+		list->lock = usf_amalloc(list->allocator, sizeof(usf_mutex)); \
+		if (list->lock == NULL || usf_mtxinit(list->lock, MTXINIT_RECURSIVE)) { \
+			usf_afree(list->allocator, list->lock, sizeof(usf_mutex)); \
+			list->lock = NULL; \
+			usf_freeseglist##_NAME(list); \
+			return NULL; /* mutex init failed */ \
+		} \
+		\
+		return list; \
+	} \
+	\
+	usf_seglist##_NAME *usf_seglist##_NAME##set(usf_seglist##_NAME *list, u64 i, _TYPE data) { \
+		/* This function is thread-safe when operating on thread-safe segmented lists.
+		 *
+		 * Sets the given data at index i in the list, or appends it if i is the list's size.
+		 * Returns the list, or NULL if i is past the list's size or an error occurred. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		u64 k, offset; \
+		if (i > list->size || (i == list->size && usf_internal_seglist##_NAME##reserve(list, i + 1))) { \
+			if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+			return NULL; /* Out of range, or allocation failed */ \
+		} \
+		\
+		k = usf_internal_seglistlocate(i, &offset); \
+		list->segments[k][offset] = data; \
+		if (i == list->size) list->size++; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list; \
+	} \
+	\
+	usf_seglist##_NAME *usf_seglist##_NAME##add(usf_seglist##_NAME *list, _TYPE data) { \
+		/* This function is thread-safe when operating on thread-safe segmented lists.
+		 *
+		 * Appends the given data to the list, without moving any element.
+		 * Returns the list, or NULL if an error occurred. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		usf_seglist##_NAME *result; \
+		result = usf_seglist##_NAME##set(list, list->size, data); \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return result; \
+	} \
+	\
+	usf_seglist##_NAME *usf_seglist##_NAME##reserve(usf_seglist##_NAME *list, u64 capacity) { \
+		/* This function is thread-safe when operating on thread-safe segmented lists.
+		 *
+		 * Allocates segments until the list can hold at least capacity elements.
+		 * Returns the list, or NULL if an error occurred. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		u8 failed; \
+		failed = usf_internal_seglist##_NAME##reserve(list, capacity); \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return failed ? NULL : list; \
+	} \
+	\
+	usf_seglist##_NAME *usf_seglist##_NAME##shrink(usf_seglist##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe segmented lists.
+		 *
+		 * Frees the segments past the one holding the last element of the list.
+		 * Returns the list. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		u64 keep, offset; \
+		keep = list->size ? usf_internal_seglistlocate(list->size - 1, &offset) + 1 : 0; \
+		while (list->nsegments > keep) { \
+			list->nsegments--; \
+			list->capacity -= USF_SEGLIST_FIRSTSIZE << list->nsegments; \
+			usf_afree(list->allocator, list->segments[list->nsegments], \
+					(USF_SEGLIST_FIRSTSIZE << list->nsegments) * sizeof(_TYPE)); \
+			list->segments[list->nsegments] = NULL; \
+		} \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return list; \
+	} \
+	\
+	_TYPE usf_seglist##_NAME##get(const usf_seglist##_NAME *list, u64 i) { \
+		/* This function is thread-safe when operating on thread-safe segmented lists.
+		 *
+		 * Returns the data at index i in the given list, or zero if it is inaccessible. */ \
+		\
+		if (list == NULL) return (_TYPE) {0}; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		_TYPE data; \
+		u64 k, offset; \
+		if (i < list->size) { \
+			k = usf_internal_seglistlocate(i, &offset); \
+			data = list->segments[k][offset]; \
+		} else data = (_TYPE) {0}; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return data; \
+	} \
+	\
+	_TYPE *usf_seglist##_NAME##at(const usf_seglist##_NAME *list, u64 i) { \
+		/* This function is thread-safe when operating on thread-safe segmented lists.
+		 *
+		 * Returns the address of the element at index i in the given list, or NULL if it is
+		 * inaccessible. It stays valid as the list grows, and always refers to index i: deleting
+		 * an element before it moves the next one there. Accessing it is not synchronized. */ \
+		\
+		if (list == NULL) return NULL; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		_TYPE *element; \
+		u64 k, offset; \
+		if (i < list->size) { \
+			k = usf_internal_seglistlocate(i, &offset); \
+			element = &list->segments[k][offset]; \
+		} else element = NULL; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return element; \
+	} \
+	\
+	_TYPE usf_seglist##_NAME##del(usf_seglist##_NAME *list, u64 i) { \
+		/* This function is thread-safe when operating on thread-safe segmented lists.
+		 *
+		 * Deletes the element at index i in the given list, shifting the following ones back by one,
+		 * a segment at a time. No memory is freed, see usf_seglist##_NAMEshrink.
+		 * Returns the deleted value, or zero if it is inaccessible. */ \
+		\
+		if (list == NULL) return (_TYPE) {0}; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		_TYPE data; \
+		u64 k, offset, n; \
+		if (i >= list->size) { \
+			if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+			return (_TYPE) {0}; /* Out of range */ \
+		} \
+		\
+		k = usf_internal_seglistlocate(i, &offset); \
+		data = list->segments[k][offset]; \
+		for (; i + 1 < list->size; i += n, k++, offset = 0) { \
+			n = USF_MIN((USF_SEGLIST_FIRSTSIZE << k) - offset, list->size - i) - 1; \
+			memmove(&list->segments[k][offset], &list->segments[k][offset + 1], n * sizeof(_TYPE)); \
+			if (i + n + 1 < list->size) list->segments[k][offset + n++] = list->segments[k + 1][0]; /* Across segments */ \
+		} \
+		list->size--; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return data; \
+	} \
+	\
+	usf_memusage usf_seglist##_NAME##memusage(const usf_seglist##_NAME *list) { \
+		/* This function is thread-safe when operating on thread-safe segmented lists.
+		 *
+		 * Returns the memory used by a segmented list, excluding what its values point to. */ \
+		\
+		if (list == NULL) return (usf_memusage) {0}; \
+		if (list->lock) usf_mtxlock(list->lock); /* Thread-safe lock */ \
+		\
+		usf_memusage usage; \
+		usage = (usf_memusage) {0}; \
+		usage.structure = sizeof(usf_seglist##_NAME); \
+		usage.array = list->size * sizeof(_TYPE); \
+		usage.slack = (list->capacity - list->size) * sizeof(_TYPE); \
+		usage.locks = list->lock ? sizeof(usf_mutex) : 0; \
+		usage.total = usage.structure + usage.array + usage.locks + usage.slack; \
+		\
+		if (list->lock) usf_mtxunlock(list->lock); /* Thread-safe unlock */ \
+		return usage; \
+	} \
+	\
+	void usf_freeseglist##_NAME##func(usf_seglist##_NAME *list, void (*freefunc)(_TYPE)) { \
+		/* Frees a segmented list and calls freefunc on its values.
+		 * If freefunc is NULL, nothing is done to the values.
+		 * If list is NULL, this function has no effect. */ \
+		\
+		if (list == NULL) return; \
+		\
+		u64 k, offset; \
+		for (k = 0; k < list->nsegments; k++) { \
+			if (freefunc) for (offset = 0; offset < USF_SEGLIST_FIRSTSIZE << k \
+					&& (USF_SEGLIST_FIRSTSIZE << k) - USF_SEGLIST_FIRSTSIZE + offset < list->size; offset++) \
+				freefunc(list->segments[k][offset]); /* Free value */ \
+			usf_afree(list->allocator, list->segments[k], (USF_SEGLIST_FIRSTSIZE << k) * sizeof(_TYPE)); \
+		} \
+		\
+		if (list->lock) { \
+			usf_mtxdestroy(list->lock); \
+			usf_afree(list->allocator, list->lock, sizeof(usf_mutex)); \
+		} \
+		usf_afree(list->allocator, list, sizeof(usf_seglist##_NAME)); \
+	} \
+	\
+	void usf_freeseglist##_NAME(usf_seglist##_NAME *list) { \
+		/* Frees a segmented list without freeing its values.
+		 * If list is NULL, this function has no effect. */ \
+		\
+		usf_freeseglist##_NAME##func(list, NULL); \
+	}
+USF_SEGLISTIMPL(i8, i8)
+USF_SEGLISTIMPL(i16, i16)
+USF_SEGLISTIMPL(i32, i32)
+USF_SEGLISTIMPL(i64, i64)
+USF_SEGLISTIMPL(u8, u8)
+USF_SEGLISTIMPL(u16, u16)
+USF_SEGLISTIMPL(u32, u32)
+USF_SEGLISTIMPL(u64, u64)
+USF_SEGLISTIMPL(f32, f32)
+USF_SEGLISTIMPL(f64, f64)
+USF_SEGLISTIMPL(void *, ptr)
+USF_SEGLISTIMPL(usf_data, )
+#undef USF_SEGLISTIMPL
+
+static u64 usf_internal_seglistlocate(u64 i, u64 *offset) {
+	/* Returns the segment holding index i and stores the index within it in offset.
+	 * Segment k starts at index FIRSTSIZE * (2^k - 1), so i + FIRSTSIZE has its highest bit at k + FIRSTSHIFT */
+
+	u64 biased, k;
+	biased = i + USF_SEGLIST_FIRSTSIZE;
+	k = (u64) (63 - __builtin_clzll(biased)) - USF_SEGLIST_FIRSTSHIFT;
+	*offset = biased - (USF_SEGLIST_FIRSTSIZE << k);
+
+	return k;
+}
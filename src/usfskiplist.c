@@ -1,53 +1,168 @@
 #include "usfskiplist.h"
 
+static usf_pool *usf_internal_skpool(usf_skiplist *skiplist, u64 height);
+static usf_skiplist *usf_internal_skbuild(usf_skiplist *skiplist, const u64 *indices, const usf_data *data, u64 n);
+static i32 usf_internal_skstart(usf_skiplist *skiplist, u64 i, usf_skipnode **pred, u64 *rank);
+static void usf_internal_skupperpreds(usf_skiplist *skiplist, u64 i, i32 bottom, usf_skipnode **preds, u64 *ranks);
+static usf_skipnode *usf_internal_skbefore(const usf_skiplist *skiplist, u64 i);
+static usf_skipnode *usf_internal_skfloor(const usf_skiplist *skiplist, u64 i);
+
+static atomic_u64 nskiplists_; /* Default seed source */
+
+/* Links and span widths leaving a predecessor, or base if it is NULL */
+#define USF_SKLINKS(_SKIPLIST, _PRED) ((_PRED) ? (_PRED)->nextnodes : (_SKIPLIST)->base)
+#define USF_SKWIDTHS(_SKIPLIST, _PRED) ((_PRED) ? USF_SKIPWIDTHS(_PRED) : (_SKIPLIST)->basewidths)
+
 usf_skiplist *usf_newsk(void) {
+	/* Wrapper for creating non thread-safe skiplists using usf_stdallocator. */
+
+	return usf_newsk_alloc(&usf_stdallocator);
+}
+
+usf_skiplist *usf_newsk_ts(void) {
+	/* Wrapper for creating thread-safe skiplists using usf_stdallocator. */
+
+	return usf_newsk_ts_alloc(&usf_stdallocator);
+}
+
+usf_skiplist *usf_newsk_alloc(const usf_allocator *allocator) {
 	/* Creates a new non thread-safe skiplist, initialized to 0.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
+	 * Nodes are sized to their height and come from one usf_pool per height; their memory
+	 * is only given back to allocator when the skiplist is freed.
 	 * Returns the created skiplist. */
 
+	if (allocator == NULL) allocator = &usf_stdallocator;
+
 	usf_skiplist *skiplist;
-	skiplist = usf_calloc(1, sizeof(usf_skiplist));
+	skiplist = usf_acalloc(allocator, 1, sizeof(usf_skiplist));
+	skiplist->allocator = allocator;
+	usf_skseed(skiplist, usf_atmaddi(&nskiplists_, 1, MEMORDER_RELAXED) ^ (uintptr_t) skiplist);
 
 	return skiplist;
 }
 
-usf_skiplist *usf_newsk_ts(void) {
+usf_skiplist *usf_newsk_ts_alloc(const usf_allocator *allocator) {
 	/* Creates a new thread-safe skiplist, initialized to 0.
+	 * All of its memory is obtained from allocator, or usf_stdallocator if it is NULL.
 	 * Returns the created skiplist, or NULL if a mutex cannot be created. */
 
 	usf_skiplist *skiplist;
-	skiplist = usf_calloc(1, sizeof(usf_skiplist));
-	skiplist->lock = usf_malloc(sizeof(usf_mutex));
+	skiplist = usf_newsk_alloc(allocator);
+	skiplist->lock = usf_amalloc(skiplist->allocator, sizeof(usf_mutex));
 	if (usf_mtxinit(skiplist->lock, MTXINIT_RECURSIVE)) {
-		usf_free(skiplist->lock);
-		usf_free(skiplist);
+		usf_afree(skiplist->allocator, skiplist->lock, sizeof(usf_mutex));
+		usf_afree(skiplist->allocator, skiplist, sizeof(usf_skiplist));
 		return NULL; /* mutex init failed */
 	}
 
 	return skiplist;
 }
 
+usf_skiplist *usf_skfromsorted(const u64 *indices, const usf_data *data, u64 n) {
+	/* Wrapper for building non thread-safe skiplists using usf_stdallocator. */
+
+	return usf_skfromsorted_alloc(indices, data, n, &usf_stdallocator);
+}
+
+usf_skiplist *usf_skfromsorted_ts(const u64 *indices, const usf_data *data, u64 n) {
+	/* Wrapper for building thread-safe skiplists using usf_stdallocator. */
+
+	return usf_skfromsorted_ts_alloc(indices, data, n, &usf_stdallocator);
+}
+
+usf_skiplist *usf_skfromsorted_alloc(const u64 *indices, const usf_data *data, u64 n,
+		const usf_allocator *allocator) {
+	/* Builds a new non thread-safe skiplist holding data[k] at virtual index indices[k]
+	 * for the n given elements, whose indices must be strictly increasing.
+	 * This runs in O(n): heights are deterministic (one plus the trailing zeros of the
+	 * element's rank), which makes the skiplist perfectly balanced, and all nodes are
+	 * laid out contiguously in a single block obtained from allocator.
+	 * Returns the built skiplist, or NULL if the indices are not sorted or allocation failed. */
+
+	return usf_internal_skbuild(usf_newsk_alloc(allocator), indices, data, n);
+}
+
+usf_skiplist *usf_skfromsorted_ts_alloc(const u64 *indices, const usf_data *data, u64 n,
+		const usf_allocator *allocator) {
+	/* Builds a new thread-safe skiplist from n sorted elements (see usf_skfromsorted_alloc).
+	 * Returns the built skiplist, or NULL if the indices are not sorted or an error occurred. */
+
+	return usf_internal_skbuild(usf_newsk_ts_alloc(allocator), indices, data, n);
+}
+
+void usf_skseed(usf_skiplist *skiplist, u64 seed) {
+	/* Seeds the generator drawing node heights in a skiplist, making its
+	 * shape deterministic for a given sequence of operations.
+	 * Skiplists are otherwise seeded differently from each other.
+	 * (Note: this function is not thread-safe) */
+
+	if (skiplist == NULL) return;
+
+	skiplist->rngstate = usf_hash(seed) | 1; /* Never zero */
+}
+
+usf_skiplist *usf_skfinger(usf_skiplist *skiplist, u8 enable) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Enables or disables the search finger of a skiplist. With a finger, every access
+	 * remembers its search path and the next one resumes from the lowest level of that
+	 * path which already lies right before its index, so that nearby accesses cost
+	 * O(log d) for a distance d. Insertions and deletions still update the span widths
+	 * on every level, but only take a step or two per level when appending in index order.
+	 * Returns the skiplist, or NULL if the finger cannot be allocated. */
+
+	if (skiplist == NULL) return NULL;
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+
+	if (enable && skiplist->finger == NULL) {
+		if ((skiplist->finger = usf_acalloc(skiplist->allocator, 1, sizeof(usf_skipfinger))) == NULL) {
+			if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+			return NULL; /* Allocation failed */
+		}
+	} else if (!enable) {
+		usf_afree(skiplist->allocator, skiplist->finger, sizeof(usf_skipfinger));
+		skiplist->finger = NULL;
+	}
+
+	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+	return skiplist;
+}
+
 /* Common loop to find and access a skiplist element
  * _SKIPLIST	reference to usf_skiplist *
  * _INDEX		virtual skiplist index being accessed
  * _ACCESS		statements to execute when a match is found
  * _LEVELSHIFT	statement to execute on skiplevel shift
  *
- * LEVEL_		current skiplevel
+ * LEVEL_		current skiplevel, starting from the highest one in use or from the finger
+ * START_		skiplevel the search started from
  * SKIPFRAME_	previous skipnode's pointers to next nodes
+ * PRED_		previous skipnode, or NULL for base
+ * RANK_		rank of the previous skipnode (1 for the first one, 0 for base)
  * NODE_		current skipnode being accessed
  * */
 
 #define USF_SKACCESS(_SKIPLIST, _INDEX, _ACCESS, _LEVELSHIFT) \
-	i32 LEVEL_; \
-	usf_skipnode **SKIPFRAME_, *NODE_; \
-	for (SKIPFRAME_ = _SKIPLIST->base, LEVEL_ = USF_SKIPLIST_FRAMESIZE - 1; LEVEL_ >= 0; LEVEL_--) { \
+	i32 LEVEL_, START_; \
+	usf_skipnode **SKIPFRAME_, *NODE_, *PRED_; \
+	u64 RANK_; \
+	NODE_ = NULL; /* Empty skiplists have no levels */ \
+	START_ = usf_internal_skstart(_SKIPLIST, _INDEX, &PRED_, &RANK_); \
+	for (SKIPFRAME_ = USF_SKLINKS(_SKIPLIST, PRED_), LEVEL_ = START_; LEVEL_ >= 0; LEVEL_--) { \
 		while ((NODE_ = SKIPFRAME_[LEVEL_])) { \
 			if (NODE_->index > _INDEX) break; /* Overshot */ \
 			if (NODE_->index == _INDEX) { /* Found */ \
 				_ACCESS(_SKIPLIST, _INDEX); \
 			} \
+			RANK_ += USF_SKWIDTHS(_SKIPLIST, PRED_)[LEVEL_]; \
+			PRED_ = NODE_; \
 			SKIPFRAME_ = NODE_->nextnodes; /* Skip along */ \
 		} \
+		if (_SKIPLIST->finger) { /* Remember path */ \
+			_SKIPLIST->finger->preds[LEVEL_] = PRED_; \
+			_SKIPLIST->finger->ranks[LEVEL_] = RANK_; \
+		} \
 		_LEVELSHIFT; \
 	}
 
@@ -60,21 +175,44 @@ usf_skiplist *usf_skset(usf_skiplist *skiplist, u64 i, usf_data data) {
 	if (skiplist == NULL) return NULL;
 	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
 
-	usf_skipnode **skiplinks[USF_SKIPLIST_FRAMESIZE];
+	usf_skipnode *preds[USF_SKIPLIST_FRAMESIZE];
+	u64 ranks[USF_SKIPLIST_FRAMESIZE];
 #define ACCESS(_SKIPLIST, _INDEX) \
 	NODE_->data = data; \
 	if (_SKIPLIST->lock) usf_mtxunlock(_SKIPLIST->lock); /* Thread-safe unlock */ \
 	return _SKIPLIST;
-	USF_SKACCESS(skiplist, i, ACCESS, skiplinks[LEVEL_] = &SKIPFRAME_[LEVEL_]);
+	USF_SKACCESS(skiplist, i, ACCESS, (preds[LEVEL_] = PRED_, ranks[LEVEL_] = RANK_));
 #undef ACCESS
 
-	NODE_ = usf_calloc(1, sizeof(usf_skipnode));
-	NODE_->data = data; NODE_->index = i;
-	for (LEVEL_ = 0; LEVEL_ < USF_SKIPLIST_FRAMESIZE; LEVEL_++) {
-		NODE_->nextnodes[LEVEL_] = *skiplinks[LEVEL_]; /* Link this with next */
-		*skiplinks[LEVEL_] = NODE_; /* Link prev with this; this why we we keep extra indirection */
+	u64 height, rank, *widths; /* Height is geometric, from the trailing zeros of a single draw */
+	height = 1 + (u64) __builtin_ctzll(usf_xorshift(&skiplist->rngstate) | U64(1) << (USF_SKIPLIST_FRAMESIZE - 1));
 
-		if (rand() & 1) break; /* Probabilistic upkeep */
+	if ((NODE_ = usf_poolalloc(usf_internal_skpool(skiplist, height))) == NULL) {
+		if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+		return NULL; /* Allocation failed */
+	}
+	NODE_->data = data; NODE_->index = i; NODE_->height = height;
+	if (START_ < (i32) skiplist->level - 1) /* Finger search started below the top level */
+		usf_internal_skupperpreds(skiplist, i, START_, preds, ranks);
+	for (; skiplist->level < height; skiplist->level++) { /* New levels start at base, spanning everything */
+		preds[skiplist->level] = NULL; ranks[skiplist->level] = 0;
+		skiplist->basewidths[skiplist->level] = skiplist->size + 1;
+	}
+	for (rank = ranks[0] + 1, LEVEL_ = 0; LEVEL_ < (i32) skiplist->level; LEVEL_++) {
+		widths = USF_SKWIDTHS(skiplist, preds[LEVEL_]);
+		if (LEVEL_ >= (i32) height) {
+			widths[LEVEL_]++; /* Now also spans this node */
+			continue;
+		}
+		SKIPFRAME_ = USF_SKLINKS(skiplist, preds[LEVEL_]);
+		NODE_->nextnodes[LEVEL_] = SKIPFRAME_[LEVEL_]; /* Link this with next */
+		SKIPFRAME_[LEVEL_] = NODE_; /* Link prev with this */
+		USF_SKIPWIDTHS(NODE_)[LEVEL_] = widths[LEVEL_] + 1 - (rank - ranks[LEVEL_]); /* Split the span */
+		widths[LEVEL_] = rank - ranks[LEVEL_];
+		if (skiplist->finger) { /* Resume right here */
+			skiplist->finger->preds[LEVEL_] = NODE_;
+			skiplist->finger->ranks[LEVEL_] = rank;
+		}
 	}
 	skiplist->size++;
 
@@ -116,16 +254,33 @@ usf_data usf_skdel(usf_skiplist *skiplist, u64 i) {
 	if (skiplist == NULL) return USFNULL;
 	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
 
+	usf_skipnode *preds[USF_SKIPLIST_FRAMESIZE];
+	u64 ranks[USF_SKIPLIST_FRAMESIZE];
 #define ACCESS(_SKIPLIST, _INDEX) \
-	SKIPFRAME_[LEVEL_] = NODE_->nextnodes[LEVEL_]; /* Unlink */ \
-	break;
-	USF_SKACCESS(skiplist, i, ACCESS, (void) 0);
+	break; /* Unlinked once all predecessors are known */
+	USF_SKACCESS(skiplist, i, ACCESS, (preds[LEVEL_] = PRED_, ranks[LEVEL_] = RANK_));
 #undef ACCESS
 
+	u64 *widths;
 	usf_data data;
 	if (NODE_ && NODE_->index == i) { /* Found */
+		if (START_ < (i32) skiplist->level - 1) /* Finger search started below the top level */
+			usf_internal_skupperpreds(skiplist, i, START_, preds, ranks);
+		for (LEVEL_ = 0; LEVEL_ < (i32) skiplist->level; LEVEL_++) {
+			widths = USF_SKWIDTHS(skiplist, preds[LEVEL_]);
+			if (LEVEL_ >= (i32) NODE_->height) {
+				widths[LEVEL_]--; /* No longer spans this node */
+				continue;
+			}
+			USF_SKLINKS(skiplist, preds[LEVEL_])[LEVEL_] = NODE_->nextnodes[LEVEL_]; /* Unlink */
+			widths[LEVEL_] += USF_SKIPWIDTHS(NODE_)[LEVEL_] - 1; /* Merge the spans */
+		}
+
 		data = NODE_->data;
-		usf_free(NODE_);
+		usf_poolfree(usf_internal_skpool(skiplist, NODE_->height), NODE_); /* Block nodes join the pool too */
+		skiplist->size--;
+		while (skiplist->level && skiplist->base[skiplist->level - 1] == NULL)
+			skiplist->level--; /* Drop emptied levels */
 	} else data = USFNULL;
 
 	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
@@ -133,6 +288,243 @@ usf_data usf_skdel(usf_skiplist *skiplist, u64 i) {
 }
 #undef USF_SKACCESS
 
+usf_skiplist *usf_sksetsorted(usf_skiplist *skiplist, const u64 *indices, const usf_data *data, u64 n) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Sets data[k] at virtual index indices[k] for the n given elements, which should be in
+	 * increasing index order. Each insertion resumes from the previous one through the finger,
+	 * which is enabled for the duration of the call if the skiplist has none.
+	 * Returns the skiplist, or NULL if an error occurred (elements before it are set). */
+
+	if (skiplist == NULL) return NULL;
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+
+	u64 k;
+	u8 temporary;
+	if ((temporary = skiplist->finger == NULL) && usf_skfinger(skiplist, 1) == NULL) {
+		if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+		return NULL; /* Allocation failed */
+	}
+
+	for (k = 0; k < n; k++) if (usf_skset(skiplist, indices[k], data[k]) == NULL) break;
+	if (temporary) usf_skfinger(skiplist, 0);
+
+	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+	return k == n ? skiplist : NULL;
+}
+
+usf_memusage usf_skmemusage(const usf_skiplist *skiplist) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Returns the memory used by a skiplist, excluding what its values point to.
+	 * Pooled nodes not currently in the skiplist are counted as slack.
+	 * Nodes are walked, so this runs in O(n). */
+
+	if (skiplist == NULL) return (usf_memusage) {0};
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+
+	usf_memusage usage;
+	usf_skipnode *node;
+	u64 height;
+	usage = (usf_memusage) {0};
+	usage.structure = sizeof(usf_skiplist) + (skiplist->finger ? sizeof(usf_skipfinger) : 0);
+	for (node = skiplist->base[0]; node; node = node->nextnodes[0])
+		usage.nodes += USF_SKIPNODESIZE(node->height);
+	for (height = 0; height < USF_SKIPLIST_FRAMESIZE; height++)
+		usage.slack += usf_poolbytes(skiplist->pools[height]);
+	usage.slack += skiplist->blocksize;
+	usage.slack -= usage.nodes;
+	usage.locks = skiplist->lock ? sizeof(usf_mutex) : 0;
+	usage.total = usage.structure + usage.nodes + usage.locks + usage.slack;
+
+	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+	return usage;
+}
+
+usf_data usf_skfloor(const usf_skiplist *skiplist, u64 i, u64 *index) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Returns the data at the greatest index lower than or equal to i, storing that index
+	 * in *index if it is not NULL. Returns USFNULL (zero) and leaves *index untouched if there is none. */
+
+	if (skiplist == NULL) return USFNULL;
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+
+	usf_skipnode *node;
+	usf_data data;
+	if ((node = usf_internal_skfloor(skiplist, i))) {
+		if (index) *index = node->index;
+		data = node->data;
+	} else data = USFNULL;
+
+	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+	return data;
+}
+
+usf_data usf_skceil(const usf_skiplist *skiplist, u64 i, u64 *index) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Returns the data at the lowest index greater than or equal to i, storing that index
+	 * in *index if it is not NULL. Returns USFNULL (zero) and leaves *index untouched if there is none. */
+
+	if (skiplist == NULL) return USFNULL;
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+
+	usf_skipnode *node;
+	usf_data data;
+	node = usf_internal_skbefore(skiplist, i);
+	if ((node = node ? node->nextnodes[0] : skiplist->base[0])) {
+		if (index) *index = node->index;
+		data = node->data;
+	} else data = USFNULL;
+
+	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+	return data;
+}
+
+usf_data usf_skfirst(const usf_skiplist *skiplist, u64 *index) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Returns the data at the lowest index in the skiplist (see usf_skceil). */
+
+	return usf_skceil(skiplist, 0, index);
+}
+
+usf_data usf_sklast(const usf_skiplist *skiplist, u64 *index) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Returns the data at the greatest index in the skiplist (see usf_skfloor). */
+
+	return usf_skfloor(skiplist, U64_MAX, index);
+}
+
+u64 usf_skrank(const usf_skiplist *skiplist, u64 i) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Returns the number of elements with an index lower than i, in O(log n)
+	 * by adding up the span widths of the links taken on the way down. */
+
+	if (skiplist == NULL) return 0;
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+
+	usf_skipnode *pred, *node;
+	u64 rank;
+	i32 level;
+	for (pred = NULL, rank = 0, level = (i32) skiplist->level - 1; level >= 0; level--) {
+		while ((node = USF_SKLINKS(skiplist, pred)[level]) && node->index < i) {
+			rank += USF_SKWIDTHS(skiplist, pred)[level];
+			pred = node; /* Skip along */
+		}
+	}
+
+	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+	return rank;
+}
+
+usf_data usf_skselect(const usf_skiplist *skiplist, u64 k, u64 *index) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Returns the data of the k-th element in index order (counting from 0), storing its index
+	 * in *index if it is not NULL, in O(log n). Returns USFNULL (zero) and leaves *index
+	 * untouched if the skiplist holds k elements or fewer. */
+
+	if (skiplist == NULL) return USFNULL;
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+
+	usf_skipnode *pred, *node;
+	usf_data data;
+	u64 rank;
+	i32 level;
+	for (pred = NULL, rank = 0, level = (i32) skiplist->level - 1; level >= 0; level--) {
+		while ((node = USF_SKLINKS(skiplist, pred)[level]) && rank + USF_SKWIDTHS(skiplist, pred)[level] <= k + 1) {
+			rank += USF_SKWIDTHS(skiplist, pred)[level];
+			pred = node; /* Skip along */
+		}
+	}
+	if (pred && rank == k + 1) {
+		if (index) *index = pred->index;
+		data = pred->data;
+	} else data = USFNULL;
+
+	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+	return data;
+}
+
+u64 usf_skrange(usf_skiplist *skiplist, u64 lo, u64 hi,
+		void (*callback)(u64 index, usf_data data, void *context), void *context) {
+	/* This function is thread-safe when operating on thread-safe skiplists.
+	 *
+	 * Calls callback on every element with an index between lo and hi (inclusive), in order,
+	 * after a single descent. The skiplist stays locked during the callbacks, which may
+	 * read it but must not modify it.
+	 * Returns the number of elements visited. */
+
+	if (skiplist == NULL) return 0;
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+
+	usf_skipnode *node;
+	u64 count;
+	node = usf_internal_skbefore(skiplist, lo);
+	for (node = node ? node->nextnodes[0] : skiplist->base[0], count = 0;
+			node && node->index <= hi; node = node->nextnodes[0], count++)
+		callback(node->index, node->data, context);
+
+	if (skiplist->lock) usf_mtxunlock(skiplist->lock); /* Thread-safe unlock */
+	return count;
+}
+
+void usf_skiterbegin(usf_skiplist *skiplist, usf_skipiter *iter) {
+	/* Initializes and begins a skiplist iterator for the given skiplist.
+	 * After iteration has finished, usf_skiterend must be called.
+	 * (Note: an iterator must be ended by the same thread which initialized it) */
+
+	usf_skiterskim(skiplist, iter);
+	if (skiplist->lock) usf_mtxlock(skiplist->lock); /* Thread-safe lock */
+}
+
+void usf_skiterskim(usf_skiplist *skiplist, usf_skipiter *iter) {
+	/* Initializes a fragile skiplist iterator for the given skiplist: using this iterator
+	 * requires that no other processes modify the skiplist concurrently.
+	 * However, usf_skiterend does not need to be called afterwards.
+	 * The iterator starts outside of the skiplist, past its last node and before its first. */
+
+	iter->node = NULL;
+	iter->skiplist = skiplist;
+}
+
+usf_skipnode *usf_skiternext(usf_skipiter *iter) {
+	/* Moves the iterator to the next node in index order, or to the first one
+	 * if it is outside of the skiplist.
+	 * Returns that node, or NULL if the iterator moved past the last node. */
+
+	return iter->node = iter->node ? iter->node->nextnodes[0] : iter->skiplist->base[0];
+}
+
+usf_skipnode *usf_skiterprev(usf_skipiter *iter) {
+	/* Moves the iterator to the previous node in index order, or to the last one
+	 * if it is outside of the skiplist. This takes a descent from the top level.
+	 * Returns that node, or NULL if the iterator moved before the first node. */
+
+	return iter->node = iter->node ? usf_internal_skbefore(iter->skiplist, iter->node->index)
+		: usf_internal_skfloor(iter->skiplist, U64_MAX);
+}
+
+usf_skipnode *usf_skiterseek(usf_skipiter *iter, u64 i) {
+	/* Moves the iterator to the first node with an index greater than or equal to i.
+	 * Returns that node, or NULL if there is none (the iterator is then outside of the skiplist). */
+
+	usf_skipnode *node;
+	node = usf_internal_skbefore(iter->skiplist, i);
+	return iter->node = node ? node->nextnodes[0] : iter->skiplist->base[0];
+}
+
+void usf_skiterend(usf_skipiter *iter) {
+	/* This function must be called after skiplist iteration has concluded.
+	 * (Note: an iterator must be ended by the same thread which initialized it) */
+
+	if (iter->skiplist->lock) usf_mtxunlock(iter->skiplist->lock); /* Thread-safe unlock */
+}
+
 void usf_freeskfunc(usf_skiplist *skiplist, void (*freefunc)(void *)) {
 	/* Frees a skiplist and calls freefunc on its values.
 	 * If freefunc is NULL, nothing is done on the skiplist values.
@@ -140,18 +532,20 @@ void usf_freeskfunc(usf_skiplist *skiplist, void (*freefunc)(void *)) {
 	
 	if (skiplist == NULL) return;
 
-	usf_skipnode *node, *next;
-	for (node = skiplist->base[0]; node; node = next) {
-		next = node->nextnodes[0];
-		if (freefunc) freefunc(node->data.p);
-		usf_free(node);
-	}
+	usf_skipnode *node;
+	u64 height;
+	if (freefunc) for (node = skiplist->base[0]; node; node = node->nextnodes[0])
+		freefunc(node->data.p);
+	for (height = 0; height < USF_SKIPLIST_FRAMESIZE; height++)
+		usf_freepool(skiplist->pools[height]); /* Releases all nodes at once */
+	usf_afree(skiplist->allocator, skiplist->finger, sizeof(usf_skipfinger));
+	usf_afree(skiplist->allocator, skiplist->block, skiplist->blocksize);
 
 	if (skiplist->lock) {
 		usf_mtxdestroy(skiplist->lock);
-		usf_free(skiplist->lock);
+		usf_afree(skiplist->allocator, skiplist->lock, sizeof(usf_mutex));
 	}
-	usf_free(skiplist);
+	usf_afree(skiplist->allocator, skiplist, sizeof(usf_skiplist));
 }
 
 void usf_freesk(usf_skiplist *skiplist) {
@@ -160,3 +554,122 @@ void usf_freesk(usf_skiplist *skiplist) {
 
 	usf_freeskfunc(skiplist, NULL);
 }
+
+static usf_pool *usf_internal_skpool(usf_skiplist *skiplist, u64 height) {
+	/* Returns the node pool for the given height, creating it if needed (NULL on failure) */
+
+	usf_pool **pool;
+	pool = &skiplist->pools[height - 1];
+	if (*pool == NULL) *pool = usf_newpool_alloc(USF_SKIPNODESIZE(height), skiplist->allocator);
+
+	return *pool;
+}
+
+static usf_skiplist *usf_internal_skbuild(usf_skiplist *skiplist, const u64 *indices, const usf_data *data, u64 n) {
+	/* Links n sorted elements into an empty skiplist, freeing it if they are not strictly increasing */
+
+	if (skiplist == NULL) return NULL;
+
+	u64 k, height, level, size;
+	for (k = 1, size = n ? USF_SKIPNODESIZE(1) : 0; k < n; k++) {
+		if (indices[k] <= indices[k - 1]) {
+			usf_freesk(skiplist);
+			return NULL; /* Not sorted */
+		}
+		size += USF_SKIPNODESIZE(1 + USF_MIN((u64) __builtin_ctzll(k + 1), (u64) USF_SKIPLIST_FRAMESIZE - 1));
+	}
+	if (n == 0) return skiplist;
+	if ((skiplist->block = usf_amalloc(skiplist->allocator, size)) == NULL) {
+		usf_freesk(skiplist);
+		return NULL; /* Allocation failed */
+	}
+	skiplist->blocksize = size;
+
+	usf_skipnode *tails[USF_SKIPLIST_FRAMESIZE], *node;
+	u64 tailranks[USF_SKIPLIST_FRAMESIZE];
+	u8 *cursor;
+	for (level = 0; level < USF_SKIPLIST_FRAMESIZE; level++) tails[level] = NULL, tailranks[level] = 0;
+	for (k = 0, cursor = skiplist->block; k < n; k++, cursor += USF_SKIPNODESIZE(height)) {
+		height = 1 + USF_MIN((u64) __builtin_ctzll(k + 1), (u64) USF_SKIPLIST_FRAMESIZE - 1);
+		node = (usf_skipnode *) (void *) cursor;
+		node->data = data[k]; node->index = indices[k]; node->height = height;
+		for (level = 0; level < height; level++) { /* Append on every level the node reaches */
+			USF_SKLINKS(skiplist, tails[level])[level] = node;
+			USF_SKWIDTHS(skiplist, tails[level])[level] = k + 1 - tailranks[level];
+			tails[level] = node; tailranks[level] = k + 1;
+		}
+		skiplist->level = USF_MAX(skiplist->level, height);
+	}
+	for (level = 0; level < skiplist->level; level++) {
+		USF_SKLINKS(skiplist, tails[level])[level] = NULL;
+		USF_SKWIDTHS(skiplist, tails[level])[level] = n + 1 - tailranks[level]; /* Spans to the end */
+	}
+	skiplist->size = n;
+
+	return skiplist;
+}
+
+static i32 usf_internal_skstart(usf_skiplist *skiplist, u64 i, usf_skipnode **pred, u64 *rank) {
+	/* Returns the level to start searching for index i from, and its predecessor there in *pred
+	 * with its rank in *rank: the lowest finger level already right before i, or else the top level from base */
+
+	usf_skipnode *next;
+	i32 level;
+	if (skiplist->finger) for (level = 0; level < (i32) skiplist->level; level++) {
+		if ((*pred = skiplist->finger->preds[level]) && (*pred)->index >= i) continue; /* Past i */
+		next = USF_SKLINKS(skiplist, *pred)[level];
+		if (next == NULL || next->index >= i) {
+			*rank = skiplist->finger->ranks[level];
+			return level;
+		}
+	}
+
+	*pred = NULL; *rank = 0;
+	return (i32) skiplist->level - 1;
+}
+
+static void usf_internal_skupperpreds(usf_skiplist *skiplist, u64 i, i32 bottom, usf_skipnode **preds, u64 *ranks) {
+	/* Fills the predecessors of index i and their ranks on the levels above bottom, jumping ahead
+	 * along the finger where it is closer, and remembers them in the finger */
+
+	usf_skipnode *at, *node, *pred;
+	u64 rank;
+	i32 level;
+	for (at = NULL, rank = 0, level = (i32) skiplist->level - 1; level > bottom; level--) {
+		if (skiplist->finger && (pred = skiplist->finger->preds[level]) && pred->index < i
+				&& (at == NULL || pred->index > at->index))
+			at = pred, rank = skiplist->finger->ranks[level]; /* Jump ahead */
+		while ((node = USF_SKLINKS(skiplist, at)[level]) && node->index < i) {
+			rank += USF_SKWIDTHS(skiplist, at)[level];
+			at = node;
+		}
+		preds[level] = at; ranks[level] = rank;
+		if (skiplist->finger) skiplist->finger->preds[level] = at, skiplist->finger->ranks[level] = rank;
+	}
+}
+
+static usf_skipnode *usf_internal_skbefore(const usf_skiplist *skiplist, u64 i) {
+	/* Returns the last node with an index lower than i, or NULL if there is none */
+
+	usf_skipnode *const *frame, *node, *before;
+	i32 level;
+	before = NULL;
+	for (frame = skiplist->base, level = (i32) skiplist->level - 1; level >= 0; level--) {
+		while ((node = frame[level]) && node->index < i) {
+			before = node;
+			frame = node->nextnodes; /* Skip along */
+		}
+	}
+
+	return before;
+}
+
+static usf_skipnode *usf_internal_skfloor(const usf_skiplist *skiplist, u64 i) {
+	/* Returns the last node with an index lower than or equal to i, or NULL if there is none */
+
+	usf_skipnode *before, *node;
+	before = usf_internal_skbefore(skiplist, i);
+	node = before ? before->nextnodes[0] : skiplist->base[0];
+
+	return node && node->index == i ? node : before;
+}
@@ -1,5 +1,166 @@
+#ifdef __linux__
+	#define _GNU_SOURCE /* cpu_set_t, pthread_setaffinity_np */
+	#include <pthread.h>
+	#include <sched.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <dirent.h>
+	#include <limits.h>
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+#endif
 #include "usfthread.h"
 
+static void usf_internal_spinwait(atomic_u32 *address, u32 value, atomic_u32 *sleepers);
+static void usf_internal_futexwait(atomic_u32 *address, u32 value);
+static void usf_internal_futexwake(atomic_u32 *address, u32 n);
+
+#ifdef __linux__
+	#define USF_SYSFS_CPU "/sys/devices/system/cpu/"
+
+static i32 usf_internal_readsys(const char *path, char *buffer, u64 size);
+static i32 usf_internal_readsysu64(const char *path, u64 *value);
+static u64 usf_internal_countcpulist(const char *list);
+#endif
+
+i32 usf_barrinit(usf_barrier *barrier, u32 nthreads) {
+	/* Initializes a reusable barrier for nthreads threads.
+	 * Returns THRD_SUCCESS, or THRD_ERROR if nthreads is 0. */
+
+	if (barrier == NULL || nthreads == 0) return THRD_ERROR;
+
+	usf_atminit(&barrier->count, nthreads);
+	usf_atminit(&barrier->phase, 0);
+	usf_atminit(&barrier->sleepers, 0);
+	barrier->nthreads = nthreads;
+
+	return THRD_SUCCESS;
+}
+
+i32 usf_barrwait(usf_barrier *barrier) {
+	/* Blocks until all threads of the barrier have called this function for the current phase.
+	 * The last thread to arrive resets the count and advances the phase (sense reversal), so the
+	 * barrier is immediately reusable. Waiters spin briefly before sleeping on the phase futex.
+	 * Returns 1 in exactly one thread per phase (the last to arrive), and 0 in all others
+	 * or if barrier is NULL. */
+
+	if (barrier == NULL) return 0;
+
+	u32 phase;
+	phase = usf_atmmld(&barrier->phase, MEMORDER_ACQUIRE);
+
+	if (usf_atmsubi(&barrier->count, 1, MEMORDER_ACQ_REL) == 1) { /* Last to arrive */
+		usf_atmmst(&barrier->count, barrier->nthreads, MEMORDER_RELAXED);
+		usf_atmmst(&barrier->phase, phase + 1, MEMORDER_SEQ_CST); /* Publishes count */
+		if (usf_atmmld(&barrier->sleepers, MEMORDER_SEQ_CST))
+			usf_internal_futexwake(&barrier->phase, U32_MAX);
+		return 1;
+	}
+
+	usf_internal_spinwait(&barrier->phase, phase, &barrier->sleepers);
+	return 0;
+}
+
+void usf_barrdestroy(usf_barrier *barrier) {
+	/* Destroys a barrier. No thread may be waiting on it.
+	 * This function currently has no effect and exists for symmetry with usf_barrinit. */
+
+	(void) barrier;
+}
+
+i32 usf_latchinit(usf_latch *latch, u32 count) {
+	/* Initializes a single-use latch which opens once it has been counted down count times.
+	 * Returns THRD_SUCCESS, or THRD_ERROR if latch is NULL. */
+
+	if (latch == NULL) return THRD_ERROR;
+
+	usf_atminit(&latch->count, count);
+	usf_atminit(&latch->sleepers, 0);
+
+	return THRD_SUCCESS;
+}
+
+void usf_latchcountdown(usf_latch *latch, u32 n) {
+	/* Decrements the latch by n, releasing all of its waiters if it reaches zero.
+	 * Counting down an open latch, or by more than its count, is undefined. */
+
+	if (usf_atmsubi(&latch->count, n, MEMORDER_SEQ_CST) == n && usf_atmmld(&latch->sleepers, MEMORDER_SEQ_CST))
+		usf_internal_futexwake(&latch->count, U32_MAX);
+}
+
+void usf_latchwait(usf_latch *latch) {
+	/* Blocks until the latch is open (its count has reached zero). */
+
+	u32 count;
+	while ((count = usf_atmmld(&latch->count, MEMORDER_ACQUIRE)))
+		usf_internal_spinwait(&latch->count, count, &latch->sleepers);
+}
+
+i32 usf_latchtrywait(usf_latch *latch) {
+	/* Returns 1 if the latch is open, or 0 if it is not. */
+
+	return usf_atmmld(&latch->count, MEMORDER_ACQUIRE) == 0;
+}
+
+void usf_latchdestroy(usf_latch *latch) {
+	/* Destroys a latch. No thread may be waiting on it.
+	 * This function currently has no effect and exists for symmetry with usf_latchinit. */
+
+	(void) latch;
+}
+
+i32 usf_seminit(usf_semaphore *semaphore, u32 count) {
+	/* Initializes a counting semaphore holding count permits.
+	 * Returns THRD_SUCCESS, or THRD_ERROR if semaphore is NULL. */
+
+	if (semaphore == NULL) return THRD_ERROR;
+
+	usf_atminit(&semaphore->count, count);
+	usf_atminit(&semaphore->sleepers, 0);
+
+	return THRD_SUCCESS;
+}
+
+void usf_sempost(usf_semaphore *semaphore) {
+	/* Releases a permit, waking one sleeping waiter if there is any. */
+
+	usf_atmaddi(&semaphore->count, 1, MEMORDER_SEQ_CST);
+	if (usf_atmmld(&semaphore->sleepers, MEMORDER_SEQ_CST))
+		usf_internal_futexwake(&semaphore->count, 1);
+}
+
+void usf_semwait(usf_semaphore *semaphore) {
+	/* Blocks until a permit is available and takes it. */
+
+	u32 count;
+	for (;;) {
+		while ((count = usf_atmmld(&semaphore->count, MEMORDER_RELAXED)))
+			if (usf_atmcmpxch_weak(&semaphore->count, &count, count - 1, MEMORDER_ACQUIRE, MEMORDER_RELAXED))
+				return; /* Taken */
+
+		usf_internal_spinwait(&semaphore->count, 0, &semaphore->sleepers);
+	}
+}
+
+i32 usf_semtrywait(usf_semaphore *semaphore) {
+	/* Takes a permit if one is available, without blocking.
+	 * Returns THRD_SUCCESS if a permit was taken, or THRD_BUSY if there was none. */
+
+	u32 count;
+	while ((count = usf_atmmld(&semaphore->count, MEMORDER_RELAXED)))
+		if (usf_atmcmpxch_weak(&semaphore->count, &count, count - 1, MEMORDER_ACQUIRE, MEMORDER_RELAXED))
+			return THRD_SUCCESS;
+
+	return THRD_BUSY;
+}
+
+void usf_semdestroy(usf_semaphore *semaphore) {
+	/* Destroys a semaphore. No thread may be waiting on it.
+	 * This function currently has no effect and exists for symmetry with usf_seminit. */
+
+	(void) semaphore;
+}
+
 u64 usf_nprocsonln(void) {
 	/* Returns the number of logical CPUs currently online. */
 
@@ -22,3 +183,270 @@ u64 usf_nprocsconf(void) {
 	return (u64) sysconf(_SC_NPROCESSORS_CONF);
 #endif
 }
+
+usf_cputopo *usf_newcputopo(void) {
+	/* Discovers the CPU topology of this machine from sysfs: physical cores, SMT siblings,
+	 * packages, NUMA nodes and the cache hierarchy of the first online CPU.
+	 * Returns the topology, or NULL if it cannot be read. Only Linux is supported. */
+
+#ifndef __linux__
+	return NULL;
+#else
+	u64 nconf;
+	if ((nconf = usf_nprocsconf()) == 0 || nconf == U64_MAX) return NULL; /* sysconf failed */
+
+	usf_cputopo *topology;
+	u32 *rawcores; /* core_id is only unique within a package */
+	topology = usf_calloc(1, sizeof(usf_cputopo));
+	topology->cpus = usf_calloc(nconf, sizeof(usf_cpu));
+	rawcores = usf_calloc(nconf, sizeof(u32));
+
+	char path[256];
+	u64 value;
+	u32 cpu;
+	usf_cpu *entry;
+	for (cpu = 0; cpu < nconf; cpu++) {
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32"/online", cpu);
+		if (!usf_internal_readsysu64(path, &value) && value == 0) continue; /* Offline */
+
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32"/topology/core_id", cpu);
+		if (usf_internal_readsysu64(path, &value)) continue; /* Not present */
+
+		entry = &topology->cpus[topology->ncpus];
+		rawcores[topology->ncpus++] = (u32) value;
+		entry->id = cpu;
+
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32"/topology/physical_package_id", cpu);
+		if (usf_internal_readsysu64(path, &value) || value > U32_MAX) value = 0; /* Unknown (-1) */
+		entry->package = (u32) value;
+
+		DIR *directory; /* NUMA node is exposed as a cpuN/nodeM link */
+		struct dirent *node;
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32, cpu);
+		if ((directory = opendir(path))) {
+			while ((node = readdir(directory)))
+				if (sscanf(node->d_name, "node%"SCNu32, &entry->node) == 1) break;
+			closedir(directory);
+		}
+	}
+
+	if (topology->ncpus == 0) { /* sysfs is not mounted */
+		usf_free(rawcores);
+		usf_freecputopo(topology);
+		return NULL;
+	}
+
+	u64 i, j;
+	for (i = 0; i < topology->ncpus; i++) { /* Dense core indices and SMT ranks */
+		entry = &topology->cpus[i];
+		for (j = 0; j < i; j++) {
+			if (topology->cpus[j].package != entry->package || rawcores[j] != rawcores[i]) continue;
+			if (entry->smt++ == 0) entry->core = topology->cpus[j].core; /* Sibling of an earlier CPU */
+		}
+		if (entry->smt == 0) entry->core = (u32) topology->ncores++;
+
+		for (j = 0; j < i && topology->cpus[j].package != entry->package; j++);
+		if (j == i) topology->npackages++; /* First CPU in this package */
+		for (j = 0; j < i && topology->cpus[j].node != entry->node; j++);
+		if (j == i) topology->nnodes++; /* First CPU in this node */
+	}
+	usf_free(rawcores);
+
+	char buffer[256];
+	usf_cpucache *cache;
+	for (i = 0; i < USF_CPU_MAXCACHES; i++) { /* Cache hierarchy of the first online CPU */
+		cpu = topology->cpus[0].id;
+		cache = &topology->caches[topology->ncaches];
+
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32"/cache/index%"PRIu64"/level", cpu, i);
+		if (usf_internal_readsysu64(path, &value)) break; /* No more cache levels */
+		cache->level = (u32) value;
+
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32"/cache/index%"PRIu64"/type", cpu, i);
+		if (usf_internal_readsys(path, buffer, sizeof(buffer))) continue;
+		if (!strcmp(buffer, "Data")) cache->type = USF_CACHE_DATA;
+		else if (!strcmp(buffer, "Instruction")) cache->type = USF_CACHE_INSTRUCTION;
+		else cache->type = USF_CACHE_UNIFIED;
+
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32"/cache/index%"PRIu64"/size", cpu, i);
+		if (usf_internal_readsys(path, buffer, sizeof(buffer))) continue;
+		char *suffix;
+		cache->size = strtou64(buffer, &suffix, 10);
+		if (*suffix == 'K') cache->size <<= 10;
+		else if (*suffix == 'M') cache->size <<= 20;
+		else if (*suffix == 'G') cache->size <<= 30;
+
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32"/cache/index%"PRIu64"/coherency_line_size",
+				cpu, i);
+		if (usf_internal_readsysu64(path, &cache->linesize)) cache->linesize = 0; /* Unknown */
+
+		snprintf(path, sizeof(path), USF_SYSFS_CPU "cpu%"PRIu32"/cache/index%"PRIu64"/shared_cpu_list",
+				cpu, i);
+		cache->nshared = usf_internal_readsys(path, buffer, sizeof(buffer)) ? 1 : usf_internal_countcpulist(buffer);
+
+		topology->ncaches++;
+	}
+
+	return topology;
+#endif
+}
+
+u64 usf_cputopocores(const usf_cputopo *topology, u32 *cpus, u64 n) {
+	/* Writes to cpus up to n logical CPU numbers, one per physical core (its first SMT sibling),
+	 * in ascending core order. Placing one worker on each of them avoids SMT sibling interference.
+	 * Returns the number of physical cores, which may be greater than n. */
+
+	if (topology == NULL) return 0;
+
+	u64 i, ncores;
+	for (i = ncores = 0; i < topology->ncpus; i++) {
+		if (topology->cpus[i].smt) continue; /* Not the first sibling */
+		if (ncores < n) cpus[ncores] = topology->cpus[i].id;
+		ncores++;
+	}
+
+	return ncores;
+}
+
+void usf_freecputopo(usf_cputopo *topology) {
+	/* Frees a CPU topology.
+	 * If topology is NULL, this function has no effect. */
+
+	if (topology == NULL) return;
+
+	usf_free(topology->cpus);
+	usf_free(topology);
+}
+
+i32 usf_thrdsetaffinity(usf_thread thread, u32 cpu) {
+	/* Pins a thread to the given logical CPU, so that the scheduler no longer migrates it.
+	 * Returns THRD_SUCCESS, or THRD_ERROR if the affinity cannot be set. Only Linux is supported. */
+
+#ifndef __linux__
+	(void) thread; (void) cpu;
+	return THRD_ERROR;
+#else
+	cpu_set_t *set;
+	u64 setsize;
+	if ((set = CPU_ALLOC(cpu + 1)) == NULL) return THRD_ERROR;
+	setsize = CPU_ALLOC_SIZE(cpu + 1);
+
+	CPU_ZERO_S(setsize, set);
+	CPU_SET_S(cpu, setsize, set);
+
+	i32 r;
+	r = pthread_setaffinity_np(thread, setsize, set);
+	CPU_FREE(set);
+
+	return r ? THRD_ERROR : THRD_SUCCESS;
+#endif
+}
+
+i32 usf_thrdpincores(const usf_thread *threads, u64 n) {
+	/* Pins each of the n threads to its own physical core, wrapping around when there are more
+	 * threads than cores. Only the first SMT sibling of each core is used.
+	 * Returns THRD_SUCCESS, or THRD_ERROR if the topology is unknown or a thread cannot be pinned. */
+
+	usf_cputopo *topology;
+	if ((topology = usf_newcputopo()) == NULL) return THRD_ERROR;
+
+	u32 *cpus;
+	u64 ncores;
+	cpus = usf_malloc(topology->ncpus * sizeof(u32));
+	ncores = usf_cputopocores(topology, cpus, topology->ncpus);
+	usf_freecputopo(topology);
+
+	u64 i;
+	i32 r;
+	for (i = 0, r = THRD_SUCCESS; i < n && r == THRD_SUCCESS; i++)
+		r = usf_thrdsetaffinity(threads[i], cpus[i % ncores]);
+
+	usf_free(cpus);
+	return r;
+}
+
+static void usf_internal_spinwait(atomic_u32 *address, u32 value, atomic_u32 *sleepers) {
+	/* Waits until *address no longer holds value: spins for USF_THREAD_SPINCOUNT iterations,
+	 * then sleeps on the address, registering in sleepers so that wakers may skip the syscall. */
+
+	u32 spins;
+	for (spins = 0; spins < USF_THREAD_SPINCOUNT; spins++) {
+		if (usf_atmmld(address, MEMORDER_ACQUIRE) != value) return;
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+
+	usf_atmaddi(sleepers, 1, MEMORDER_SEQ_CST);
+	while (usf_atmmld(address, MEMORDER_SEQ_CST) == value) usf_internal_futexwait(address, value);
+	usf_atmsubi(sleepers, 1, MEMORDER_RELAXED);
+}
+
+static void usf_internal_futexwait(atomic_u32 *address, u32 value) {
+	/* Sleeps until woken if *address still holds value.
+	 * Without futexes, this yields the processor instead. */
+
+#ifdef __linux__
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+	(void) address; (void) value;
+	usf_thrdyield();
+#endif
+}
+
+static void usf_internal_futexwake(atomic_u32 *address, u32 n) {
+	/* Wakes up to n threads sleeping on address. */
+
+#ifdef __linux__
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, n > INT_MAX ? INT_MAX : (c_int) n, NULL, NULL, 0);
+#else
+	(void) address; (void) n;
+#endif
+}
+
+#ifdef __linux__
+static i32 usf_internal_readsys(const char *path, char *buffer, u64 size) {
+	/* Reads the first line of a sysfs file into buffer, without its newline.
+	 * Returns 0 on success, or 1 if the file cannot be read. */
+
+	FILE *f;
+	if ((f = fopen(path, "r")) == NULL) return 1;
+
+	if (fgets(buffer, (c_int) size, f) == NULL) {
+		fclose(f);
+		return 1; /* Empty file */
+	}
+	fclose(f);
+
+	buffer[strcspn(buffer, "\n")] = '\0';
+	return 0;
+}
+
+static i32 usf_internal_readsysu64(const char *path, u64 *value) {
+	/* Reads a decimal value from a sysfs file.
+	 * Returns 0 on success, or 1 if the file cannot be read. */
+
+	char buffer[32];
+	if (usf_internal_readsys(path, buffer, sizeof(buffer))) return 1;
+
+	*value = strtou64(buffer, NULL, 10);
+	return 0;
+}
+
+static u64 usf_internal_countcpulist(const char *list) {
+	/* Returns the number of CPUs in a sysfs CPU list (e.g. 0-3,8-11). */
+
+	u64 count, low, high;
+	char *end;
+	for (count = 0; *list;) {
+		low = high = strtou64(list, &end, 10);
+		if (end == list) break; /* Malformed */
+		if (*end == '-') high = strtou64(end + 1, &end, 10);
+		count += high - low + 1;
+
+		list = *end == ',' ? end + 1 : end;
+	}
+
+	return count;
+}
+#endif
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include "usfarena.h"
+#include "usfhashmap.h"
+#include "usflist.h"
+#include "usftime.h"
+
+#define TESTSZ 100000
+#define PERFSZ 100000
+
+static usf_compatibility_int threadworker(void *arg);
+
+i32 main(void) {
+	/* usfarena.c test */
+
+	u64 i, r;
+	usf_arena *arena;
+	u64 *values[TESTSZ];
+
+	/* NORMAL TESTS */
+
+	printf("arenatest: Starting test!\n");
+	arena = usf_newarenasz(4096);
+
+	for (i = 0; i < TESTSZ; i++) {
+		values[i] = usf_arenaalloc(arena, sizeof(u64) * (i % 7 + 1));
+		if ((uintptr_t) values[i] % USF_ARENA_ALIGNMENT) {
+			printf("arenatest: arenaalloc returned misaligned pointer %p, aborting.\n", (void *) values[i]);
+			exit(1);
+		}
+		*values[i] = i;
+	}
+	for (i = 0; i < TESTSZ; i++) if (*values[i] != i) {
+		printf("arenatest: arena contents mismatch, got %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				*values[i], i);
+		exit(2);
+	}
+	printf("arenatest: arenaalloc OK\n");
+
+	void *aligned;
+	if ((uintptr_t) (aligned = usf_arenaalalloc(arena, 100, 4096)) % 4096
+			|| usf_arenaalalloc(arena, 8, 3) != NULL) {
+		printf("arenatest: arenaalalloc returned misaligned pointer %p, aborting.\n", aligned);
+		exit(3);
+	}
+	usf_arenaalloc(arena, 1 << 20); /* Bigger than a chunk */
+	aligned = usf_arenaalloc(arena, 24);
+	r = arena->offset;
+	if (usf_arenaalloc(arena, U64_MAX - 8) != NULL
+			|| usf_arealloc(&arena->allocator, aligned, 24, U64_MAX - 8) != NULL || arena->offset != r) {
+		printf("arenatest: arenaalloc of a size overflowing the chunk did not fail, aborting.\n");
+		exit(4);
+	}
+	printf("arenatest: arenaalalloc OK\n");
+
+	usf_arenamark mark;
+	mark = usf_arenasave(arena);
+	for (i = 0; i < TESTSZ; i++) usf_arenaalloc(arena, 64);
+	usf_arenarewind(arena, mark);
+	if (arena->chunk != mark.chunk || arena->offset != mark.offset) {
+		printf("arenatest: arenarewind did not return to the saved mark, aborting.\n");
+		exit(5);
+	}
+	printf("arenatest: arenarewind OK\n");
+
+	usf_arenareset(arena);
+	if (arena->chunk->prev != NULL || arena->offset != 0) {
+		printf("arenatest: arenareset left more than its first chunk, aborting.\n");
+		exit(6);
+	}
+	printf("arenatest: arenareset OK\n");
+
+	usf_hashmap *hashmap;
+	usf_listu64 *list;
+	hashmap = usf_newhm_alloc(&arena->allocator);
+	list = usf_newlistu64_alloc(&arena->allocator);
+	for (i = 0; i < TESTSZ; i++) usf_inthmput(hashmap, i, USFDATAU(i)), usf_listu64add(list, i);
+	for (i = 0; i < TESTSZ; i++) if (usf_inthmget(hashmap, i).u != i || usf_listu64get(list, i) != i) {
+		printf("arenatest: arena-backed containers mismatch at %"PRIu64", aborting.\n", i);
+		exit(7);
+	}
+	usf_arenareset(arena); /* Frees both containers at once */
+	printf("arenatest: arena allocator OK\n");
+
+	usf_freearena(arena);
+
+	/* CONCURRENT TESTS */
+
+	printf("arenatest: Starting concurrency test!\n");
+	usf_thread threads[8];
+	usf_compatibility_int result;
+	for (i = 0; i < countof(threads); i++) usf_thrdcreate(&threads[i], threadworker, NULL);
+	for (i = r = 0; i < countof(threads); i++) usf_thrdjoin(threads[i], &result), r |= (u64) result;
+	if (r) {
+		printf("arenatest: threadarena was shared between threads, aborting.\n");
+		exit(8);
+	}
+	if (usf_threadarena() != usf_threadarena()) {
+		printf("arenatest: threadarena returned different arenas on one thread, aborting.\n");
+		exit(9);
+	}
+	usf_freethreadarena();
+	printf("arenatest: threadarena OK\n");
+
+	/* PERFORMANCE TESTS */
+
+	printf("arenatest: Starting performance tests!\n");
+	struct timespec start, end;
+
+	arena = usf_newarena();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) values[i] = usf_arenaalloc(arena, 32);
+	usf_arenareset(arena);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freearena(arena);
+	printf("arenatest: arenaalloc: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) values[i] = usf_malloc(32);
+	for (i = 0; i < PERFSZ; i++) usf_free(values[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("arenatest: malloc + free: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	printf("arenatest: usfarena OK (ALL TESTS PASSED)\n");
+	return 0;
+}
+
+static usf_compatibility_int threadworker(void *arg) {
+	(void) arg;
+	u64 i, *value;
+	usf_arena *arena;
+	arena = usf_threadarena();
+	value = usf_arenaalloc(arena, sizeof(u64));
+	for (i = 0; i < TESTSZ; i++) {
+		*value = i;
+		usf_thrdyield();
+		if (*value != i || usf_threadarena() != arena) return 1;
+	}
+	return 0;
+}
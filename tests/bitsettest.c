@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include "usfbitset.h"
+#include "usfmath.h"
+#include "usftime.h"
+
+#define TESTSZ 100003
+#define PERFSZ 10000000
+
+i32 main(void) {
+	/* usfbitset.c test */
+
+	u64 i, r, count;
+	u8 twin[TESTSZ], other[TESTSZ];
+	usf_bitset *bitset, *operand;
+
+	/* NORMAL TESTS */
+
+	printf("bitsettest: Starting test!\n");
+	bitset = usf_newbitset(TESTSZ);
+
+	for (i = 0; i < TESTSZ; i++) if ((twin[i] = usf_hash(i) % 3 == 0)) usf_bitsetset(bitset, i);
+	for (i = 0; i < TESTSZ; i += 7) usf_bitsetclear(bitset, i), twin[i] = 0;
+	for (i = 0; i < TESTSZ; i++) if (usf_bitsettest(bitset, i) != twin[i]) {
+		printf("bitsettest: bitset holds %"PRIu8" at %"PRIu64" while expecting %"PRIu8", aborting.\n",
+				usf_bitsettest(bitset, i), i, twin[i]);
+		exit(1);
+	}
+	if (usf_bitsetset(bitset, TESTSZ) != NULL || usf_bitsetclear(bitset, TESTSZ) != NULL || usf_bitsettest(bitset, TESTSZ)) {
+		printf("bitsettest: bitset accepted an index past its size, aborting.\n");
+		exit(2);
+	}
+	printf("bitsettest: bitsetset OK\n");
+	printf("bitsettest: bitsetclear OK\n");
+	printf("bitsettest: bitsettest OK\n");
+
+	for (i = count = 0; i < TESTSZ; i++) count += twin[i];
+	if (usf_bitsetcount(bitset) != count) {
+		printf("bitsettest: bitsetcount counted %"PRIu64" bits while expecting %"PRIu64", aborting.\n",
+				usf_bitsetcount(bitset), count);
+		exit(3);
+	}
+	for (i = usf_bitsetnext(bitset, 0), r = 0; i != U64_MAX; i = usf_bitsetnext(bitset, i + 1), r++) if (!twin[i]) {
+		printf("bitsettest: bitsetnext stopped at cleared bit %"PRIu64", aborting.\n", i);
+		exit(4);
+	}
+	if (r != count) {
+		printf("bitsettest: bitsetnext found %"PRIu64" bits while expecting %"PRIu64", aborting.\n", r, count);
+		exit(5);
+	}
+	printf("bitsettest: bitsetcount OK\n");
+	printf("bitsettest: bitsetnext OK\n");
+
+	for (i = r = 0; i <= TESTSZ; r += i < TESTSZ && twin[i], i++) if (usf_bitsetrank(bitset, i) != r) {
+		printf("bitsettest: bitsetrank returned %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_bitsetrank(bitset, i), i, r);
+		exit(6);
+	}
+	for (i = 0; i < TESTSZ; i++) if (twin[i] && usf_bitsetselect(bitset, usf_bitsetrank(bitset, i)) != i) {
+		printf("bitsettest: bitsetselect returned %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_bitsetselect(bitset, usf_bitsetrank(bitset, i)), i);
+		exit(7);
+	}
+	if (usf_bitsetselect(bitset, count) != U64_MAX) {
+		printf("bitsettest: bitsetselect found a bit past the last one, aborting.\n");
+		exit(8);
+	}
+	usf_bitsetset(bitset, TESTSZ - 1), twin[TESTSZ - 1] = 1; /* Rank index goes stale */
+	if (usf_bitsetselect(bitset, count) != TESTSZ - 1 || usf_bitsetrank(bitset, TESTSZ) != count + 1) {
+		printf("bitsettest: bitsetselect used a stale rank index, aborting.\n");
+		exit(9);
+	}
+	printf("bitsettest: bitsetrank OK\n");
+	printf("bitsettest: bitsetselect OK\n");
+
+	operand = usf_newbitset(TESTSZ / 2 + 5);
+	for (i = 0; i < TESTSZ; i++) if ((other[i] = i < TESTSZ / 2 + 5 && usf_hash(i + TESTSZ) % 2)) usf_bitsetset(operand, i);
+	usf_bitsetor(bitset, operand);
+	for (i = 0; i < TESTSZ; i++) twin[i] |= other[i];
+	usf_bitsetandnot(operand, bitset);
+	usf_bitsetxor(bitset, operand);
+	for (i = 0; i < TESTSZ; i++) other[i] &= !twin[i], twin[i] ^= other[i];
+	usf_bitsetand(bitset, operand);
+	for (i = 0; i < TESTSZ; i++) twin[i] &= other[i];
+	for (i = 0; i < TESTSZ; i++) if (usf_bitsettest(bitset, i) != twin[i] || usf_bitsettest(operand, i) != other[i]) {
+		printf("bitsettest: bitset operations left %"PRIu8" at %"PRIu64" while expecting %"PRIu8", aborting.\n",
+				usf_bitsettest(bitset, i), i, twin[i]);
+		exit(10);
+	}
+	printf("bitsettest: bitsetand OK\n");
+	printf("bitsettest: bitsetor OK\n");
+	printf("bitsettest: bitsetxor OK\n");
+	printf("bitsettest: bitsetandnot OK\n");
+
+	usf_bitsetfill(operand, 1);
+	usf_bitsetresize(operand, TESTSZ);
+	if (usf_bitsetcount(operand) != TESTSZ / 2 + 5 || usf_bitsetnext(operand, TESTSZ / 2 + 5) != U64_MAX) {
+		printf("bitsettest: bitsetresize added %"PRIu64" set bits, aborting.\n", usf_bitsetcount(operand) - TESTSZ / 2 - 5);
+		exit(11);
+	}
+	usf_bitsetresize(operand, 100);
+	usf_bitsetresize(operand, 200);
+	if (usf_bitsetcount(operand) != 100 || usf_bitsetrank(operand, 200) != 100 || usf_bitsetselect(operand, 99) != 99) {
+		printf("bitsettest: bitsetresize kept %"PRIu64" set bits, aborting.\n", usf_bitsetcount(operand));
+		exit(12);
+	}
+	usf_bitsetfill(operand, 0);
+	if (usf_bitsetcount(operand) || usf_bitsetnext(operand, 0) != U64_MAX) {
+		printf("bitsettest: bitsetfill left bits set, aborting.\n");
+		exit(13);
+	}
+	printf("bitsettest: bitsetresize OK\n");
+	printf("bitsettest: bitsetfill OK\n");
+
+	usf_memusage usage;
+	usage = usf_bitsetmemusage(bitset);
+	if (usage.array != (TESTSZ + 63) / 64 * sizeof(u64) || usage.total < usage.array + usage.nodes + sizeof(usf_bitset)) {
+		printf("bitsettest: bitsetmemusage reported %"PRIu64" bytes of words, aborting.\n", usage.array);
+		exit(14);
+	}
+	printf("bitsettest: bitsetmemusage OK\n");
+	usf_freebitset(bitset);
+	usf_freebitset(operand);
+
+	/* CONCURRENT TESTS */
+	printf("bitsettest: Starting concurrency test!\n");
+	bitset = usf_newbitset_ts(TESTSZ);
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i += 3) usf_bitsetset(bitset, i);
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) if (usf_bitsettest(bitset, i) != (i % 3 == 0)) {
+		printf("bitsettest: bitset contents mismatch at %"PRIu64", aborting.\n", i);
+		exit(15);
+	}
+	printf("bitsettest: bitsetset OK\n");
+	printf("bitsettest: bitsettest OK\n");
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i += 3) if (usf_bitsetselect(bitset, i / 3) != i || usf_bitsetrank(bitset, i) != i / 3) {
+		printf("bitsettest: bitsetselect returned %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_bitsetselect(bitset, i / 3), i);
+		exit(16);
+	}
+	printf("bitsettest: bitsetrank OK\n");
+	printf("bitsettest: bitsetselect OK\n");
+	usf_freebitset(bitset);
+
+	/* PERFORMANCE TESTS */
+	printf("bitsettest: Starting performance tests!\n");
+	struct timespec start, end;
+	u8 *bytes;
+	f64 time;
+	bitset = usf_newbitset(PERFSZ);
+	operand = usf_newbitset(PERFSZ);
+	bytes = calloc(PERFSZ, sizeof(u8));
+	for (i = 0; i < PERFSZ; i += 3) usf_bitsetset(operand, i);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) usf_bitsetset(bitset, usf_hash(i) % PERFSZ);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("bitsettest: bitsetset: %f ns (bitset sz %d).\n", time / PERFSZ, PERFSZ);
+
+	for (i = 0; i < PERFSZ; i++) bytes[usf_hash(i) % PERFSZ] = 1;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = count = 0; i < PERFSZ; i++) count += bytes[i];
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("bitsettest: byte array count: %f ns per element, %"PRIu64" set (sz %d).\n", time / PERFSZ, count, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	count = usf_bitsetcount(bitset);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("bitsettest: bitsetcount: %f ns per bit, %"PRIu64" set (bitset sz %d).\n", time / PERFSZ, count, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_bitsetxor(bitset, operand);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("bitsettest: bitsetxor: %f ns per bit (bitset sz %d).\n", time / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = r = 0; i < PERFSZ; i += 1000) r += usf_bitsetrank(bitset, usf_hash(i) % PERFSZ);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("bitsettest: bitsetrank (with index build): %f ns (bitset sz %d).\n", time / (PERFSZ / 1000), PERFSZ);
+
+	count = usf_bitsetcount(bitset);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = r = 0; i < PERFSZ; i += 1000) r += usf_bitsetselect(bitset, usf_hash(i) % count);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("bitsettest: bitsetselect: %f ns (bitset sz %d).\n", time / (PERFSZ / 1000), PERFSZ);
+	usf_freebitset(bitset);
+	usf_freebitset(operand);
+	free(bytes);
+
+	printf("bitsettest: usfbitset OK (ALL TESTS PASSED)\n");
+	return 0;
+}
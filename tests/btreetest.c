@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include "usfbtree.h"
+#include "usfskiplist.h"
+#include "usfmath.h"
+#include "usftime.h"
+
+#define TESTSZ 100000
+#define PERFSZ 100000
+#define WINDOWSZ 1000
+
+static void rangesum(u64 index, usf_data data, void *context);
+static u64 checknode(const usf_btnode *node, u64 depth, u64 lo, u64 hi);
+
+i32 main(void) {
+	/* usfbtree.c test */
+
+	u64 i, r, index;
+	usf_btree *btree;
+	usf_skiplist *twin;
+
+	/* NORMAL TESTS */
+
+	printf("btreetest: Starting test!\n");
+	btree = usf_newbt();
+
+	for (i = 0; i < TESTSZ; i++) usf_btset(btree, i, USFDATAU(i));
+	for (i = 0; i < TESTSZ; i++) if (usf_btget(btree, i).u != i) {
+		printf("btreetest: btree contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_btget(btree, i).u, i);
+		exit(1);
+	}
+	if (usf_btget(btree, U64_MAX).u != 0 || (usf_btset(btree, U64_MAX, USFDATAU(7)), usf_btget(btree, U64_MAX).u) != 7
+			|| usf_btdel(btree, U64_MAX).u != 7) {
+		printf("btreetest: btree mishandled the greatest index, aborting.\n");
+		exit(2);
+	}
+	printf("btreetest: btset OK\n");
+	printf("btreetest: btget OK\n");
+
+	for (i = 0; i < TESTSZ; i += 2) if ((r = usf_btdel(btree, i).u) != i) {
+		printf("btreetest: btdel returned bad value %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				r, i);
+		exit(3);
+	}
+	for (i = 0; i < TESTSZ; i++) if (usf_btget(btree, i).u != (i & 1 ? i : 0)) {
+		printf("btreetest: btdel left bad value %"PRIu64" at %"PRIu64", aborting.\n",
+				usf_btget(btree, i).u, i);
+		exit(4);
+	}
+	if (btree->size != TESTSZ / 2 || checknode(btree->root, btree->depth, 0, U64_MAX) != TESTSZ / 2) {
+		printf("btreetest: btree is malformed after deleting half of it, aborting.\n");
+		exit(5);
+	}
+	for (i = 1; i < TESTSZ; i += 2) usf_btdel(btree, i);
+	if (btree->root != NULL || btree->size != 0 || btree->nnodes != 0) {
+		printf("btreetest: emptied btree still holds %"PRIu64" nodes, aborting.\n", btree->nnodes);
+		exit(6);
+	}
+	printf("btreetest: btdel OK\n");
+	usf_freebt(btree);
+
+	btree = usf_newbt();
+	twin = usf_newsk();
+	for (i = 0; i < TESTSZ * 4; i++) { /* Random mix against a skiplist */
+		index = usf_hash(i) % TESTSZ;
+		if (i % 3 == 2) usf_btdel(btree, index), usf_skdel(twin, index);
+		else usf_btset(btree, index, USFDATAU(index + 1)), usf_skset(twin, index, USFDATAU(index + 1));
+	}
+	for (i = 0; i < TESTSZ; i++) if (usf_btget(btree, i).u != usf_skget(twin, i).u) {
+		printf("btreetest: btree holds %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_btget(btree, i).u, i, usf_skget(twin, i).u);
+		exit(7);
+	}
+	if (btree->size != twin->size || checknode(btree->root, btree->depth, 0, U64_MAX) != twin->size) {
+		printf("btreetest: btree is malformed after random operations, aborting.\n");
+		exit(8);
+	}
+	printf("btreetest: random operations OK\n");
+
+	u64 sum, expected;
+	usf_memusage usage;
+	for (i = 0, expected = 0; i < TESTSZ; i++) if (i >= 100 && i <= 5000 && usf_skget(twin, i).u) expected += i;
+	sum = 0;
+	if (usf_btrange(btree, 100, 5000, rangesum, &sum) != usf_skrange(twin, 100, 5000, rangesum, &r) || sum != expected) {
+		printf("btreetest: btrange summed %"PRIu64" while expecting %"PRIu64", aborting.\n", sum, expected);
+		exit(9);
+	}
+	printf("btreetest: btrange OK\n");
+
+	usage = usf_btmemusage(btree);
+	if (usage.nodes != btree->nnodes * sizeof(usf_btnode) || usage.total < usage.nodes + sizeof(usf_btree)) {
+		printf("btreetest: btmemusage reported %"PRIu64" bytes of nodes, aborting.\n", usage.nodes);
+		exit(10);
+	}
+	printf("btreetest: btmemusage OK\n");
+	usf_freebt(btree);
+	usf_freesk(twin);
+
+	u64 indices[TESTSZ / 4];
+	usf_data sorted[TESTSZ / 4];
+	for (i = 0; i < TESTSZ / 4; i++) indices[i] = i * 4, sorted[i] = USFDATAU(i);
+	btree = usf_btfromsorted(indices, sorted, TESTSZ / 4);
+	if (btree == NULL || btree->size != TESTSZ / 4 || checknode(btree->root, btree->depth, 0, U64_MAX) != TESTSZ / 4) {
+		printf("btreetest: btfromsorted built a malformed btree, aborting.\n");
+		exit(11);
+	}
+	for (i = 0; i < TESTSZ; i += 8) usf_btdel(btree, i);
+	for (i = 2; i < TESTSZ; i += 8) usf_btset(btree, i, USFDATAU(i / 4));
+	for (i = 0; i < TESTSZ; i++) if (usf_btget(btree, i).u != (i % 8 == 4 || i % 8 == 2 ? i / 4 : 0)) {
+		printf("btreetest: btfromsorted btree holds bad value %"PRIu64" at %"PRIu64", aborting.\n",
+				usf_btget(btree, i).u, i);
+		exit(12);
+	}
+	usf_freebt(btree);
+	indices[1] = indices[0];
+	if (usf_btfromsorted(indices, sorted, TESTSZ / 4) != NULL) {
+		printf("btreetest: btfromsorted accepted unsorted indices, aborting.\n");
+		exit(13);
+	}
+	printf("btreetest: btfromsorted OK\n");
+
+	/* CONCURRENT TESTS */
+	printf("btreetest: Starting concurrency test!\n");
+	btree = usf_newbt_ts();
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) usf_btset(btree, i, USFDATAU(i));
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) if (usf_btget(btree, i).u != i) {
+		printf("btreetest: btree contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_btget(btree, i).u, i);
+		exit(14);
+	}
+	printf("btreetest: btset OK\n");
+	printf("btreetest: btget OK\n");
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i += 2) if (usf_btdel(btree, i).u != i) {
+		printf("btreetest: btdel returned bad value while expecting %"PRIu64", aborting.\n", i);
+		exit(15);
+	}
+	if (btree->size != TESTSZ / 2 || checknode(btree->root, btree->depth, 0, U64_MAX) != TESTSZ / 2) {
+		printf("btreetest: btree is malformed after concurrent deletions, aborting.\n");
+		exit(16);
+	}
+	printf("btreetest: btdel OK\n");
+	usf_freebt(btree);
+
+	/* PERFORMANCE TESTS */
+	printf("btreetest: Starting performance tests!\n");
+	struct timespec start, end;
+	f64 time;
+	u64 randvals[PERFSZ], cyclesz, ncycles;
+	for (i = 0; i < PERFSZ; i++) randvals[i] = usf_hash((u64) rand());
+
+	for (ncycles = time = 0, cyclesz = 16; cyclesz < PERFSZ; cyclesz <<= 1) {
+		btree = usf_newbt();
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < cyclesz; i++) usf_btset(btree, randvals[i], USFDATAU(i));
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		usf_freebt(btree);
+
+		time += usf_elapsedtimens(start, end);
+		ncycles += cyclesz;
+	}
+	printf("btreetest: btset: %f ns (max sample sz %d).\n", time / ncycles, PERFSZ);
+
+	btree = usf_newbt(); /* Dummy btree */
+	for (i = 0; i < PERFSZ; i++) usf_btset(btree, randvals[i], USFDATAU(i));
+
+	for (ncycles = time = 0, cyclesz = 16; cyclesz < PERFSZ; cyclesz <<= 1) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < cyclesz; i++) usf_btget(btree, randvals[i]);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		time += usf_elapsedtimens(start, end);
+		ncycles += cyclesz;
+	}
+	printf("btreetest: btget: %f ns (max sample sz %d).\n", time / ncycles, PERFSZ);
+	usf_freebt(btree);
+
+	for (ncycles = time = 0, cyclesz = 16; cyclesz < PERFSZ; cyclesz <<= 1) {
+		btree = usf_newbt();
+		for (i = 0; i < cyclesz; i++) usf_btset(btree, randvals[i], USFDATAU(i));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < cyclesz; i++) usf_btdel(btree, randvals[i]);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		usf_freebt(btree);
+
+		time += usf_elapsedtimens(start, end);
+		ncycles += cyclesz;
+	}
+	printf("btreetest: btdel: %f ns (max sample sz %d).\n", time / ncycles, PERFSZ);
+
+	u64 perfindices[PERFSZ];
+	usf_data perfdata[PERFSZ];
+	for (i = 0; i < PERFSZ; i++) perfindices[i] = i * 2, perfdata[i] = USFDATAU(i);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	btree = usf_btfromsorted(perfindices, perfdata, PERFSZ);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("btreetest: btfromsorted: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = sum = 0; i < PERFSZ; i += WINDOWSZ) usf_btrange(btree, i, i + WINDOWSZ - 1, rangesum, &sum);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freebt(btree);
+	printf("btreetest: btrange: %f ns per index (window sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, WINDOWSZ);
+
+	printf("btreetest: usfbtree OK (ALL TESTS PASSED)\n");
+	return 0;
+}
+
+static void rangesum(u64 index, usf_data data, void *context) {
+	(void) data;
+	*(u64 *) context += index;
+}
+
+static u64 checknode(const usf_btnode *node, u64 depth, u64 lo, u64 hi) {
+	/* Returns the number of elements under node, or exits if its keys are out of
+	 * order, outside of [lo, hi], badly padded, or its leaves are at uneven depths */
+
+	u64 count;
+	u32 k;
+	if (node == NULL) return 0;
+	if (node->leaf != (depth == 0)) exit(100);
+	for (k = 0; k < USF_BTREE_NKEYS; k++) {
+		if (k >= node->nkeys ? node->keys[k] != U64_MAX
+				: node->keys[k] < lo || node->keys[k] > hi || (k && node->keys[k] <= node->keys[k - 1])) exit(101);
+	}
+	if (node->leaf) return node->nkeys;
+
+	for (k = 0, count = 0; k <= node->nkeys; k++)
+		count += checknode(node->children[k], depth - 1, k ? node->keys[k - 1] : lo, k < node->nkeys ? node->keys[k] - 1 : hi);
+	return count;
+}
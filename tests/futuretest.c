@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include "usffuture.h"
+#include "usftime.h"
+
+#define TESTSZ 64
+#define PERFSZ 100000
+
+static usf_data square(void *arg);
+static usf_data increment(usf_data value, void *arg);
+static usf_data delayed(void *arg);
+
+i32 main(void) {
+	/* usffuture.c test */
+
+	u64 i, r;
+	usf_future *future, *chained, *futures[TESTSZ];
+
+	/* NORMAL TESTS */
+
+	printf("futuretest: Starting test!\n");
+	future = usf_newfuture();
+
+	if (usf_futureready(future)) {
+		printf("futuretest: new future is already ready, aborting.\n");
+		exit(1);
+	}
+	struct timespec timeout;
+	timespec_get(&timeout, TIME_UTC);
+	timeout.tv_nsec += 1000000; /* 1 ms */
+	if (timeout.tv_nsec >= 1000000000) timeout.tv_sec++, timeout.tv_nsec -= 1000000000;
+	if (usf_futuretimedwait(future, &timeout) != THRD_TIMEOUT) {
+		printf("futuretest: futuretimedwait on a pending future did not time out, aborting.\n");
+		exit(2);
+	}
+	printf("futuretest: futuretimedwait OK\n");
+
+	chained = usf_futurethen(future, increment, NULL);
+	usf_futureset(future, USFDATAU(41));
+	usf_futureset(future, USFDATAU(0));
+	if ((r = usf_futureget(future).u) != 41) {
+		printf("futuretest: futureset overwrote a ready future (got %"PRIu64"), aborting.\n", r);
+		exit(3);
+	}
+	printf("futuretest: futureset OK\n");
+	printf("futuretest: futureget OK\n");
+
+	if ((r = usf_futureget(chained).u) != 42) {
+		printf("futuretest: futurethen returned bad value %"PRIu64" while expecting 42, aborting.\n", r);
+		exit(4);
+	}
+	usf_freefuture(chained);
+	chained = usf_futurethen(future, increment, NULL); /* Already ready */
+	if ((r = usf_futureget(chained).u) != 42) {
+		printf("futuretest: futurethen on a ready future returned bad value %"PRIu64", aborting.\n", r);
+		exit(5);
+	}
+	usf_freefuture(chained);
+	usf_freefuture(future);
+	printf("futuretest: futurethen OK\n");
+
+	/* CONCURRENT TESTS */
+
+	printf("futuretest: Starting concurrency test!\n");
+	for (i = 0; i < TESTSZ; i++) futures[i] = usf_async(square, (void *) (uintptr_t) i);
+	for (i = 0; i < TESTSZ; i++) if ((r = usf_futureget(futures[i]).u) != i * i) {
+		printf("futuretest: async returned bad value %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				r, i * i);
+		exit(6);
+	}
+	printf("futuretest: async OK\n");
+
+	future = usf_futurewhenall(futures, TESTSZ); /* All ready */
+	if ((r = usf_futureget(future).u) != TESTSZ) {
+		printf("futuretest: futurewhenall returned bad value %"PRIu64", aborting.\n", r);
+		exit(7);
+	}
+	usf_freefuture(future);
+	for (i = 0; i < TESTSZ; i++) usf_freefuture(futures[i]);
+
+	for (i = 0; i < TESTSZ; i++) futures[i] = usf_async(delayed, (void *) (uintptr_t) i);
+	chained = usf_futurewhenany(futures, TESTSZ);
+	future = usf_futurewhenall(futures, TESTSZ);
+	if ((r = usf_futureget(chained).u) >= TESTSZ) {
+		printf("futuretest: futurewhenany returned bad index %"PRIu64", aborting.\n", r);
+		exit(8);
+	}
+	if ((r = usf_futureget(future).u) != TESTSZ) {
+		printf("futuretest: futurewhenall returned bad value %"PRIu64", aborting.\n", r);
+		exit(9);
+	}
+	for (i = 0; i < TESTSZ; i++) if (!usf_futureready(futures[i])) {
+		printf("futuretest: futurewhenall was set before future %"PRIu64", aborting.\n", i);
+		exit(10);
+	}
+	usf_freefuture(chained);
+	usf_freefuture(future);
+	for (i = 0; i < TESTSZ; i++) usf_freefuture(futures[i]);
+	printf("futuretest: futurewhenany OK\n");
+	printf("futuretest: futurewhenall OK\n");
+
+	futures[0] = usf_newfuture(); /* Freed with continuations pending */
+	futures[1] = usf_newfuture();
+	chained = usf_futurethen(futures[0], increment, NULL);
+	futures[2] = usf_futurewhenall(futures, 2);
+	futures[3] = usf_futurewhenany(futures, 2);
+	usf_freefuture(futures[0]);
+	usf_futureset(futures[1], USFDATAU(0));
+	if (usf_futureready(chained) || usf_futureready(futures[2])) {
+		printf("futuretest: continuation of a freed future was run, aborting.\n");
+		exit(11);
+	}
+	if ((r = usf_futureget(futures[3]).u) != 1) {
+		printf("futuretest: futurewhenany returned bad index %"PRIu64" while expecting 1, aborting.\n", r);
+		exit(12);
+	}
+	usf_freefuture(chained);
+	for (i = 1; i < 4; i++) usf_freefuture(futures[i]);
+	printf("futuretest: freefuture OK\n");
+
+	/* PERFORMANCE TESTS */
+
+	printf("futuretest: Starting performance tests!\n");
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) {
+		future = usf_newfuture();
+		usf_futureset(future, USFDATAU(i));
+		usf_futureget(future);
+		usf_freefuture(future);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("futuretest: futureset + futureget: %f ns (sample sz %d).\n",
+			usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	usf_future **chain;
+	chain = usf_malloc(sizeof(usf_future *) * (PERFSZ + 1));
+	chain[0] = usf_newfuture();
+	for (i = 0; i < PERFSZ; i++) chain[i + 1] = usf_futurethen(chain[i], increment, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_futureset(chain[0], USFDATAU(0));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if ((r = usf_futureget(chain[PERFSZ]).u) != PERFSZ) {
+		printf("futuretest: futurethen chain returned bad value %"PRIu64", aborting.\n", r);
+		exit(13);
+	}
+	for (i = 0; i <= PERFSZ; i++) usf_freefuture(chain[i]);
+	usf_free(chain);
+	printf("futuretest: futurethen: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	printf("futuretest: usffuture OK (ALL TESTS PASSED)\n");
+	return 0;
+}
+
+static usf_data square(void *arg) { return USFDATAU((u64) (uintptr_t) arg * (u64) (uintptr_t) arg); }
+static usf_data increment(usf_data value, void *arg) { (void) arg; return USFDATAU(value.u + 1); }
+static usf_data delayed(void *arg) {
+	struct timespec delay = { .tv_sec = 0, .tv_nsec = 1000 * (i64) (uintptr_t) arg };
+	usf_thrdsleep(&delay, NULL);
+	return USFDATAP(arg);
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include "usfgaplist.h"
+#include "usflist.h"
+#include "usfmath.h"
+#include "usftime.h"
+
+#define TESTSZ 100000
+#define PERFSZ 100000
+#define EDITSZ 1000
+
+i32 main(void) {
+	/* usfgaplist.c test */
+
+	u64 i, r, index;
+	usf_gaplistu64 *list;
+	usf_listu64 *twin;
+
+	/* NORMAL TESTS */
+
+	printf("gaplisttest: Starting test!\n");
+	list = usf_newgaplistu64();
+
+	for (i = 0; i < TESTSZ; i++) usf_gaplistu64add(list, i);
+	for (i = 0; i < TESTSZ; i++) if (usf_gaplistu64get(list, i) != i) {
+		printf("gaplisttest: gaplist contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_gaplistu64get(list, i), i);
+		exit(1);
+	}
+	if (usf_gaplistu64get(list, TESTSZ) != 0 || usf_gaplistu64set(list, TESTSZ + 1, 7) != NULL
+			|| usf_gaplistu64ins(list, TESTSZ + 1, 7) != NULL || usf_gaplistu64seek(list, TESTSZ + 1) != NULL) {
+		printf("gaplisttest: gaplist accepted an index past its size, aborting.\n");
+		exit(2);
+	}
+	printf("gaplisttest: gaplistadd OK\n");
+	printf("gaplisttest: gaplistget OK\n");
+
+	for (i = 0; i < TESTSZ; i++) usf_gaplistu64set(list, i, i * 3);
+	usf_gaplistu64seek(list, TESTSZ / 2);
+	for (i = 0; i < TESTSZ; i++) if (usf_gaplistu64get(list, i) != i * 3) {
+		printf("gaplisttest: gaplistset left bad value %"PRIu64" at %"PRIu64", aborting.\n",
+				usf_gaplistu64get(list, i), i);
+		exit(3);
+	}
+	printf("gaplisttest: gaplistset OK\n");
+	printf("gaplisttest: gaplistseek OK\n");
+
+	for (i = 0; i < TESTSZ; i += 2) if ((r = usf_gaplistu64del(list, i / 2)) != i * 3) {
+		printf("gaplisttest: gaplistdel returned bad value %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				r, i * 3);
+		exit(4);
+	}
+	if (list->size != TESTSZ / 2 || usf_gaplistu64del(list, TESTSZ / 2) != 0) {
+		printf("gaplisttest: gaplist holds %"PRIu64" elements after deleting half of them, aborting.\n", list->size);
+		exit(5);
+	}
+	printf("gaplisttest: gaplistdel OK\n");
+	usf_freegaplistu64(list);
+
+	list = usf_newgaplistu64sz(4);
+	twin = usf_newlistu64();
+	for (i = 0; i < TESTSZ * 2; i++) { /* Random mix against a list */
+		index = twin->size ? usf_hash(i) % (twin->size + 1) : 0;
+		if (i % 3 == 2 && twin->size) usf_gaplistu64del(list, index % twin->size), usf_listu64del(twin, index % twin->size);
+		else if (i % 5 == 4 && index < twin->size) usf_gaplistu64set(list, index, i), usf_listu64set(twin, index, i);
+		else usf_gaplistu64ins(list, index, i), usf_listu64ins(twin, index, i);
+	}
+	if (list->size != twin->size || list->gap > list->size || list->size > list->capacity) {
+		printf("gaplisttest: gaplist is malformed after random operations, aborting.\n");
+		exit(6);
+	}
+	for (i = 0; i < twin->size; i++) if (usf_gaplistu64get(list, i) != usf_listu64get(twin, i)) {
+		printf("gaplisttest: gaplist holds %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_gaplistu64get(list, i), i, usf_listu64get(twin, i));
+		exit(7);
+	}
+	printf("gaplisttest: random operations OK\n");
+
+	u64 copied[TESTSZ];
+	usf_memusage usage;
+	usf_gaplistu64seek(list, list->size / 3);
+	if (usf_gaplistu64copy(list, 10, TESTSZ, copied) != list->size - 10 || usf_gaplistu64copy(list, list->size, 1, copied)) {
+		printf("gaplisttest: gaplistcopy copied a bad number of elements, aborting.\n");
+		exit(8);
+	}
+	for (i = 10; i < twin->size; i++) if (copied[i - 10] != usf_listu64get(twin, i)) {
+		printf("gaplisttest: gaplistcopy copied %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				copied[i - 10], i, usf_listu64get(twin, i));
+		exit(9);
+	}
+	printf("gaplisttest: gaplistcopy OK\n");
+
+	usage = usf_gaplistu64memusage(list);
+	if (usage.array != list->size * sizeof(u64) || usage.slack != (list->capacity - list->size) * sizeof(u64)
+			|| usage.total < usage.array + usage.slack + sizeof(usf_gaplistu64)) {
+		printf("gaplisttest: gaplistmemusage reported %"PRIu64" bytes of elements, aborting.\n", usage.array);
+		exit(10);
+	}
+	printf("gaplisttest: gaplistmemusage OK\n");
+	usf_freegaplistu64(list);
+	usf_freelistu64(twin);
+
+	/* CONCURRENT TESTS */
+	printf("gaplisttest: Starting concurrency test!\n");
+	list = usf_newgaplistu64_ts();
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) usf_gaplistu64ins(list, 0, 1);
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) usf_gaplistu64set(list, i, i);
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) if (usf_gaplistu64get(list, i) != i) {
+		printf("gaplisttest: gaplist contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_gaplistu64get(list, i), i);
+		exit(11);
+	}
+	printf("gaplisttest: gaplistins OK\n");
+	printf("gaplisttest: gaplistset OK\n");
+	printf("gaplisttest: gaplistget OK\n");
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ / 2; i++) usf_gaplistu64del(list, 0);
+	if (list->size != TESTSZ / 2) {
+		printf("gaplisttest: gaplist holds %"PRIu64" elements after concurrent deletions, aborting.\n", list->size);
+		exit(12);
+	}
+	printf("gaplisttest: gaplistdel OK\n");
+	usf_freegaplistu64(list);
+
+	/* PERFORMANCE TESTS */
+	printf("gaplisttest: Starting performance tests!\n");
+	struct timespec start, end;
+	f64 time;
+	list = usf_newgaplistu64();
+	twin = usf_newlistu64();
+	for (i = 0; i < PERFSZ; i++) usf_gaplistu64add(list, i), usf_listu64add(twin, i);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < EDITSZ; i++) usf_gaplistu64ins(list, PERFSZ / 2 + i, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("gaplisttest: gaplistins at a cursor: %f ns (list sz %d).\n", time / EDITSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < EDITSZ; i++) usf_listu64ins(twin, PERFSZ / 2 + i, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("gaplisttest: listins at a cursor: %f ns (list sz %d).\n", time / EDITSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < EDITSZ; i++) usf_gaplistu64ins(list, usf_hash(i) % list->size, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("gaplisttest: gaplistins at random: %f ns (list sz %d).\n", time / EDITSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) usf_gaplistu64get(list, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("gaplisttest: gaplistget: %f ns (list sz %d).\n", time / PERFSZ, PERFSZ);
+	usf_freegaplistu64(list);
+	usf_freelistu64(twin);
+
+	printf("gaplisttest: usfgaplist OK (ALL TESTS PASSED)\n");
+	return 0;
+}
@@ -6,6 +6,12 @@
 #define TESTSZ 100000
 #define PERFSZ 100000
 
+i64 outstanding_; /* Bytes held from the counting allocator */
+
+static void *countalloc(void *context, u64 size);
+static void *countrealloc(void *context, void *pointer, u64 oldsize, u64 newsize);
+static void countfree(void *context, void *pointer, u64 size);
+
 i32 main(void) {
 	/* usfhashmap.c test */
 
@@ -134,6 +140,66 @@ i32 main(void) {
 
 	usf_freehm(hashmap);
 
+	usf_allocator counting = { countalloc, countrealloc, countfree, NULL };
+	outstanding_ = 0;
+	hashmap = usf_newhm_ts_alloc(&counting);
+	for (i = 0; i < TESTSZ; i++) sprintf(s, "%"PRIu64, i), usf_strhmput(hashmap, s, USFDATAU(i));
+	for (i = 0; i < TESTSZ; i += 2) sprintf(s, "%"PRIu64, i), usf_strhmdel(hashmap, s);
+	usf_freehm(hashmap);
+	if (outstanding_ != 0) {
+		printf("hashmaptest: allocator has %"PRIi64" bytes outstanding after freehm, aborting.\n", outstanding_);
+		exit(8);
+	}
+	printf("hashmaptest: newhm_alloc OK\n");
+
+	usf_memtag *tag;
+	usf_memusage usage;
+	tag = usf_newmemtag("hashmaptest", NULL);
+	hashmap = usf_newhm_ts_alloc(&tag->allocator);
+	for (i = 0; i < TESTSZ; i++) sprintf(s, "%"PRIu64, i), usf_strhmput(hashmap, s, USFDATAU(i));
+	usage = usf_hmmemusage(hashmap);
+	if (usage.total != usf_memtagstats(tag).bytes || usage.array != TESTSZ * sizeof(usf_hashentry)
+			|| usage.keys == 0 || usage.locks != sizeof(usf_mutex)) {
+		printf("hashmaptest: hmmemusage reported %"PRIu64" bytes while the tag counted %"PRIu64", aborting.\n",
+				usage.total, usf_memtagstats(tag).bytes);
+		exit(15);
+	}
+	usf_freehm(hashmap);
+	if (usf_memtagstats(tag).bytes != 0 || usf_memtagstats(tag).allocations != usf_memtagstats(tag).frees) {
+		printf("hashmaptest: memtag has %"PRIu64" bytes outstanding after freehm, aborting.\n",
+				usf_memtagstats(tag).bytes);
+		exit(16);
+	}
+	usf_freememtag(tag);
+
+	usf_memstats before;
+	usf_memtrack(1);
+	before = usf_memglobal();
+	hashmap = usf_newhm();
+	for (i = 0; i < TESTSZ; i++) usf_inthmput(hashmap, i, USFDATAU(i));
+	if (usf_memglobal().bytes - before.bytes != usf_hmmemusage(hashmap).total) {
+		printf("hashmaptest: memglobal counted %"PRIu64" bytes while expecting %"PRIu64", aborting.\n",
+				usf_memglobal().bytes - before.bytes, usf_hmmemusage(hashmap).total);
+		exit(17);
+	}
+	usf_freehm(hashmap);
+	usf_memtrack(0);
+	printf("hashmaptest: hmmemusage OK\n");
+
+	hashmap = usf_newhm_alloc(&usf_hugepageallocator);
+	for (i = 0; i < TESTSZ * 8; i++) usf_inthmput(hashmap, i, USFDATAU(i));
+	for (i = 0; i < TESTSZ * 8; i++) if (usf_inthmget(hashmap, i).u != i) {
+		printf("hashmaptest: huge page hashmap lost value %"PRIu64", aborting.\n", i);
+		exit(18);
+	}
+	if ((uintptr_t) hashmap->array % (hashmap->capacity * sizeof(usf_hashentry) >= USF_ALLOC_HUGEPAGE
+			? USF_ALLOC_HUGEPAGE : USF_ALLOC_CACHELINE)) {
+		printf("hashmaptest: huge page hashmap array is misaligned after growing, aborting.\n");
+		exit(18);
+	}
+	usf_freehm(hashmap);
+	printf("hashmaptest: newhm_alloc with huge pages OK\n");
+
 	/* CONCURRENT TESTS */
 	printf("hashmaptest: Starting concurrency test!\n");
 	hashmap = usf_newhm_ts();
@@ -269,3 +335,21 @@ i32 main(void) {
 	printf("hashmaptest: usfhashmap OK (ALL TESTS PASSED)\n");
 	return 0;
 }
+
+static void *countalloc(void *context, u64 size) {
+	(void) context;
+	outstanding_ += (i64) size;
+	return usf_malloc(size);
+}
+
+static void *countrealloc(void *context, void *pointer, u64 oldsize, u64 newsize) {
+	(void) context;
+	outstanding_ += (i64) newsize - (i64) oldsize;
+	return usf_realloc(pointer, newsize);
+}
+
+static void countfree(void *context, void *pointer, u64 size) {
+	(void) context;
+	outstanding_ -= (i64) size;
+	usf_free(pointer);
+}
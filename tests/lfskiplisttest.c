@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include "usflfskiplist.h"
+#include "usfskiplist.h"
+#include "usftime.h"
+
+#define TESTSZ 100000
+#define PERFSZ 100000
+#define NTHREADS 8
+
+typedef struct workerarg {
+	usf_lfskiplist *lfskiplist;
+	usf_skiplist *skiplist;
+	u64 id;
+} workerarg;
+
+static usf_compatibility_int stressworker(void *arg);
+static usf_compatibility_int lfperfworker(void *arg);
+static usf_compatibility_int perfworker(void *arg);
+
+i32 main(void) {
+	/* usflfskiplist.c test */
+
+	u64 i, r;
+	usf_lfskiplist *skiplist;
+
+	/* NORMAL TESTS */
+
+	printf("lfskiplisttest: Starting test!\n");
+	skiplist = usf_newlfsk();
+
+	for (i = 0; i < TESTSZ; i++) usf_lfskset(skiplist, i, USFDATAU(i));
+	for (i = 0; i < TESTSZ; i++) if (usf_lfskget(skiplist, i).u != i) {
+		printf("lfskiplisttest: skiplist contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_lfskget(skiplist, i).u, i);
+		exit(1);
+	}
+	printf("lfskiplisttest: lfskset OK\n");
+	printf("lfskiplisttest: lfskget OK\n");
+
+	for (i = 0; i < TESTSZ; i += 2) if ((r = usf_lfskdel(skiplist, i).u) != i) {
+		printf("lfskiplisttest: lfskdel returned bad value %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				r, i);
+		exit(2);
+	}
+	for (i = 0; i < TESTSZ; i++) if (usf_lfskget(skiplist, i).u != (i & 1 ? i : 0)) {
+		printf("lfskiplisttest: lfskdel left bad value %"PRIu64" at %"PRIu64", aborting.\n",
+				usf_lfskget(skiplist, i).u, i);
+		exit(3);
+	}
+	if (skiplist->size != TESTSZ / 2 || usf_lfskdel(skiplist, 0).u != 0) {
+		printf("lfskiplisttest: lfskiplist has size %"PRIu64" after deleting half of it, aborting.\n",
+				skiplist->size);
+		exit(4);
+	}
+	printf("lfskiplisttest: lfskdel OK\n");
+	usf_freelfsk(skiplist);
+
+	/* CONCURRENT TESTS */
+
+	printf("lfskiplisttest: Starting concurrency test!\n");
+	usf_thread threads[NTHREADS];
+	workerarg args[NTHREADS];
+	usf_compatibility_int result;
+	skiplist = usf_newlfsk();
+	for (i = 0; i < NTHREADS; i++) {
+		args[i] = (workerarg) { .lfskiplist = skiplist, .id = i };
+		usf_thrdcreate(&threads[i], stressworker, &args[i]);
+	}
+	for (i = r = 0; i < NTHREADS; i++) usf_thrdjoin(threads[i], &result), r |= (u64) result;
+	if (r) {
+		printf("lfskiplisttest: concurrent operations lost or corrupted a value, aborting.\n");
+		exit(5);
+	}
+
+	usf_lfskipnode *node, *prev;
+	for (i = 0; i < TESTSZ; i++) if (usf_lfskget(skiplist, i).u != (i % 4 == 3 ? i : 0)) {
+		printf("lfskiplisttest: lfskiplist holds %"PRIu64" at %"PRIu64" after the stress test, aborting.\n",
+				usf_lfskget(skiplist, i).u, i);
+		exit(6);
+	}
+	for (prev = NULL, node = (usf_lfskipnode *) (uintptr_t) skiplist->base[0], r = 0; node;
+			prev = node, node = (usf_lfskipnode *) (uintptr_t) node->nextnodes[0], r++)
+		if ((prev && prev->index >= node->index) || node->nextnodes[0] & 1) break;
+	if (node || r != TESTSZ / 4 || skiplist->size != TESTSZ / 4) {
+		printf("lfskiplisttest: level 0 holds %"PRIu64" nodes (size %"PRIu64") after the stress test, aborting.\n",
+				r, skiplist->size);
+		exit(7);
+	}
+	usf_freelfsk(skiplist);
+	printf("lfskiplisttest: concurrent set/get/del OK\n");
+
+	/* PERFORMANCE TESTS */
+
+	printf("lfskiplisttest: Starting performance tests!\n");
+	struct timespec start, end;
+	usf_skiplist *lockedskiplist;
+
+	skiplist = usf_newlfsk();
+	for (i = 0; i < PERFSZ; i++) usf_lfskset(skiplist, usf_hash(i) % PERFSZ, USFDATAU(i));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < NTHREADS; i++) {
+		args[i] = (workerarg) { .lfskiplist = skiplist, .id = i };
+		usf_thrdcreate(&threads[i], lfperfworker, &args[i]);
+	}
+	for (i = 0; i < NTHREADS; i++) usf_thrdjoin(threads[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freelfsk(skiplist);
+	printf("lfskiplisttest: lfskget/lfskset (%d threads): %f ns (sample sz %d).\n",
+			NTHREADS, usf_elapsedtimens(start, end) / (PERFSZ * NTHREADS), PERFSZ);
+
+	lockedskiplist = usf_newsk_ts();
+	for (i = 0; i < PERFSZ; i++) usf_skset(lockedskiplist, usf_hash(i) % PERFSZ, USFDATAU(i));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < NTHREADS; i++) {
+		args[i] = (workerarg) { .skiplist = lockedskiplist, .id = i };
+		usf_thrdcreate(&threads[i], perfworker, &args[i]);
+	}
+	for (i = 0; i < NTHREADS; i++) usf_thrdjoin(threads[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freesk(lockedskiplist);
+	printf("lfskiplisttest: skget/skset with mutex (%d threads): %f ns (sample sz %d).\n",
+			NTHREADS, usf_elapsedtimens(start, end) / (PERFSZ * NTHREADS), PERFSZ);
+
+	printf("lfskiplisttest: usflfskiplist OK (ALL TESTS PASSED)\n");
+	return 0;
+}
+
+static usf_compatibility_int stressworker(void *arg) {
+	/* Every thread inserts all indices congruent to its id modulo NTHREADS, then all threads
+	 * race to delete even indices, overwrite and delete indices 1 mod 4, and read the rest */
+	workerarg *args;
+	u64 i, r;
+	args = arg;
+	for (i = args->id; i < TESTSZ; i += NTHREADS) usf_lfskset(args->lfskiplist, i, USFDATAU(i));
+	for (i = 0; i < TESTSZ; i++) {
+		switch (i % 4) {
+			case 0: case 2:
+				if ((r = usf_lfskdel(args->lfskiplist, i).u) != 0 && r != i) return 1;
+				break;
+			case 1:
+				usf_lfskset(args->lfskiplist, i, USFDATAU(i));
+				usf_lfskdel(args->lfskiplist, i);
+				break;
+			case 3:
+				if ((r = usf_lfskget(args->lfskiplist, i).u) != 0 && r != i) return 1;
+				break;
+		}
+	}
+	for (i = 3; i < TESTSZ; i += 4) usf_lfskset(args->lfskiplist, i, USFDATAU(i));
+	return 0;
+}
+
+static usf_compatibility_int lfperfworker(void *arg) {
+	workerarg *args;
+	u64 i, key;
+	args = arg;
+	for (i = 0; i < PERFSZ; i++) {
+		key = usf_hash(i + args->id * PERFSZ) % PERFSZ;
+		if (i % 8) usf_lfskget(args->lfskiplist, key);
+		else usf_lfskset(args->lfskiplist, key, USFDATAU(i));
+	}
+	return 0;
+}
+
+static usf_compatibility_int perfworker(void *arg) {
+	workerarg *args;
+	u64 i, key;
+	args = arg;
+	for (i = 0; i < PERFSZ; i++) {
+		key = usf_hash(i + args->id * PERFSZ) % PERFSZ;
+		if (i % 8) usf_skget(args->skiplist, key);
+		else usf_skset(args->skiplist, key, USFDATAU(i));
+	}
+	return 0;
+}
@@ -4,11 +4,22 @@
 
 #define TESTSZ 40000
 #define PERFSZ 40000
+#define NTHREADS 8
+
+typedef struct workerarg {
+	usf_listu64 *list;
+	u64 id;
+} workerarg;
 
 u64 freeindex_;
 u64 freedvalues_[TESTSZ];
+u8 ccdone_; /* Stops ccgetter threads */
 
 static void freevalues(u64 value);
+static usf_compatibility_int ccadder(void *arg);
+static usf_compatibility_int ccreader(void *arg);
+static usf_compatibility_int ccshrinker(void *arg);
+static usf_compatibility_int ccgetter(void *arg);
 
 i32 main(void) {
 	/* usflist.c test
@@ -66,6 +77,220 @@ i32 main(void) {
 	}
 	printf("listtest: listdel OK\n");
 
+	u64 values[TESTSZ];
+	usf_listu64 *other;
+	for (i = 0; i < TESTSZ; i++) values[i] = i;
+	list = usf_newlistu64();
+	usf_listu64add(list, 0);
+	usf_listu64addn(list, values + 1, TESTSZ - 1);
+	usf_listu64addn(list, values, 0);
+	for (i = 0; i < TESTSZ; i++) if (list->array[i] != i || list->size != TESTSZ) {
+		printf("listtest: listaddn left bad value %"PRIu64" at %"PRIu64", aborting.\n", list->array[i], i);
+		exit(7);
+	}
+	printf("listtest: listaddn OK\n");
+
+	other = usf_newlistu64();
+	usf_listu64addn(other, values, TESTSZ / 2);
+	usf_listu64extend(list, other);
+	usf_listu64extend(other, other);
+	for (i = 0; i < TESTSZ / 2; i++) {
+		if (list->array[TESTSZ + i] != i || other->array[TESTSZ / 2 + i] != i) {
+			printf("listtest: listextend left bad value at %"PRIu64", aborting.\n", i);
+			exit(8);
+		}
+	}
+	if (list->size != TESTSZ + TESTSZ / 2 || other->size != TESTSZ) {
+		printf("listtest: listextend left a list of size %"PRIu64", aborting.\n", list->size);
+		exit(8);
+	}
+	usf_freelistu64(other);
+	printf("listtest: listextend OK\n");
+
+	usf_listu64shrink(list);
+	if (list->capacity != list->size || list->array[list->size - 1] != TESTSZ / 2 - 1) {
+		printf("listtest: listshrink left capacity %"PRIu64" for size %"PRIu64", aborting.\n",
+				list->capacity, list->size);
+		exit(9);
+	}
+	usf_listu64reserve(list, TESTSZ * 4);
+	usf_listu64set(list, TESTSZ * 3, 1);
+	if (list->capacity != TESTSZ * 4 || list->array[TESTSZ * 2] != 0 || list->array[TESTSZ * 3] != 1) {
+		printf("listtest: listreserve left capacity %"PRIu64" or nonzero unused elements, aborting.\n",
+				list->capacity);
+		exit(10);
+	}
+	while (list->size) usf_listu64del(list, list->size - 1);
+	usf_listu64shrink(list);
+	usf_listu64add(list, 5);
+	if (list->size != 1 || list->array[0] != 5) {
+		printf("listtest: list cannot grow back after being shrunk empty, aborting.\n");
+		exit(9);
+	}
+	usf_freelistu64(list);
+	printf("listtest: listreserve/listshrink OK\n");
+
+	usf_listu64 *twin;
+	usf_listi32 *signedlist;
+	usf_listf32 *floatlist;
+	list = usf_newlistu64();
+	twin = usf_newlistu64();
+	for (i = 0; i < TESTSZ; i++) usf_listu64add(list, usf_hash(i) >> (i % 64)); /* All digit widths */
+	usf_listu64extend(twin, list);
+	usf_listu64sort(list);
+	for (i = 1; i < TESTSZ; i++) if (list->array[i - 1] > list->array[i]) {
+		printf("listtest: listsort left %"PRIu64" before %"PRIu64", aborting.\n", list->array[i - 1], list->array[i]);
+		exit(13);
+	}
+	signedlist = usf_newlisti32();
+	floatlist = usf_newlistf32();
+	for (i = 0; i < TESTSZ; i++) {
+		usf_listi32add(signedlist, (i32) (u32) usf_hash(i));
+		usf_listf32add(floatlist, (f32) (i32) (u32) usf_hash(i) / (f32) (i % 7 + 1));
+	}
+	usf_listi32sort(signedlist);
+	usf_listf32sort(floatlist);
+	for (i = 1; i < TESTSZ; i++) if (signedlist->array[i - 1] > signedlist->array[i]
+			|| floatlist->array[i - 1] > floatlist->array[i]) {
+		printf("listtest: listsort misordered negative values at %"PRIu64", aborting.\n", i);
+		exit(13);
+	}
+	usf_freelisti32(signedlist);
+	usf_freelistf32(floatlist);
+	printf("listtest: listsort OK\n");
+
+	usf_listu64sortby(twin, usf_indcmpu64);
+	if (memcmp(twin->array, list->array, TESTSZ * sizeof(u64))) {
+		printf("listtest: listsortby disagrees with listsort, aborting.\n");
+		exit(14);
+	}
+	for (i = 0; i < TESTSZ; i++) twin->array[i] = i % 3; /* Many duplicates */
+	usf_listu64sortby(twin, usf_indcmpu64);
+	for (i = 1; i < TESTSZ; i++) if (twin->array[i - 1] > twin->array[i]) {
+		printf("listtest: listsortby misordered duplicates at %"PRIu64", aborting.\n", i);
+		exit(14);
+	}
+	printf("listtest: listsortby OK\n");
+
+	for (i = 0; i < TESTSZ; i++) twin->array[i] = usf_hash(i) >> (i % 64);
+	usf_listu64psort(twin, NTHREADS);
+	if (memcmp(twin->array, list->array, TESTSZ * sizeof(u64))) {
+		printf("listtest: listpsort disagrees with listsort, aborting.\n");
+		exit(15);
+	}
+	usf_freelistu64(list);
+	usf_freelistu64(twin);
+	printf("listtest: listpsort OK\n");
+
+	u64 sum, count;
+	i64 signedsum;
+	f64 floatsum;
+	i8 low, high;
+	usf_listi8 *smalllist;
+	list = usf_newlistu64();
+	smalllist = usf_newlisti8();
+	floatlist = usf_newlistf32();
+	for (i = sum = count = 0, signedsum = 0, floatsum = 0; i < TESTSZ + 7; i++) { /* Odd size for the tails */
+		usf_listu64add(list, usf_hash(i) % 1000);
+		usf_listi8add(smalllist, (i8) (i % 201 - 100));
+		usf_listf32add(floatlist, (f32) (i % 11) - 5.5f);
+		sum += list->array[i];
+		count += list->array[i] == 7;
+		signedsum += smalllist->array[i];
+		floatsum += floatlist->array[i];
+	}
+	if (usf_listu64sum(list) != sum || usf_listi8sum(smalllist) != signedsum
+			|| usf_listf32sum(floatlist) != floatsum || usf_listu64count(list, 7) != count) {
+		printf("listtest: listsum or listcount disagrees with a scalar loop, aborting.\n");
+		exit(16);
+	}
+	usf_listi8minmax(smalllist, &low, &high);
+	if (low != -100 || high != 100 || usf_listi8min(smalllist) != -100 || usf_listf32max(floatlist) != 4.5f
+			|| usf_listu64min(list) != usf_arru64min(list->array, list->size)) {
+		printf("listtest: listminmax returned %d and %d, aborting.\n", low, high);
+		exit(16);
+	}
+	list->array[TESTSZ + 3] = 5000;
+	if (usf_listu64find(list, 5000) != TESTSZ + 3 || usf_listu64find(list, 5001) != U64_MAX
+			|| usf_arri8find(smalllist->array, smalllist->size, 100) != 200) {
+		printf("listtest: listfind returned a bad index, aborting.\n");
+		exit(17);
+	}
+	if (usf_listi8dot(smalllist, smalllist) != usf_arri8dot(smalllist->array, smalllist->array, TESTSZ + 7)
+			|| usf_arri8dot(smalllist->array, smalllist->array, 201) != 2 * 338350) {
+		printf("listtest: listdot returned a bad product, aborting.\n");
+		exit(17);
+	}
+	usf_freelistu64(list);
+	usf_freelisti8(smalllist);
+	usf_freelistf32(floatlist);
+	printf("listtest: listsum/listminmax/listcount/listfind/listdot OK\n");
+
+	list = usf_newlistu64map("listtest-map.bin", "w+");
+	if (list == NULL) {
+		printf("listtest: Couldn't create mapped list file \"listtest-map.bin\", aborting.\n");
+		exit(18);
+	}
+	for (i = 0; i < TESTSZ; i++) usf_listu64add(list, i * 3);
+	if (usf_listu64sync(list) == NULL) {
+		printf("listtest: listsync failed on a mapped list, aborting.\n");
+		exit(18);
+	}
+	usf_freelistu64(list);
+	list = usf_newlistu64map("listtest-map.bin", "r+");
+	if (list == NULL || list->size != TESTSZ) {
+		printf("listtest: mapped list did not persist its size, aborting.\n");
+		exit(19);
+	}
+	for (i = 0; i < TESTSZ; i++) if (list->array[i] != i * 3) {
+		printf("listtest: mapped list holds %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				list->array[i], i, i * 3);
+		exit(19);
+	}
+	while (list->size > TESTSZ / 2) usf_listu64del(list, list->size - 1);
+	usf_listu64shrink(list);
+	usf_freelistu64(list);
+	list = usf_newlistu64map("listtest-map.bin", "r");
+	if (list == NULL || list->size != TESTSZ / 2 || list->capacity != TESTSZ / 2
+			|| list->array[TESTSZ / 2 - 1] != (TESTSZ / 2 - 1) * 3) {
+		printf("listtest: mapped list did not shrink its file, aborting.\n");
+		exit(19);
+	}
+	usf_freelistu64(list);
+	if (usf_newlisti32map("listtest-map.bin", "r+") || usf_newlistu64map("listtest-none.bin", "r")) {
+		printf("listtest: mapped a list from a file that does not hold one, aborting.\n");
+		exit(20);
+	}
+	remove("listtest-map.bin");
+	printf("listtest: listmap/listsync OK\n");
+
+	usf_alignalloc *aligned;
+	aligned = usf_newalignalloc(4096, USF_ALLOC_HUGETLB); /* Falls back when no huge pages are reserved */
+	list = usf_newlistu64_alloc(&aligned->allocator);
+	for (i = 0; i < USF_ALLOC_HUGEPAGE / sizeof(u64) * 2; i++) {
+		usf_listu64add(list, i);
+		if ((uintptr_t) list->array % 4096) {
+			printf("listtest: aligned list array is misaligned at capacity %"PRIu64", aborting.\n", list->capacity);
+			exit(21);
+		}
+	}
+	for (i = 0; i < list->size; i++) if (list->array[i] != i) {
+		printf("listtest: aligned list lost value %"PRIu64" while growing, aborting.\n", i);
+		exit(21);
+	}
+	usf_listu64shrink(list);
+	if ((uintptr_t) list->array % USF_ALLOC_HUGEPAGE || list->array[list->size - 1] != list->size - 1) {
+		printf("listtest: huge page list array is misaligned after shrinking, aborting.\n");
+		exit(21);
+	}
+	usf_freelistu64(list);
+	usf_freealignalloc(aligned);
+	if (usf_newalignalloc(48, 0) != NULL) {
+		printf("listtest: newalignalloc accepted an alignment that is not a power of two, aborting.\n");
+		exit(21);
+	}
+	printf("listtest: aligned and huge page lists OK\n");
+
 	/* CONCURRENT TESTS */
 
 	printf("listtest: Starting concurrency test!\n");
@@ -95,6 +320,70 @@ i32 main(void) {
 
 	usf_freelistu64(list);
 
+	usf_thread threads[NTHREADS + 1];
+	workerarg args[NTHREADS];
+	usf_compatibility_int result;
+	u8 *seen;
+	list = usf_newlistu64sz_cc(16); /* Grows many times under readers */
+	usf_thrdcreate(&threads[NTHREADS], ccreader, list);
+	for (i = 0; i < NTHREADS; i++) {
+		args[i] = (workerarg) { .list = list, .id = i };
+		usf_thrdcreate(&threads[i], ccadder, &args[i]);
+	}
+	for (i = r = 0; i <= NTHREADS; i++) usf_thrdjoin(threads[i], &result), r |= (u64) result;
+	if (r || list->size != TESTSZ * 2) {
+		printf("listtest: concurrent list reader saw an unpublished element or size is %"PRIu64", aborting.\n",
+				list->size);
+		exit(11);
+	}
+	seen = calloc(TESTSZ * 2, 1);
+	for (i = 0; i < TESTSZ * 2; i++) if (list->array[i] == 0 || list->array[i] > TESTSZ * 2 || seen[list->array[i] - 1]++) {
+		printf("listtest: concurrent list lost or duplicated value %"PRIu64", aborting.\n", list->array[i]);
+		exit(12);
+	}
+	free(seen);
+	usf_freelistu64(list);
+	printf("listtest: concurrent listadd OK\n");
+
+	list = usf_newlistu64sz_cc(16); /* Shrunk over and over under adders */
+	usf_thrdcreate(&threads[NTHREADS], ccshrinker, list);
+	for (i = 0; i < NTHREADS; i++) {
+		args[i] = (workerarg) { .list = list, .id = i };
+		usf_thrdcreate(&threads[i], ccadder, &args[i]);
+	}
+	for (i = 0; i <= NTHREADS; i++) usf_thrdjoin(threads[i], &result);
+	seen = calloc(TESTSZ * 2, 1);
+	for (i = 0; i < list->size; i++) if (list->array[i] == 0 || list->array[i] > TESTSZ * 2 || seen[list->array[i] - 1]++) {
+		printf("listtest: concurrent list lost or duplicated value %"PRIu64" while shrinking, aborting.\n", list->array[i]);
+		exit(22);
+	}
+	if (list->size != TESTSZ * 2) {
+		printf("listtest: concurrent list holds %"PRIu64" values after adds racing shrinks, aborting.\n", list->size);
+		exit(22);
+	}
+	free(seen);
+	usf_freelistu64(list);
+	printf("listtest: concurrent listadd/listshrink OK\n");
+
+	list = usf_newlistu64sz_cc(1); /* Read at its end while it is deleted from and shrunk */
+	for (i = 0; i < NTHREADS; i++) usf_thrdcreate(&threads[i], ccgetter, list);
+	for (i = 1; i <= TESTSZ * 2; i++) {
+		usf_listu64add(list, i);
+		usf_listu64add(list, i);
+		usf_listu64shrink(list);
+		usf_listu64del(list, list->size - 1);
+		usf_listu64shrink(list);
+	}
+	__atomic_store_n(&ccdone_, 1, __ATOMIC_RELEASE);
+	for (i = r = 0; i < NTHREADS; i++) usf_thrdjoin(threads[i], &result), r |= (u64) result;
+	if (r || list->size != TESTSZ * 2 || list->capacity < list->size) {
+		printf("listtest: concurrent list reader saw a bad value or size is %"PRIu64", aborting.\n", list->size);
+		exit(23);
+	}
+	usf_freelistu64(list);
+	printf("listtest: concurrent listget/listdel/listshrink OK\n");
+	printf("listtest: concurrent listmax/listdot OK\n");
+
 	/* PERFORMANCE TESTS */
 
 	printf("listtest: Starting performance tests!\n");
@@ -139,6 +428,37 @@ i32 main(void) {
 	}
 	printf("listtest: listadd: %f ns (max sample size %d).\n", time / ncycles, PERFSZ);
 
+	for (ncycles = time = 0, cyclesz = 16; cyclesz < PERFSZ; cyclesz <<= 1) {
+		list = usf_newlistu64();
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		usf_listu64addn(list, randvals, cyclesz);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		usf_freelistu64(list);
+
+		time += usf_elapsedtimens(start, end);
+		ncycles += cyclesz;
+	}
+	printf("listtest: listaddn: %f ns per element (max sample size %d).\n", time / ncycles, PERFSZ);
+
+	list = usf_newlistu64_ts();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) usf_listu64add(list, randvals[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freelistu64(list);
+	printf("listtest: listadd thread-safe: %f ns (sample size %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	list = usf_newlistu64_cc();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) usf_listu64add(list, randvals[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("listtest: listadd concurrent: %f ns (sample size %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = r = 0; i < PERFSZ; i++) r += usf_listu64get(list, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freelistu64(list);
+	printf("listtest: listget concurrent: %f ns (sample size %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
 	list = usf_newlistu64(); /* Dummy list to get values on */
 	for (i = 0; i < PERFSZ; i++) usf_listu64set(list, i, randvals[i]);
 
@@ -164,8 +484,99 @@ i32 main(void) {
 
 	usf_freelistu64(list);
 
+	u64 sortvals[PERFSZ];
+	memcpy(sortvals, randvals, sizeof(sortvals));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	qsort(sortvals, PERFSZ, sizeof(u64), usf_indcmpu64);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("listtest: qsort (reference): %f ns per element (sample size %d).\n",
+			usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	list = usf_newlistu64();
+	usf_listu64addn(list, randvals, PERFSZ);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_listu64sortby(list, usf_indcmpu64);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("listtest: listsortby: %f ns per element (sample size %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	memcpy(list->array, randvals, sizeof(randvals));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_listu64sort(list);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("listtest: listsort: %f ns per element (sample size %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	memcpy(list->array, randvals, sizeof(randvals));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_listu64psort(list, NTHREADS);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("listtest: listpsort: %f ns per element (sample size %d, %d threads).\n",
+			usf_elapsedtimens(start, end) / PERFSZ, PERFSZ, NTHREADS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0, sum = 0; i < PERFSZ; i++) sum += list->array[i] == randvals[0];
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("listtest: scalar count (reference): %f ns per element (sample size %d).\n",
+			usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_listu64count(list, randvals[0]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("listtest: listcount: %f ns per element (sample size %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_listu64sum(list);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("listtest: listsum: %f ns per element (sample size %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+	usf_freelistu64(list);
+
 	printf("listtest: usflist OK (ALL TESTS PASSED)\n");
 	return 0;
 }
 
 static void freevalues(u64 value) { freedvalues_[freeindex_++] = value; }
+
+static usf_compatibility_int ccadder(void *arg) {
+	/* Every thread adds the values from 1 to TESTSZ * 2 congruent to its id + 1 modulo NTHREADS */
+	workerarg *args;
+	u64 i;
+	args = arg;
+	for (i = args->id + 1; i <= TESTSZ * 2; i += NTHREADS) usf_listu64add(args->list, i);
+	return 0;
+}
+
+static usf_compatibility_int ccreader(void *arg) {
+	/* Reads elements as they get published, none of which may still be unwritten */
+	usf_listu64 *list;
+	u64 i, size;
+	list = arg;
+	for (i = 0; i < TESTSZ * 2; usf_thrdyield()) {
+		size = __atomic_load_n(&list->size, __ATOMIC_ACQUIRE);
+		for (; i < size; i++) if (usf_listu64get(list, i) == 0) return 1;
+	}
+	return 0;
+}
+
+static usf_compatibility_int ccshrinker(void *arg) {
+	/* Shrinks the list until all adders are done, which must not take their slots from under them */
+	usf_listu64 *list;
+	list = arg;
+	while (__atomic_load_n(&list->size, __ATOMIC_ACQUIRE) < TESTSZ * 2) {
+		usf_listu64shrink(list);
+		usf_thrdyield();
+	}
+	return 0;
+}
+
+static usf_compatibility_int ccgetter(void *arg) {
+	/* Reads the last element of the list and reduces it until told to stop, never out of bounds */
+	usf_listu64 *list;
+	u64 size;
+	list = arg;
+	while (!__atomic_load_n(&ccdone_, __ATOMIC_ACQUIRE)) {
+		size = __atomic_load_n(&list->size, __ATOMIC_ACQUIRE);
+		if (size && usf_listu64get(list, size - 1) > TESTSZ * 2) return 1;
+		if (usf_listu64max(list) > TESTSZ * 2
+				|| usf_listu64dot(list, list) > ((u64) TESTSZ * 2 + 1) * TESTSZ * 2 * TESTSZ * 2) return 1;
+	}
+	return 0;
+}
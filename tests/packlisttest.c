@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include "usfpacklist.h"
+#include "usflist.h"
+#include "usfmath.h"
+#include "usftime.h"
+
+#define TESTSZ 100000
+#define PERFSZ 1000000
+
+i32 main(void) {
+	/* usfpacklist.c test */
+
+	u64 i, j, r, value, *values, *copied;
+	usf_packlist *list, *other, *result;
+
+	/* NORMAL TESTS */
+
+	printf("packlisttest: Starting test!\n");
+	list = usf_newpacklist();
+	values = malloc(TESTSZ * sizeof(u64));
+	copied = malloc(TESTSZ * sizeof(u64));
+
+	for (i = 0, value = 0; i < TESTSZ; i++) { /* Gaps of all widths, with runs of equal values */
+		value += i % 1000 == 999 ? U64(1) << (i / 1000 % 40) : i % 7 == 0 ? 0 : usf_hash(i) % 100;
+		values[i] = value;
+		usf_packlistadd(list, value);
+	}
+	for (i = 0; i < TESTSZ; i++) if (usf_packlistget(list, i) != values[i]) {
+		printf("packlisttest: packlist holds %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_packlistget(list, i), i, values[i]);
+		exit(1);
+	}
+	if (usf_packlistget(list, TESTSZ) != 0 || usf_packlistadd(list, values[TESTSZ - 1] - 1) != NULL || list->size != TESTSZ) {
+		printf("packlisttest: packlist accepted an unsorted value, aborting.\n");
+		exit(2);
+	}
+	printf("packlisttest: packlistadd OK\n");
+	printf("packlisttest: packlistget OK\n");
+
+	if (usf_packlistcopy(list, 0, TESTSZ + 1, copied) != TESTSZ || memcmp(copied, values, TESTSZ * sizeof(u64))
+			|| usf_packlistcopy(list, 1000, 333, copied) != 333 || memcmp(copied, values + 1000, 333 * sizeof(u64))) {
+		printf("packlisttest: packlistcopy decoded bad values, aborting.\n");
+		exit(3);
+	}
+	printf("packlisttest: packlistcopy OK\n");
+
+	for (i = 0; i < TESTSZ; i += 37) {
+		for (j = i; j && values[j - 1] == values[i]; j--); /* First of equal values */
+		if ((r = usf_packlistfind(list, values[i])) != j || (values[i] && usf_packlistfind(list, values[i] - 1) > j)) {
+			printf("packlisttest: packlistfind returned %"PRIu64" while expecting %"PRIu64", aborting.\n", r, j);
+			exit(4);
+		}
+	}
+	if (usf_packlistfind(list, values[TESTSZ - 1] + 1) != TESTSZ) {
+		printf("packlisttest: packlistfind found a value past the last one, aborting.\n");
+		exit(5);
+	}
+	printf("packlisttest: packlistfind OK\n");
+
+	usf_memusage usage;
+	usage = usf_packlistmemusage(list);
+	if (usage.array + usage.nodes > TESTSZ * sizeof(u64) / 2 || usage.array != list->datasize * sizeof(u64)) {
+		printf("packlisttest: packlist takes %"PRIu64" bytes for %d values, aborting.\n", usage.array + usage.nodes, TESTSZ);
+		exit(6);
+	}
+	printf("packlisttest: packlistmemusage OK\n");
+	usf_freepacklist(list);
+
+	usf_listu64 *expected;
+	list = usf_newpacklist();
+	other = usf_newpacklist();
+	for (i = 0; i < TESTSZ; i++) usf_packlistadd(list, i * 2 + (i & 1)); /* Evens then odds in pairs */
+	for (i = 0; i < TESTSZ / 10; i++) usf_packlistadd(other, i * i);
+	for (i = 0; i < 3; i++) usf_packlistadd(other, (u64) TESTSZ * TESTSZ); /* Duplicates */
+
+	result = usf_packlistintersect(list, other);
+	expected = usf_newlistu64();
+	for (i = 0; i < TESTSZ / 10; i++) if (i * i < TESTSZ * 2 && (i * i / 2 & 1) == (i * i & 1)) usf_listu64add(expected, i * i);
+	if (result == NULL || result->size != expected->size) {
+		printf("packlisttest: packlistintersect found %"PRIu64" values while expecting %"PRIu64", aborting.\n",
+				result ? result->size : 0, expected->size);
+		exit(7);
+	}
+	for (i = 0; i < expected->size; i++) if (usf_packlistget(result, i) != usf_listu64get(expected, i)) {
+		printf("packlisttest: packlistintersect holds %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_packlistget(result, i), i, usf_listu64get(expected, i));
+		exit(8);
+	}
+	printf("packlisttest: packlistintersect OK\n");
+	usf_freepacklist(result);
+
+	result = usf_packlistunion(list, other);
+	if (result == NULL || result->size != TESTSZ + TESTSZ / 10 + 1 - expected->size) {
+		printf("packlisttest: packlistunion found %"PRIu64" values, aborting.\n", result ? result->size : 0);
+		exit(9);
+	}
+	usf_packlistcopy(result, 0, TESTSZ, copied);
+	for (i = 1; i < USF_MIN(result->size, TESTSZ); i++) if (copied[i] <= copied[i - 1]) {
+		printf("packlisttest: packlistunion holds %"PRIu64" after %"PRIu64", aborting.\n", copied[i], copied[i - 1]);
+		exit(10);
+	}
+	printf("packlisttest: packlistunion OK\n");
+	usf_freepacklist(result);
+	usf_freepacklist(list);
+	usf_freepacklist(other);
+	usf_freelistu64(expected);
+
+	/* CONCURRENT TESTS */
+	printf("packlisttest: Starting concurrency test!\n");
+	list = usf_newpacklist_ts();
+	for (i = 0; i < TESTSZ; i++) values[i] = i * 3;
+	usf_packlistaddn(list, values, TESTSZ);
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) if (usf_packlistget(list, i) != i * 3 || usf_packlistfind(list, i * 3) != i) {
+		printf("packlisttest: packlist contents mismatch at %"PRIu64", aborting.\n", i);
+		exit(11);
+	}
+	printf("packlisttest: packlistget OK\n");
+	printf("packlisttest: packlistfind OK\n");
+
+	other = usf_newpacklist_ts();
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) usf_packlistadd(other, 0);
+	result = usf_packlistunion(list, other);
+	if (other->size != TESTSZ || result == NULL || result->size != TESTSZ) {
+		printf("packlisttest: packlist holds %"PRIu64" values after concurrent additions, aborting.\n", other->size);
+		exit(12);
+	}
+	printf("packlisttest: packlistadd OK\n");
+	usf_freepacklist(result);
+	usf_freepacklist(list);
+	usf_freepacklist(other);
+	free(values);
+	free(copied);
+
+	/* PERFORMANCE TESTS */
+	printf("packlisttest: Starting performance tests!\n");
+	struct timespec start, end;
+	usf_listu64 *twin;
+	f64 time;
+	values = malloc(PERFSZ * sizeof(u64));
+	for (i = 0, value = 0; i < PERFSZ; i++) values[i] = value += 1 + usf_hash(i) % 16; /* Dense ids */
+
+	list = usf_newpacklist();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_packlistaddn(list, values, PERFSZ);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	usage = usf_packlistmemusage(list);
+	printf("packlisttest: packlistaddn: %f ns, %f bytes per value (list sz %d).\n",
+			time / PERFSZ, (f64) (usage.array + usage.nodes) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_packlistcopy(list, 0, PERFSZ, values);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("packlisttest: packlistcopy: %f ns per value (list sz %d).\n", time / PERFSZ, PERFSZ);
+
+	twin = usf_newlistu64();
+	for (i = 0; i < PERFSZ; i++) usf_listu64add(twin, values[i]);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = r = 0; i < PERFSZ; i++) r += usf_listu64get(twin, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("packlisttest: listget: %f ns per value, 8 bytes per value (list sz %d).\n", time / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = r = 0; i < PERFSZ; i += 100) r += usf_packlistget(list, usf_hash(i) % PERFSZ);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("packlisttest: packlistget: %f ns (list sz %d).\n", time / (PERFSZ / 100), PERFSZ);
+
+	other = usf_newpacklist();
+	for (i = 0; i < PERFSZ; i += 1000) usf_packlistadd(other, values[i] + (i & 1));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	result = usf_packlistintersect(other, list);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("packlisttest: packlistintersect: %f ns per value of the short list (sizes %"PRIu64" and %d).\n",
+			time / other->size, other->size, PERFSZ);
+	usf_freepacklist(result);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	result = usf_packlistunion(other, list);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("packlisttest: packlistunion: %f ns per value (sizes %"PRIu64" and %d).\n",
+			time / (PERFSZ + other->size), other->size, PERFSZ);
+	usf_freepacklist(result);
+	usf_freepacklist(list);
+	usf_freepacklist(other);
+	usf_freelistu64(twin);
+	free(values);
+
+	printf("packlisttest: usfpacklist OK (ALL TESTS PASSED)\n");
+	return 0;
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include "usfpool.h"
+#include "usfqueue.h"
+#include "usfskiplist.h"
+#include "usftime.h"
+
+#define TESTSZ 100000
+#define PERFSZ 100000
+#define BATCHSZ 256
+
+static usf_compatibility_int threadworker(void *arg);
+
+i32 main(void) {
+	/* usfpool.c test */
+
+	u64 i;
+	usf_pool *pool;
+	u64 *values[TESTSZ];
+
+	/* NORMAL TESTS */
+
+	printf("pooltest: Starting test!\n");
+	pool = usf_newpool(24);
+
+	for (i = 0; i < TESTSZ; i++) {
+		values[i] = usf_poolalloc(pool);
+		if ((uintptr_t) values[i] % 8) {
+			printf("pooltest: poolalloc returned misaligned pointer %p, aborting.\n", (void *) values[i]);
+			exit(1);
+		}
+		values[i][0] = values[i][2] = i;
+	}
+	for (i = 0; i < TESTSZ; i++) if (values[i][0] != i || values[i][2] != i) {
+		printf("pooltest: pool contents mismatch at %"PRIu64", aborting.\n", i);
+		exit(2);
+	}
+	printf("pooltest: poolalloc OK\n");
+
+	void *first;
+	first = values[0];
+	for (i = 0; i < TESTSZ; i += 2) usf_poolfree(pool, values[i]);
+	for (i = 0; i < TESTSZ; i += 2) values[i] = usf_poolalloc(pool), values[i][0] = values[i][2] = i;
+	for (i = 0; i < TESTSZ; i++) if (values[i][0] != i || values[i][2] != i) {
+		printf("pooltest: recycled object overlaps a live one at %"PRIu64", aborting.\n", i);
+		exit(3);
+	}
+	printf("pooltest: poolfree OK\n");
+
+	usf_poolslab *slabs;
+	slabs = pool->slabs;
+	usf_poolreset(pool);
+	if (usf_poolalloc(pool) != first) {
+		printf("pooltest: poolreset did not reuse the first slab, aborting.\n");
+		exit(4);
+	}
+	for (i = 1; i < TESTSZ; i++) usf_poolalloc(pool);
+	if (pool->slabs != slabs || pool->freshslab->next != NULL) {
+		printf("pooltest: poolreset allocated new slabs, aborting.\n");
+		exit(5);
+	}
+	printf("pooltest: poolreset OK\n");
+	usf_freepool(pool);
+
+	usf_queue *queue;
+	usf_skiplist *skiplist;
+	queue = usf_newqueue();
+	skiplist = usf_newsk();
+	for (i = 0; i < TESTSZ; i++) usf_enqueue(queue, USFDATAU(i)), usf_skset(skiplist, i, USFDATAU(i));
+	for (i = 0; i < TESTSZ; i += 2) usf_skdel(skiplist, i);
+	for (i = 0; i < TESTSZ; i++) if (usf_dequeue(queue).u != i || usf_skget(skiplist, i).u != (i & 1 ? i : 0)) {
+		printf("pooltest: pool-backed containers mismatch at %"PRIu64", aborting.\n", i);
+		exit(6);
+	}
+	usf_freequeue(queue);
+	usf_freesk(skiplist);
+	printf("pooltest: pooled containers OK\n");
+
+	/* CONCURRENT TESTS */
+
+	printf("pooltest: Starting concurrency test!\n");
+	usf_thread threads[8];
+	usf_compatibility_int result;
+	u64 r;
+	pool = usf_newpool_ts(sizeof(u64));
+	for (i = 0; i < countof(threads); i++) usf_thrdcreate(&threads[i], threadworker, pool);
+	for (i = r = 0; i < countof(threads); i++) usf_thrdjoin(threads[i], &result), r |= (u64) result;
+	if (r) {
+		printf("pooltest: thread-safe pool handed out an object twice, aborting.\n");
+		exit(7);
+	}
+	usf_freepool(pool);
+	printf("pooltest: thread-safe pool OK\n");
+
+	/* PERFORMANCE TESTS */
+
+	printf("pooltest: Starting performance tests!\n");
+	struct timespec start, end;
+
+	pool = usf_newpool(32);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) values[i] = usf_poolalloc(pool);
+	for (i = 0; i < PERFSZ; i++) usf_poolfree(pool, values[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freepool(pool);
+	printf("pooltest: poolalloc + poolfree: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	pool = usf_newpool_ts(32);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) values[i] = usf_poolalloc(pool);
+	for (i = 0; i < PERFSZ; i++) usf_poolfree(pool, values[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freepool(pool);
+	printf("pooltest: poolalloc + poolfree (ts): %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) values[i] = usf_malloc(32);
+	for (i = 0; i < PERFSZ; i++) usf_free(values[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("pooltest: malloc + free: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	printf("pooltest: usfpool OK (ALL TESTS PASSED)\n");
+	return 0;
+}
+
+static usf_compatibility_int threadworker(void *arg) {
+	usf_pool *pool;
+	u64 i, j, *objects[BATCHSZ];
+	pool = arg;
+	for (i = 0; i < TESTSZ / BATCHSZ; i++) {
+		for (j = 0; j < BATCHSZ; j++) *(objects[j] = usf_poolalloc(pool)) = (uintptr_t) objects;
+		usf_thrdyield();
+		for (j = 0; j < BATCHSZ; j++) if (*objects[j] != (uintptr_t) objects) return 1;
+		for (j = 0; j < BATCHSZ; j++) usf_poolfree(pool, objects[j]);
+	}
+	return 0;
+}
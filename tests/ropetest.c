@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include "usfrope.h"
+#include "usflist.h"
+#include "usfmath.h"
+#include "usftime.h"
+
+#define TESTSZ 100000
+#define PERFSZ 100000
+#define EDITSZ 1000
+
+static u64 checknode(const usf_ropebase *rope, const void *node, u64 depth, u64 *nleaves, u64 *nnodes);
+
+i32 main(void) {
+	/* usfrope.c test */
+
+	u64 i, r, index, nleaves, nnodes;
+	usf_ropeu64 *rope;
+	usf_listu64 *twin;
+
+	/* NORMAL TESTS */
+
+	printf("ropetest: Starting test!\n");
+	rope = usf_newropeu64();
+
+	for (i = 0; i < TESTSZ; i++) usf_ropeu64add(rope, i);
+	for (i = 0; i < TESTSZ; i++) if (usf_ropeu64get(rope, i) != i) {
+		printf("ropetest: rope contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_ropeu64get(rope, i), i);
+		exit(1);
+	}
+	if (usf_ropeu64get(rope, TESTSZ) != 0 || usf_ropeu64set(rope, TESTSZ + 1, 7) != NULL
+			|| usf_ropeu64ins(rope, TESTSZ + 1, 7) != NULL) {
+		printf("ropetest: rope accepted an index past its size, aborting.\n");
+		exit(2);
+	}
+	if (rope->rope.nleaves != (TESTSZ * sizeof(u64) + USF_ROPE_LEAFSIZE - 1) / USF_ROPE_LEAFSIZE) {
+		printf("ropetest: appending left %"PRIu64" leaves partly empty, aborting.\n", rope->rope.nleaves);
+		exit(3);
+	}
+	printf("ropetest: ropeadd OK\n");
+	printf("ropetest: ropeget OK\n");
+
+	for (i = 0; i < TESTSZ; i++) usf_ropeu64set(rope, i, i * 3);
+	for (i = 0; i < TESTSZ; i++) if (usf_ropeu64get(rope, i) != i * 3) {
+		printf("ropetest: ropeset left bad value %"PRIu64" at %"PRIu64", aborting.\n",
+				usf_ropeu64get(rope, i), i);
+		exit(4);
+	}
+	printf("ropetest: ropeset OK\n");
+
+	for (i = 0; i < TESTSZ; i += 2) if ((r = usf_ropeu64del(rope, i / 2)) != i * 3) {
+		printf("ropetest: ropedel returned bad value %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				r, i * 3);
+		exit(5);
+	}
+	nleaves = nnodes = 0;
+	if (rope->rope.size != TESTSZ / 2 || checknode(&rope->rope, rope->rope.root, rope->rope.depth, &nleaves, &nnodes) != TESTSZ / 2
+			|| nleaves != rope->rope.nleaves || nnodes != rope->rope.nnodes) {
+		printf("ropetest: rope is malformed after deleting half of it, aborting.\n");
+		exit(6);
+	}
+	for (i = 0; i < TESTSZ / 2; i++) usf_ropeu64del(rope, (TESTSZ / 2 - i) / 2);
+	if (rope->rope.root != NULL || rope->rope.size != 0 || rope->rope.nleaves != 0 || rope->rope.nnodes != 0) {
+		printf("ropetest: emptied rope still holds %"PRIu64" nodes, aborting.\n", rope->rope.nnodes);
+		exit(7);
+	}
+	printf("ropetest: ropedel OK\n");
+	usf_freeropeu64(rope);
+
+	rope = usf_newropeu64();
+	twin = usf_newlistu64();
+	for (i = 0; i < TESTSZ * 2; i++) { /* Random mix against a list */
+		index = twin->size ? usf_hash(i) % (twin->size + 1) : 0;
+		if (i % 3 == 2 && twin->size) usf_ropeu64del(rope, index % twin->size), usf_listu64del(twin, index % twin->size);
+		else if (i % 5 == 4 && index < twin->size) usf_ropeu64set(rope, index, i), usf_listu64set(twin, index, i);
+		else usf_ropeu64ins(rope, index, i), usf_listu64ins(twin, index, i);
+	}
+	nleaves = nnodes = 0;
+	if (rope->rope.size != twin->size || checknode(&rope->rope, rope->rope.root, rope->rope.depth, &nleaves, &nnodes) != twin->size
+			|| nleaves != rope->rope.nleaves || nnodes != rope->rope.nnodes) {
+		printf("ropetest: rope is malformed after random operations, aborting.\n");
+		exit(8);
+	}
+	for (i = 0; i < twin->size; i++) if (usf_ropeu64get(rope, i) != usf_listu64get(twin, i)) {
+		printf("ropetest: rope holds %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_ropeu64get(rope, i), i, usf_listu64get(twin, i));
+		exit(9);
+	}
+	printf("ropetest: random operations OK\n");
+
+	u64 copied[TESTSZ];
+	usf_memusage usage;
+	if (usf_ropeu64copy(rope, 10, TESTSZ, copied) != rope->rope.size - 10 || usf_ropeu64copy(rope, rope->rope.size, 1, copied)) {
+		printf("ropetest: ropecopy copied a bad number of elements, aborting.\n");
+		exit(10);
+	}
+	for (i = 10; i < twin->size; i++) if (copied[i - 10] != usf_listu64get(twin, i)) {
+		printf("ropetest: ropecopy copied %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				copied[i - 10], i, usf_listu64get(twin, i));
+		exit(11);
+	}
+	printf("ropetest: ropecopy OK\n");
+
+	usage = usf_ropeu64memusage(rope);
+	if (usage.array != rope->rope.size * sizeof(u64) || usage.nodes < rope->rope.nnodes * sizeof(usf_ropenode)
+			|| usage.array + usage.slack != rope->rope.nleaves * rope->rope.leafcapacity * sizeof(u64)) {
+		printf("ropetest: ropememusage reported %"PRIu64" bytes of elements, aborting.\n", usage.array);
+		exit(12);
+	}
+	printf("ropetest: ropememusage OK\n");
+	usf_freeropeu64(rope);
+	usf_freelistu64(twin);
+
+	/* CONCURRENT TESTS */
+	printf("ropetest: Starting concurrency test!\n");
+	rope = usf_newropeu64_ts();
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) usf_ropeu64ins(rope, 0, 1);
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) usf_ropeu64set(rope, i, i);
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) if (usf_ropeu64get(rope, i) != i) {
+		printf("ropetest: rope contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_ropeu64get(rope, i), i);
+		exit(13);
+	}
+	printf("ropetest: ropeins OK\n");
+	printf("ropetest: ropeset OK\n");
+	printf("ropetest: ropeget OK\n");
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ / 2; i++) usf_ropeu64del(rope, 0);
+	nleaves = nnodes = 0;
+	if (rope->rope.size != TESTSZ / 2 || checknode(&rope->rope, rope->rope.root, rope->rope.depth, &nleaves, &nnodes) != TESTSZ / 2) {
+		printf("ropetest: rope is malformed after concurrent deletions, aborting.\n");
+		exit(14);
+	}
+	printf("ropetest: ropedel OK\n");
+	usf_freeropeu64(rope);
+
+	/* PERFORMANCE TESTS */
+	printf("ropetest: Starting performance tests!\n");
+	struct timespec start, end;
+	f64 time;
+	rope = usf_newropeu64();
+	twin = usf_newlistu64();
+	for (i = 0; i < PERFSZ; i++) usf_ropeu64add(rope, i), usf_listu64add(twin, i);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < EDITSZ; i++) usf_ropeu64ins(rope, usf_hash(i) % rope->rope.size, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("ropetest: ropeins at random: %f ns (rope sz %d).\n", time / EDITSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < EDITSZ; i++) usf_listu64ins(twin, usf_hash(i) % twin->size, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("ropetest: listins at random: %f ns (list sz %d).\n", time / EDITSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) usf_ropeu64get(rope, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("ropetest: ropeget: %f ns (rope sz %d).\n", time / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	usf_ropeu64copy(rope, 0, PERFSZ, copied);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("ropetest: ropecopy: %f ns per element (rope sz %d).\n", time / PERFSZ, PERFSZ);
+	usf_freeropeu64(rope);
+	usf_freelistu64(twin);
+
+	printf("ropetest: usfrope OK (ALL TESTS PASSED)\n");
+	return 0;
+}
+
+static u64 checknode(const usf_ropebase *rope, const void *node, u64 depth, u64 *nleaves, u64 *nnodes) {
+	/* Returns the number of elements under node and counts its leaves and inner nodes,
+	 * or exits if a node's counts are wrong, a node or leaf is empty or overfull,
+	 * or its leaves are at uneven depths */
+
+	const usf_ropenode *inner;
+	u64 count, k;
+	if (node == NULL) return 0;
+	if (depth == 0) {
+		count = ((const usf_ropeleaf *) node)->count;
+		if (count == 0 || count > rope->leafcapacity) exit(100);
+		(*nleaves)++;
+		return count;
+	}
+
+	inner = node;
+	if (inner->nchildren == 0 || inner->nchildren > USF_ROPE_FANOUT) exit(101);
+	for (k = 0, count = 0; k < inner->nchildren; k++) {
+		if (checknode(rope, inner->children[k], depth - 1, nleaves, nnodes) != inner->counts[k]) exit(102);
+		count += inner->counts[k];
+	}
+	(*nnodes)++;
+	return count;
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include "usfseglist.h"
+#include "usflist.h"
+#include "usfmath.h"
+#include "usftime.h"
+
+#define TESTSZ 100000
+#define PERFSZ 1000000
+
+i32 main(void) {
+	/* usfseglist.c test */
+
+	u64 i, r, *addresses[TESTSZ];
+	usf_seglistu64 *list;
+
+	/* NORMAL TESTS */
+
+	printf("seglisttest: Starting test!\n");
+	list = usf_newseglistu64();
+
+	for (i = 0; i < TESTSZ; i++) {
+		usf_seglistu64add(list, i);
+		addresses[i] = usf_seglistu64at(list, i);
+	}
+	for (i = 0; i < TESTSZ; i++) if (usf_seglistu64get(list, i) != i || *addresses[i] != i) {
+		printf("seglisttest: seglist contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_seglistu64get(list, i), i);
+		exit(1);
+	}
+	if (usf_seglistu64get(list, TESTSZ) != 0 || usf_seglistu64at(list, TESTSZ) != NULL
+			|| usf_seglistu64set(list, TESTSZ + 1, 7) != NULL) {
+		printf("seglisttest: seglist accepted an index past its size, aborting.\n");
+		exit(2);
+	}
+	printf("seglisttest: seglistadd OK\n");
+	printf("seglisttest: seglistget OK\n");
+	printf("seglisttest: seglistat OK\n");
+
+	for (i = 0; i < TESTSZ; i++) usf_seglistu64set(list, i, i * 3);
+	for (i = 0; i < TESTSZ; i++) if (*addresses[i] != i * 3) {
+		printf("seglisttest: seglistset left bad value %"PRIu64" at %"PRIu64", aborting.\n", *addresses[i], i);
+		exit(3);
+	}
+	printf("seglisttest: seglistset OK\n");
+
+	for (i = 0; i < TESTSZ; i += 2) if ((r = usf_seglistu64del(list, i / 2)) != i * 3) {
+		printf("seglisttest: seglistdel returned bad value %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				r, i * 3);
+		exit(4);
+	}
+	for (i = 0; i < TESTSZ / 2; i++) if (usf_seglistu64get(list, i) != (i * 2 + 1) * 3) {
+		printf("seglisttest: seglistdel left bad value %"PRIu64" at %"PRIu64", aborting.\n",
+				usf_seglistu64get(list, i), i);
+		exit(5);
+	}
+	printf("seglisttest: seglistdel OK\n");
+
+	u64 capacity;
+	usf_memusage usage;
+	capacity = list->capacity;
+	usf_seglistu64shrink(list);
+	if (list->capacity >= capacity || list->capacity < list->size || usf_seglistu64at(list, 0) != addresses[0]) {
+		printf("seglisttest: seglistshrink left a capacity of %"PRIu64", aborting.\n", list->capacity);
+		exit(6);
+	}
+	if (usf_seglistu64reserve(list, TESTSZ * 4) == NULL || list->capacity < TESTSZ * 4
+			|| usf_seglistu64at(list, TESTSZ / 2 - 1) != addresses[TESTSZ / 2 - 1]) {
+		printf("seglisttest: seglistreserve left a capacity of %"PRIu64", aborting.\n", list->capacity);
+		exit(7);
+	}
+	printf("seglisttest: seglistshrink OK\n");
+	printf("seglisttest: seglistreserve OK\n");
+
+	usage = usf_seglistu64memusage(list);
+	if (usage.array != list->size * sizeof(u64) || usage.array + usage.slack != list->capacity * sizeof(u64)) {
+		printf("seglisttest: seglistmemusage reported %"PRIu64" bytes of elements, aborting.\n", usage.array);
+		exit(8);
+	}
+	printf("seglisttest: seglistmemusage OK\n");
+	usf_freeseglistu64(list);
+
+	/* CONCURRENT TESTS */
+	printf("seglisttest: Starting concurrency test!\n");
+	list = usf_newseglistu64_ts();
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) usf_seglistu64add(list, 1);
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) usf_seglistu64set(list, i, i);
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ; i++) if (usf_seglistu64get(list, i) != i || *usf_seglistu64at(list, i) != i) {
+		printf("seglisttest: seglist contents mismatch at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_seglistu64get(list, i), i);
+		exit(9);
+	}
+	printf("seglisttest: seglistadd OK\n");
+	printf("seglisttest: seglistset OK\n");
+	printf("seglisttest: seglistget OK\n");
+
+#ifndef USFTEST_NO_PARALLEL
+#pragma omp parallel for
+#endif
+	for (i = 0; i < TESTSZ / 100; i++) usf_seglistu64del(list, 0);
+	if (list->size != TESTSZ - TESTSZ / 100 || usf_seglistu64get(list, 0) != TESTSZ / 100) {
+		printf("seglisttest: seglist holds %"PRIu64" elements after concurrent deletions, aborting.\n", list->size);
+		exit(10);
+	}
+	printf("seglisttest: seglistdel OK\n");
+	usf_freeseglistu64(list);
+
+	/* PERFORMANCE TESTS */
+	printf("seglisttest: Starting performance tests!\n");
+	struct timespec start, end;
+	usf_listu64 *twin;
+	f64 time;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	list = usf_newseglistu64();
+	for (i = 0; i < PERFSZ; i++) usf_seglistu64add(list, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("seglisttest: seglistadd: %f ns (list sz %d).\n", time / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	twin = usf_newlistu64();
+	for (i = 0; i < PERFSZ; i++) usf_listu64add(twin, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("seglisttest: listadd: %f ns (list sz %d).\n", time / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = r = 0; i < PERFSZ; i++) r += usf_seglistu64get(list, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("seglisttest: seglistget: %f ns (list sz %d).\n", time / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = r = 0; i < PERFSZ; i++) r += usf_listu64get(twin, i);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	time = usf_elapsedtimens(start, end);
+	printf("seglisttest: listget: %f ns (list sz %d).\n", time / PERFSZ, PERFSZ);
+	usf_freeseglistu64(list);
+	usf_freelistu64(twin);
+
+	printf("seglisttest: usfseglist OK (ALL TESTS PASSED)\n");
+	return 0;
+}
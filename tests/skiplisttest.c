@@ -5,6 +5,9 @@
 
 #define TESTSZ 100000
 #define PERFSZ 100000
+#define WINDOWSZ 1000
+
+static void rangesum(u64 index, usf_data data, void *context);
 
 i32 main(void) {
 	/* usfskiplist.c test */
@@ -36,7 +39,176 @@ i32 main(void) {
 				usf_skget(skiplist, i * 2).u);
 	}
 	printf("skiplisttest: skdel OK\n");
+
+	usf_memusage usage;
+	usf_skipnode *node;
+	u64 nodebytes, maxheight;
+	for (node = skiplist->base[0], nodebytes = maxheight = 0; node; node = node->nextnodes[0])
+		nodebytes += USF_SKIPNODESIZE(node->height), maxheight = USF_MAX(maxheight, node->height);
+	if (skiplist->level != maxheight || nodebytes > skiplist->size * USF_SKIPNODESIZE(4)) {
+		printf("skiplisttest: skiplist has %"PRIu64" levels for a highest node of %"PRIu64", aborting.\n",
+				skiplist->level, maxheight);
+		exit(6);
+	}
+	usage = usf_skmemusage(skiplist);
+	if (skiplist->size != TESTSZ / 2 || usage.nodes != nodebytes
+			|| usage.total != usage.structure + usage.nodes + usage.slack) {
+		printf("skiplisttest: skmemusage reported %"PRIu64" bytes of nodes for %"PRIu64" elements, aborting.\n",
+				usage.nodes, skiplist->size);
+		exit(5);
+	}
+	printf("skiplisttest: skmemusage OK\n");
+	usf_freesk(skiplist);
+
+	usf_skiplist *twin;
+	usf_skipnode *twinnode;
+	skiplist = usf_newsk();
+	twin = usf_newsk();
+	usf_skseed(skiplist, 42);
+	usf_skseed(twin, 42);
+	for (i = 0; i < TESTSZ; i++) usf_skset(skiplist, i, USFDATAU(i)), usf_skset(twin, i, USFDATAU(i));
+	for (node = skiplist->base[0], twinnode = twin->base[0]; node;
+			node = node->nextnodes[0], twinnode = twinnode->nextnodes[0]) if (node->height != twinnode->height) {
+			printf("skiplisttest: equally seeded skiplists differ at index %"PRIu64", aborting.\n", node->index);
+			exit(7);
+		}
+	usf_freesk(skiplist);
+	usf_freesk(twin);
+	printf("skiplisttest: skseed OK\n");
+
+	u64 sum, index;
+	skiplist = usf_newsk();
+	for (i = 0; i < TESTSZ; i += 3) usf_skset(skiplist, i, USFDATAU(i));
+	sum = 0;
+	if (usf_skrange(skiplist, 10, 100, rangesum, &sum) != 30 || sum != 30 * (12 + 99) / 2) {
+		printf("skiplisttest: skrange visited the wrong elements (sum %"PRIu64"), aborting.\n", sum);
+		exit(8);
+	}
+	printf("skiplisttest: skrange OK\n");
+
+	if (usf_skfloor(skiplist, 10, &index).u != 9 || index != 9
+			|| usf_skceil(skiplist, 10, &index).u != 12 || index != 12
+			|| usf_skfloor(skiplist, 9, NULL).u != 9 || usf_skceil(skiplist, 9, NULL).u != 9
+			|| usf_skfirst(skiplist, &index).u != 0 || index != 0
+			|| usf_sklast(skiplist, &index).u != (TESTSZ - 1) / 3 * 3 || index != (TESTSZ - 1) / 3 * 3) {
+		printf("skiplisttest: floor/ceil/first/last returned a bad index %"PRIu64", aborting.\n", index);
+		exit(9);
+	}
+	index = 1;
+	if (usf_skceil(skiplist, TESTSZ, &index).u != 0 || index != 1) {
+		printf("skiplisttest: skceil past the last element returned index %"PRIu64", aborting.\n", index);
+		exit(10);
+	}
+	printf("skiplisttest: skfloor/skceil OK\n");
+
+	usf_skipiter iter;
+	usf_skiterbegin(skiplist, &iter);
+	if (usf_skiterseek(&iter, 10)->index != 12 || usf_skiterprev(&iter)->index != 9
+			|| usf_skiternext(&iter)->index != 12) {
+		printf("skiplisttest: skiter seek/prev/next moved to the wrong node, aborting.\n");
+		exit(11);
+	}
+	for (usf_skiterskim(skiplist, &iter), r = 0; usf_skiternext(&iter); r++)
+		if (iter.node->index != r * 3) break;
+	for (index = 0; usf_skiterprev(&iter); index++);
+	if (r != skiplist->size || index != skiplist->size) {
+		printf("skiplisttest: skiter walked %"PRIu64" then %"PRIu64" nodes of %"PRIu64", aborting.\n",
+				r, index, skiplist->size);
+		exit(12);
+	}
+	usf_skiterend(&iter);
+	usf_freesk(skiplist);
+	printf("skiplisttest: skiter OK\n");
+
+	skiplist = usf_newsk();
+	twin = usf_newsk();
+	usf_skfinger(skiplist, 1);
+	for (i = 0; i < TESTSZ; i++) { /* Mixed nearby and random accesses */
+		index = i & 1 ? usf_hash(i) % TESTSZ : i / 2;
+		if (i % 5 == 4) usf_skdel(skiplist, index), usf_skdel(twin, index);
+		else usf_skset(skiplist, index, USFDATAU(index + 1)), usf_skset(twin, index, USFDATAU(index + 1));
+	}
+	for (i = 0; i < TESTSZ; i++) if (usf_skget(skiplist, i).u != usf_skget(twin, i).u) {
+		printf("skiplisttest: fingered skiplist holds %"PRIu64" at %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				usf_skget(skiplist, i).u, i, usf_skget(twin, i).u);
+		exit(13);
+	}
+	if (skiplist->size != twin->size) {
+		printf("skiplisttest: fingered skiplist has size %"PRIu64" while expecting %"PRIu64", aborting.\n",
+				skiplist->size, twin->size);
+		exit(14);
+	}
+	usf_freesk(skiplist);
+	usf_freesk(twin);
+	printf("skiplisttest: skfinger OK\n");
+
+	u64 indices[TESTSZ / 4];
+	usf_data sorted[TESTSZ / 4];
+	skiplist = usf_newsk();
+	for (i = 0; i < TESTSZ / 4; i++) indices[i] = i * 4, sorted[i] = USFDATAU(i);
+	usf_sksetsorted(skiplist, indices, sorted, TESTSZ / 4);
+	for (i = 0; i < TESTSZ; i++) if (usf_skget(skiplist, i).u != (i % 4 ? 0 : i / 4)) {
+		printf("skiplisttest: sksetsorted left bad value %"PRIu64" at %"PRIu64", aborting.\n",
+				usf_skget(skiplist, i).u, i);
+		exit(15);
+	}
+	if (skiplist->finger != NULL) {
+		printf("skiplisttest: sksetsorted left a temporary finger behind, aborting.\n");
+		exit(16);
+	}
 	usf_freesk(skiplist);
+	printf("skiplisttest: sksetsorted OK\n");
+
+	skiplist = usf_skfromsorted(indices, sorted, TESTSZ / 4);
+	if (skiplist == NULL || (void *) skiplist->base[0] != skiplist->block
+			|| skiplist->level != 64 - (u64) __builtin_clzll(TESTSZ / 4) || skiplist->size != TESTSZ / 4) {
+		printf("skiplisttest: skfromsorted built an unbalanced skiplist, aborting.\n");
+		exit(17);
+	}
+	for (i = 0; i < TESTSZ; i += 8) usf_skdel(skiplist, i);
+	for (i = 2; i < TESTSZ; i += 8) usf_skset(skiplist, i, USFDATAU(i / 4));
+	for (i = 0; i < TESTSZ; i++) if (usf_skget(skiplist, i).u != (i % 8 == 4 || i % 8 == 2 ? i / 4 : 0)) {
+		printf("skiplisttest: skfromsorted skiplist holds bad value %"PRIu64" at %"PRIu64", aborting.\n",
+				usf_skget(skiplist, i).u, i);
+		exit(18);
+	}
+	usf_freesk(skiplist);
+	indices[1] = indices[0];
+	if (usf_skfromsorted(indices, sorted, TESTSZ / 4) != NULL) {
+		printf("skiplisttest: skfromsorted accepted unsorted indices, aborting.\n");
+		exit(19);
+	}
+	printf("skiplisttest: skfromsorted OK\n");
+
+	for (r = 0; r < 3; r++) { /* Plain, fingered, and bulk-built skiplists */
+		skiplist = r == 2 ? usf_skfromsorted(indices + 2, sorted + 2, TESTSZ / 4 - 2) : usf_newsk();
+		if (r == 1) usf_skfinger(skiplist, 1);
+		for (i = 0; i < TESTSZ; i++) {
+			index = usf_hash(i + r) % TESTSZ;
+			if (i % 3 == 2) usf_skdel(skiplist, index);
+			else usf_skset(skiplist, index, USFDATAU(index + 1));
+		}
+		usf_skiterskim(skiplist, &iter);
+		for (i = 0; usf_skiternext(&iter); i++) {
+			if (usf_skrank(skiplist, iter.node->index) != i || usf_skrank(skiplist, iter.node->index + 1) != i + 1) {
+				printf("skiplisttest: skrank returned %"PRIu64" for position %"PRIu64", aborting.\n",
+						usf_skrank(skiplist, iter.node->index), i);
+				exit(20);
+			}
+			if (usf_skselect(skiplist, i, &index).u != iter.node->data.u || index != iter.node->index) {
+				printf("skiplisttest: skselect returned index %"PRIu64" for position %"PRIu64" while expecting %"PRIu64", aborting.\n",
+						index, i, iter.node->index);
+				exit(21);
+			}
+		}
+		if (i != skiplist->size || usf_skselect(skiplist, i, NULL).u != 0 || usf_skrank(skiplist, U64_MAX) != i) {
+			printf("skiplisttest: skiplist holds %"PRIu64" elements but has size %"PRIu64", aborting.\n",
+					i, skiplist->size);
+			exit(22);
+		}
+		usf_freesk(skiplist);
+	}
+	printf("skiplisttest: skrank/skselect OK\n");
 
 	/* CONCURRENT TESTS */
 	printf("skiplisttest: Starting concurrency test!\n");
@@ -121,6 +293,68 @@ i32 main(void) {
 	}
 	printf("skiplisttest: skdel: %f ns (max sample sz %d).\n", time / ncycles, PERFSZ);
 
+	skiplist = usf_newsk();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) usf_skset(skiplist, i, USFDATAU(i));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freesk(skiplist);
+	printf("skiplisttest: skset append: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	u64 perfindices[PERFSZ];
+	usf_data perfdata[PERFSZ];
+	for (i = 0; i < PERFSZ; i++) perfindices[i] = i, perfdata[i] = USFDATAU(i);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	skiplist = usf_skfromsorted(perfindices, perfdata, PERFSZ);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("skiplisttest: skfromsorted: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) usf_skget(skiplist, randvals[i] % PERFSZ);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freesk(skiplist);
+	printf("skiplisttest: skget after skfromsorted: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	skiplist = usf_newsk();
+	usf_skfinger(skiplist, 1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < PERFSZ; i++) usf_skset(skiplist, i, USFDATAU(i));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("skiplisttest: skset append with finger: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = sum = 0; i < PERFSZ; i++) sum += usf_skget(skiplist, i).u;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_freesk(skiplist);
+	printf("skiplisttest: skget sequential with finger: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	skiplist = usf_newsk();
+	for (i = 0; i < PERFSZ; i++) usf_skset(skiplist, i * 2, USFDATAU(i));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = sum = 0; i < PERFSZ; i += WINDOWSZ) usf_skrange(skiplist, i, i + WINDOWSZ - 1, rangesum, &sum);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("skiplisttest: skrange: %f ns per index (window sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, WINDOWSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = sum = 0; i < PERFSZ; i++) sum += usf_skget(skiplist, i).u;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("skiplisttest: skget window: %f ns per index (window sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, WINDOWSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = sum = 0; i < PERFSZ; i++) sum += usf_skrank(skiplist, randvals[i] % (PERFSZ * 2));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("skiplisttest: skrank: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = sum = 0; i < PERFSZ; i++) sum += usf_skselect(skiplist, randvals[i] % PERFSZ, NULL).u;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("skiplisttest: skselect: %f ns (sample sz %d).\n", usf_elapsedtimens(start, end) / PERFSZ, PERFSZ);
+	usf_freesk(skiplist);
+
 	printf("skiplisttest: usfskiplist OK (ALL TESTS PASSED)\n");
 	return 0;
 }
+
+static void rangesum(u64 index, usf_data data, void *context) {
+	(void) data;
+	*(u64 *) context += index;
+}
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include "usfthread.h"
+#include "usfatomic.h"
+#include "usftime.h"
+
+#define NTHREADS 8
+#define TESTSZ 1000
+#define PERFSZ 10000
+
+usf_barrier barrier_;
+usf_latch latch_;
+usf_semaphore semaphore_;
+atomic_u64 counter_, inside_, maxinside_;
+u64 nserial_;
+
+static usf_compatibility_int pinworker(void *arg);
+static usf_compatibility_int barrierworker(void *arg);
+static usf_compatibility_int latchworker(void *arg);
+static usf_compatibility_int semaphoreworker(void *arg);
+static usf_compatibility_int perfworker(void *arg);
+static void runthreads(usf_threadfunc func);
+
+i32 main(void) {
+	/* usfthread.c test */
+
+	u64 r;
+	usf_compatibility_int pinned;
+
+	/* NORMAL TESTS */
+
+	printf("threadtest: Starting test!\n");
+	usf_cputopo *topology;
+	if ((topology = usf_newcputopo())) {
+		u32 cpus[1];
+		if (topology->ncores == 0 || usf_cputopocores(topology, cpus, 1) != topology->ncores) {
+			printf("threadtest: cputopocores returned inconsistent core count, aborting.\n");
+			exit(1);
+		}
+		usf_thread thread; /* Pinned in its own thread, as affinity is inherited by children */
+		usf_thrdcreate(&thread, pinworker, NULL);
+		usf_thrdjoin(thread, &pinned);
+		if (pinned != THRD_SUCCESS) {
+			printf("threadtest: thrdpincores failed to pin the current thread, aborting.\n");
+			exit(2);
+		}
+		printf("threadtest: %"PRIu64" CPUs, %"PRIu64" cores, %"PRIu64" packages, %"PRIu64" nodes.\n",
+				topology->ncpus, topology->ncores, topology->npackages, topology->nnodes);
+		usf_freecputopo(topology);
+	}
+	printf("threadtest: cputopo OK\n");
+
+	usf_seminit(&semaphore_, 1);
+	if (usf_semtrywait(&semaphore_) != THRD_SUCCESS || usf_semtrywait(&semaphore_) != THRD_BUSY) {
+		printf("threadtest: semtrywait did not take exactly one permit, aborting.\n");
+		exit(3);
+	}
+	usf_sempost(&semaphore_);
+	usf_semwait(&semaphore_);
+	usf_semdestroy(&semaphore_);
+	printf("threadtest: semtrywait OK\n");
+
+	/* CONCURRENT TESTS */
+
+	printf("threadtest: Starting concurrency test!\n");
+	usf_atminit(&counter_, 0);
+	usf_barrinit(&barrier_, NTHREADS);
+	nserial_ = 0;
+	runthreads(barrierworker); /* Workers check phase consistency themselves */
+	if ((r = usf_atmmld(&counter_, MEMORDER_RELAXED)) != NTHREADS * TESTSZ || nserial_ != TESTSZ * 2) {
+		printf("threadtest: barrwait let %"PRIu64" increments and %"PRIu64" serial threads through, aborting.\n",
+				r, nserial_);
+		exit(4);
+	}
+	usf_barrdestroy(&barrier_);
+	printf("threadtest: barrwait OK\n");
+
+	usf_latchinit(&latch_, NTHREADS);
+	usf_atminit(&counter_, 0);
+	runthreads(latchworker);
+	if (!usf_latchtrywait(&latch_)) {
+		printf("threadtest: latch is still closed after all countdowns, aborting.\n");
+		exit(5);
+	}
+	usf_latchdestroy(&latch_);
+	printf("threadtest: latchwait OK\n");
+
+	usf_seminit(&semaphore_, 2);
+	usf_atminit(&inside_, 0);
+	usf_atminit(&maxinside_, 0);
+	runthreads(semaphoreworker);
+	if ((r = usf_atmmld(&maxinside_, MEMORDER_RELAXED)) > 2) {
+		printf("threadtest: semwait let %"PRIu64" threads in while expecting at most 2, aborting.\n", r);
+		exit(6);
+	}
+	usf_semdestroy(&semaphore_);
+	printf("threadtest: semwait OK\n");
+
+	/* PERFORMANCE TESTS */
+
+	printf("threadtest: Starting performance tests!\n");
+	struct timespec start, end;
+
+	usf_barrinit(&barrier_, NTHREADS);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	runthreads(perfworker);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usf_barrdestroy(&barrier_);
+	printf("threadtest: barrwait: %f ns per phase (%d threads, sample sz %d).\n",
+			usf_elapsedtimens(start, end) / PERFSZ, NTHREADS, PERFSZ);
+
+	printf("threadtest: usfthread OK (ALL TESTS PASSED)\n");
+	return 0;
+}
+
+static usf_compatibility_int pinworker(void *arg) {
+	(void) arg;
+	usf_thread self;
+	self = usf_thrdcurrent();
+	return usf_thrdpincores(&self, 1);
+}
+
+static usf_compatibility_int barrierworker(void *arg) {
+	(void) arg;
+	u64 phase, r;
+	for (phase = 0; phase < TESTSZ; phase++) {
+		usf_atmaddi(&counter_, 1, MEMORDER_RELAXED);
+		if (usf_barrwait(&barrier_)) nserial_++; /* Only one thread per phase */
+		if ((r = usf_atmmld(&counter_, MEMORDER_RELAXED)) != NTHREADS * (phase + 1)) {
+			printf("threadtest: barrwait released a thread early (counter %"PRIu64" at phase %"PRIu64
+					"), aborting.\n", r, phase);
+			exit(7);
+		}
+		if (usf_barrwait(&barrier_)) nserial_++;
+	}
+	return 0;
+}
+
+static usf_compatibility_int latchworker(void *arg) {
+	(void) arg;
+	usf_atmaddi(&counter_, 1, MEMORDER_RELAXED);
+	usf_latchcountdown(&latch_, 1);
+	usf_latchwait(&latch_);
+	if (usf_atmmld(&counter_, MEMORDER_RELAXED) != NTHREADS) {
+		printf("threadtest: latchwait returned before the latch opened, aborting.\n");
+		exit(8);
+	}
+	return 0;
+}
+
+static usf_compatibility_int semaphoreworker(void *arg) {
+	(void) arg;
+	u64 i, inside, max;
+	for (i = 0; i < TESTSZ; i++) {
+		usf_semwait(&semaphore_);
+		inside = usf_atmaddi(&inside_, 1, MEMORDER_RELAXED) + 1;
+		for (max = usf_atmmld(&maxinside_, MEMORDER_RELAXED); inside > max;)
+			if (usf_atmcmpxch_weak(&maxinside_, &max, inside, MEMORDER_RELAXED, MEMORDER_RELAXED)) break;
+		usf_atmsubi(&inside_, 1, MEMORDER_RELAXED);
+		usf_sempost(&semaphore_);
+	}
+	return 0;
+}
+
+static usf_compatibility_int perfworker(void *arg) {
+	(void) arg;
+	u64 phase;
+	for (phase = 0; phase < PERFSZ; phase++) usf_barrwait(&barrier_);
+	return 0;
+}
+
+static void runthreads(usf_threadfunc func) {
+	u64 i;
+	usf_thread threads[NTHREADS];
+	for (i = 0; i < NTHREADS; i++) usf_thrdcreate(&threads[i], func, NULL);
+	for (i = 0; i < NTHREADS; i++) usf_thrdjoin(threads[i], NULL);
+}